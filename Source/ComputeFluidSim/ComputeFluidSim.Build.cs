@@ -29,6 +29,7 @@ public class ComputeFluidSim : ModuleRules
 				"Core",
 				"Engine",
 				"MaterialShaderQualitySettings",
+				"ComputeFluidSimCore",
 
 				// ... add other public dependencies that you statically link with here ...
 			}
@@ -46,6 +47,7 @@ public class ComputeFluidSim : ModuleRules
 				"Renderer",
 				"Projects",
 				"RHI",
+				"Json",
 				// ... add private dependencies that you statically link with here ...	
 			}
 			);
@@ -3,8 +3,6 @@
 #include "ShaderCompilerCore.h"
 
 
-const int FluidSimThreads = 8;
-
 void FObjectGPUAdvectionShader::ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
 {
 	FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
@@ -16,18 +14,52 @@ void FObjectGPUAdvectionShader::ModifyCompilationEnvironment(const FGlobalShader
 }
 
 
+bool FObjectGPUInjectionShader::ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+{
+	// Injections without events are never dispatched.
+	const FPermutationDomain PermutationVector(Parameters.PermutationId);
+	return PermutationVector.Get<FluidSimPermutation::FInjectVelocityDim>() ||
+		PermutationVector.Get<FluidSimPermutation::FInjectPressureDim>() ||
+		PermutationVector.Get<FluidSimPermutation::FInjectFanPressureDim>() ||
+		PermutationVector.Get<FluidSimPermutation::FInjectDensityDim>();
+}
+
 void FObjectGPUInjectionShader::ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
 {
 	FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
 
+	const FPermutationDomain PermutationVector(Parameters.PermutationId);
+	const int32 Threads = FluidSimPermutation::GetGroupSize(PermutationVector.Get<FluidSimPermutation::FGroupShapeDim>());
+	OutEnvironment.SetDefine(TEXT("THREADS_X"), Threads);
+	OutEnvironment.SetDefine(TEXT("THREADS_Y"), Threads);
+	OutEnvironment.SetDefine(TEXT("THREADS_Z"), Threads);
+	OutEnvironment.CompilerFlags.Add(ECompilerFlags::CFLAG_AllowTypedUAVLoads); // DX12 feature for the float4 type
+}
+
+
+void FObjectGPUDissipationShader::ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+{
+	FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+
+	const FPermutationDomain PermutationVector(Parameters.PermutationId);
+	const int32 Threads = FluidSimPermutation::GetGroupSize(PermutationVector.Get<FluidSimPermutation::FGroupShapeDim>());
+	OutEnvironment.SetDefine(TEXT("THREADS_X"), Threads);
+	OutEnvironment.SetDefine(TEXT("THREADS_Y"), Threads);
+	OutEnvironment.SetDefine(TEXT("THREADS_Z"), Threads);
+	OutEnvironment.CompilerFlags.Add(ECompilerFlags::CFLAG_AllowTypedUAVLoads); // DX12 feature for the float4 type
+}
+
+void FObjectGPUDiffusionShader::ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+{
+	FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+
 	OutEnvironment.SetDefine(TEXT("THREADS_X"), FluidSimThreads);
 	OutEnvironment.SetDefine(TEXT("THREADS_Y"), FluidSimThreads);
 	OutEnvironment.SetDefine(TEXT("THREADS_Z"), FluidSimThreads);
 	OutEnvironment.CompilerFlags.Add(ECompilerFlags::CFLAG_AllowTypedUAVLoads); // DX12 feature for the float4 type
 }
 
-
-void FObjectGPUDissipationShader::ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+void FObjectGPUDivergenceShader::ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
 {
 	FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
 
@@ -37,7 +69,7 @@ void FObjectGPUDissipationShader::ModifyCompilationEnvironment(const FGlobalShad
 	OutEnvironment.CompilerFlags.Add(ECompilerFlags::CFLAG_AllowTypedUAVLoads); // DX12 feature for the float4 type
 }
 
-void FObjectGPUDiffusionShader::ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+void FObjectGPUProjectPressureShader::ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
 {
 	FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
 
@@ -47,7 +79,7 @@ void FObjectGPUDiffusionShader::ModifyCompilationEnvironment(const FGlobalShader
 	OutEnvironment.CompilerFlags.Add(ECompilerFlags::CFLAG_AllowTypedUAVLoads); // DX12 feature for the float4 type
 }
 
-void FObjectGPUDivergenceShader::ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+void FObjectGPUPressureResidualShader::ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
 {
 	FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
 
@@ -57,7 +89,7 @@ void FObjectGPUDivergenceShader::ModifyCompilationEnvironment(const FGlobalShade
 	OutEnvironment.CompilerFlags.Add(ECompilerFlags::CFLAG_AllowTypedUAVLoads); // DX12 feature for the float4 type
 }
 
-void FObjectGPUProjectPressureShader::ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+void FObjectGPUPressureConvergenceShader::ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
 {
 	FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
 
@@ -75,4 +107,113 @@ void FObjectGPUProjectGradientShader::ModifyCompilationEnvironment(const FGlobal
 	OutEnvironment.SetDefine(TEXT("THREADS_Y"), FluidSimThreads);
 	OutEnvironment.SetDefine(TEXT("THREADS_Z"), FluidSimThreads);
 	OutEnvironment.CompilerFlags.Add(ECompilerFlags::CFLAG_AllowTypedUAVLoads); // DX12 feature for the float4 type
-}
\ No newline at end of file
+}
+
+void FObjectGPUScrollClearShader::ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+{
+	FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+
+	OutEnvironment.SetDefine(TEXT("THREADS_X"), FluidSimThreads);
+	OutEnvironment.SetDefine(TEXT("THREADS_Y"), FluidSimThreads);
+	OutEnvironment.SetDefine(TEXT("THREADS_Z"), FluidSimThreads);
+	OutEnvironment.CompilerFlags.Add(ECompilerFlags::CFLAG_AllowTypedUAVLoads); // DX12 feature for the float4 type
+}
+
+void FObjectGPUCascadeBoundaryShader::ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+{
+	FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+
+	OutEnvironment.SetDefine(TEXT("THREADS_X"), FluidSimThreads);
+	OutEnvironment.SetDefine(TEXT("THREADS_Y"), FluidSimThreads);
+	OutEnvironment.SetDefine(TEXT("THREADS_Z"), FluidSimThreads);
+	OutEnvironment.CompilerFlags.Add(ECompilerFlags::CFLAG_AllowTypedUAVLoads); // DX12 feature for the float4 type
+}
+
+void FObjectGPUCascadeRestrictShader::ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+{
+	FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+
+	OutEnvironment.SetDefine(TEXT("THREADS_X"), FluidSimThreads);
+	OutEnvironment.SetDefine(TEXT("THREADS_Y"), FluidSimThreads);
+	OutEnvironment.SetDefine(TEXT("THREADS_Z"), FluidSimThreads);
+	OutEnvironment.CompilerFlags.Add(ECompilerFlags::CFLAG_AllowTypedUAVLoads); // DX12 feature for the float4 type
+}
+
+void FObjectGPUResampleShader::ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+{
+	FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+
+	OutEnvironment.SetDefine(TEXT("THREADS_X"), FluidSimThreads);
+	OutEnvironment.SetDefine(TEXT("THREADS_Y"), FluidSimThreads);
+	OutEnvironment.SetDefine(TEXT("THREADS_Z"), FluidSimThreads);
+	OutEnvironment.CompilerFlags.Add(ECompilerFlags::CFLAG_AllowTypedUAVLoads); // DX12 feature for the float4 type
+}
+
+void FObjectGPUBrickOccupancyShader::ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+{
+	FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+
+	OutEnvironment.SetDefine(TEXT("THREADS_X"), FluidSimThreads);
+	OutEnvironment.SetDefine(TEXT("THREADS_Y"), FluidSimThreads);
+	OutEnvironment.SetDefine(TEXT("THREADS_Z"), FluidSimThreads);
+	OutEnvironment.CompilerFlags.Add(ECompilerFlags::CFLAG_AllowTypedUAVLoads); // DX12 feature for the float4 type
+}
+
+void FObjectGPUBrickDilateShader::ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+{
+	FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+
+	OutEnvironment.SetDefine(TEXT("THREADS_X"), FluidSimThreads);
+	OutEnvironment.SetDefine(TEXT("THREADS_Y"), FluidSimThreads);
+	OutEnvironment.SetDefine(TEXT("THREADS_Z"), FluidSimThreads);
+	OutEnvironment.CompilerFlags.Add(ECompilerFlags::CFLAG_AllowTypedUAVLoads); // DX12 feature for the float4 type
+}
+
+void FObjectGPUDiagnosticsReduceShader::ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+{
+	FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+
+	OutEnvironment.SetDefine(TEXT("THREADS_X"), FluidSimThreads);
+	OutEnvironment.SetDefine(TEXT("THREADS_Y"), FluidSimThreads);
+	OutEnvironment.SetDefine(TEXT("THREADS_Z"), FluidSimThreads);
+	OutEnvironment.CompilerFlags.Add(ECompilerFlags::CFLAG_AllowTypedUAVLoads); // DX12 feature for the float4 type
+}
+
+void FObjectGPUDiagnosticsResolveShader::ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+{
+	FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+
+	OutEnvironment.SetDefine(TEXT("THREADS_X"), FluidSimThreads);
+	OutEnvironment.SetDefine(TEXT("THREADS_Y"), FluidSimThreads);
+	OutEnvironment.SetDefine(TEXT("THREADS_Z"), FluidSimThreads);
+	OutEnvironment.CompilerFlags.Add(ECompilerFlags::CFLAG_AllowTypedUAVLoads); // DX12 feature for the float4 type
+}
+
+void FObjectGPUSequenceBlendShader::ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+{
+	FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+
+	OutEnvironment.SetDefine(TEXT("THREADS_X"), FluidSimThreads);
+	OutEnvironment.SetDefine(TEXT("THREADS_Y"), FluidSimThreads);
+	OutEnvironment.SetDefine(TEXT("THREADS_Z"), FluidSimThreads);
+	OutEnvironment.CompilerFlags.Add(ECompilerFlags::CFLAG_AllowTypedUAVLoads); // DX12 feature for the float4 type
+}
+
+void FObjectGPUObstacleScatterShader::ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+{
+	FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+
+	OutEnvironment.SetDefine(TEXT("THREADS_X"), FluidSimThreads);
+	OutEnvironment.SetDefine(TEXT("THREADS_Y"), FluidSimThreads);
+	OutEnvironment.SetDefine(TEXT("THREADS_Z"), FluidSimThreads);
+}
+
+void FObjectGPUColliderRasterShader::ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+{
+	FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+
+	OutEnvironment.SetDefine(TEXT("THREADS_X"), FluidSimThreads);
+	OutEnvironment.SetDefine(TEXT("THREADS_Y"), FluidSimThreads);
+	OutEnvironment.SetDefine(TEXT("THREADS_Z"), FluidSimThreads);
+	OutEnvironment.CompilerFlags.Add(ECompilerFlags::CFLAG_AllowTypedUAVLoads); // DX12 feature for the float4 type
+}
@@ -5,6 +5,73 @@
 #include "GlobalShader.h"
 #include "ShaderParameterStruct.h"
 
+// Threads per group on every axis, dispatches cover the domain with DivideAndRoundUp(Resolution, FluidSimThreads) groups.
+constexpr int32 FluidSimThreads = 8;
+
+// What can be solid in a step, bit 0 obstacles and bit 1 colliders as FluidSimCommon.ush reads FLUIDSIM_BOUNDARY.
+enum class EFluidSimBoundaryMode : uint8
+{
+	Open,
+	Obstacles,
+	Colliders,
+	ObstaclesAndColliders,
+	MAX
+};
+
+// Thread group of the dense stages that don't work in bricks. Everything else is FluidSimThreads^3, the brick size.
+enum class EFluidSimGroupShape : uint8
+{
+	Cube8,
+	Cube4,
+	MAX
+};
+
+// Compile time variants. The proxy picks one per dispatch from what the step uses, so the kernels carry no branches
+// for features the scene doesn't have.
+namespace FluidSimPermutation
+{
+	class FSparseDim : SHADER_PERMUTATION_BOOL("FLUIDSIM_SPARSE");
+	class FBoundaryDim : SHADER_PERMUTATION_ENUM_CLASS("FLUIDSIM_BOUNDARY", EFluidSimBoundaryMode);
+	class FGroupShapeDim : SHADER_PERMUTATION_ENUM_CLASS("FLUIDSIM_GROUP_SHAPE", EFluidSimGroupShape);
+
+	// Event types present in an injection, each field's events are a loop of their own, see FluidSimInjectionShader.usf.
+	class FInjectVelocityDim : SHADER_PERMUTATION_BOOL("INJECT_VELOCITY");
+	class FInjectPressureDim : SHADER_PERMUTATION_BOOL("INJECT_PRESSURE");
+	class FInjectFanPressureDim : SHADER_PERMUTATION_BOOL("INJECT_FAN_PRESSURE");
+	class FInjectDensityDim : SHADER_PERMUTATION_BOOL("INJECT_DENSITY");
+	class FInjectStampDim : SHADER_PERMUTATION_BOOL("INJECT_STAMPS");
+
+	inline int32 GetGroupSize(const EFluidSimGroupShape Shape)
+	{
+		return Shape == EFluidSimGroupShape::Cube4 ? 4 : FluidSimThreads;
+	}
+
+	// The narrow groups only when the wide ones would overhang the domain further.
+	inline EFluidSimGroupShape GetGroupShape(const FIntVector& Resolution)
+	{
+		const FIntVector Wide = FIntVector::DivideAndRoundUp(Resolution, GetGroupSize(EFluidSimGroupShape::Cube8));
+		const FIntVector Narrow = FIntVector::DivideAndRoundUp(Resolution, GetGroupSize(EFluidSimGroupShape::Cube4));
+		return Wide * 2 == Narrow ? EFluidSimGroupShape::Cube8 : EFluidSimGroupShape::Cube4;
+	}
+}
+
+// Toroidal addressing of the simulation domain, see FluidSimCommon.ush.
+BEGIN_SHADER_PARAMETER_STRUCT(FFluidSimDomainParameters, )
+	SHADER_PARAMETER(FIntVector, DomainResolution)
+	SHADER_PARAMETER(FIntVector, DomainOffset)
+END_SHADER_PARAMETER_STRUCT()
+
+// Brick activity of sparse mode, read under FSparseDim, see IsBrickActive() in FluidSimCommon.ush.
+BEGIN_SHADER_PARAMETER_STRUCT(FFluidSimSparseParameters, )
+	SHADER_PARAMETER_RDG_BUFFER_SRV(Buffer<uint>, ActiveBricks)
+	SHADER_PARAMETER(FIntVector, BrickCount)
+END_SHADER_PARAMETER_STRUCT()
+
+// Voxelized obstacles and the moving colliders' boundary velocity, read under FBoundaryDim, see IsSolid() in FluidSimCommon.ush.
+BEGIN_SHADER_PARAMETER_STRUCT(FFluidSimObstacleParameters, )
+	SHADER_PARAMETER_RDG_TEXTURE_SRV(Texture3D<float>, Obstacles)
+	SHADER_PARAMETER_RDG_TEXTURE_SRV(Texture3D<FVector4f>, BoundaryVelocity)
+END_SHADER_PARAMETER_STRUCT()
 
 class FObjectGPUAdvectionShader : public FGlobalShader
 {
@@ -13,7 +80,12 @@ public:
 	DECLARE_GLOBAL_SHADER(FObjectGPUAdvectionShader);
 	SHADER_USE_PARAMETER_STRUCT(FObjectGPUAdvectionShader, FGlobalShader);
 
+	using FPermutationDomain = TShaderPermutationDomain<FluidSimPermutation::FSparseDim, FluidSimPermutation::FBoundaryDim>;
+
 	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_STRUCT_INCLUDE(FFluidSimDomainParameters, Domain)
+		SHADER_PARAMETER_STRUCT_INCLUDE(FFluidSimSparseParameters, Sparse)
+		SHADER_PARAMETER_STRUCT_INCLUDE(FFluidSimObstacleParameters, Obstacle)
 		SHADER_PARAMETER_RDG_TEXTURE_SRV(Texture3D<FVector4f>, RT_Field_Read)
 		SHADER_PARAMETER_RDG_TEXTURE_SRV(Texture3D<FVector4f>, RT_Velocity)
 		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture3D<FVector4f>, RT_Field_Write)
@@ -34,16 +106,29 @@ public:
 	DECLARE_GLOBAL_SHADER(FObjectGPUInjectionShader);
 	SHADER_USE_PARAMETER_STRUCT(FObjectGPUInjectionShader, FGlobalShader);
 
+	using FPermutationDomain = TShaderPermutationDomain<
+		FluidSimPermutation::FInjectVelocityDim,
+		FluidSimPermutation::FInjectPressureDim,
+		FluidSimPermutation::FInjectFanPressureDim,
+		FluidSimPermutation::FInjectDensityDim,
+		FluidSimPermutation::FInjectStampDim,
+		FluidSimPermutation::FGroupShapeDim>;
+
 	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_STRUCT_INCLUDE(FFluidSimDomainParameters, Domain)
 		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture3D<FVector4f>, RT_Velocity)
 		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture3D<FVector4f>, RT_Pressure)
 		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture3D<FVector4f>, RT_Density)
 		SHADER_PARAMETER_RDG_BUFFER_SRV(StructuredBuffer<float>, InjectionEventBuffer)
-		SHADER_PARAMETER(int, BufferLength)
+		SHADER_PARAMETER(FUintVector4, EventRanges)
 		SHADER_PARAMETER(FIntVector, FieldResolution)	
+		SHADER_PARAMETER_RDG_TEXTURE_SRV(Texture3D<FVector4f>, StampAtlas)
+		SHADER_PARAMETER_SAMPLER(SamplerState, StampSampler)
+		SHADER_PARAMETER(uint32, StampCount)
 	END_SHADER_PARAMETER_STRUCT()
 
 public:
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters);
 	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment);
 
 };
@@ -55,7 +140,10 @@ public:
 	DECLARE_GLOBAL_SHADER(FObjectGPUDissipationShader);
 	SHADER_USE_PARAMETER_STRUCT(FObjectGPUDissipationShader, FGlobalShader);
 
+	using FPermutationDomain = TShaderPermutationDomain<FluidSimPermutation::FGroupShapeDim>;
+
 	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_STRUCT_INCLUDE(FFluidSimDomainParameters, Domain)
 		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture3D<FVector4f>, RT_DissipationField)
 		SHADER_PARAMETER(float, DissipationGain)
 	END_SHADER_PARAMETER_STRUCT()
@@ -72,7 +160,11 @@ public:
 	DECLARE_GLOBAL_SHADER(FObjectGPUDiffusionShader);
 	SHADER_USE_PARAMETER_STRUCT(FObjectGPUDiffusionShader, FGlobalShader);
 
+	using FPermutationDomain = TShaderPermutationDomain<FluidSimPermutation::FSparseDim>;
+
 	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_STRUCT_INCLUDE(FFluidSimDomainParameters, Domain)
+		SHADER_PARAMETER_STRUCT_INCLUDE(FFluidSimSparseParameters, Sparse)
 		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture3D<FVector4f>, RT_DiffusionField)
 		SHADER_PARAMETER(float, DiffusionGain)
 	END_SHADER_PARAMETER_STRUCT()
@@ -89,7 +181,12 @@ public:
 	DECLARE_GLOBAL_SHADER(FObjectGPUDivergenceShader);
 	SHADER_USE_PARAMETER_STRUCT(FObjectGPUDivergenceShader, FGlobalShader);
 
+	using FPermutationDomain = TShaderPermutationDomain<FluidSimPermutation::FSparseDim, FluidSimPermutation::FBoundaryDim>;
+
 	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_STRUCT_INCLUDE(FFluidSimDomainParameters, Domain)
+		SHADER_PARAMETER_STRUCT_INCLUDE(FFluidSimSparseParameters, Sparse)
+		SHADER_PARAMETER_STRUCT_INCLUDE(FFluidSimObstacleParameters, Obstacle)
 		SHADER_PARAMETER_RDG_TEXTURE_SRV(Texture3D<FVector4f>, RT_Divergence_Vel)
 		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture3D<FVector4f>, RT_Divergence)
 	END_SHADER_PARAMETER_STRUCT()
@@ -106,9 +203,56 @@ public:
 	DECLARE_GLOBAL_SHADER(FObjectGPUProjectPressureShader);
 	SHADER_USE_PARAMETER_STRUCT(FObjectGPUProjectPressureShader, FGlobalShader);
 
+	using FPermutationDomain = TShaderPermutationDomain<FluidSimPermutation::FSparseDim, FluidSimPermutation::FBoundaryDim>;
+
 	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_STRUCT_INCLUDE(FFluidSimDomainParameters, Domain)
+		SHADER_PARAMETER_STRUCT_INCLUDE(FFluidSimSparseParameters, Sparse)
+		SHADER_PARAMETER_STRUCT_INCLUDE(FFluidSimObstacleParameters, Obstacle)
 		SHADER_PARAMETER_RDG_TEXTURE_SRV(Texture3D<FVector4f>, RT_ProjPressure_Divergence)
 		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture3D<FVector4f>, RT_ProjPressure_Pressure)
+		RDG_BUFFER_ACCESS(IndirectArgs, ERHIAccess::IndirectArgs)
+	END_SHADER_PARAMETER_STRUCT()
+
+public:
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment);
+
+};
+
+class FObjectGPUPressureResidualShader : public FGlobalShader
+{
+public:
+
+	DECLARE_GLOBAL_SHADER(FObjectGPUPressureResidualShader);
+	SHADER_USE_PARAMETER_STRUCT(FObjectGPUPressureResidualShader, FGlobalShader);
+
+	using FPermutationDomain = TShaderPermutationDomain<FluidSimPermutation::FSparseDim, FluidSimPermutation::FBoundaryDim>;
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_STRUCT_INCLUDE(FFluidSimDomainParameters, Domain)
+		SHADER_PARAMETER_STRUCT_INCLUDE(FFluidSimSparseParameters, Sparse)
+		SHADER_PARAMETER_STRUCT_INCLUDE(FFluidSimObstacleParameters, Obstacle)
+		SHADER_PARAMETER_RDG_TEXTURE_SRV(Texture3D<FVector4f>, RT_Residual_Divergence)
+		SHADER_PARAMETER_RDG_TEXTURE_SRV(Texture3D<FVector4f>, RT_Residual_Pressure)
+		SHADER_PARAMETER_RDG_BUFFER_UAV(RWBuffer<uint>, RW_Residual)
+	END_SHADER_PARAMETER_STRUCT()
+
+public:
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment);
+
+};
+
+class FObjectGPUPressureConvergenceShader : public FGlobalShader
+{
+public:
+
+	DECLARE_GLOBAL_SHADER(FObjectGPUPressureConvergenceShader);
+	SHADER_USE_PARAMETER_STRUCT(FObjectGPUPressureConvergenceShader, FGlobalShader);
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_RDG_BUFFER_SRV(Buffer<uint>, Residual)
+		SHADER_PARAMETER_RDG_BUFFER_UAV(RWBuffer<uint>, RW_IndirectArgs)
+		SHADER_PARAMETER(float, TargetResidual)
 	END_SHADER_PARAMETER_STRUCT()
 
 public:
@@ -123,7 +267,12 @@ public:
 	DECLARE_GLOBAL_SHADER(FObjectGPUProjectGradientShader);
 	SHADER_USE_PARAMETER_STRUCT(FObjectGPUProjectGradientShader, FGlobalShader);
 
+	using FPermutationDomain = TShaderPermutationDomain<FluidSimPermutation::FSparseDim, FluidSimPermutation::FBoundaryDim>;
+
 	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_STRUCT_INCLUDE(FFluidSimDomainParameters, Domain)
+		SHADER_PARAMETER_STRUCT_INCLUDE(FFluidSimSparseParameters, Sparse)
+		SHADER_PARAMETER_STRUCT_INCLUDE(FFluidSimObstacleParameters, Obstacle)
 		SHADER_PARAMETER_RDG_TEXTURE_SRV(Texture3D<FVector4f>, RT_ProjGradient_Pressure)
 		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture3D<FVector4f>, RT_ProjGradient_Velocity)
 	END_SHADER_PARAMETER_STRUCT()
@@ -133,3 +282,229 @@ public:
 
 };
 
+class FObjectGPUScrollClearShader : public FGlobalShader
+{
+public:
+	
+	DECLARE_GLOBAL_SHADER(FObjectGPUScrollClearShader);
+	SHADER_USE_PARAMETER_STRUCT(FObjectGPUScrollClearShader, FGlobalShader);
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_STRUCT_INCLUDE(FFluidSimDomainParameters, Domain)
+		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture3D<FVector4f>, RT_Scroll_Velocity)
+		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture3D<FVector4f>, RT_Scroll_Density)
+		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture3D<FVector4f>, RT_Scroll_Pressure)
+		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture3D<float>, RT_Scroll_Obstacles)
+		SHADER_PARAMETER(FIntVector, ScrollDelta)
+	END_SHADER_PARAMETER_STRUCT()
+
+public:
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment);
+
+};
+
+class FObjectGPUCascadeBoundaryShader : public FGlobalShader
+{
+public:
+	
+	DECLARE_GLOBAL_SHADER(FObjectGPUCascadeBoundaryShader);
+	SHADER_USE_PARAMETER_STRUCT(FObjectGPUCascadeBoundaryShader, FGlobalShader);
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_STRUCT_INCLUDE(FFluidSimDomainParameters, Domain)
+		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture3D<FVector4f>, RT_Boundary_Velocity)
+		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture3D<FVector4f>, RT_Boundary_Density)
+		SHADER_PARAMETER_RDG_TEXTURE_SRV(Texture3D<FVector4f>, RT_Coarse_Velocity)
+		SHADER_PARAMETER_RDG_TEXTURE_SRV(Texture3D<FVector4f>, RT_Coarse_Density)
+		SHADER_PARAMETER(FIntVector, CoarseDomainOffset)
+		SHADER_PARAMETER(FVector3f, FineToCoarse)
+	END_SHADER_PARAMETER_STRUCT()
+
+public:
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment);
+
+};
+
+class FObjectGPUCascadeRestrictShader : public FGlobalShader
+{
+public:
+	
+	DECLARE_GLOBAL_SHADER(FObjectGPUCascadeRestrictShader);
+	SHADER_USE_PARAMETER_STRUCT(FObjectGPUCascadeRestrictShader, FGlobalShader);
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_STRUCT_INCLUDE(FFluidSimDomainParameters, Domain)
+		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture3D<FVector4f>, RT_Restrict_Velocity)
+		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture3D<FVector4f>, RT_Restrict_Density)
+		SHADER_PARAMETER_RDG_TEXTURE_SRV(Texture3D<FVector4f>, RT_Fine_Velocity)
+		SHADER_PARAMETER_RDG_TEXTURE_SRV(Texture3D<FVector4f>, RT_Fine_Density)
+		SHADER_PARAMETER(FIntVector, FineDomainOffset)
+		SHADER_PARAMETER(FVector3f, FineToCoarse)
+	END_SHADER_PARAMETER_STRUCT()
+
+public:
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment);
+
+};
+
+class FObjectGPUResampleShader : public FGlobalShader
+{
+public:
+	
+	DECLARE_GLOBAL_SHADER(FObjectGPUResampleShader);
+	SHADER_USE_PARAMETER_STRUCT(FObjectGPUResampleShader, FGlobalShader);
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_STRUCT_INCLUDE(FFluidSimDomainParameters, Domain)
+		SHADER_PARAMETER_RDG_TEXTURE_SRV(Texture3D<FVector4f>, RT_Resample_Source)
+		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture3D<FVector4f>, RT_Resample_Dest)
+		SHADER_PARAMETER(FIntVector, SourceResolution)
+		SHADER_PARAMETER(FIntVector, SourceOffset)
+		SHADER_PARAMETER(FVector4f, ValueScale)
+	END_SHADER_PARAMETER_STRUCT()
+
+public:
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment);
+
+};
+
+class FObjectGPUBrickOccupancyShader : public FGlobalShader
+{
+public:
+	
+	DECLARE_GLOBAL_SHADER(FObjectGPUBrickOccupancyShader);
+	SHADER_USE_PARAMETER_STRUCT(FObjectGPUBrickOccupancyShader, FGlobalShader);
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_STRUCT_INCLUDE(FFluidSimDomainParameters, Domain)
+		SHADER_PARAMETER_RDG_TEXTURE_SRV(Texture3D<FVector4f>, RT_Sparse_Velocity)
+		SHADER_PARAMETER_RDG_TEXTURE_SRV(Texture3D<FVector4f>, RT_Sparse_Density)
+		SHADER_PARAMETER_RDG_BUFFER_UAV(RWBuffer<uint>, RW_BrickOccupancy)
+		SHADER_PARAMETER(FIntVector, BrickCount)
+		SHADER_PARAMETER(float, SparseThreshold)
+	END_SHADER_PARAMETER_STRUCT()
+
+public:
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment);
+
+};
+
+class FObjectGPUBrickDilateShader : public FGlobalShader
+{
+public:
+	
+	DECLARE_GLOBAL_SHADER(FObjectGPUBrickDilateShader);
+	SHADER_USE_PARAMETER_STRUCT(FObjectGPUBrickDilateShader, FGlobalShader);
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_RDG_BUFFER_SRV(Buffer<uint>, BrickOccupancy)
+		SHADER_PARAMETER_RDG_BUFFER_UAV(RWBuffer<uint>, RW_ActiveBricks)
+		SHADER_PARAMETER_RDG_BUFFER_UAV(RWBuffer<uint>, RW_ActiveBrickCount)
+		SHADER_PARAMETER(FIntVector, BrickCount)
+		SHADER_PARAMETER(int, SparseMargin)
+	END_SHADER_PARAMETER_STRUCT()
+
+public:
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment);
+
+};
+
+class FObjectGPUDiagnosticsReduceShader : public FGlobalShader
+{
+public:
+	
+	DECLARE_GLOBAL_SHADER(FObjectGPUDiagnosticsReduceShader);
+	SHADER_USE_PARAMETER_STRUCT(FObjectGPUDiagnosticsReduceShader, FGlobalShader);
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_STRUCT_INCLUDE(FFluidSimDomainParameters, Domain)
+		SHADER_PARAMETER_RDG_TEXTURE_SRV(Texture3D<FVector4f>, RT_Diag_Velocity)
+		SHADER_PARAMETER_RDG_TEXTURE_SRV(Texture3D<FVector4f>, RT_Diag_Density)
+		SHADER_PARAMETER_RDG_BUFFER_UAV(RWBuffer<float>, RW_DiagPartials)
+		SHADER_PARAMETER(FIntVector, DiagGroupCount)
+	END_SHADER_PARAMETER_STRUCT()
+
+public:
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment);
+
+};
+
+class FObjectGPUDiagnosticsResolveShader : public FGlobalShader
+{
+public:
+	
+	DECLARE_GLOBAL_SHADER(FObjectGPUDiagnosticsResolveShader);
+	SHADER_USE_PARAMETER_STRUCT(FObjectGPUDiagnosticsResolveShader, FGlobalShader);
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_RDG_BUFFER_SRV(Buffer<float>, DiagPartials)
+		SHADER_PARAMETER_RDG_BUFFER_UAV(RWBuffer<float>, RW_Diagnostics)
+		SHADER_PARAMETER(uint32, NumPartials)
+	END_SHADER_PARAMETER_STRUCT()
+
+public:
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment);
+
+};
+
+class FObjectGPUSequenceBlendShader : public FGlobalShader
+{
+public:
+	
+	DECLARE_GLOBAL_SHADER(FObjectGPUSequenceBlendShader);
+	SHADER_USE_PARAMETER_STRUCT(FObjectGPUSequenceBlendShader, FGlobalShader);
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_STRUCT_INCLUDE(FFluidSimDomainParameters, Domain)
+		SHADER_PARAMETER_RDG_TEXTURE_SRV(Texture3D<FVector4f>, RT_Sequence_VelocityA)
+		SHADER_PARAMETER_RDG_TEXTURE_SRV(Texture3D<FVector4f>, RT_Sequence_VelocityB)
+		SHADER_PARAMETER_RDG_TEXTURE_SRV(Texture3D<FVector4f>, RT_Sequence_DensityA)
+		SHADER_PARAMETER_RDG_TEXTURE_SRV(Texture3D<FVector4f>, RT_Sequence_DensityB)
+		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture3D<FVector4f>, RT_Sequence_OutVelocity)
+		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture3D<FVector4f>, RT_Sequence_OutDensity)
+		SHADER_PARAMETER(float, FrameAlpha)
+	END_SHADER_PARAMETER_STRUCT()
+
+public:
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment);
+
+};
+
+class FObjectGPUObstacleScatterShader : public FGlobalShader
+{
+public:
+	
+	DECLARE_GLOBAL_SHADER(FObjectGPUObstacleScatterShader);
+	SHADER_USE_PARAMETER_STRUCT(FObjectGPUObstacleScatterShader, FGlobalShader);
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_STRUCT_INCLUDE(FFluidSimDomainParameters, Domain)
+		SHADER_PARAMETER_RDG_BUFFER_SRV(StructuredBuffer<FObstacleBrick>, ObstacleBricks)
+		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture3D<float>, RW_Obstacles)
+		SHADER_PARAMETER(FIntVector, LatticeOrigin)
+	END_SHADER_PARAMETER_STRUCT()
+
+public:
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment);
+
+};
+
+class FObjectGPUColliderRasterShader : public FGlobalShader
+{
+public:
+	
+	DECLARE_GLOBAL_SHADER(FObjectGPUColliderRasterShader);
+	SHADER_USE_PARAMETER_STRUCT(FObjectGPUColliderRasterShader, FGlobalShader);
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_STRUCT_INCLUDE(FFluidSimDomainParameters, Domain)
+		SHADER_PARAMETER_RDG_BUFFER_SRV(StructuredBuffer<FCollider>, Colliders)
+		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture3D<FVector4f>, RW_Boundary)
+		SHADER_PARAMETER(float, LevelScale)
+		SHADER_PARAMETER(FVector3f, LevelOffset)
+	END_SHADER_PARAMETER_STRUCT()
+
+public:
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment);
+
+};
@@ -0,0 +1,80 @@
+#include "FluidSimColliderComponent.h"
+
+#include "Engine/World.h"
+#include "FluidSimSubsystem.h"
+
+UFluidSimColliderComponent::UFluidSimColliderComponent()
+{
+	// Sampled by the manager, nothing to do per tick.
+	PrimaryComponentTick.bCanEverTick = false;
+}
+
+void UFluidSimColliderComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (UFluidSimSubsystem* Subsystem = GetWorld() ? GetWorld()->GetSubsystem<UFluidSimSubsystem>() : nullptr)
+	{
+		Subsystem->RegisterCollider(this);
+	}
+	bHasLastTransform = false;
+	SampledFrame = MAX_uint64;
+}
+
+void UFluidSimColliderComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UFluidSimSubsystem* Subsystem = GetWorld() ? GetWorld()->GetSubsystem<UFluidSimSubsystem>() : nullptr)
+	{
+		Subsystem->UnregisterCollider(this);
+	}
+	Super::EndPlay(EndPlayReason);
+}
+
+FFluidSimColliderState UFluidSimColliderComponent::Sample(const float DeltaTime) const
+{
+	if (SampledFrame == GFrameCounter)
+	{
+		return SampledState;
+	}
+
+	const FTransform& Transform = GetComponentTransform();
+	const FVector Scale = Transform.GetScale3D().GetAbs();
+
+	FFluidSimColliderState State;
+	State.Location = Transform.GetLocation();
+	State.Rotation = Transform.GetRotation();
+	switch (Shape)
+	{
+	case EFluidColliderShape::Box:
+		State.Extent = BoxExtent.GetAbs() * Scale;
+		break;
+
+	case EFluidColliderShape::Capsule:
+		State.Radius = Radius * FMath::Min(Scale.X, Scale.Y);
+		State.Extent = FVector(0.0f, 0.0f, FMath::Max(HalfHeight * Scale.Z - State.Radius, 0.0f));
+		break;
+
+	case EFluidColliderShape::Sphere:
+		State.Radius = Radius * Scale.GetMin();
+		break;
+	}
+
+	if (bHasLastTransform && DeltaTime > 0.0f)
+	{
+		State.Velocity = (State.Location - LastTransform.GetLocation()) / DeltaTime * VelocityScale;
+
+		// Shortest way round, a body can't turn half a revolution in a frame.
+		FQuat Delta = State.Rotation * LastTransform.GetRotation().Inverse();
+		Delta.EnforceShortestArcWith(FQuat::Identity);
+		FVector Axis;
+		float Angle;
+		Delta.ToAxisAndAngle(Axis, Angle);
+		State.AngularVelocity = Axis * (Angle / DeltaTime * VelocityScale);
+	}
+
+	LastTransform = Transform;
+	bHasLastTransform = true;
+	SampledState = State;
+	SampledFrame = GFrameCounter;
+	return State;
+}
@@ -0,0 +1,70 @@
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/SceneComponent.h"
+
+#include "FluidSimColliderComponent.generated.h"
+
+UENUM(BlueprintType)
+enum class EFluidColliderShape : uint8 {
+	Box = 0			UMETA(DisplayName = "Box"),
+	Capsule = 1		UMETA(DisplayName = "Capsule"),
+	Sphere = 2		UMETA(DisplayName = "Sphere"),
+};
+
+// World space shape of a collider and how fast it moves, in uu/s and rad/s. A box of half size Extent with edges
+// rounded by Radius, see FFluidSimColliderShaderData.
+struct FFluidSimColliderState
+{
+	FVector Location = FVector::ZeroVector;
+	FQuat Rotation = FQuat::Identity;
+	FVector Extent = FVector::ZeroVector;
+	float Radius = 0.0f;
+	FVector Velocity = FVector::ZeroVector;
+	FVector AngularVelocity = FVector::ZeroVector;
+};
+
+// A moving body that pushes the fluid, e.g. a vehicle or a character. Managers with bMovingColliders hand every
+// registered collider to the GPU as one instance a frame, they're all rasterized in one pass into the boundary velocity the projection
+// enforces. Far cheaper than a wake source per actor, which splats an injection event every frame.
+UCLASS(ClassGroup = (FluidSim), meta = (BlueprintSpawnableComponent))
+class COMPUTEFLUIDSIM_API UFluidSimColliderComponent : public USceneComponent
+{
+	GENERATED_BODY()
+
+public:
+	UFluidSimColliderComponent();
+
+	// Centred on the component and scaled by its world scale, capsules are upright along its Z axis.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	EFluidColliderShape Shape = EFluidColliderShape::Box;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (EditCondition = "Shape == EFluidColliderShape::Box"))
+	FVector BoxExtent = FVector(50.0f, 50.0f, 50.0f);
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = 0.0, EditCondition = "Shape != EFluidColliderShape::Box"))
+	float Radius = 50.0f;
+
+	// Including the hemispheres, like UCapsuleComponent.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = 0.0, EditCondition = "Shape == EFluidColliderShape::Capsule"))
+	float HalfHeight = 100.0f;
+
+	// Scales the velocity the fluid sees, 0 still blocks the fluid but doesn't push it.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	float VelocityScale = 1.0f;
+
+	// Velocity is the movement since the previous frame over DeltaTime, the first frame has none. Worked out by the first
+	// call of a frame, every other manager sampling the collider that frame gets the same state.
+	FFluidSimColliderState Sample(const float DeltaTime) const;
+
+protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	mutable FTransform LastTransform = FTransform::Identity;
+	mutable bool bHasLastTransform = false;
+	mutable FFluidSimColliderState SampledState;
+	mutable uint64 SampledFrame = MAX_uint64;
+};
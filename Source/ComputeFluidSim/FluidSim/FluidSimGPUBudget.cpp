@@ -0,0 +1,175 @@
+#include "FluidSimGPUBudget.h"
+
+#include "RenderGraphBuilder.h"
+#include "RHI.h"
+#include "RHICommandList.h"
+#include "ShaderParameterMacros.h"
+#include "Stats/Stats.h"
+#include "ProfilingDebugging/CsvProfiler.h"
+
+namespace
+{
+	constexpr float GPUTimeSmoothing = 0.2f;
+
+	// Recover once comfortably under budget, a few percent a frame.
+	constexpr float RecoverThreshold = 0.8f;
+	constexpr float RecoverRate = 1.03f;
+
+	// Orders the timestamp against the simulation passes on async compute. The field stays in the state they leave it
+	// in, so graphics has no reason to wait on the timestamp before its own passes.
+	BEGIN_SHADER_PARAMETER_STRUCT(FFluidSimTimestampParameters, )
+		RDG_TEXTURE_ACCESS(Field, ERHIAccess::UAVCompute)
+	END_SHADER_PARAMETER_STRUCT()
+
+	bool IsGPUTimeObserved()
+	{
+#if STATS
+		if (FThreadStats::IsCollectingData())
+		{
+			return true;
+		}
+#endif
+#if CSV_PROFILER
+		if (FCsvProfiler::Get()->IsCapturing_Renderthread())
+		{
+			return true;
+		}
+#endif
+		return false;
+	}
+}
+
+
+void FFluidSimGPUBudget::Update(const float BudgetMs, const bool bTimeWithoutBudget)
+{
+	check(IsInRenderingThread());
+
+	bTiming = GSupportsTimestampRenderQueries && (BudgetMs > 0.0f || bTimeWithoutBudget || IsGPUTimeObserved());
+	bEnabled = BudgetMs > 0.0f && bTiming;
+	if (!bEnabled)
+	{
+		WorkloadScale = 1.0f;
+	}
+	if (!bTiming)
+	{
+		// Frames still in flight would come back as a stale time once timing resumes.
+		for (FTimerQuery& Query : Queries)
+		{
+			Query.bPending = false;
+		}
+		LastGPUTimeMs = 0.0f;
+		SmoothedGPUTimeMs = 0.0f;
+		return;
+	}
+
+	if (!QueryPool.IsValid())
+	{
+		QueryPool = RHICreateRenderQueryPool(RQT_AbsoluteTime, NumQueries * 2);
+	}
+
+	for (FTimerQuery& Query : Queries)
+	{
+		if (!Query.bPending)
+		{
+			continue;
+		}
+
+		uint64 BeginMicroseconds = 0;
+		uint64 EndMicroseconds = 0;
+		if (!RHIGetRenderQueryResult(Query.Begin.GetQuery(), BeginMicroseconds, false) ||
+			!RHIGetRenderQueryResult(Query.End.GetQuery(), EndMicroseconds, false))
+		{
+			continue;
+		}
+		Query.bPending = false;
+
+		LastGPUTimeMs = static_cast<float>(EndMicroseconds - FMath::Min(BeginMicroseconds, EndMicroseconds)) / 1000.0f;
+		SmoothedGPUTimeMs = SmoothedGPUTimeMs > 0.0f ? FMath::Lerp(SmoothedGPUTimeMs, LastGPUTimeMs, GPUTimeSmoothing) : LastGPUTimeMs;
+		MeasurementCount++;
+		if (!bEnabled)
+		{
+			continue;
+		}
+
+		// Cost is roughly proportional to the workload, so over budget goes straight to the scale that would have fit.
+		// Derived from the scale the frame ran at rather than the current one, the frames still in flight when the
+		// scale changed then ask for the same scale instead of cutting again on top of it.
+		if (LastGPUTimeMs > BudgetMs)
+		{
+			WorkloadScale = FMath::Min(WorkloadScale, FMath::Clamp(Query.WorkloadScale * BudgetMs / LastGPUTimeMs, MinWorkloadScale, 1.0f));
+		}
+		else if (LastGPUTimeMs < BudgetMs * RecoverThreshold && Query.WorkloadScale == WorkloadScale)
+		{
+			// Only from frames that ran at the current scale, one step up per frame measured since the last change.
+			WorkloadScale = FMath::Min(WorkloadScale * RecoverRate, 1.0f);
+		}
+	}
+}
+
+FFluidSolverSettings FFluidSimGPUBudget::Apply(const FFluidSolverSettings& InSettings) const
+{
+	if (!bEnabled || WorkloadScale >= 1.0f)
+	{
+		return InSettings;
+	}
+
+	auto Scaled = [this](const int32 Value, const int32 Min) { return FMath::Max(FMath::RoundToInt(Value * WorkloadScale), Min); };
+
+	FFluidSolverSettings Settings = InSettings;
+	Settings.PressureIterations = Scaled(InSettings.PressureIterations, 1);
+	Settings.MaxPressureIterations = Scaled(InSettings.MaxPressureIterations, 1);
+	Settings.MinPressureIterations = FMath::Min(Settings.MinPressureIterations, Settings.MaxPressureIterations);
+	Settings.MaxSubsteps = Scaled(InSettings.MaxSubsteps, 1);
+	Settings.SparseMargin = Scaled(InSettings.SparseMargin, 0);
+	return Settings;
+}
+
+void FFluidSimGPUBudget::BeginFrame(FRDGBuilder& GraphBuilder, FRDGTextureRef Field)
+{
+	ActiveQuery = INDEX_NONE;
+	if (!bTiming || Queries[NextQuery].bPending)
+	{
+		return;
+	}
+
+	ActiveQuery = NextQuery;
+	NextQuery = (NextQuery + 1) % NumQueries;
+
+	// The pool only holds the queries of the slots, hand the old ones back first.
+	FTimerQuery& Query = Queries[ActiveQuery];
+	Query.Begin.ReleaseQuery();
+	Query.End.ReleaseQuery();
+	Query.Begin = QueryPool->AllocateQuery();
+	Query.End = QueryPool->AllocateQuery();
+	Query.WorkloadScale = WorkloadScale;
+	AddTimestampPass(GraphBuilder, Field, Query.Begin.GetQuery());
+}
+
+void FFluidSimGPUBudget::EndFrame(FRDGBuilder& GraphBuilder, FRDGTextureRef Field)
+{
+	if (ActiveQuery == INDEX_NONE)
+	{
+		return;
+	}
+
+	FTimerQuery& Query = Queries[ActiveQuery];
+	AddTimestampPass(GraphBuilder, Field, Query.End.GetQuery());
+	Query.bPending = true;
+	ActiveQuery = INDEX_NONE;
+}
+
+void FFluidSimGPUBudget::AddTimestampPass(FRDGBuilder& GraphBuilder, FRDGTextureRef Field, FRHIRenderQuery* Query) const
+{
+	FFluidSimTimestampParameters* PassParameters = GraphBuilder.AllocParameters<FFluidSimTimestampParameters>();
+	PassParameters->Field = Field;
+
+	GraphBuilder.AddPass(
+		RDG_EVENT_NAME("FluidSimTimestamp"),
+		PassParameters,
+		ERDGPassFlags::AsyncCompute | ERDGPassFlags::NeverCull,
+		[Query](FRHICommandList& RHICmdList)
+		{
+			RHICmdList.EndRenderQuery(Query);
+		}
+	);
+}
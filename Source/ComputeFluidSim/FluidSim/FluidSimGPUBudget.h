@@ -0,0 +1,68 @@
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "RHIResources.h"
+#include "RenderGraphDefinitions.h"
+#include "FluidStructs.h"
+
+// Closed loop controller keeping a simulation's GPU time per frame within a budget, render thread only.
+// The frame's simulation passes are bracketed by timestamp queries on the async compute pipe they run on, read back a
+// few frames later without waiting on the GPU. Frames are only timed when something reads the time: the budget,
+// diagnostics, stat collection or a CSV capture. Over budget the workload is scaled down,
+// pressure iterations first as they dominate the step, along with the catch up substeps and the sparse margin. Under
+// budget it recovers slowly to avoid oscillating.
+class FFluidSimGPUBudget
+{
+public:
+	// Lowest workload the budget scales down to, past it only a lower resolution helps.
+	static constexpr float MinWorkloadScale = 0.25f;
+
+	// Reads back whatever frames finished and moves the workload towards the budget. A budget of 0 turns the scaling off,
+	// bTimeWithoutBudget keeps the frames timed for a consumer of the time other than stats.
+	void Update(const float BudgetMs, const bool bTimeWithoutBudget);
+
+	// Settings with the current workload applied.
+	FFluidSolverSettings Apply(const FFluidSolverSettings& InSettings) const;
+
+	// Bracket every pass of the frame's steps. Both stay on async compute, the end only waits for the passes writing Field.
+	void BeginFrame(FRDGBuilder& GraphBuilder, FRDGTextureRef Field);
+	void EndFrame(FRDGBuilder& GraphBuilder, FRDGTextureRef Field);
+
+	float GetWorkloadScale() const { return WorkloadScale; }
+	float GetGPUTimeMs() const { return SmoothedGPUTimeMs; }
+	float GetLastGPUTimeMs() const { return LastGPUTimeMs; }
+
+	// Counts the frames timed so far, changes whenever the times above do.
+	uint32 GetMeasurementCount() const { return MeasurementCount; }
+
+private:
+	struct FTimerQuery
+	{
+		FRHIPooledRenderQuery Begin;
+		FRHIPooledRenderQuery End;
+		bool bPending = false;
+
+		// Scale the frame's steps ran at.
+		float WorkloadScale = 1.0f;
+	};
+
+	void AddTimestampPass(FRDGBuilder& GraphBuilder, FRDGTextureRef Field, FRHIRenderQuery* Query) const;
+
+	bool bTiming = false;
+	bool bEnabled = false;
+	FRenderQueryPoolRHIRef QueryPool;
+
+	// A few frames in flight, a frame is only timed if a slot is free.
+	static constexpr int32 NumQueries = 4;
+	FTimerQuery Queries[NumQueries];
+	int32 NextQuery = 0;
+	int32 ActiveQuery = INDEX_NONE;
+
+	float SmoothedGPUTimeMs = 0.0f;
+	float LastGPUTimeMs = 0.0f;
+	uint32 MeasurementCount = 0;
+
+	// 1 is the authored workload.
+	float WorkloadScale = 1.0f;
+};
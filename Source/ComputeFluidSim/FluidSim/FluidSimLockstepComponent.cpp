@@ -0,0 +1,170 @@
+#include "FluidSimLockstepComponent.h"
+
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "FluidSimLog.h"
+#include "FluidSimulationManager.h"
+
+namespace
+{
+	// Well under net.MaxRepArraySize, a 64x64x32 snapshot is a few hundred of these.
+	constexpr int32 ResyncChunkSize = 2048;
+
+	// Per tick, so a resync doesn't flood the reliable buffer.
+	constexpr int32 ResyncChunksPerTick = 16;
+
+	// Seconds between snapshots to one connection, a client asking more often waits.
+	constexpr double ResyncInterval = 2.0;
+}
+
+UFluidSimLockstepComponent::UFluidSimLockstepComponent()
+{
+	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.bStartWithTickEnabled = false;
+	SetIsReplicatedByDefault(true);
+}
+
+void UFluidSimLockstepComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	if (!OutgoingManager.IsValid() && DeferredManager.IsValid() && GetWorld()->GetRealTimeSeconds() >= NextResyncTime)
+	{
+		StartResync(DeferredManager.Get());
+		DeferredManager.Reset();
+	}
+
+	AFluidSimulationManager* Manager = OutgoingManager.Get();
+	const int32 ChunkCount = FMath::DivideAndRoundUp(Outgoing.Num(), ResyncChunkSize);
+	for (int32 Sent = 0; Manager != nullptr && OutgoingChunk < ChunkCount && Sent < ResyncChunksPerTick; Sent++, OutgoingChunk++)
+	{
+		const int32 Offset = OutgoingChunk * ResyncChunkSize;
+		ClientResyncChunk(Manager, OutgoingChunk, ChunkCount, TArray<uint8>(Outgoing.GetData() + Offset, FMath::Min(ResyncChunkSize, Outgoing.Num() - Offset)));
+	}
+
+	if (Manager == nullptr || OutgoingChunk >= ChunkCount)
+	{
+		OutgoingManager.Reset();
+		Outgoing.Empty();
+		SetComponentTickEnabled(DeferredManager.IsValid());
+	}
+}
+
+template<typename FunctionType>
+void UFluidSimLockstepComponent::ForEachRemote(const AFluidSimulationManager* Manager, FunctionType&& Function)
+{
+	const UWorld* World = Manager->GetWorld();
+	if (World == nullptr)
+	{
+		return;
+	}
+
+	for (FConstPlayerControllerIterator It = World->GetPlayerControllerIterator(); It; ++It)
+	{
+		const APlayerController* PlayerController = It->Get();
+		if (PlayerController != nullptr && !PlayerController->IsLocalController())
+		{
+			if (UFluidSimLockstepComponent* Component = PlayerController->FindComponentByClass<UFluidSimLockstepComponent>())
+			{
+				Function(*Component);
+			}
+		}
+	}
+}
+
+void UFluidSimLockstepComponent::BroadcastSteps(AFluidSimulationManager* Manager, const TArray<uint8>& Steps)
+{
+	ForEachRemote(Manager, [Manager, &Steps](UFluidSimLockstepComponent& Component) { Component.ClientSteps(Manager, Steps); });
+}
+
+void UFluidSimLockstepComponent::BroadcastHash(AFluidSimulationManager* Manager, const int32 Step, const uint32 Hash)
+{
+	ForEachRemote(Manager, [Manager, Step, Hash](UFluidSimLockstepComponent& Component) { Component.ClientHash(Manager, Step, Hash); });
+}
+
+UFluidSimLockstepComponent* UFluidSimLockstepComponent::FindLocal(const UWorld* World)
+{
+	const APlayerController* PlayerController = World != nullptr ? World->GetFirstPlayerController() : nullptr;
+	return PlayerController != nullptr ? PlayerController->FindComponentByClass<UFluidSimLockstepComponent>() : nullptr;
+}
+
+void UFluidSimLockstepComponent::ClientSteps_Implementation(AFluidSimulationManager* Manager, const TArray<uint8>& Steps)
+{
+	if (IsValid(Manager))
+	{
+		Manager->ReceiveLockstepSteps(Steps);
+	}
+}
+
+void UFluidSimLockstepComponent::ClientHash_Implementation(AFluidSimulationManager* Manager, const int32 Step, const uint32 Hash)
+{
+	if (IsValid(Manager))
+	{
+		Manager->ReceiveLockstepHash(Step, Hash);
+	}
+}
+
+void UFluidSimLockstepComponent::ServerRequestResync_Implementation(AFluidSimulationManager* Manager)
+{
+	if (!IsValid(Manager) || Manager->GetWorld() != GetWorld())
+	{
+		return;
+	}
+
+	// The snapshot on its way already brings the client up to date, a new one would only restart the send.
+	if (OutgoingManager == Manager)
+	{
+		UE_LOG(LogFluidSim, Verbose, TEXT("'%s' ignored a resync request for '%s', a snapshot is still being sent."), *GetNameSafe(GetOwner()), *Manager->GetName());
+		return;
+	}
+
+	// One snapshot at a time and at most one per ResyncInterval, whatever is asked for meanwhile is sent after. The
+	// client doesn't ask again while it waits, so one deferred request per connection is all there is to keep.
+	if (OutgoingManager.IsValid() || GetWorld()->GetRealTimeSeconds() < NextResyncTime)
+	{
+		DeferredManager = Manager;
+		SetComponentTickEnabled(true);
+		return;
+	}
+
+	StartResync(Manager);
+}
+
+void UFluidSimLockstepComponent::StartResync(AFluidSimulationManager* Manager)
+{
+	if (!IsValid(Manager) || !Manager->SaveLockstepSnapshot(Outgoing))
+	{
+		return;
+	}
+
+	OutgoingManager = Manager;
+	OutgoingChunk = 0;
+	NextResyncTime = GetWorld()->GetRealTimeSeconds() + ResyncInterval;
+	SetComponentTickEnabled(true);
+}
+
+void UFluidSimLockstepComponent::ClientResyncChunk_Implementation(AFluidSimulationManager* Manager, const int32 ChunkIndex, const int32 ChunkCount, const TArray<uint8>& Chunk)
+{
+	// Reliable and in order, a first chunk always starts a new snapshot.
+	if (ChunkIndex == 0)
+	{
+		Incoming.Reset();
+		IncomingChunk = 0;
+	}
+	if (ChunkIndex != IncomingChunk)
+	{
+		return;
+	}
+
+	Incoming.Append(Chunk);
+	IncomingChunk++;
+	if (IncomingChunk == ChunkCount)
+	{
+		if (IsValid(Manager))
+		{
+			Manager->ApplyLockstepSnapshot(Incoming);
+		}
+		Incoming.Empty();
+		IncomingChunk = 0;
+	}
+}
@@ -0,0 +1,58 @@
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+
+#include "FluidSimLockstepComponent.generated.h"
+
+// Network channel of lockstep simulations, see AFluidSimulationManager::bLockstep. Level placed managers aren't owned
+// by a connection so can't take server calls, the subsystem adds one of these to every player controller instead.
+UCLASS()
+class COMPUTEFLUIDSIM_API UFluidSimLockstepComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UFluidSimLockstepComponent();
+
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+	// Server, sent to every remote player. The local player's simulation is the authority's own.
+	static void BroadcastSteps(class AFluidSimulationManager* Manager, const TArray<uint8>& Steps);
+	static void BroadcastHash(class AFluidSimulationManager* Manager, const int32 Step, const uint32 Hash);
+
+	// Client, the component of the first local player.
+	static UFluidSimLockstepComponent* FindLocal(const UWorld* World);
+
+	UFUNCTION(Client, Reliable)
+	void ClientSteps(class AFluidSimulationManager* Manager, const TArray<uint8>& Steps);
+
+	UFUNCTION(Client, Reliable)
+	void ClientHash(class AFluidSimulationManager* Manager, const int32 Step, const uint32 Hash);
+
+	// Asks the server for a snapshot, it arrives in chunks a few at a time.
+	UFUNCTION(Server, Reliable)
+	void ServerRequestResync(class AFluidSimulationManager* Manager);
+
+	UFUNCTION(Client, Reliable)
+	void ClientResyncChunk(class AFluidSimulationManager* Manager, const int32 ChunkIndex, const int32 ChunkCount, const TArray<uint8>& Chunk);
+
+private:
+	template<typename FunctionType>
+	static void ForEachRemote(const class AFluidSimulationManager* Manager, FunctionType&& Function);
+
+	// Server, starts sending the manager's snapshot.
+	void StartResync(class AFluidSimulationManager* Manager);
+
+	// Server, the snapshot still being sent and the request waiting for it or for ResyncInterval to pass.
+	TWeakObjectPtr<class AFluidSimulationManager> OutgoingManager;
+	TArray<uint8> Outgoing;
+	int32 OutgoingChunk = 0;
+	TWeakObjectPtr<class AFluidSimulationManager> DeferredManager;
+	double NextResyncTime = 0.0;
+
+	// Client, the snapshot being received.
+	TArray<uint8> Incoming;
+	int32 IncomingChunk = 0;
+};
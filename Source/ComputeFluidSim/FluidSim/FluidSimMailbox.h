@@ -0,0 +1,62 @@
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include <atomic>
+
+// Single producer, single consumer triple buffer.
+// The producer writes into its own slot and publishes it by swapping it with the shared middle slot, the consumer
+// swaps its slot with the middle when there is something new. Neither side ever waits on the other.
+// A packet is never overwritten before it is consumed: while the middle slot is still unread Publish() fails and the
+// producer keeps accumulating into its write slot, which then goes out with the next successful Publish().
+// T must provide Reset(), it is called on a slot when it is handed back to the producer.
+template<typename T>
+class TFluidSimMailbox
+{
+public:
+	TFluidSimMailbox() = default;
+	TFluidSimMailbox(const TFluidSimMailbox&) = delete;
+	TFluidSimMailbox& operator=(const TFluidSimMailbox&) = delete;
+
+	// Producer only.
+	T& GetWriteSlot() { return Slots[WriteIndex]; }
+
+	// Producer only. Returns false if the consumer has not picked up the previous packet yet.
+	bool Publish()
+	{
+		// Only the producer sets the dirty bit, so if it's clear here it stays clear until the exchange below.
+		if (Middle.load(std::memory_order_acquire) & DirtyBit)
+		{
+			return false;
+		}
+
+		const uint32 Previous = Middle.exchange(WriteIndex | DirtyBit, std::memory_order_acq_rel);
+		WriteIndex = Previous & IndexMask;
+		Slots[WriteIndex].Reset();
+		return true;
+	}
+
+	// Consumer only. Returns the newest published packet or nullptr if nothing new arrived since the last call.
+	// The packet stays valid until the next call to Consume().
+	T* Consume()
+	{
+		if (!(Middle.load(std::memory_order_acquire) & DirtyBit))
+		{
+			return nullptr;
+		}
+
+		const uint32 Previous = Middle.exchange(ReadIndex, std::memory_order_acq_rel);
+		ReadIndex = Previous & IndexMask;
+		return &Slots[ReadIndex];
+	}
+
+private:
+	static constexpr uint32 IndexMask = 0x3;
+	static constexpr uint32 DirtyBit = 0x4;
+
+	T Slots[3];
+
+	uint32 WriteIndex = 0; // Producer thread.
+	uint32 ReadIndex = 1; // Consumer thread.
+	std::atomic<uint32> Middle { 2 };
+};
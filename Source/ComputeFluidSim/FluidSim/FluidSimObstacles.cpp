@@ -0,0 +1,269 @@
+#include "FluidSimObstacles.h"
+
+#include "Components/PrimitiveComponent.h"
+#include "Engine/OverlapResult.h"
+#include "Engine/World.h"
+
+namespace
+{
+	int32 FloorDiv(const int32 Value, const int32 Divisor)
+	{
+		return Value >= 0 ? Value / Divisor : -((Divisor - 1 - Value) / Divisor);
+	}
+
+	FIntVector FloorDiv(const FIntVector& Value, const int32 Divisor)
+	{
+		return FIntVector(FloorDiv(Value.X, Divisor), FloorDiv(Value.Y, Divisor), FloorDiv(Value.Z, Divisor));
+	}
+
+	bool IsInRange(const FIntVector& Value, const FIntVector& Min, const FIntVector& Max)
+	{
+		return Value.X >= Min.X && Value.Y >= Min.Y && Value.Z >= Min.Z && Value.X <= Max.X && Value.Y <= Max.Y && Value.Z <= Max.Z;
+	}
+}
+
+FFluidSimObstacles::FFluidSimObstacles(const ECollisionChannel InChannel)
+	: Channel(InChannel)
+{}
+
+void FFluidSimObstacles::PlaceLevel(FLevelState& State, const int32 Level, const FFluidSimObstacleGrid& Grid) const
+{
+	// Same snapping as the render proxy, see AFluidSimulationManager::GetCascadeCentre(). Odd resolutions put the domain
+	// centre on a voxel centre, so on those axes the lattice sits half a voxel over.
+	const int32 Divisor = 1 << Level;
+	const FVector OddAxes = FVector(Grid.Resolution.X % 2, Grid.Resolution.Y % 2, Grid.Resolution.Z % 2);
+	State.VoxelSize = Grid.VoxelSize * static_cast<float>(Divisor);
+	State.Origin = FloorDiv(Grid.Centre, Divisor) - Grid.Resolution / 2;
+	State.Anchor = Grid.CentreOffset - OddAxes * (State.VoxelSize * 0.5f);
+
+	State.BrickMin = FloorDiv(State.Origin, FluidSimObstacles::BrickSize);
+	State.BrickMax = FloorDiv(State.Origin + Grid.Resolution - FIntVector(1, 1, 1), FluidSimObstacles::BrickSize);
+}
+
+FIntVector FFluidSimObstacles::ToLattice(const FLevelState& State, const FVector& Location) const
+{
+	const FVector Voxel = (Location - State.Anchor) / State.VoxelSize;
+	return FIntVector(FMath::FloorToInt(Voxel.X), FMath::FloorToInt(Voxel.Y), FMath::FloorToInt(Voxel.Z));
+}
+
+void FFluidSimObstacles::MarkDirty(const FBox& Box)
+{
+	for (FLevelState& State : LevelStates)
+	{
+		const FIntVector Min = FloorDiv(ToLattice(State, Box.Min), FluidSimObstacles::BrickSize).ComponentMax(State.BrickMin);
+		const FIntVector Max = FloorDiv(ToLattice(State, Box.Max), FluidSimObstacles::BrickSize).ComponentMin(State.BrickMax);
+		for (int32 Z = Min.Z; Z <= Max.Z; Z++)
+		{
+			for (int32 Y = Min.Y; Y <= Max.Y; Y++)
+			{
+				for (int32 X = Min.X; X <= Max.X; X++)
+				{
+					State.Dirty.Add(FIntVector(X, Y, Z));
+				}
+			}
+		}
+	}
+}
+
+void FFluidSimObstacles::Update(const UWorld& World, const FFluidSimObstacleGrid& Grid, const AActor* IgnoreActor, TArray<FFluidSimObstacleBrick>& OutBricks)
+{
+	if (Grid.Resolution.X <= 0 || Grid.Resolution.Y <= 0 || Grid.Resolution.Z <= 0 || Grid.Levels <= 0)
+	{
+		return;
+	}
+
+	// The render proxy clears its obstacles along with its fields when the resolution changes.
+	if (!(Grid == LastGrid))
+	{
+		LevelStates.Reset();
+		LevelStates.SetNum(Grid.Levels);
+		Primitives.Reset();
+	}
+	LastGrid = Grid;
+
+	// Scrolling, bricks the domain left are forgotten. The ones it moved onto are voxelized, or sent again from the
+	// cache if the domain already covered part of them.
+	for (int32 Level = 0; Level < LevelStates.Num(); Level++)
+	{
+		FLevelState& State = LevelStates[Level];
+		const FIntVector OldOrigin = State.Origin;
+		const bool bWasPlaced = State.bPlaced;
+		PlaceLevel(State, Level, Grid);
+		State.bPlaced = true;
+		if (bWasPlaced && OldOrigin == State.Origin)
+		{
+			continue;
+		}
+
+		for (auto It = State.Cache.CreateIterator(); It; ++It)
+		{
+			if (!IsInRange(It.Key(), State.BrickMin, State.BrickMax))
+			{
+				It.RemoveCurrent();
+			}
+		}
+		for (auto It = State.Dirty.CreateIterator(); It; ++It)
+		{
+			if (!IsInRange(*It, State.BrickMin, State.BrickMax))
+			{
+				It.RemoveCurrent();
+			}
+		}
+
+		const FIntVector OldMax = OldOrigin + Grid.Resolution - FIntVector(1, 1, 1);
+		for (int32 Z = State.BrickMin.Z; Z <= State.BrickMax.Z; Z++)
+		{
+			for (int32 Y = State.BrickMin.Y; Y <= State.BrickMax.Y; Y++)
+			{
+				for (int32 X = State.BrickMin.X; X <= State.BrickMax.X; X++)
+				{
+					const FIntVector Brick = FIntVector(X, Y, Z);
+					const FIntVector VoxelMin = Brick * FluidSimObstacles::BrickSize;
+					const FIntVector VoxelMax = VoxelMin + FIntVector(FluidSimObstacles::BrickSize - 1);
+					if (bWasPlaced && IsInRange(VoxelMin, OldOrigin, OldMax) && IsInRange(VoxelMax, OldOrigin, OldMax))
+					{
+						continue;
+					}
+
+					if (State.Cache.Contains(Brick))
+					{
+						State.Resend.Add(Brick);
+					}
+					else
+					{
+						State.Dirty.Add(Brick);
+					}
+				}
+			}
+		}
+	}
+
+	// One query over the coarsest level finds every primitive any level can see.
+	const FLevelState& Coarsest = LevelStates.Last();
+	const FBox DomainBox = FBox(
+		Coarsest.Anchor + FVector(Coarsest.Origin) * Coarsest.VoxelSize,
+		Coarsest.Anchor + FVector(Coarsest.Origin + Grid.Resolution) * Coarsest.VoxelSize);
+
+	TArray<FOverlapResult> Overlaps;
+	const FCollisionQueryParams QueryParams = FCollisionQueryParams(SCENE_QUERY_STAT(FluidSimObstacles), false, IgnoreActor);
+	World.OverlapMultiByObjectType(Overlaps, DomainBox.GetCenter(), FQuat::Identity, FCollisionObjectQueryParams(Channel), FCollisionShape::MakeBox(DomainBox.GetExtent()), QueryParams);
+
+	// Primitives that appeared, moved or left dirty the bricks of both where they were and where they are.
+	TSet<TWeakObjectPtr<UPrimitiveComponent>> Seen;
+	for (const FOverlapResult& Overlap : Overlaps)
+	{
+		UPrimitiveComponent* Primitive = Overlap.GetComponent();
+		if (Primitive == nullptr)
+		{
+			continue;
+		}
+
+		bool bAlreadySeen = false;
+		Seen.Add(Primitive, &bAlreadySeen);
+		if (bAlreadySeen)
+		{
+			continue;
+		}
+
+		const FPrimitiveState NewState = { Primitive->Bounds.GetBox(), Primitive->GetComponentTransform() };
+		FPrimitiveState* OldState = Primitives.Find(Primitive);
+		if (OldState == nullptr)
+		{
+			MarkDirty(NewState.Bounds);
+			Primitives.Add(Primitive, NewState);
+		}
+		else if (!OldState->Transform.Equals(NewState.Transform) || OldState->Bounds != NewState.Bounds)
+		{
+			MarkDirty(OldState->Bounds);
+			MarkDirty(NewState.Bounds);
+			*OldState = NewState;
+		}
+	}
+
+	for (auto It = Primitives.CreateIterator(); It; ++It)
+	{
+		if (!Seen.Contains(It.Key()))
+		{
+			MarkDirty(It.Value().Bounds);
+			It.RemoveCurrent();
+		}
+	}
+
+	// Anything over the budget waits for the next update, the GPU keeps the old occupancy until then.
+	int32 Budget = FMath::Max(BricksPerUpdate, 1);
+	for (int32 Level = 0; Level < LevelStates.Num(); Level++)
+	{
+		FLevelState& State = LevelStates[Level];
+		for (auto It = State.Dirty.CreateIterator(); It && Budget > 0; ++It, Budget--)
+		{
+			FFluidSimObstacleBrick Brick;
+			Voxelize(State, Level, *It, Brick);
+
+			// Something moving through a brick doesn't always change which of its voxels are solid.
+			const FFluidSimObstacleBrick* Cached = State.Cache.Find(*It);
+			if (Cached == nullptr || FMemory::Memcmp(Cached->Occupancy, Brick.Occupancy, sizeof(Brick.Occupancy)) != 0)
+			{
+				OutBricks.Add(Brick);
+			}
+			State.Cache.Add(*It, Brick);
+			State.Resend.Remove(*It);
+			It.RemoveCurrent();
+		}
+
+		for (const FIntVector& Brick : State.Resend)
+		{
+			if (const FFluidSimObstacleBrick* Cached = State.Cache.Find(Brick))
+			{
+				OutBricks.Add(*Cached);
+			}
+		}
+		State.Resend.Reset();
+	}
+}
+
+void FFluidSimObstacles::Voxelize(const FLevelState& State, const int32 Level, const FIntVector& Brick, FFluidSimObstacleBrick& OutBrick) const
+{
+	OutBrick.Brick = Brick;
+	OutBrick.Level = Level;
+
+	const FIntVector VoxelMin = Brick * FluidSimObstacles::BrickSize;
+	const FBox BrickBox = FBox(
+		State.Anchor + FVector(VoxelMin) * State.VoxelSize,
+		State.Anchor + FVector(VoxelMin + FIntVector(FluidSimObstacles::BrickSize)) * State.VoxelSize);
+
+	TArray<UPrimitiveComponent*, TInlineAllocator<8>> Candidates;
+	for (const TPair<TWeakObjectPtr<UPrimitiveComponent>, FPrimitiveState>& Pair : Primitives)
+	{
+		UPrimitiveComponent* Primitive = Pair.Key.Get();
+		if (Primitive != nullptr && Pair.Value.Bounds.Intersect(BrickBox))
+		{
+			Candidates.Add(Primitive);
+		}
+	}
+	if (Candidates.IsEmpty())
+	{
+		return;
+	}
+
+	// Solid wherever the geometry touches the voxel, so walls thinner than a voxel still block.
+	const FCollisionShape VoxelShape = FCollisionShape::MakeBox(FVector(State.VoxelSize * 0.5f));
+	for (int32 Z = 0; Z < FluidSimObstacles::BrickSize; Z++)
+	{
+		for (int32 Y = 0; Y < FluidSimObstacles::BrickSize; Y++)
+		{
+			for (int32 X = 0; X < FluidSimObstacles::BrickSize; X++)
+			{
+				const FVector Centre = State.Anchor + (FVector(VoxelMin + FIntVector(X, Y, Z)) + 0.5f) * State.VoxelSize;
+				for (UPrimitiveComponent* Primitive : Candidates)
+				{
+					if (Primitive->OverlapComponent(Centre, FQuat::Identity, VoxelShape))
+					{
+						const int32 Bit = X + Y * FluidSimObstacles::BrickSize + Z * FluidSimObstacles::BrickSize * FluidSimObstacles::BrickSize;
+						OutBrick.Occupancy[Bit / 32] |= 1u << (Bit % 32);
+						break;
+					}
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,93 @@
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/EngineTypes.h"
+
+class AActor;
+class UPrimitiveComponent;
+class UWorld;
+
+namespace FluidSimObstacles
+{
+	// Voxels per brick edge, one thread group of the scatter pass per brick.
+	constexpr int32 BrickSize = 8;
+	constexpr int32 BrickWords = BrickSize * BrickSize * BrickSize / 32;
+}
+
+// One brick of voxelized obstacles for the render thread. Bricks sit on a lattice fixed in the world, so they stay
+// valid while the domain scrolls. Bit X + Y * 8 + Z * 64 is set for solid voxels. Layout matches FluidSimObstacleShader.usf.
+struct FFluidSimObstacleBrick
+{
+	FIntVector Brick = FIntVector::ZeroValue;
+	int32 Level = 0;
+	uint32 Occupancy[FluidSimObstacles::BrickWords] = {};
+};
+
+// Where the simulation sits, in the terms the voxelizer needs.
+struct FFluidSimObstacleGrid
+{
+	FIntVector Resolution = FIntVector::ZeroValue;
+	int32 Levels = 1;
+
+	// Finest level, in unreal units.
+	float VoxelSize = 0.0f;
+
+	// World voxel of the finest level at the domain centre, and how far the domain centre sits from it.
+	FIntVector Centre = FIntVector::ZeroValue;
+	FVector CentreOffset = FVector::ZeroVector;
+
+	bool operator==(const FFluidSimObstacleGrid& Other) const
+	{
+		return Resolution == Other.Resolution && Levels == Other.Levels && VoxelSize == Other.VoxelSize && CentreOffset.Equals(Other.CentreOffset);
+	}
+};
+
+// Game thread voxelizer of the collision geometry overlapping the domain. Every update gathers the primitives over the
+// coarsest level once, and only the bricks that a primitive appeared in, moved through or left are voxelized again.
+// Bricks the domain scrolls onto are voxelized as they arrive, ones it already partly covered are sent again from the cache.
+class FFluidSimObstacles
+{
+public:
+	explicit FFluidSimObstacles(const ECollisionChannel InChannel);
+
+	// Appends the bricks that changed, voxelizing at most BricksPerUpdate, the rest carry over to the next update.
+	// A different grid starts over from an empty domain.
+	void Update(const UWorld& World, const FFluidSimObstacleGrid& Grid, const AActor* IgnoreActor, TArray<FFluidSimObstacleBrick>& OutBricks);
+
+	int32 BricksPerUpdate = 64;
+
+private:
+	struct FPrimitiveState
+	{
+		FBox Bounds;
+		FTransform Transform;
+	};
+
+	struct FLevelState
+	{
+		// Lattice voxel of the level's logical voxel 0, and the world position lattice voxel 0 starts at.
+		FIntVector Origin = FIntVector::ZeroValue;
+		FVector Anchor = FVector::ZeroVector;
+		float VoxelSize = 0.0f;
+		bool bPlaced = false;
+
+		// Brick range covering the domain, inclusive.
+		FIntVector BrickMin = FIntVector::ZeroValue;
+		FIntVector BrickMax = FIntVector::ZeroValue;
+
+		TMap<FIntVector, FFluidSimObstacleBrick> Cache;
+		TSet<FIntVector> Dirty;
+		TSet<FIntVector> Resend;
+	};
+
+	void PlaceLevel(FLevelState& State, const int32 Level, const FFluidSimObstacleGrid& Grid) const;
+	void MarkDirty(const FBox& Box);
+	FIntVector ToLattice(const FLevelState& State, const FVector& Location) const;
+	void Voxelize(const FLevelState& State, const int32 Level, const FIntVector& Brick, FFluidSimObstacleBrick& OutBrick) const;
+
+	ECollisionChannel Channel;
+	FFluidSimObstacleGrid LastGrid;
+	TArray<FLevelState> LevelStates;
+	TMap<TWeakObjectPtr<UPrimitiveComponent>, FPrimitiveState> Primitives;
+};
@@ -0,0 +1,2048 @@
+#include "FluidSimRenderProxy.h"
+
+#include "RenderGraph.h"
+#include "RenderGraphUtils.h"
+#include "GlobalShader.h"
+#include "RHI.h"
+#include "RHIGPUReadback.h"
+#include "TextureResource.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/FileHelper.h"
+#include "Tasks/Task.h"
+#include "FluidSimCheckpoint.h"
+#include "FluidSimSequence.h"
+#include "FluidSimStamps.h"
+#include "FluidSimLog.h"
+#include "FluidSimStats.h"
+#include "FluidShaderImplementation.h"
+#include "FluidSimShaderCache.h"
+#include "FluidSimTexturePool.h"
+
+// This will tell the engine to create the shader and where the shader entry point is.
+//                            ShaderType                            ShaderPath                     Shader function name    Type
+IMPLEMENT_GLOBAL_SHADER(FObjectGPUAdvectionShader,			"/DynamicsShaders/FluidSimShader.usf", "AdvectionShader",		SF_Compute);
+IMPLEMENT_GLOBAL_SHADER(FObjectGPUDissipationShader,		"/DynamicsShaders/FluidSimShader.usf", "DissipationShader",		SF_Compute);
+IMPLEMENT_GLOBAL_SHADER(FObjectGPUDiffusionShader,			"/DynamicsShaders/FluidSimShader.usf", "DiffusionShader",		SF_Compute);
+IMPLEMENT_GLOBAL_SHADER(FObjectGPUDivergenceShader,			"/DynamicsShaders/FluidSimShader.usf", "DivergenceShader",		SF_Compute);
+IMPLEMENT_GLOBAL_SHADER(FObjectGPUProjectPressureShader,	"/DynamicsShaders/FluidSimShader.usf", "ProjPressureShader",	SF_Compute);
+IMPLEMENT_GLOBAL_SHADER(FObjectGPUPressureResidualShader,	"/DynamicsShaders/FluidSimShader.usf", "PressureResidualShader",	SF_Compute);
+IMPLEMENT_GLOBAL_SHADER(FObjectGPUPressureConvergenceShader,"/DynamicsShaders/FluidSimShader.usf", "PressureConvergenceShader", SF_Compute);
+IMPLEMENT_GLOBAL_SHADER(FObjectGPUScrollClearShader,		"/DynamicsShaders/FluidSimShader.usf", "ScrollClearShader",		SF_Compute);
+IMPLEMENT_GLOBAL_SHADER(FObjectGPUProjectGradientShader,	"/DynamicsShaders/FluidSimShader.usf", "ProjGradientVelShader", SF_Compute);
+
+// Injection
+IMPLEMENT_GLOBAL_SHADER(FObjectGPUInjectionShader, "/DynamicsShaders/FluidSimInjectionShader.usf", "InjectionShader", SF_Compute);
+
+// Resolution
+IMPLEMENT_GLOBAL_SHADER(FObjectGPUResampleShader, "/DynamicsShaders/FluidSimResampleShader.usf", "ResampleShader", SF_Compute);
+
+// Cascades
+IMPLEMENT_GLOBAL_SHADER(FObjectGPUCascadeBoundaryShader, "/DynamicsShaders/FluidSimCascadeShader.usf", "CascadeBoundaryShader", SF_Compute);
+IMPLEMENT_GLOBAL_SHADER(FObjectGPUCascadeRestrictShader, "/DynamicsShaders/FluidSimCascadeShader.usf", "CascadeRestrictShader", SF_Compute);
+
+// Sparse
+IMPLEMENT_GLOBAL_SHADER(FObjectGPUBrickOccupancyShader, "/DynamicsShaders/FluidSimSparseShader.usf", "BrickOccupancyShader", SF_Compute);
+IMPLEMENT_GLOBAL_SHADER(FObjectGPUBrickDilateShader, "/DynamicsShaders/FluidSimSparseShader.usf", "BrickDilateShader", SF_Compute);
+
+// Diagnostics
+IMPLEMENT_GLOBAL_SHADER(FObjectGPUDiagnosticsReduceShader, "/DynamicsShaders/FluidSimDiagnosticsShader.usf", "DiagnosticsReduceShader", SF_Compute);
+IMPLEMENT_GLOBAL_SHADER(FObjectGPUDiagnosticsResolveShader, "/DynamicsShaders/FluidSimDiagnosticsShader.usf", "DiagnosticsResolveShader", SF_Compute);
+
+// Playback
+IMPLEMENT_GLOBAL_SHADER(FObjectGPUSequenceBlendShader, "/DynamicsShaders/FluidSimSequenceShader.usf", "SequenceBlendShader", SF_Compute);
+
+// Obstacles
+IMPLEMENT_GLOBAL_SHADER(FObjectGPUObstacleScatterShader, "/DynamicsShaders/FluidSimObstacleShader.usf", "ObstacleScatterShader", SF_Compute);
+IMPLEMENT_GLOBAL_SHADER(FObjectGPUColliderRasterShader, "/DynamicsShaders/FluidSimColliderShader.usf", "ColliderRasterShader", SF_Compute);
+
+// GPU time per stage, under stat GPU and in Insights.
+DECLARE_GPU_STAT(FluidSimScroll);
+DECLARE_GPU_STAT(FluidSimOutputs);
+DECLARE_GPU_STAT(FluidSimDissipate);
+DECLARE_GPU_STAT(FluidSimInject);
+DECLARE_GPU_STAT(FluidSimSparse);
+DECLARE_GPU_STAT(FluidSimDiffuse);
+DECLARE_GPU_STAT(FluidSimDivergence);
+DECLARE_GPU_STAT(FluidSimPressure);
+DECLARE_GPU_STAT(FluidSimProject);
+DECLARE_GPU_STAT(FluidSimDiagnostics);
+DECLARE_GPU_STAT(FluidSimAdvect);
+DECLARE_GPU_STAT(FluidSimCascade);
+DECLARE_GPU_STAT(FluidSimResize);
+DECLARE_GPU_STAT(FluidSimObstacles);
+DECLARE_GPU_STAT(FluidSimColliders);
+
+
+static FFluidSimDomainParameters GetDomainParameters(const TSharedPtr<FComputeStageIntrinsics>& Stage)
+{
+	FFluidSimDomainParameters Domain;
+	Domain.DomainResolution = Stage->SH_RT_Velocity->Desc.GetSize();
+	Domain.DomainOffset = Stage->DomainOffset;
+	return Domain;
+}
+
+static FFluidSimSparseParameters GetSparseParameters(const TSharedPtr<FComputeStageIntrinsics>& Stage)
+{
+	FFluidSimSparseParameters Sparse;
+	Sparse.ActiveBricks = Stage->GraphBuilder.CreateSRV(Stage->ActiveBricks, PF_R32_UINT);
+	Sparse.BrickCount = Stage->GPUGroupCount;
+	return Sparse;
+}
+
+static FFluidSimObstacleParameters GetObstacleParameters(const TSharedPtr<FComputeStageIntrinsics>& Stage)
+{
+	FFluidSimObstacleParameters Obstacle;
+	Obstacle.Obstacles = Stage->GraphBuilder.CreateSRV(Stage->SH_RT_Obstacles);
+	Obstacle.BoundaryVelocity = Stage->GraphBuilder.CreateSRV(Stage->SH_RT_Boundary);
+	return Obstacle;
+}
+
+// Permutation of the stages that read obstacles and colliders, open when the step has neither.
+static EFluidSimBoundaryMode GetBoundaryMode(const TSharedPtr<FComputeStageIntrinsics>& Stage)
+{
+	if (Stage->bObstacles)
+	{
+		return Stage->bColliders ? EFluidSimBoundaryMode::ObstaclesAndColliders : EFluidSimBoundaryMode::Obstacles;
+	}
+	return Stage->bColliders ? EFluidSimBoundaryMode::Colliders : EFluidSimBoundaryMode::Open;
+}
+
+// Copied out tightly packed, the staging rows may be padded.
+static void CopyReadback(FRHIGPUTextureReadback& Readback, const FIntVector& Res, TArray<FFloat16Color>& Dest)
+{
+	Dest.SetNumUninitialized(Res.X * Res.Y * Res.Z);
+
+	int32 RowPitch = 0;
+	int32 BufferHeight = 0;
+	const FFloat16Color* Source = static_cast<const FFloat16Color*>(Readback.Lock(RowPitch, &BufferHeight));
+	BufferHeight = BufferHeight > 0 ? BufferHeight : Res.Y;
+	for (int32 Z = 0; Z < Res.Z; Z++)
+	{
+		for (int32 Y = 0; Y < Res.Y; Y++)
+		{
+			FMemory::Memcpy(&Dest[(Z * Res.Y + Y) * Res.X], Source + (Z * BufferHeight + Y) * RowPitch, Res.X * sizeof(FFloat16Color));
+		}
+	}
+	Readback.Unlock();
+}
+
+
+FFluidSimRenderProxy::FFluidSimRenderProxy(const FGridDescription& InGridDescription, const TArray<FFluidSimOutputResources>& InLevelOutputs, const TSharedRef<FFluidSimShaderCache, ESPMode::ThreadSafe>& InShaders, const TSharedRef<FFluidSimTexturePool, ESPMode::ThreadSafe>& InTexturePool, const FFluidSimInitialState& InInitialState)
+	: Shaders(InShaders), TexturePool(InTexturePool), InitialState(InInitialState), GridDescription(InGridDescription), GroupCount(FIntVector::DivideAndRoundUp(InGridDescription.GridResolution, FluidSimThreads))
+{
+	Levels.SetNum(InLevelOutputs.Num());
+	for (int32 Level = 0; Level < Levels.Num(); Level++)
+	{
+		Levels[Level].Outputs = InLevelOutputs[Level];
+	}
+}
+
+FFluidSimRenderProxy::~FFluidSimRenderProxy()
+{
+	check(IsInRenderingThread());
+	StopRenderThread();
+}
+
+void FFluidSimRenderProxy::SetupRenderThread(FRHICommandListImmediate& RHICmdList)
+{
+	StopRenderThread();
+	Shaders->Update(RHICmdList, GMaxRHIFeatureLevel);
+	
+	constexpr EPixelFormat TextureFormat = EPixelFormat::PF_FloatRGBA; 
+
+	bool bLevelsValid = !Levels.IsEmpty();
+	for (FFluidSimCascadeLevel& Level : Levels)
+	{
+		CreateRHITextureResource(Level.RT_Pressure, TEXT("FluidSim_RT_Pressure"), TextureFormat);
+		CreateRHITextureResource(Level.RT_Density, TEXT("FluidSim_RT_Density"), TextureFormat);
+		CreateRHITextureResource(Level.RT_Velocity, TEXT("FluidSim_RT_Velocity"), TextureFormat);
+		CreateRHITextureResource(Level.RT_Obstacles, TEXT("FluidSim_RT_Obstacles"), EPixelFormat::PF_R8);
+
+		// Clear RTs, pooled ones hold whatever their last simulation left.
+		ClearRenderTarget(RHICmdList, Level.RT_Pressure);
+		ClearRenderTarget(RHICmdList, Level.RT_Density);
+		ClearRenderTarget(RHICmdList, Level.RT_Velocity);
+		ClearRenderTarget(RHICmdList, Level.RT_Obstacles);
+		Level.bHasObstacles = false;
+
+		bLevelsValid = bLevelsValid &&
+			Level.RT_Velocity &&
+			Level.RT_Pressure &&
+			Level.RT_Density &&
+			Level.RT_Obstacles &&
+			Level.Outputs.IsValid(); // Output textures exist.
+	}
+	StampAtlas = TexturePool->GetStampAtlas(RHICmdList);
+	StepCounter = 0;
+	UpdateTextureMemoryStat();
+
+	ReadyToRender = 
+		bLevelsValid &&
+		StampAtlas &&
+		GridDescription.GridResolution.X > 0 && GridDescription.GridResolution.Y > 0 && GridDescription.GridResolution.Z > 0;
+
+	if (ReadyToRender && InitialState.IsSet())
+	{
+		ApplyInitialState(RHICmdList);
+	}
+	InitialState = FFluidSimInitialState();
+}
+
+void FFluidSimRenderProxy::ApplyInitialState(FRHICommandListImmediate& RHICmdList)
+{
+	FRDGBuilder GraphBuilder(RHICmdList, FRDGEventName(TEXT("UFluidSimulation::InitialState")));
+
+	if (InitialState.Checkpoint.IsValid())
+	{
+		UploadCheckpoint(RHICmdList, GraphBuilder, *InitialState.Checkpoint);
+	}
+
+	// Textures override the checkpoint's finest level for the fields they set.
+	const FIntVector Res = GridDescription.GridResolution;
+	if (InitialState.Velocity && InitialState.Velocity->TextureRHI)
+	{
+		FRDGTextureRef Source = RegisterExternalTexture(GraphBuilder, InitialState.Velocity->TextureRHI, TEXT("FluidSim_InitialVelocity"));
+		AddResamplePass(GraphBuilder, Source, FIntVector::ZeroValue, RegisterExternalTexture(GraphBuilder, Levels[0].RT_Velocity, TEXT("FluidSim_RT_Velocity")),
+			GetResampleScale(EFieldUnits::VoxelVector, Source->Desc.GetSize(), Res));
+	}
+
+	if (InitialState.Density && InitialState.Density->TextureRHI)
+	{
+		FRDGTextureRef Source = RegisterExternalTexture(GraphBuilder, InitialState.Density->TextureRHI, TEXT("FluidSim_InitialDensity"));
+		AddResamplePass(GraphBuilder, Source, FIntVector::ZeroValue, RegisterExternalTexture(GraphBuilder, Levels[0].RT_Density, TEXT("FluidSim_RT_Density")),
+			GetResampleScale(EFieldUnits::Unitless, Source->Desc.GetSize(), Res));
+	}
+
+	GraphBuilder.Execute();
+}
+
+void FFluidSimRenderProxy::UpdateRenderThread(FRHICommandListImmediate& RHICmdList)
+{
+	FRDGBuilder GraphBuilder(RHICmdList, FRDGEventName(TEXT("UFluidSimulation::SimulationStep")));
+	ConsumeMailbox(GraphBuilder);
+	UpdateGPUBudget();
+	ReportFrameStats();
+	PollCheckpoints();
+	PollBake();
+	StageTimer.Resolve(false);
+
+	// Pipelined steps have to be part of the scene's graph to overlap with it, they're picked up in TickRenderThread().
+	if (Settings.bPipelined)
+	{
+		PendingSteps = FMath::Min(PendingSteps, FMath::Max(StepSettings.MaxSubsteps, 1));
+	}
+	else if (ReadyToRender && PendingSteps > 0)
+	{
+		AddSimulationSteps(GraphBuilder, PendingSteps);
+		PendingSteps = 0;
+	}
+
+	GraphBuilder.Execute();
+}
+
+void FFluidSimRenderProxy::TickRenderThread(FRDGBuilder& GraphBuilder)
+{
+	ConsumeMailbox(GraphBuilder);
+	if (!ReadyToRender)
+	{
+		return;
+	}
+	UpdateGPUBudget();
+	ReportFrameStats();
+	PollCheckpoints();
+	PollBake();
+	StageTimer.Resolve(false);
+
+	if (Settings.Clock != EFluidSimClock::RenderThread)
+	{
+		LastTickTime = 0.0;
+
+		// Game thread clock in pipelined mode, run whatever the game thread queued inside the scene's graph.
+		if (Settings.bPipelined && PendingSteps > 0 && LastTickFrame != GFrameCounterRenderThread)
+		{
+			LastTickFrame = GFrameCounterRenderThread;
+
+			RDG_EVENT_SCOPE(GraphBuilder, "UFluidSimulation::SimulationStep");
+			AddSimulationSteps(GraphBuilder, PendingSteps);
+			PendingSteps = 0;
+		}
+		return;
+	}
+
+	// Several view families can render in one frame, only the first one steps.
+	if (LastTickFrame == GFrameCounterRenderThread)
+	{
+		return;
+	}
+	LastTickFrame = GFrameCounterRenderThread;
+
+	const double Now = FPlatformTime::Seconds();
+	const double DeltaTime = LastTickTime > 0.0 ? Now - LastTickTime : 0.0;
+	LastTickTime = Now;
+
+	// Fixed rate, any time beyond MaxSubsteps is dropped rather than caught up.
+	const double StepTime = 1.0 / FMath::Max(Settings.SimulationRate, 1.0f);
+	const int32 MaxSubsteps = FMath::Max(StepSettings.MaxSubsteps, 1);
+	ClockAccumulator = FMath::Min(ClockAccumulator + DeltaTime, StepTime * MaxSubsteps);
+
+	int32 StepCount = 0;
+	while (ClockAccumulator >= StepTime)
+	{
+		ClockAccumulator -= StepTime;
+		StepCount++;
+	}
+
+	if (StepCount > 0)
+	{
+		RDG_EVENT_SCOPE(GraphBuilder, "UFluidSimulation::SimulationStep");
+		AddSimulationSteps(GraphBuilder, StepCount);
+	}
+
+	// Steps requested by the game thread have no meaning on this clock.
+	PendingSteps = 0;
+}
+
+void FFluidSimRenderProxy::ConsumeMailbox(FRDGBuilder& GraphBuilder)
+{
+	const FFluidSimProxyPacket* Packet = Mailbox.Consume();
+	if (Packet == nullptr)
+	{
+		return;
+	}
+
+	// Resized before anything else, the packet's centre and events are already in voxels of the new resolution.
+	if (Packet->GridDescription.GridResolution != GridDescription.GridResolution)
+	{
+		ResizeLevels(GraphBuilder, Packet->GridDescription);
+	}
+
+	Settings = Packet->Settings;
+	if (Packet->bCollidersChanged)
+	{
+		Colliders = Packet->Colliders;
+	}
+	PendingSteps += Packet->StepCount;
+	SetDomainCentre(Packet->DomainCentre);
+
+	// Event positions are voxels of the finest level, every level that covers an event gets it in its own voxels.
+	const FVector3f Resolution = FVector3f(GridDescription.GridResolution);
+	for (int32 Level = 0; Level < Levels.Num(); Level++)
+	{
+		const float Scale = 1.0f / static_cast<float>(1 << Level);
+		const FVector3f Offset = GetLevelMappingOffset(0, Level);
+		for (const FFluidSimSourceShaderData& Event : Packet->InjectionEvents)
+		{
+			const FVector3f Position = FVector3f(Event.PositionIdx) * Scale + Offset;
+			const float Size = Event.Size * Scale;
+			if (Position.X < -Size || Position.Y < -Size || Position.Z < -Size ||
+				Position.X > Resolution.X + Size || Position.Y > Resolution.Y + Size || Position.Z > Resolution.Z + Size)
+			{
+				continue;
+			}
+
+			FFluidSimSourceShaderData& LevelEvent = Levels[Level].PendingEvents.Add_GetRef(Event);
+			LevelEvent.PositionIdx = FIntVector(FMath::RoundToInt(Position.X), FMath::RoundToInt(Position.Y), FMath::RoundToInt(Position.Z));
+			LevelEvent.Size = Size;
+		}
+	}
+
+	// Bricks are already sorted by level, they're placed in the world so the level's scroll doesn't matter.
+	for (const FFluidSimObstacleBrick& Brick : Packet->ObstacleBricks)
+	{
+		if (Levels.IsValidIndex(Brick.Level))
+		{
+			Levels[Brick.Level].PendingObstacleBricks.Add(Brick);
+		}
+	}
+}
+
+void FFluidSimRenderProxy::UpdateGPUBudget()
+{
+	// Called before any steps are added, polling more than once a frame is harmless. Diagnostics report the time too.
+	GPUBudget.Update(Settings.GPUBudgetMs, Settings.bDiagnostics);
+	StepSettings = GPUBudget.Apply(Settings);
+}
+
+void FFluidSimRenderProxy::ResizeLevels(FRDGBuilder& GraphBuilder, const FGridDescription& InGridDescription)
+{
+	const FIntVector OldResolution = GridDescription.GridResolution;
+	const FIntVector NewResolution = InGridDescription.GridResolution;
+	if (NewResolution.X <= 0 || NewResolution.Y <= 0 || NewResolution.Z <= 0)
+	{
+		return;
+	}
+
+	GridDescription = InGridDescription;
+	GroupCount = FIntVector::DivideAndRoundUp(NewResolution, FluidSimThreads);
+
+	// Nothing allocated yet, SetupRenderThread() picks up the new size.
+	if (!ReadyToRender)
+	{
+		return;
+	}
+
+	RDG_EVENT_SCOPE(GraphBuilder, "UFluidSimulation::Resize");
+	RDG_GPU_STAT_SCOPE(GraphBuilder, FluidSimResize);
+
+	const FVector4f VelocityScale = GetResampleScale(EFieldUnits::VoxelVector, OldResolution, NewResolution);
+	const FVector4f PressureScale = GetResampleScale(EFieldUnits::VoxelSquared, OldResolution, NewResolution);
+	const FVector4f DensityScale = GetResampleScale(EFieldUnits::Unitless, OldResolution, NewResolution);
+
+	constexpr EPixelFormat TextureFormat = EPixelFormat::PF_FloatRGBA;
+	for (FFluidSimCascadeLevel& Level : Levels)
+	{
+		// Given back at the end, the graph still reads them.
+		FTextureRHIRef OldVelocityRHI = MoveTemp(Level.RT_Velocity);
+		FTextureRHIRef OldDensityRHI = MoveTemp(Level.RT_Density);
+		FTextureRHIRef OldPressureRHI = MoveTemp(Level.RT_Pressure);
+		FRDGTextureRef OldVelocity = RegisterExternalTexture(GraphBuilder, OldVelocityRHI, TEXT("FluidSim_RT_Velocity"));
+		FRDGTextureRef OldDensity = RegisterExternalTexture(GraphBuilder, OldDensityRHI, TEXT("FluidSim_RT_Density"));
+		FRDGTextureRef OldPressure = RegisterExternalTexture(GraphBuilder, OldPressureRHI, TEXT("FluidSim_RT_Pressure"));
+
+		CreateRHITextureResource(Level.RT_Velocity, TEXT("FluidSim_RT_Velocity"), TextureFormat);
+		CreateRHITextureResource(Level.RT_Density, TEXT("FluidSim_RT_Density"), TextureFormat);
+		CreateRHITextureResource(Level.RT_Pressure, TEXT("FluidSim_RT_Pressure"), TextureFormat);
+
+		// Resampled into a linear layout, the old offset is resolved along the way.
+		AddResamplePass(GraphBuilder, OldVelocity, Level.DomainOffset, RegisterExternalTexture(GraphBuilder, Level.RT_Velocity, TEXT("FluidSim_RT_Velocity")), VelocityScale);
+		AddResamplePass(GraphBuilder, OldDensity, Level.DomainOffset, RegisterExternalTexture(GraphBuilder, Level.RT_Density, TEXT("FluidSim_RT_Density")), DensityScale);
+		AddResamplePass(GraphBuilder, OldPressure, Level.DomainOffset, RegisterExternalTexture(GraphBuilder, Level.RT_Pressure, TEXT("FluidSim_RT_Pressure")), PressureScale);
+
+		TexturePool->Release(OldVelocityRHI, true);
+		TexturePool->Release(OldDensityRHI, true);
+		TexturePool->Release(OldPressureRHI, true);
+
+		// Obstacles aren't resampled, the game thread voxelizes them again at the new resolution.
+		TexturePool->Release(Level.RT_Obstacles, true);
+		CreateRHITextureResource(Level.RT_Obstacles, TEXT("FluidSim_RT_Obstacles"), EPixelFormat::PF_R8);
+		AddClearUAVPass(GraphBuilder, GraphBuilder.CreateUAV(RegisterExternalTexture(GraphBuilder, Level.RT_Obstacles, TEXT("FluidSim_RT_Obstacles"))), FLinearColor::Black);
+		Level.PendingObstacleBricks.Reset();
+		Level.bHasObstacles = false;
+
+		Level.DomainOffset = FIntVector::ZeroValue;
+		Level.PendingScrollDelta = FIntVector::ZeroValue;
+
+		// Still in voxels of the old resolution, positions and sizes alike.
+		const FVector3f EventScale = FVector3f(NewResolution) / FVector3f(OldResolution);
+		const float EventSizeScale = (EventScale.X + EventScale.Y + EventScale.Z) / 3.0f;
+		for (FFluidSimSourceShaderData& Event : Level.PendingEvents)
+		{
+			const FVector3f Position = FVector3f(Event.PositionIdx) * EventScale;
+			Event.PositionIdx = FIntVector(FMath::RoundToInt(Position.X), FMath::RoundToInt(Position.Y), FMath::RoundToInt(Position.Z));
+			Event.Size *= EventSizeScale;
+		}
+	}
+
+	// Centres are in voxels of the old resolution, the levels are placed again by the next centre without scrolling.
+	bHasDomainCentre = false;
+
+	UpdateTextureMemoryStat();
+}
+
+void FFluidSimRenderProxy::SetDomainCentre(const FIntVector& FineCentre)
+{
+	const FIntVector Res = GridDescription.GridResolution;
+	auto FloorDiv = [](const int32 Value, const int32 Divisor) { return Value >= 0 ? Value / Divisor : -((Divisor - 1 - Value) / Divisor); };
+	auto Wrap = [](const int32 Value, const int32 Size) { return ((Value % Size) + Size) % Size; };
+
+	for (int32 Level = 0; Level < Levels.Num(); Level++)
+	{
+		FFluidSimCascadeLevel& CascadeLevel = Levels[Level];
+		const int32 Divisor = 1 << Level;
+		const FIntVector Centre = FIntVector(FloorDiv(FineCentre.X, Divisor), FloorDiv(FineCentre.Y, Divisor), FloorDiv(FineCentre.Z, Divisor));
+
+		// The first centre only places the levels, there's nothing to scroll yet.
+		if (bHasDomainCentre && Centre != CascadeLevel.Centre)
+		{
+			const FIntVector Delta = Centre - CascadeLevel.Centre;
+			CascadeLevel.DomainOffset = FIntVector(
+				Wrap(CascadeLevel.DomainOffset.X + Delta.X, Res.X),
+				Wrap(CascadeLevel.DomainOffset.Y + Delta.Y, Res.Y),
+				Wrap(CascadeLevel.DomainOffset.Z + Delta.Z, Res.Z));
+			CascadeLevel.PendingScrollDelta += Delta;
+		}
+		CascadeLevel.Centre = Centre;
+	}
+
+	bHasDomainCentre = true;
+}
+
+bool FFluidSimRenderProxy::IsLevelDue(const int32 Level, const uint32 Step) const
+{
+	return Step % (1u << Level) == 0;
+}
+
+FVector3f FFluidSimRenderProxy::GetLevelMappingOffset(const int32 FromLevel, const int32 ToLevel) const
+{
+	// Voxel index I of level L is centred on world voxel (Centre - Res / 2 + I + 0.5) * 2^L of the finest level.
+	const FVector3f HalfRes = FVector3f(GridDescription.GridResolution) * 0.5f;
+	const float Scale = FMath::Pow(2.0f, static_cast<float>(FromLevel - ToLevel));
+	const FVector3f FromOrigin = FVector3f(Levels[FromLevel].Centre) - HalfRes + 0.5f;
+	const FVector3f ToOrigin = FVector3f(Levels[ToLevel].Centre) - HalfRes + 0.5f;
+	return FromOrigin * Scale - ToOrigin;
+}
+
+void FFluidSimRenderProxy::AddSimulationSteps(FRDGBuilder& GraphBuilder, const int32 StepCount)
+{
+	SCOPE_CYCLE_COUNTER(STAT_FluidSimAddSteps);
+
+	// Timed on the finest level's velocity, every level's steps write it or feed into it.
+	FRDGTextureRef TimedField = RegisterExternalTexture(GraphBuilder, Levels[0].RT_Velocity, TEXT("FluidSim_RT_Velocity"));
+	GPUBudget.BeginFrame(GraphBuilder, TimedField);
+
+	if (StepSettings.bSparse)
+	{
+		FrameBrickCounter = GraphBuilder.CreateBuffer(FRDGBufferDesc::CreateBufferDesc(sizeof(uint32), 1), TEXT("FluidSim_ActiveBrickCount"));
+		AddClearUAVPass(GraphBuilder, GraphBuilder.CreateUAV(FrameBrickCounter, PF_R32_UINT), 0u);
+	}
+
+	// One group per collider, the rest wait for the dispatch limit to allow them.
+	const int32 ColliderCount = FMath::Min(Colliders.Num(), static_cast<int32>(GRHIMaxDispatchThreadGroupsPerDimension.X));
+	if (ColliderCount > 0)
+	{
+		FrameColliders = CreateStructuredBuffer(GraphBuilder, TEXT("FluidSim_Colliders"), sizeof(FFluidSimColliderShaderData), ColliderCount, Colliders.GetData(), ColliderCount * sizeof(FFluidSimColliderShaderData));
+	}
+
+	for (int32 Step = 0; Step < StepCount; Step++)
+	{
+		// Coarse to fine, each level takes its boundary from the level above and hands its result back once stepped.
+		// A coarse level moves twice the distance per step, so it only has to step half as often.
+		for (int32 Level = Levels.Num() - 1; Level >= 0; Level--)
+		{
+			if (!IsLevelDue(Level, StepCounter + Step)) { continue; }
+
+			const bool bHasCoarser = Level + 1 < Levels.Num();
+			if (bHasCoarser)
+			{
+				RDG_GPU_STAT_SCOPE(GraphBuilder, FluidSimCascade);
+				AddCascadeBoundary(GraphBuilder, Level);
+			}
+
+			// Events and scrolling are only applied once, any further steps run without them.
+			FFluidSimCascadeLevel& CascadeLevel = Levels[Level];
+			FObjectGPUDispatchParams Params = FObjectGPUDispatchParams(GroupCount, StepSettings, CascadeLevel.PendingEvents);
+			Params.Level = Level;
+			Params.DomainOffset = CascadeLevel.DomainOffset;
+			Params.ScrollDelta = CascadeLevel.PendingScrollDelta;
+
+			// Outputs are written once per frame, the first time a level steps when pipelined and the last time otherwise.
+			const int32 Period = 1 << Level;
+			Params.bWriteOutputs = StepSettings.bPipelined ? Step < Period : Step + Period >= StepCount;
+			DispatchRenderThread(GraphBuilder, Params);
+
+			CascadeLevel.PendingEvents.Reset();
+			CascadeLevel.PendingScrollDelta = FIntVector::ZeroValue;
+
+			if (bHasCoarser)
+			{
+				RDG_GPU_STAT_SCOPE(GraphBuilder, FluidSimCascade);
+				AddCascadeRestriction(GraphBuilder, Level);
+			}
+		}
+	}
+
+	GPUBudget.EndFrame(GraphBuilder, TimedField);
+
+	// One count in flight at a time, frames in between just aren't counted.
+	if (FrameBrickCounter && !bBrickReadbackPending)
+	{
+		if (!ActiveBrickReadback.IsValid())
+		{
+			ActiveBrickReadback = MakeUnique<FRHIGPUBufferReadback>(TEXT("FluidSim_ActiveBrickReadback"));
+		}
+		AddEnqueueCopyPass(GraphBuilder, ActiveBrickReadback.Get(), FrameBrickCounter, sizeof(uint32));
+		bBrickReadbackPending = true;
+		ReadbackBytes += sizeof(uint32);
+	}
+	FrameBrickCounter = nullptr;
+
+	if (FrameDiagnostics && !bDiagnosticsReadbackPending)
+	{
+		if (!DiagnosticsReadback.IsValid())
+		{
+			DiagnosticsReadback = MakeUnique<FRHIGPUBufferReadback>(TEXT("FluidSim_DiagnosticsReadback"));
+		}
+		AddEnqueueCopyPass(GraphBuilder, DiagnosticsReadback.Get(), FrameDiagnostics, FrameDiagnostics->Desc.GetSize());
+		bDiagnosticsReadbackPending = true;
+		DiagnosticsStep = StepCounter + StepCount;
+		ReadbackBytes += static_cast<uint32>(FrameDiagnostics->Desc.GetSize());
+	}
+	FrameDiagnostics = nullptr;
+	FrameColliders = nullptr;
+
+	if (BakeWriter.IsValid() && !bBakeStopping)
+	{
+		AddBakeCapture(GraphBuilder, StepCounter + StepCount);
+	}
+
+	FlushStepStats(StepCount);
+	StepCounter += StepCount;
+}
+
+void FFluidSimRenderProxy::FlushStepStats(const int32 StepCount)
+{
+	constexpr uint32 VoxelsPerBrick = FluidSimThreads * FluidSimThreads * FluidSimThreads;
+
+	INC_DWORD_STAT_BY(STAT_FluidSimSteps, StepCount);
+	INC_DWORD_STAT_BY(STAT_FluidSimPressureIterations, PressureIterationsDispatched);
+	INC_DWORD_STAT_BY(STAT_FluidSimInjectionEvents, InjectionEventCount);
+	INC_DWORD_STAT_BY(STAT_FluidSimActiveBricks, ActiveBrickCount);
+	INC_DWORD_STAT_BY(STAT_FluidSimActiveVoxels, ActiveBrickCount * VoxelsPerBrick);
+	INC_DWORD_STAT_BY(STAT_FluidSimReadbackBytes, ReadbackBytes);
+
+	CSV_CUSTOM_STAT(FluidSim, Steps, StepCount, ECsvCustomStatOp::Accumulate);
+	CSV_CUSTOM_STAT(FluidSim, PressureIterations, static_cast<int32>(PressureIterationsDispatched), ECsvCustomStatOp::Accumulate);
+	CSV_CUSTOM_STAT(FluidSim, InjectionEvents, static_cast<int32>(InjectionEventCount), ECsvCustomStatOp::Accumulate);
+	CSV_CUSTOM_STAT(FluidSim, ActiveBricks, static_cast<int32>(ActiveBrickCount), ECsvCustomStatOp::Accumulate);
+	CSV_CUSTOM_STAT(FluidSim, ReadbackBytes, static_cast<int32>(ReadbackBytes), ECsvCustomStatOp::Accumulate);
+
+	PressureIterationsDispatched = 0;
+	InjectionEventCount = 0;
+	ActiveBrickCount = 0;
+	ReadbackBytes = 0;
+}
+
+void FFluidSimRenderProxy::ReportFrameStats()
+{
+	// Both clocks call this, only report once per frame.
+	if (LastStatsFrame == GFrameCounterRenderThread)
+	{
+		return;
+	}
+	LastStatsFrame = GFrameCounterRenderThread;
+
+	if (bBrickReadbackPending && ActiveBrickReadback->IsReady())
+	{
+		SparseBrickCount = *static_cast<const uint32*>(ActiveBrickReadback->Lock(sizeof(uint32)));
+		ActiveBrickReadback->Unlock();
+		bBrickReadbackPending = false;
+	}
+
+	// Sparse bricks are a few frames old, dense ones were counted as the steps were added.
+	if (Settings.bSparse)
+	{
+		constexpr uint32 VoxelsPerBrick = FluidSimThreads * FluidSimThreads * FluidSimThreads;
+		INC_DWORD_STAT_BY(STAT_FluidSimActiveBricks, SparseBrickCount);
+		INC_DWORD_STAT_BY(STAT_FluidSimActiveVoxels, SparseBrickCount * VoxelsPerBrick);
+		CSV_CUSTOM_STAT(FluidSim, ActiveBricks, static_cast<int32>(SparseBrickCount), ECsvCustomStatOp::Accumulate);
+	}
+
+	if (bDiagnosticsReadbackPending && DiagnosticsReadback->IsReady())
+	{
+		const float* Values = static_cast<const float*>(DiagnosticsReadback->Lock(5 * sizeof(float)));
+		FFluidSimDiagnostics& Diagnostics = LatestDiagnostics;
+		Diagnostics.TotalDivergence = Values[0];
+		Diagnostics.MaxDivergence = Values[1];
+		Diagnostics.MaxVelocity = Values[2];
+		Diagnostics.TotalDensity = Values[3];
+		Diagnostics.KineticEnergy = Values[4];
+		Diagnostics.Step = static_cast<int32>(DiagnosticsStep);
+		Diagnostics.GPUTimeMs = GPUBudget.GetLastGPUTimeMs();
+		Diagnostics.bValid = true;
+		DiagnosticsReadback->Unlock();
+		bDiagnosticsReadbackPending = false;
+
+		SET_FLOAT_STAT(STAT_FluidSimTotalDivergence, Diagnostics.TotalDivergence);
+		SET_FLOAT_STAT(STAT_FluidSimMaxDivergence, Diagnostics.MaxDivergence);
+		SET_FLOAT_STAT(STAT_FluidSimMaxVelocity, Diagnostics.MaxVelocity);
+		SET_FLOAT_STAT(STAT_FluidSimTotalDensity, Diagnostics.TotalDensity);
+		SET_FLOAT_STAT(STAT_FluidSimKineticEnergy, Diagnostics.KineticEnergy);
+
+		CSV_CUSTOM_STAT(FluidSim, TotalDivergence, Diagnostics.TotalDivergence, ECsvCustomStatOp::Set);
+		CSV_CUSTOM_STAT(FluidSim, MaxDivergence, Diagnostics.MaxDivergence, ECsvCustomStatOp::Set);
+		CSV_CUSTOM_STAT(FluidSim, MaxVelocity, Diagnostics.MaxVelocity, ECsvCustomStatOp::Set);
+		CSV_CUSTOM_STAT(FluidSim, TotalDensity, Diagnostics.TotalDensity, ECsvCustomStatOp::Set);
+		CSV_CUSTOM_STAT(FluidSim, KineticEnergy, Diagnostics.KineticEnergy, ECsvCustomStatOp::Set);
+		bFeedbackPending = true;
+	}
+
+	// New GPU times go out even without diagnostics, dynamic resolution follows them.
+	if (GPUBudget.GetMeasurementCount() != PublishedGPUMeasurement)
+	{
+		PublishedGPUMeasurement = GPUBudget.GetMeasurementCount();
+		bFeedbackPending = true;
+	}
+
+	if (bFeedbackPending)
+	{
+		FFluidSimProxyFeedback& Feedback = FeedbackMailbox.GetWriteSlot();
+		Feedback.Diagnostics = LatestDiagnostics;
+		Feedback.GPUTimeMs = GPUBudget.GetGPUTimeMs();
+		Feedback.WorkloadScale = GPUBudget.GetWorkloadScale();
+
+		// If the game thread hasn't picked up the last one this goes out next frame.
+		bFeedbackPending = !FeedbackMailbox.Publish();
+	}
+
+	INC_FLOAT_STAT_BY(STAT_FluidSimGPUTime, GPUBudget.GetLastGPUTimeMs());
+	CSV_CUSTOM_STAT(FluidSim, GPUTimeMs, GPUBudget.GetLastGPUTimeMs(), ECsvCustomStatOp::Accumulate);
+	CSV_CUSTOM_STAT(FluidSim, TextureMemoryMB, static_cast<float>(TextureMemoryBytes) / (1024.0f * 1024.0f), ECsvCustomStatOp::Accumulate);
+}
+
+FFluidSimGPUProfile FFluidSimRenderProxy::CaptureGPUProfile(FRHICommandListImmediate& RHICmdList)
+{
+	RHICmdList.BlockUntilGPUIdle();
+	StageTimer.Resolve(true);
+
+	FFluidSimGPUProfile Profile;
+	StageTimer.TakeTotals(Profile);
+	Profile.TextureMemoryBytes = TextureMemoryBytes;
+	return Profile;
+}
+
+void FFluidSimRenderProxy::UpdateTextureMemoryStat()
+{
+	DEC_MEMORY_STAT_BY(STAT_FluidSimTextureMemory, TextureMemoryBytes);
+
+	// Persistent state only, scratch fields are transient and owned by RDG.
+	TextureMemoryBytes = 0;
+	for (const FFluidSimCascadeLevel& Level : Levels)
+	{
+		for (FRHITexture* Texture : { Level.RT_Velocity.GetReference(), Level.RT_Density.GetReference(), Level.RT_Pressure.GetReference(), Level.RT_Obstacles.GetReference() })
+		{
+			TextureMemoryBytes += Texture ? RHIComputeMemorySize(Texture) : 0;
+		}
+	}
+
+	INC_MEMORY_STAT_BY(STAT_FluidSimTextureMemory, TextureMemoryBytes);
+}
+
+void FFluidSimRenderProxy::DispatchRenderThread(FRDGBuilder& GraphBuilder, const FObjectGPUDispatchParams& Params)
+{
+	TSharedPtr<FComputeStageIntrinsics> StageIntrinsics = MakeShared<FComputeStageIntrinsics>(GraphBuilder.RHICmdList, GraphBuilder, Params.GroupCount, Params.Settings);
+	StageIntrinsics->Level = Params.Level;
+	StageIntrinsics->DomainOffset = Params.DomainOffset;
+	
+	// Register external textures with the graph builder.
+	FFluidSimCascadeLevel& CascadeLevel = Levels[Params.Level];
+	StageIntrinsics->SH_RT_Density = RegisterExternalTexture(GraphBuilder, CascadeLevel.RT_Density, TEXT("FluidSim_RT_Density"));
+	StageIntrinsics->SH_RT_Velocity = RegisterExternalTexture(GraphBuilder, CascadeLevel.RT_Velocity, TEXT("FluidSim_RT_Velocity"));
+	StageIntrinsics->SH_RT_Pressure = RegisterExternalTexture(GraphBuilder, CascadeLevel.RT_Pressure, TEXT("FluidSim_RT_Pressure"));
+	StageIntrinsics->SH_RT_Obstacles = RegisterExternalTexture(GraphBuilder, CascadeLevel.RT_Obstacles, TEXT("FluidSim_RT_Obstacles"));
+
+	// Scratch fields only live for the step, RDG is free to alias their memory with other passes.
+	StageIntrinsics->SH_RT_Divergence = CreateScratchVolume(GraphBuilder, TEXT("FluidSim_RT_Divergence"));
+
+	// The domain moved, the slabs it moved into still hold the other side of the volume.
+	if (Params.ScrollDelta != FIntVector::ZeroValue)
+	{
+		RDG_GPU_STAT_SCOPE(GraphBuilder, FluidSimScroll);
+		ScrollClear(StageIntrinsics, Params.ScrollDelta);
+	}
+
+	// After the scroll, bricks are placed against the level's current offset.
+	if (!CascadeLevel.PendingObstacleBricks.IsEmpty())
+	{
+		RDG_GPU_STAT_SCOPE(GraphBuilder, FluidSimObstacles);
+		ScatterObstacles(StageIntrinsics, CascadeLevel.PendingObstacleBricks);
+		CascadeLevel.PendingObstacleBricks.Reset();
+		CascadeLevel.bHasObstacles = true;
+	}
+	StageIntrinsics->bObstacles = CascadeLevel.bHasObstacles;
+
+	// Moved since the last step, rasterized again every step of every level.
+	{
+		RDG_GPU_STAT_SCOPE(GraphBuilder, FluidSimColliders);
+		RasterizeColliders(StageIntrinsics);
+	}
+
+	// Pipelined, hand the previous step's result to this frame's materials before the step overwrites it.
+	// The copies run on the graphics pipe and are the only sync point, the step then forks onto async compute
+	// and overlaps with the rest of the frame.
+	if (Params.bWriteOutputs && Params.Settings.bPipelined)
+	{
+		RDG_GPU_STAT_SCOPE(GraphBuilder, FluidSimOutputs);
+		CopyToOutputs(StageIntrinsics);
+	}
+
+	// Projection starts from zero pressure unless warm started. Cleared up front so injected pressure still feeds the solve.
+	if (!Params.Settings.bWarmStartPressure)
+	{
+		AddClearUAVPass(GraphBuilder, GraphBuilder.CreateUAV(StageIntrinsics->SH_RT_Pressure), FLinearColor::Black);
+	}
+	
+	// Stage timings wait for the fields, divergence once a stage wrote it. The sparse stage only writes buffers, its
+	// time goes to the stage that reads them.
+	const FRDGTextureRef Fields[] = { StageIntrinsics->SH_RT_Velocity, StageIntrinsics->SH_RT_Density, StageIntrinsics->SH_RT_Pressure, StageIntrinsics->SH_RT_Divergence };
+	auto TimedFields = [&Fields]() { return TConstArrayView<FRDGTextureRef>(Fields, HasBeenProduced(Fields[3]) ? 4 : 3); };
+	StageTimer.BeginStep(GraphBuilder, TimedFields());
+
+	// Add simulation steps.
+	{
+		RDG_GPU_STAT_SCOPE(GraphBuilder, FluidSimDissipate);
+		Dissipate(StageIntrinsics, StageIntrinsics->SH_RT_Density, StageIntrinsics->Settings.DissipationDensity );
+		Dissipate(StageIntrinsics, StageIntrinsics->SH_RT_Velocity, StageIntrinsics->Settings.DissipationVelocity );
+		StageTimer.EndStage(GraphBuilder, TimedFields(), EFluidSimGPUStage::Dissipate);
+	}
+	{
+		RDG_GPU_STAT_SCOPE(GraphBuilder, FluidSimInject);
+		InjectSources(StageIntrinsics, Params);
+		StageTimer.EndStage(GraphBuilder, TimedFields(), EFluidSimGPUStage::Inject);
+	}
+	{
+		RDG_GPU_STAT_SCOPE(GraphBuilder, FluidSimSparse);
+		UpdateActiveBricks(StageIntrinsics);
+		StageTimer.EndStage(GraphBuilder, TimedFields(), EFluidSimGPUStage::Sparse);
+	}
+	{
+		RDG_GPU_STAT_SCOPE(GraphBuilder, FluidSimDiffuse);
+		Diffusion(StageIntrinsics, StageIntrinsics->SH_RT_Density);
+		StageTimer.EndStage(GraphBuilder, TimedFields(), EFluidSimGPUStage::Diffuse);
+	}
+
+	// Projection
+	{
+		RDG_GPU_STAT_SCOPE(GraphBuilder, FluidSimDivergence);
+		Divergence(StageIntrinsics);
+		StageTimer.EndStage(GraphBuilder, TimedFields(), EFluidSimGPUStage::Divergence);
+	}
+	{
+		RDG_GPU_STAT_SCOPE(GraphBuilder, FluidSimPressure);
+		if (Params.Settings.PressureSolve == EFluidPressureSolve::Adaptive)
+		{
+			// Dispatched, the GPU may skip the tail once converged.
+			ProjectPressureAdaptive(StageIntrinsics);
+			PressureIterationsDispatched += FMath::Max(Params.Settings.MaxPressureIterations, 1);
+		}
+		else
+		{
+			int Itr = 0;
+			while (Itr < Params.Settings.PressureIterations)
+			{
+				ProjectPressure(StageIntrinsics);
+				Itr++;
+			}
+			PressureIterationsDispatched += Itr;
+		}
+		StageTimer.EndStage(GraphBuilder, TimedFields(), EFluidSimGPUStage::Pressure);
+	}
+	{
+		RDG_GPU_STAT_SCOPE(GraphBuilder, FluidSimProject);
+		ProjectGradient(StageIntrinsics);
+		StageTimer.EndStage(GraphBuilder, TimedFields(), EFluidSimGPUStage::Project);
+	}
+
+	// Measured on the projected field, once a frame on the finest level.
+	if (Params.Level == 0 && Params.bWriteOutputs && Params.Settings.bDiagnostics)
+	{
+		RDG_GPU_STAT_SCOPE(GraphBuilder, FluidSimDiagnostics);
+		ReduceDiagnostics(StageIntrinsics);
+	}
+
+	// Final Advection
+	{
+		RDG_GPU_STAT_SCOPE(GraphBuilder, FluidSimAdvect);
+		Advect(StageIntrinsics);
+		StageTimer.EndStage(GraphBuilder, TimedFields(), EFluidSimGPUStage::Advect);
+	}
+
+	// Copy the field to the RT which is then used with other actors/materials.
+	if (Params.bWriteOutputs && !Params.Settings.bPipelined)
+	{
+		RDG_GPU_STAT_SCOPE(GraphBuilder, FluidSimOutputs);
+		CopyToOutputs(StageIntrinsics);
+	}
+
+	// Divergence can't wait for the next step when pipelined, it's transient.
+	if (Params.bWriteOutputs)
+	{
+		RDG_GPU_STAT_SCOPE(GraphBuilder, FluidSimOutputs);
+		CopyDivergenceToOutput(StageIntrinsics);
+	}
+
+	// Dense steps are counted here, sparse ones by the GPU.
+	InjectionEventCount += Params.InjectionEvents.Num();
+	if (!Params.Settings.bSparse)
+	{
+		ActiveBrickCount += Params.GroupCount.X * Params.GroupCount.Y * Params.GroupCount.Z;
+	}
+	
+	StageIntrinsics.Reset();
+}
+
+void FFluidSimRenderProxy::Dissipate(const TSharedPtr<FComputeStageIntrinsics>& Stage, const FRDGTextureRef& DissipationTexture, const float& Strength)
+{
+	if (Stage->Settings.Debug < EFluidStageDebug::Dissipate) { return; }
+	
+	// Instantiate shader.
+	const EFluidSimGroupShape GroupShape = FluidSimPermutation::GetGroupShape(DissipationTexture->Desc.GetSize());
+	FObjectGPUDissipationShader::FPermutationDomain PermutationVector;
+	PermutationVector.Set<FluidSimPermutation::FGroupShapeDim>(GroupShape);
+	const TShaderRef<FObjectGPUDissipationShader>& ComputeShader = Shaders->Dissipation.Get(PermutationVector);
+
+	if (!ComputeShader.IsValid())
+	{
+		UE_LOG(LogFluidSim, Warning, TEXT("Dissipate failed for '%s'"), DissipationTexture->Name);
+		return;
+	}
+
+	FObjectGPUDissipationShader::FParameters* PassParameters = Stage->GraphBuilder.AllocParameters<FObjectGPUDissipationShader::FParameters>();
+	PassParameters->Domain = GetDomainParameters(Stage);
+
+	// Shader parameters.
+	PassParameters->RT_DissipationField = Stage->GraphBuilder.CreateUAV(DissipationTexture);
+	PassParameters->DissipationGain = Strength;
+
+	// Construct compute pass.
+	Stage->GraphBuilder.AddPass(
+		RDG_EVENT_NAME("ExecuteGPUObjectFluidSimDissipation"),
+		PassParameters,
+		ERDGPassFlags::AsyncCompute,
+		[Params=PassParameters, CS=ComputeShader, Group=FComputeShaderUtils::GetGroupCount(DissipationTexture->Desc.GetSize(), FluidSimPermutation::GetGroupSize(GroupShape))](FRHIComputeCommandList& CmdList)
+		{
+			FComputeShaderUtils::Dispatch(CmdList, CS, *Params, Group);
+		}
+	);
+	
+}
+
+void FFluidSimRenderProxy::Diffusion(const TSharedPtr<FComputeStageIntrinsics>& Stage, const FRDGTextureRef& DiffusionTexture)
+{
+	if (Stage->Settings.Debug < EFluidStageDebug::Diffuse) { return; }
+	
+	FObjectGPUDiffusionShader::FPermutationDomain PermutationVector;
+	PermutationVector.Set<FluidSimPermutation::FSparseDim>(Stage->Settings.bSparse);
+	const TShaderRef<FObjectGPUDiffusionShader>& ComputeShader = Shaders->Diffusion.Get(PermutationVector);
+
+	if (!ComputeShader.IsValid())
+	{
+		UE_LOG(LogFluidSim, Warning, TEXT("Diffusion failed for '%s'"), DiffusionTexture->Name);
+		return;
+	}
+
+	// Shader parameters.
+	FObjectGPUDiffusionShader::FParameters* PassParameters = Stage->GraphBuilder.AllocParameters<FObjectGPUDiffusionShader::FParameters>();
+	PassParameters->Domain = GetDomainParameters(Stage);
+	PassParameters->Sparse = GetSparseParameters(Stage);
+	PassParameters->RT_DiffusionField = Stage->GraphBuilder.CreateUAV(DiffusionTexture);
+	PassParameters->DiffusionGain = 1.0f - Stage->Settings.DiffusionStrength;
+
+	// Construct compute pass.
+	Stage->GraphBuilder.AddPass(
+		RDG_EVENT_NAME("ExecuteGPUObjectFluidSimDiffusion"),
+		PassParameters,
+		ERDGPassFlags::AsyncCompute,
+		[Params=PassParameters, CS=ComputeShader, Group=Stage->GPUGroupCount](FRHIComputeCommandList& CmdList)
+		{
+			FComputeShaderUtils::Dispatch(CmdList, CS, *Params, Group);
+		}
+	);
+	
+}
+
+void FFluidSimRenderProxy::Divergence(const TSharedPtr<FComputeStageIntrinsics>& Stage)
+{
+	if (Stage->Settings.Debug < EFluidStageDebug::Divergence) { return; }
+	
+	FObjectGPUDivergenceShader::FPermutationDomain PermutationVector;
+	PermutationVector.Set<FluidSimPermutation::FSparseDim>(Stage->Settings.bSparse);
+	PermutationVector.Set<FluidSimPermutation::FBoundaryDim>(GetBoundaryMode(Stage));
+	const TShaderRef<FObjectGPUDivergenceShader>& ComputeShader = Shaders->Divergence.Get(PermutationVector);
+
+	if (!ComputeShader.IsValid())
+	{
+		UE_LOG(LogFluidSim, Warning, TEXT("Divergence failed."));
+		return;
+	}
+
+	// Skipped bricks don't write divergence, the solve and the debug output read it everywhere. Cleared here rather than
+	// with the brick activity so every sparse step has it, whichever way the bricks were flagged.
+	if (Stage->Settings.bSparse)
+	{
+		AddClearUAVPass(Stage->GraphBuilder, Stage->GraphBuilder.CreateUAV(Stage->SH_RT_Divergence), FLinearColor::Black);
+	}
+
+	// Shader parameters.
+	FObjectGPUDivergenceShader::FParameters* PassParameters = Stage->GraphBuilder.AllocParameters<FObjectGPUDivergenceShader::FParameters>();
+	PassParameters->Domain = GetDomainParameters(Stage);
+	PassParameters->Sparse = GetSparseParameters(Stage);
+	PassParameters->Obstacle = GetObstacleParameters(Stage);
+	PassParameters->RT_Divergence = Stage->GraphBuilder.CreateUAV(Stage->SH_RT_Divergence);
+	PassParameters->RT_Divergence_Vel = Stage->GraphBuilder.CreateSRV(Stage->SH_RT_Velocity);
+	
+	// Construct compute pass.
+	Stage->GraphBuilder.AddPass(
+		RDG_EVENT_NAME("ExecuteGPUObjectFluidSimDivergence"),
+		PassParameters,
+		ERDGPassFlags::AsyncCompute,
+		[Params=PassParameters, CS=ComputeShader, Group=Stage->GPUGroupCount](FRHIComputeCommandList& CmdList)
+		{
+			FComputeShaderUtils::Dispatch(CmdList, CS, *Params, Group);
+		}
+	);
+}
+
+void FFluidSimRenderProxy::ProjectPressure(const TSharedPtr<FComputeStageIntrinsics>& Stage, const bool bIndirect)
+{
+	if (Stage->Settings.Debug < EFluidStageDebug::Pressure) { return; }
+	
+	FObjectGPUProjectPressureShader::FPermutationDomain PermutationVector;
+	PermutationVector.Set<FluidSimPermutation::FSparseDim>(Stage->Settings.bSparse);
+	PermutationVector.Set<FluidSimPermutation::FBoundaryDim>(GetBoundaryMode(Stage));
+	const TShaderRef<FObjectGPUProjectPressureShader>& ComputeShader = Shaders->ProjectPressure.Get(PermutationVector);
+
+	if (!ComputeShader.IsValid())
+	{
+		UE_LOG(LogFluidSim, Warning, TEXT("Project pressure failed."));
+		return;
+	}
+
+	// Shader parameters.
+	FObjectGPUProjectPressureShader::FParameters* PassParameters = Stage->GraphBuilder.AllocParameters<FObjectGPUProjectPressureShader::FParameters>();
+	PassParameters->Domain = GetDomainParameters(Stage);
+	PassParameters->Sparse = GetSparseParameters(Stage);
+	PassParameters->Obstacle = GetObstacleParameters(Stage);
+	PassParameters->RT_ProjPressure_Divergence = Stage->GraphBuilder.CreateSRV(Stage->SH_RT_Divergence);
+	PassParameters->RT_ProjPressure_Pressure = Stage->GraphBuilder.CreateUAV(Stage->SH_RT_Pressure);
+	PassParameters->IndirectArgs = bIndirect ? Stage->PressureIndirectArgs : nullptr;
+	
+	// Construct compute pass.
+	Stage->GraphBuilder.AddPass(
+		RDG_EVENT_NAME("ExecuteGPUObjectFluidSimProjectPressure"),
+		PassParameters,
+		ERDGPassFlags::AsyncCompute,
+		[Params=PassParameters, CS=ComputeShader, Group=Stage->GPUGroupCount](FRHIComputeCommandList& CmdList)
+		{
+			if (Params->IndirectArgs)
+			{
+				FComputeShaderUtils::DispatchIndirect(CmdList, CS, *Params, Params->IndirectArgs->GetIndirectRHICallBuffer(), 0);
+			}
+			else
+			{
+				FComputeShaderUtils::Dispatch(CmdList, CS, *Params, Group);
+			}
+		}
+	);
+}
+
+void FFluidSimRenderProxy::ProjectPressureAdaptive(const TSharedPtr<FComputeStageIntrinsics>& Stage)
+{
+	if (Stage->Settings.Debug < EFluidStageDebug::Pressure) { return; }
+
+	const int32 MaxIterations = FMath::Max(Stage->Settings.MaxPressureIterations, 1);
+	const int32 MinIterations = FMath::Clamp(Stage->Settings.MinPressureIterations, 1, MaxIterations);
+	const int32 CheckInterval = FMath::Max(Stage->Settings.ResidualCheckInterval, 1);
+
+	// Iterations past the minimum are dispatched indirectly, the convergence check zeroes the args once the residual
+	// is low enough so the rest of the chain costs next to nothing. Nothing is read back to the CPU.
+	const FRHIDispatchIndirectParameters InitialArgs = { 
+		static_cast<uint32>(Stage->GPUGroupCount.X), 
+		static_cast<uint32>(Stage->GPUGroupCount.Y), 
+		static_cast<uint32>(Stage->GPUGroupCount.Z) };
+	Stage->PressureIndirectArgs = Stage->GraphBuilder.CreateBuffer(FRDGBufferDesc::CreateIndirectDesc<FRHIDispatchIndirectParameters>(1), TEXT("FluidSim_PressureIndirectArgs"));
+	Stage->GraphBuilder.QueueBufferUpload(Stage->PressureIndirectArgs, &InitialArgs, sizeof(InitialArgs));
+
+	for (int32 Itr = 0; Itr < MaxIterations; Itr++)
+	{
+		ProjectPressure(Stage, Itr >= MinIterations);
+
+		const int32 Done = Itr + 1;
+		if (Done >= MinIterations && Done < MaxIterations && (Done - MinIterations) % CheckInterval == 0)
+		{
+			CheckPressureConvergence(Stage);
+		}
+	}
+
+	Stage->PressureIndirectArgs = nullptr;
+}
+
+void FFluidSimRenderProxy::CheckPressureConvergence(const TSharedPtr<FComputeStageIntrinsics>& Stage)
+{
+	FObjectGPUPressureResidualShader::FPermutationDomain ResidualPermutation;
+	ResidualPermutation.Set<FluidSimPermutation::FSparseDim>(Stage->Settings.bSparse);
+	ResidualPermutation.Set<FluidSimPermutation::FBoundaryDim>(GetBoundaryMode(Stage));
+	const TShaderRef<FObjectGPUPressureResidualShader>& ResidualShader = Shaders->PressureResidual.Get(ResidualPermutation);
+	const TShaderRef<FObjectGPUPressureConvergenceShader>& ConvergenceShader = Shaders->PressureConvergence.Get();
+
+	if (!ResidualShader.IsValid() || !ConvergenceShader.IsValid())
+	{
+		UE_LOG(LogFluidSim, Warning, TEXT("Pressure convergence check failed."));
+		return;
+	}
+
+	FRDGBufferRef ResidualBuffer = Stage->GraphBuilder.CreateBuffer(FRDGBufferDesc::CreateBufferDesc(sizeof(uint32), 1), TEXT("FluidSim_PressureResidual"));
+	FRDGBufferUAVRef ResidualUAV = Stage->GraphBuilder.CreateUAV(ResidualBuffer, PF_R32_UINT);
+	AddClearUAVPass(Stage->GraphBuilder, ResidualUAV, 0u);
+
+	// Reduce the residual.
+	FObjectGPUPressureResidualShader::FParameters* ResidualParameters = Stage->GraphBuilder.AllocParameters<FObjectGPUPressureResidualShader::FParameters>();
+	ResidualParameters->Domain = GetDomainParameters(Stage);
+	ResidualParameters->Sparse = GetSparseParameters(Stage);
+	ResidualParameters->Obstacle = GetObstacleParameters(Stage);
+	ResidualParameters->RT_Residual_Divergence = Stage->GraphBuilder.CreateSRV(Stage->SH_RT_Divergence);
+	ResidualParameters->RT_Residual_Pressure = Stage->GraphBuilder.CreateSRV(Stage->SH_RT_Pressure);
+	ResidualParameters->RW_Residual = ResidualUAV;
+
+	Stage->GraphBuilder.AddPass(
+		RDG_EVENT_NAME("ExecuteGPUObjectFluidSimPressureResidual"),
+		ResidualParameters,
+		ERDGPassFlags::AsyncCompute,
+		[Params=ResidualParameters, CS=ResidualShader, Group=Stage->GPUGroupCount](FRHIComputeCommandList& CmdList)
+		{
+			FComputeShaderUtils::Dispatch(CmdList, CS, *Params, Group);
+		}
+	);
+
+	// Stop the remaining iterations if converged.
+	FObjectGPUPressureConvergenceShader::FParameters* ConvergenceParameters = Stage->GraphBuilder.AllocParameters<FObjectGPUPressureConvergenceShader::FParameters>();
+	ConvergenceParameters->Residual = Stage->GraphBuilder.CreateSRV(ResidualBuffer, PF_R32_UINT);
+	ConvergenceParameters->RW_IndirectArgs = Stage->GraphBuilder.CreateUAV(Stage->PressureIndirectArgs, PF_R32_UINT);
+	ConvergenceParameters->TargetResidual = Stage->Settings.TargetResidual;
+
+	Stage->GraphBuilder.AddPass(
+		RDG_EVENT_NAME("ExecuteGPUObjectFluidSimPressureConvergence"),
+		ConvergenceParameters,
+		ERDGPassFlags::AsyncCompute,
+		[Params=ConvergenceParameters, CS=ConvergenceShader](FRHIComputeCommandList& CmdList)
+		{
+			FComputeShaderUtils::Dispatch(CmdList, CS, *Params, FIntVector(1, 1, 1));
+		}
+	);
+}
+
+void FFluidSimRenderProxy::ProjectGradient(const TSharedPtr<FComputeStageIntrinsics>& Stage)
+{
+	if (Stage->Settings.Debug < EFluidStageDebug::Project) { return; }
+	
+	FObjectGPUProjectGradientShader::FPermutationDomain PermutationVector;
+	PermutationVector.Set<FluidSimPermutation::FSparseDim>(Stage->Settings.bSparse);
+	PermutationVector.Set<FluidSimPermutation::FBoundaryDim>(GetBoundaryMode(Stage));
+    const TShaderRef<FObjectGPUProjectGradientShader>& ComputeShader = Shaders->ProjectGradient.Get(PermutationVector);
+
+    if (!ComputeShader.IsValid())
+    {
+    	UE_LOG(LogFluidSim, Warning, TEXT("Project gradient failed."));
+    	return;
+    }
+
+    // Shader parameters.
+    FObjectGPUProjectGradientShader::FParameters* PassParameters = Stage->GraphBuilder.AllocParameters<FObjectGPUProjectGradientShader::FParameters>();
+    PassParameters->Domain = GetDomainParameters(Stage);
+    PassParameters->Sparse = GetSparseParameters(Stage);
+    PassParameters->Obstacle = GetObstacleParameters(Stage);
+    PassParameters->RT_ProjGradient_Pressure = Stage->GraphBuilder.CreateSRV(Stage->SH_RT_Pressure);
+    PassParameters->RT_ProjGradient_Velocity = Stage->GraphBuilder.CreateUAV(Stage->SH_RT_Velocity);
+    
+    // Construct compute pass.
+    Stage->GraphBuilder.AddPass(
+    	RDG_EVENT_NAME("ExecuteGPUObjectFluidSimProjectGradient"),
+    	PassParameters,
+    	ERDGPassFlags::AsyncCompute,
+    	[Params=PassParameters, CS=ComputeShader, Group=Stage->GPUGroupCount](FRHIComputeCommandList& CmdList)
+    	{
+    		FComputeShaderUtils::Dispatch(CmdList, CS, *Params, Group);
+    	}
+    	);
+}
+
+void FFluidSimRenderProxy::Advect(const TSharedPtr<FComputeStageIntrinsics>& Stage)
+{
+	if (Stage->Settings.Debug < EFluidStageDebug::Advect) { return; }
+	
+	// Instantiate shader.
+	FObjectGPUAdvectionShader::FPermutationDomain PermutationVector;
+	PermutationVector.Set<FluidSimPermutation::FSparseDim>(Stage->Settings.bSparse);
+	PermutationVector.Set<FluidSimPermutation::FBoundaryDim>(GetBoundaryMode(Stage));
+	const TShaderRef<FObjectGPUAdvectionShader>& ComputeShader = Shaders->Advection.Get(PermutationVector);
+
+	if (!ComputeShader.IsValid())
+	{
+		UE_LOG(LogFluidSim, Warning, TEXT("Advection failed."));
+		return;
+	}
+	
+	// Shader parameters.
+	FObjectGPUAdvectionShader::FParameters* PassParameters = Stage->GraphBuilder.AllocParameters<FObjectGPUAdvectionShader::FParameters>();
+	PassParameters->Domain = GetDomainParameters(Stage);
+	PassParameters->Sparse = GetSparseParameters(Stage);
+	PassParameters->Obstacle = GetObstacleParameters(Stage);
+	PassParameters->RT_Field_Read = Stage->GraphBuilder.CreateSRV(Stage->SH_RT_Density );
+	PassParameters->RT_Field_Write = Stage->GraphBuilder.CreateUAV(Stage->SH_RT_Density);
+	PassParameters->RT_Velocity = Stage->GraphBuilder.CreateSRV(Stage->SH_RT_Velocity );
+	PassParameters->RT_Vel_Write = Stage->GraphBuilder.CreateUAV(Stage->SH_RT_Velocity);
+	PassParameters->FieldSize = Stage->SH_RT_Velocity->Desc.GetSize();
+	
+	PassParameters->SamplerTrilinear = Shaders->SamplerTrilinear;
+	
+	// Construct compute pass.
+	Stage->GraphBuilder.AddPass(
+		RDG_EVENT_NAME("ExecuteGPUObjectFluidSimAdvection"),
+		PassParameters,
+		ERDGPassFlags::AsyncCompute,
+		[Params=PassParameters, CS=ComputeShader, Group=Stage->GPUGroupCount](FRHIComputeCommandList& CmdList)
+		{
+			FComputeShaderUtils::Dispatch(CmdList, CS, *Params, Group);
+		}
+	);
+}
+
+void FFluidSimRenderProxy::InjectSources(const TSharedPtr<FComputeStageIntrinsics>& Stage, const FObjectGPUDispatchParams& Params)
+{
+	if (Stage->Settings.Debug < EFluidStageDebug::Inject) { return; }
+
+	// Sorted by the field they write, stable so each field still sees its events in order. Fields are independent,
+	// the result is the same as injecting in submission order.
+	TArray<FFluidSimSourceShaderData, TInlineAllocator<16>> Events;
+	FUintVector4 EventRanges = FUintVector4(0, 0, 0, 0);
+	bool bTypes[4] = {};
+	bool bStamps = false;
+	const uint32 FieldTypes[3][2] = {
+		{ FluidSimCoreInjection::Velocity, FluidSimCoreInjection::Velocity },
+		{ FluidSimCoreInjection::Pressure, FluidSimCoreInjection::FanPressure },
+		{ FluidSimCoreInjection::Density, FluidSimCoreInjection::Density } };
+	for (int32 Field = 0; Field < 3; Field++)
+	{
+		for (const FFluidSimSourceShaderData& Event : Params.InjectionEvents)
+		{
+			if (Event.InjectionType == FieldTypes[Field][0] || Event.InjectionType == FieldTypes[Field][1])
+			{
+				Events.Add(Event);
+				bTypes[FMath::FloorLog2(Event.InjectionType)] = true;
+				bStamps |= Event.Stamp != FluidSimStamps::None;
+			}
+		}
+		EventRanges[Field] = Events.Num();
+	}
+	if (Events.IsEmpty()) { return; } // Nothing to inject this step.
+
+	const FIntVector Resolution = Stage->SH_RT_Velocity->Desc.GetSize();
+	const EFluidSimGroupShape GroupShape = FluidSimPermutation::GetGroupShape(Resolution);
+	
+	// Instantiate shader.
+	FObjectGPUInjectionShader::FPermutationDomain PermutationVector;
+	PermutationVector.Set<FluidSimPermutation::FInjectVelocityDim>(bTypes[0]);
+	PermutationVector.Set<FluidSimPermutation::FInjectPressureDim>(bTypes[1]);
+	PermutationVector.Set<FluidSimPermutation::FInjectFanPressureDim>(bTypes[2]);
+	PermutationVector.Set<FluidSimPermutation::FInjectDensityDim>(bTypes[3]);
+	PermutationVector.Set<FluidSimPermutation::FInjectStampDim>(bStamps);
+	PermutationVector.Set<FluidSimPermutation::FGroupShapeDim>(GroupShape);
+	const TShaderRef<FObjectGPUInjectionShader>& ComputeShader = Shaders->Injection.Get(PermutationVector);
+
+	if (!ComputeShader.IsValid()) return; // Add some warning/error text here later on.
+
+	// Shader parameters.
+	FObjectGPUInjectionShader::FParameters* PassParameters = Stage->GraphBuilder.AllocParameters<FObjectGPUInjectionShader::FParameters>();
+	PassParameters->Domain = GetDomainParameters(Stage);
+
+	// Assign common textures. 
+	PassParameters->RT_Velocity = Stage->GraphBuilder.CreateUAV(Stage->SH_RT_Velocity);
+	PassParameters->RT_Pressure = Stage->GraphBuilder.CreateUAV(Stage->SH_RT_Pressure);
+	PassParameters->RT_Density = Stage->GraphBuilder.CreateUAV(Stage->SH_RT_Density);
+	PassParameters->FieldResolution = Resolution;
+
+	// Create Input events buffer.
+	FRDGBufferRef InputBuffer = CreateStructuredBuffer(
+		Stage->GraphBuilder,
+		TEXT("FluidSimSourcingBuffer"),
+		sizeof(FFluidSimSourceShaderData),
+		Events.Num(),
+		Events.GetData(),
+		Events.Num() * sizeof(FFluidSimSourceShaderData));
+
+	PassParameters->InjectionEventBuffer = Stage->GraphBuilder.CreateSRV(InputBuffer);
+	PassParameters->EventRanges = EventRanges;
+
+	// Hardware filtered, stamped events pay one fetch per voxel instead of the analytic splat, two for velocity.
+	PassParameters->StampAtlas = Stage->GraphBuilder.CreateSRV(RegisterExternalTexture(Stage->GraphBuilder, StampAtlas, TEXT("FluidSim_StampAtlas")));
+	PassParameters->StampSampler = Shaders->SamplerTrilinear;
+	PassParameters->StampCount = FluidSimStamps::Count;
+
+	// Construct render pass.
+	Stage->GraphBuilder.AddPass(
+		RDG_EVENT_NAME("ExecuteGPUObjectFluidSimInjection"),
+		PassParameters,
+		ERDGPassFlags::AsyncCompute,
+		[Params=PassParameters, CS=ComputeShader, Group=FComputeShaderUtils::GetGroupCount(Resolution, FluidSimPermutation::GetGroupSize(GroupShape))](FRHIComputeCommandList& CmdList)
+		{
+			FComputeShaderUtils::Dispatch(CmdList, CS, *Params, Group);
+		}
+	);
+}
+
+void FFluidSimRenderProxy::CopyToOutputs(const TSharedPtr<FComputeStageIntrinsics>& Stage)
+{
+	const FFluidSimOutputResources& Outputs = Levels[Stage->Level].Outputs;
+	const EFluidSimOutputFields Fields = static_cast<EFluidSimOutputFields>(Stage->Settings.OutputFields);
+
+	// Fields left out keep whatever was last copied into them.
+	if (EnumHasAnyFlags(Fields, EFluidSimOutputFields::Velocity))
+	{
+		FRDGTextureRef GameRTVelocity = RegisterExternalTexture(Stage->GraphBuilder, Outputs.Velocity->GetRenderTargetTexture(), TEXT("ObjectGPUFluidSimulation_OutRTVel"));
+		AddOutputCopyPasses(Stage->GraphBuilder, Stage->SH_RT_Velocity, Stage->DomainOffset, GameRTVelocity, EFieldUnits::VoxelVector);
+	}
+
+	if (EnumHasAnyFlags(Fields, EFluidSimOutputFields::Density))
+	{
+		FRDGTextureRef GameRTDensity = RegisterExternalTexture(Stage->GraphBuilder, Outputs.Density->GetRenderTargetTexture(), TEXT("ObjectGPUFluidSimulation_OutRTDensity"));
+		AddOutputCopyPasses(Stage->GraphBuilder, Stage->SH_RT_Density, Stage->DomainOffset, GameRTDensity, EFieldUnits::Unitless);
+	}
+
+	if (EnumHasAnyFlags(Fields, EFluidSimOutputFields::Pressure))
+	{
+		FRDGTextureRef GameRTPressure = RegisterExternalTexture(Stage->GraphBuilder, Outputs.Pressure->GetRenderTargetTexture(), TEXT("ObjectGPUFluidSimulation_OutRTPressure"));
+		AddOutputCopyPasses(Stage->GraphBuilder, Stage->SH_RT_Pressure, Stage->DomainOffset, GameRTPressure, EFieldUnits::VoxelSquared);
+	}
+}
+
+void FFluidSimRenderProxy::CopyDivergenceToOutput(const TSharedPtr<FComputeStageIntrinsics>& Stage)
+{
+	// Debug only, divergence doesn't exist outside of the step that computed it.
+	const FFluidSimOutputResources& Outputs = Levels[Stage->Level].Outputs;
+	if (Outputs.Divergence == nullptr || Stage->Settings.Debug < EFluidStageDebug::Divergence) { return; }
+
+	FRDGTextureRef GameRTDivergence = RegisterExternalTexture(Stage->GraphBuilder, Outputs.Divergence->GetRenderTargetTexture(), TEXT("ObjectGPUFluidSimulation_OutRTDivergence"));
+	AddOutputCopyPasses(Stage->GraphBuilder, Stage->SH_RT_Divergence, Stage->DomainOffset, GameRTDivergence, EFieldUnits::Unitless);
+}
+
+void FFluidSimRenderProxy::UpdateActiveBricks(const TSharedPtr<FComputeStageIntrinsics>& Stage)
+{
+	// Dense steps still bind the buffer, a single brick flagged active that the shaders never index. Only read, so every
+	// dense step of every level shares the one uploaded the first time.
+	if (!Stage->Settings.bSparse)
+	{
+		if (DenseActiveBricks.IsValid())
+		{
+			Stage->ActiveBricks = Stage->GraphBuilder.RegisterExternalBuffer(DenseActiveBricks, TEXT("FluidSim_DenseActiveBricks"));
+			return;
+		}
+
+		constexpr uint32 DenseBrick = 1;
+		Stage->ActiveBricks = Stage->GraphBuilder.CreateBuffer(FRDGBufferDesc::CreateBufferDesc(sizeof(uint32), 1), TEXT("FluidSim_DenseActiveBricks"));
+		Stage->GraphBuilder.QueueBufferUpload(Stage->ActiveBricks, &DenseBrick, sizeof(DenseBrick));
+		DenseActiveBricks = Stage->GraphBuilder.ConvertToExternalBuffer(Stage->ActiveBricks);
+		return;
+	}
+
+	const TShaderRef<FObjectGPUBrickOccupancyShader>& OccupancyShader = Shaders->BrickOccupancy.Get();
+	const TShaderRef<FObjectGPUBrickDilateShader>& DilateShader = Shaders->BrickDilate.Get();
+
+	const FIntVector BrickCount = Stage->GPUGroupCount;
+	const uint32 NumBricks = BrickCount.X * BrickCount.Y * BrickCount.Z;
+	Stage->ActiveBricks = Stage->GraphBuilder.CreateBuffer(FRDGBufferDesc::CreateBufferDesc(sizeof(uint32), NumBricks), TEXT("FluidSim_ActiveBricks"));
+
+	if (!OccupancyShader.IsValid() || !DilateShader.IsValid())
+	{
+		UE_LOG(LogFluidSim, Warning, TEXT("Brick activity failed, simulating every brick."));
+		AddClearUAVPass(Stage->GraphBuilder, Stage->GraphBuilder.CreateUAV(Stage->ActiveBricks, PF_R32_UINT), 1u);
+		return;
+	}
+
+	FRDGBufferRef Occupancy = Stage->GraphBuilder.CreateBuffer(FRDGBufferDesc::CreateBufferDesc(sizeof(uint32), NumBricks), TEXT("FluidSim_BrickOccupancy"));
+	FRDGBufferUAVRef OccupancyUAV = Stage->GraphBuilder.CreateUAV(Occupancy, PF_R32_UINT);
+	AddClearUAVPass(Stage->GraphBuilder, OccupancyUAV, 0u);
+
+	// Flag occupied bricks.
+	FObjectGPUBrickOccupancyShader::FParameters* OccupancyParameters = Stage->GraphBuilder.AllocParameters<FObjectGPUBrickOccupancyShader::FParameters>();
+	OccupancyParameters->Domain = GetDomainParameters(Stage);
+	OccupancyParameters->RT_Sparse_Velocity = Stage->GraphBuilder.CreateSRV(Stage->SH_RT_Velocity);
+	OccupancyParameters->RT_Sparse_Density = Stage->GraphBuilder.CreateSRV(Stage->SH_RT_Density);
+	OccupancyParameters->RW_BrickOccupancy = OccupancyUAV;
+	OccupancyParameters->BrickCount = BrickCount;
+	OccupancyParameters->SparseThreshold = Stage->Settings.SparseThreshold;
+
+	Stage->GraphBuilder.AddPass(
+		RDG_EVENT_NAME("ExecuteGPUObjectFluidSimBrickOccupancy"),
+		OccupancyParameters,
+		ERDGPassFlags::AsyncCompute,
+		[Params=OccupancyParameters, CS=OccupancyShader, Group=Stage->GPUGroupCount](FRHIComputeCommandList& CmdList)
+		{
+			FComputeShaderUtils::Dispatch(CmdList, CS, *Params, Group);
+		}
+	);
+
+	// Grow them by the margin.
+	FObjectGPUBrickDilateShader::FParameters* DilateParameters = Stage->GraphBuilder.AllocParameters<FObjectGPUBrickDilateShader::FParameters>();
+	DilateParameters->BrickOccupancy = Stage->GraphBuilder.CreateSRV(Occupancy, PF_R32_UINT);
+	DilateParameters->RW_ActiveBricks = Stage->GraphBuilder.CreateUAV(Stage->ActiveBricks, PF_R32_UINT);
+	DilateParameters->RW_ActiveBrickCount = Stage->GraphBuilder.CreateUAV(FrameBrickCounter, PF_R32_UINT);
+	DilateParameters->BrickCount = BrickCount;
+	DilateParameters->SparseMargin = FMath::Max(Stage->Settings.SparseMargin, 0);
+
+	Stage->GraphBuilder.AddPass(
+		RDG_EVENT_NAME("ExecuteGPUObjectFluidSimBrickDilate"),
+		DilateParameters,
+		ERDGPassFlags::AsyncCompute,
+		[Params=DilateParameters, CS=DilateShader, Group=FIntVector::DivideAndRoundUp(BrickCount, FluidSimThreads)](FRHIComputeCommandList& CmdList)
+		{
+			FComputeShaderUtils::Dispatch(CmdList, CS, *Params, Group);
+		}
+	);
+}
+
+void FFluidSimRenderProxy::ReduceDiagnostics(const TSharedPtr<FComputeStageIntrinsics>& Stage)
+{
+	const TShaderRef<FObjectGPUDiagnosticsReduceShader>& ReduceShader = Shaders->DiagnosticsReduce.Get();
+	const TShaderRef<FObjectGPUDiagnosticsResolveShader>& ResolveShader = Shaders->DiagnosticsResolve.Get();
+
+	if (!ReduceShader.IsValid() || !ResolveShader.IsValid())
+	{
+		UE_LOG(LogFluidSim, Warning, TEXT("Diagnostics reduction failed."));
+		return;
+	}
+
+	// Sum |divergence|, max |divergence|, max speed, sum density and kinetic energy.
+	constexpr uint32 NumValues = 5;
+	const FIntVector Groups = Stage->GPUGroupCount;
+	const uint32 NumPartials = Groups.X * Groups.Y * Groups.Z;
+
+	FRDGBufferRef Partials = Stage->GraphBuilder.CreateBuffer(FRDGBufferDesc::CreateBufferDesc(sizeof(float), NumPartials * NumValues), TEXT("FluidSim_DiagnosticsPartials"));
+	FrameDiagnostics = Stage->GraphBuilder.CreateBuffer(FRDGBufferDesc::CreateBufferDesc(sizeof(float), NumValues), TEXT("FluidSim_Diagnostics"));
+
+	// One partial per group.
+	FObjectGPUDiagnosticsReduceShader::FParameters* ReduceParameters = Stage->GraphBuilder.AllocParameters<FObjectGPUDiagnosticsReduceShader::FParameters>();
+	ReduceParameters->Domain = GetDomainParameters(Stage);
+	ReduceParameters->RT_Diag_Velocity = Stage->GraphBuilder.CreateSRV(Stage->SH_RT_Velocity);
+	ReduceParameters->RT_Diag_Density = Stage->GraphBuilder.CreateSRV(Stage->SH_RT_Density);
+	ReduceParameters->RW_DiagPartials = Stage->GraphBuilder.CreateUAV(Partials, PF_R32_FLOAT);
+	ReduceParameters->DiagGroupCount = Groups;
+
+	Stage->GraphBuilder.AddPass(
+		RDG_EVENT_NAME("ExecuteGPUObjectFluidSimDiagnosticsReduce"),
+		ReduceParameters,
+		ERDGPassFlags::AsyncCompute,
+		[Params=ReduceParameters, CS=ReduceShader, Group=Groups](FRHIComputeCommandList& CmdList)
+		{
+			FComputeShaderUtils::Dispatch(CmdList, CS, *Params, Group);
+		}
+	);
+
+	// Fold them into the values read back.
+	FObjectGPUDiagnosticsResolveShader::FParameters* ResolveParameters = Stage->GraphBuilder.AllocParameters<FObjectGPUDiagnosticsResolveShader::FParameters>();
+	ResolveParameters->DiagPartials = Stage->GraphBuilder.CreateSRV(Partials, PF_R32_FLOAT);
+	ResolveParameters->RW_Diagnostics = Stage->GraphBuilder.CreateUAV(FrameDiagnostics, PF_R32_FLOAT);
+	ResolveParameters->NumPartials = NumPartials;
+
+	Stage->GraphBuilder.AddPass(
+		RDG_EVENT_NAME("ExecuteGPUObjectFluidSimDiagnosticsResolve"),
+		ResolveParameters,
+		ERDGPassFlags::AsyncCompute,
+		[Params=ResolveParameters, CS=ResolveShader](FRHIComputeCommandList& CmdList)
+		{
+			FComputeShaderUtils::Dispatch(CmdList, CS, *Params, FIntVector(1, 1, 1));
+		}
+	);
+}
+
+void FFluidSimRenderProxy::ScrollClear(const TSharedPtr<FComputeStageIntrinsics>& Stage, const FIntVector& ScrollDelta)
+{
+	const FIntVector Resolution = Stage->SH_RT_Velocity->Desc.GetSize();
+
+	// Moved further than the domain is wide, nothing survives.
+	if (FMath::Abs(ScrollDelta.X) >= Resolution.X || FMath::Abs(ScrollDelta.Y) >= Resolution.Y || FMath::Abs(ScrollDelta.Z) >= Resolution.Z)
+	{
+		AddClearUAVPass(Stage->GraphBuilder, Stage->GraphBuilder.CreateUAV(Stage->SH_RT_Velocity), FLinearColor::Black);
+		AddClearUAVPass(Stage->GraphBuilder, Stage->GraphBuilder.CreateUAV(Stage->SH_RT_Density), FLinearColor::Black);
+		AddClearUAVPass(Stage->GraphBuilder, Stage->GraphBuilder.CreateUAV(Stage->SH_RT_Pressure), FLinearColor::Black);
+		AddClearUAVPass(Stage->GraphBuilder, Stage->GraphBuilder.CreateUAV(Stage->SH_RT_Obstacles), FLinearColor::Black);
+		return;
+	}
+
+	const TShaderRef<FObjectGPUScrollClearShader>& ComputeShader = Shaders->ScrollClear.Get();
+
+	if (!ComputeShader.IsValid())
+	{
+		UE_LOG(LogFluidSim, Warning, TEXT("Scroll clear failed."));
+		return;
+	}
+
+	// Shader parameters.
+	FObjectGPUScrollClearShader::FParameters* PassParameters = Stage->GraphBuilder.AllocParameters<FObjectGPUScrollClearShader::FParameters>();
+	PassParameters->Domain = GetDomainParameters(Stage);
+	PassParameters->RT_Scroll_Velocity = Stage->GraphBuilder.CreateUAV(Stage->SH_RT_Velocity);
+	PassParameters->RT_Scroll_Density = Stage->GraphBuilder.CreateUAV(Stage->SH_RT_Density);
+	PassParameters->RT_Scroll_Pressure = Stage->GraphBuilder.CreateUAV(Stage->SH_RT_Pressure);
+	PassParameters->RT_Scroll_Obstacles = Stage->GraphBuilder.CreateUAV(Stage->SH_RT_Obstacles);
+	PassParameters->ScrollDelta = ScrollDelta;
+
+	// Construct compute pass.
+	Stage->GraphBuilder.AddPass(
+		RDG_EVENT_NAME("ExecuteGPUObjectFluidSimScrollClear"),
+		PassParameters,
+		ERDGPassFlags::AsyncCompute,
+		[Params=PassParameters, CS=ComputeShader, Group=Stage->GPUGroupCount](FRHIComputeCommandList& CmdList)
+		{
+			FComputeShaderUtils::Dispatch(CmdList, CS, *Params, Group);
+		}
+	);
+}
+
+void FFluidSimRenderProxy::ScatterObstacles(const TSharedPtr<FComputeStageIntrinsics>& Stage, const TArray<FFluidSimObstacleBrick>& Bricks)
+{
+	static_assert(FluidSimThreads == FluidSimObstacles::BrickSize, "One thread group covers one obstacle brick.");
+
+	const TShaderRef<FObjectGPUObstacleScatterShader>& ComputeShader = Shaders->ObstacleScatter.Get();
+
+	if (!ComputeShader.IsValid())
+	{
+		UE_LOG(LogFluidSim, Warning, TEXT("Obstacle scatter failed."));
+		return;
+	}
+
+	// Copied into the graph, the level's list is reset once the pass is added.
+	FRDGBufferRef BrickBuffer = CreateStructuredBuffer(Stage->GraphBuilder, TEXT("FluidSim_ObstacleBricks"), sizeof(FFluidSimObstacleBrick), Bricks.Num(), Bricks.GetData(), Bricks.Num() * sizeof(FFluidSimObstacleBrick));
+
+	// Shader parameters.
+	const FIntVector Resolution = Stage->SH_RT_Obstacles->Desc.GetSize();
+	FObjectGPUObstacleScatterShader::FParameters* PassParameters = Stage->GraphBuilder.AllocParameters<FObjectGPUObstacleScatterShader::FParameters>();
+	PassParameters->Domain = GetDomainParameters(Stage);
+	PassParameters->ObstacleBricks = Stage->GraphBuilder.CreateSRV(BrickBuffer);
+	PassParameters->RW_Obstacles = Stage->GraphBuilder.CreateUAV(Stage->SH_RT_Obstacles);
+	PassParameters->LatticeOrigin = Levels[Stage->Level].Centre - Resolution / 2;
+
+	// Construct compute pass.
+	Stage->GraphBuilder.AddPass(
+		RDG_EVENT_NAME("ExecuteGPUObjectFluidSimObstacleScatter"),
+		PassParameters,
+		ERDGPassFlags::AsyncCompute,
+		[Params=PassParameters, CS=ComputeShader, Group=FIntVector(Bricks.Num(), 1, 1)](FRHIComputeCommandList& CmdList)
+		{
+			FComputeShaderUtils::Dispatch(CmdList, CS, *Params, Group);
+		}
+	);
+}
+
+void FFluidSimRenderProxy::RasterizeColliders(const TSharedPtr<FComputeStageIntrinsics>& Stage)
+{
+	// Steps without colliders still bind the field, a single cleared voxel the shaders never read.
+	if (FrameColliders == nullptr)
+	{
+		const FRDGTextureDesc Desc = FRDGTextureDesc::Create3D(FIntVector(1, 1, 1), EPixelFormat::PF_FloatRGBA, FClearValueBinding::Black, ETextureCreateFlags::UAV | ETextureCreateFlags::ShaderResource);
+		Stage->SH_RT_Boundary = Stage->GraphBuilder.CreateTexture(Desc, TEXT("FluidSim_RT_Boundary"));
+		AddClearUAVPass(Stage->GraphBuilder, Stage->GraphBuilder.CreateUAV(Stage->SH_RT_Boundary), FLinearColor::Black);
+		return;
+	}
+
+	Stage->SH_RT_Boundary = CreateScratchVolume(Stage->GraphBuilder, TEXT("FluidSim_RT_Boundary"));
+	AddClearUAVPass(Stage->GraphBuilder, Stage->GraphBuilder.CreateUAV(Stage->SH_RT_Boundary), FLinearColor::Black);
+
+	const TShaderRef<FObjectGPUColliderRasterShader>& ComputeShader = Shaders->ColliderRaster.Get();
+
+	if (!ComputeShader.IsValid())
+	{
+		UE_LOG(LogFluidSim, Warning, TEXT("Collider rasterization failed."));
+		return;
+	}
+
+	// Shader parameters.
+	FObjectGPUColliderRasterShader::FParameters* PassParameters = Stage->GraphBuilder.AllocParameters<FObjectGPUColliderRasterShader::FParameters>();
+	PassParameters->Domain = GetDomainParameters(Stage);
+	PassParameters->Colliders = Stage->GraphBuilder.CreateSRV(FrameColliders);
+	PassParameters->RW_Boundary = Stage->GraphBuilder.CreateUAV(Stage->SH_RT_Boundary);
+	PassParameters->LevelScale = 1.0f / static_cast<float>(1 << Stage->Level);
+	PassParameters->LevelOffset = GetLevelMappingOffset(0, Stage->Level);
+
+	// Construct compute pass.
+	Stage->GraphBuilder.AddPass(
+		RDG_EVENT_NAME("ExecuteGPUObjectFluidSimColliderRaster"),
+		PassParameters,
+		ERDGPassFlags::AsyncCompute,
+		[Params=PassParameters, CS=ComputeShader, Group=FIntVector(FrameColliders->Desc.NumElements, 1, 1)](FRHIComputeCommandList& CmdList)
+		{
+			FComputeShaderUtils::Dispatch(CmdList, CS, *Params, Group);
+		}
+	);
+
+	Stage->bColliders = true;
+}
+
+void FFluidSimRenderProxy::AddCascadeBoundary(FRDGBuilder& GraphBuilder, const int32 FineLevel)
+{
+	const TShaderRef<FObjectGPUCascadeBoundaryShader>& ComputeShader = Shaders->CascadeBoundary.Get();
+
+	if (!ComputeShader.IsValid())
+	{
+		UE_LOG(LogFluidSim, Warning, TEXT("Cascade boundary failed."));
+		return;
+	}
+
+	const FFluidSimCascadeLevel& Fine = Levels[FineLevel];
+	const FFluidSimCascadeLevel& Coarse = Levels[FineLevel + 1];
+
+	// Shader parameters.
+	FObjectGPUCascadeBoundaryShader::FParameters* PassParameters = GraphBuilder.AllocParameters<FObjectGPUCascadeBoundaryShader::FParameters>();
+	PassParameters->Domain.DomainResolution = GridDescription.GridResolution;
+	PassParameters->Domain.DomainOffset = Fine.DomainOffset;
+	PassParameters->RT_Boundary_Velocity = GraphBuilder.CreateUAV(RegisterExternalTexture(GraphBuilder, Fine.RT_Velocity, TEXT("FluidSim_RT_Velocity")));
+	PassParameters->RT_Boundary_Density = GraphBuilder.CreateUAV(RegisterExternalTexture(GraphBuilder, Fine.RT_Density, TEXT("FluidSim_RT_Density")));
+	PassParameters->RT_Coarse_Velocity = GraphBuilder.CreateSRV(RegisterExternalTexture(GraphBuilder, Coarse.RT_Velocity, TEXT("FluidSim_RT_Velocity")));
+	PassParameters->RT_Coarse_Density = GraphBuilder.CreateSRV(RegisterExternalTexture(GraphBuilder, Coarse.RT_Density, TEXT("FluidSim_RT_Density")));
+	PassParameters->CoarseDomainOffset = Coarse.DomainOffset;
+	PassParameters->FineToCoarse = GetLevelMappingOffset(FineLevel, FineLevel + 1);
+
+	// Construct compute pass.
+	GraphBuilder.AddPass(
+		RDG_EVENT_NAME("ExecuteGPUObjectFluidSimCascadeBoundary"),
+		PassParameters,
+		ERDGPassFlags::AsyncCompute,
+		[Params=PassParameters, CS=ComputeShader, Group=GroupCount](FRHIComputeCommandList& CmdList)
+		{
+			FComputeShaderUtils::Dispatch(CmdList, CS, *Params, Group);
+		}
+	);
+}
+
+void FFluidSimRenderProxy::AddCascadeRestriction(FRDGBuilder& GraphBuilder, const int32 FineLevel)
+{
+	const TShaderRef<FObjectGPUCascadeRestrictShader>& ComputeShader = Shaders->CascadeRestrict.Get();
+
+	if (!ComputeShader.IsValid())
+	{
+		UE_LOG(LogFluidSim, Warning, TEXT("Cascade restriction failed."));
+		return;
+	}
+
+	const FFluidSimCascadeLevel& Fine = Levels[FineLevel];
+	const FFluidSimCascadeLevel& Coarse = Levels[FineLevel + 1];
+
+	// Shader parameters, dispatched over the coarse level.
+	FObjectGPUCascadeRestrictShader::FParameters* PassParameters = GraphBuilder.AllocParameters<FObjectGPUCascadeRestrictShader::FParameters>();
+	PassParameters->Domain.DomainResolution = GridDescription.GridResolution;
+	PassParameters->Domain.DomainOffset = Coarse.DomainOffset;
+	PassParameters->RT_Restrict_Velocity = GraphBuilder.CreateUAV(RegisterExternalTexture(GraphBuilder, Coarse.RT_Velocity, TEXT("FluidSim_RT_Velocity")));
+	PassParameters->RT_Restrict_Density = GraphBuilder.CreateUAV(RegisterExternalTexture(GraphBuilder, Coarse.RT_Density, TEXT("FluidSim_RT_Density")));
+	PassParameters->RT_Fine_Velocity = GraphBuilder.CreateSRV(RegisterExternalTexture(GraphBuilder, Fine.RT_Velocity, TEXT("FluidSim_RT_Velocity")));
+	PassParameters->RT_Fine_Density = GraphBuilder.CreateSRV(RegisterExternalTexture(GraphBuilder, Fine.RT_Density, TEXT("FluidSim_RT_Density")));
+	PassParameters->FineDomainOffset = Fine.DomainOffset;
+	PassParameters->FineToCoarse = GetLevelMappingOffset(FineLevel, FineLevel + 1);
+
+	// Construct compute pass.
+	GraphBuilder.AddPass(
+		RDG_EVENT_NAME("ExecuteGPUObjectFluidSimCascadeRestrict"),
+		PassParameters,
+		ERDGPassFlags::AsyncCompute,
+		[Params=PassParameters, CS=ComputeShader, Group=GroupCount](FRHIComputeCommandList& CmdList)
+		{
+			FComputeShaderUtils::Dispatch(CmdList, CS, *Params, Group);
+		}
+	);
+}
+
+void FFluidSimRenderProxy::CaptureCheckpoint(FRHICommandListImmediate& RHICmdList, const FString& Path)
+{
+	if (!ReadyToRender)
+	{
+		UE_LOG(LogFluidSim, Warning, TEXT("Checkpoint '%s' skipped, the simulation isn't running."), *Path);
+		return;
+	}
+
+	FRDGBuilder GraphBuilder(RHICmdList, FRDGEventName(TEXT("UFluidSimulation::CaptureCheckpoint")));
+
+	FCheckpointCapture& Capture = PendingCheckpoints.AddDefaulted_GetRef();
+	Capture.Path = Path;
+	Capture.Resolution = GridDescription.GridResolution;
+
+	// Unwrapped on the GPU so the file doesn't depend on where each level had scrolled to.
+	for (const FFluidSimCascadeLevel& Level : Levels)
+	{
+		for (const FTextureRHIRef& Texture : { Level.RT_Velocity, Level.RT_Density, Level.RT_Pressure })
+		{
+			FRDGTextureRef Source = RegisterExternalTexture(GraphBuilder, Texture, TEXT("FluidSim_Checkpoint_Source"));
+			FRDGTextureRef Linear = CreateScratchVolume(GraphBuilder, TEXT("FluidSim_Checkpoint_Linear"));
+			AddUnwrapCopyPasses(GraphBuilder, Source, Linear, Level.DomainOffset);
+
+			TUniquePtr<FRHIGPUTextureReadback>& Readback = Capture.Readbacks.Add_GetRef(MakeUnique<FRHIGPUTextureReadback>(TEXT("FluidSim_CheckpointReadback")));
+			AddEnqueueCopyPass(GraphBuilder, Readback.Get(), Linear);
+			ReadbackBytes += static_cast<uint32>(Capture.Resolution.X * Capture.Resolution.Y * Capture.Resolution.Z * sizeof(FFloat16Color));
+		}
+	}
+
+	GraphBuilder.Execute();
+}
+
+void FFluidSimRenderProxy::PollCheckpoints()
+{
+	for (int32 Index = PendingCheckpoints.Num() - 1; Index >= 0; Index--)
+	{
+		FCheckpointCapture& Capture = PendingCheckpoints[Index];
+		if (Capture.Readbacks.ContainsByPredicate([](const TUniquePtr<FRHIGPUTextureReadback>& Readback) { return !Readback->IsReady(); }))
+		{
+			continue;
+		}
+
+		TSharedRef<FFluidSimCheckpoint> Checkpoint = MakeShared<FFluidSimCheckpoint>();
+		Checkpoint->Resolution = Capture.Resolution;
+		Checkpoint->Levels.SetNum(Capture.Readbacks.Num() / 3);
+		for (int32 Field = 0; Field < Capture.Readbacks.Num(); Field++)
+		{
+			FFluidSimCheckpointLevel& Level = Checkpoint->Levels[Field / 3];
+			TArray<FFloat16Color>& Dest = Field % 3 == 0 ? Level.Velocity : (Field % 3 == 1 ? Level.Density : Level.Pressure);
+			CopyReadback(*Capture.Readbacks[Field], Capture.Resolution, Dest);
+		}
+
+		UE::Tasks::Launch(UE_SOURCE_LOCATION, [Checkpoint, Path = Capture.Path]()
+		{
+			const double StartTime = FPlatformTime::Seconds();
+			TArray<uint8> Data;
+			if (!FluidSimCheckpoint::Encode(*Checkpoint, Data) || !FFileHelper::SaveArrayToFile(Data, *Path))
+			{
+				UE_LOG(LogFluidSim, Warning, TEXT("Failed to write checkpoint '%s'."), *Path);
+				return;
+			}
+			UE_LOG(LogFluidSim, Log, TEXT("Wrote checkpoint '%s', %d bytes in %.2f ms."), *Path, Data.Num(), (FPlatformTime::Seconds() - StartTime) * 1000.0);
+		});
+
+		PendingCheckpoints.RemoveAtSwap(Index);
+	}
+}
+
+void FFluidSimRenderProxy::FlushCheckpoints()
+{
+	if (PendingCheckpoints.IsEmpty())
+	{
+		return;
+	}
+
+	// Asked for explicitly, worth a stall to still write them.
+	FRHICommandListImmediate::Get().BlockUntilGPUIdle();
+	PollCheckpoints();
+
+	for (const FCheckpointCapture& Capture : PendingCheckpoints)
+	{
+		UE_LOG(LogFluidSim, Warning, TEXT("Checkpoint '%s' dropped, the simulation stopped before it was read back."), *Capture.Path);
+	}
+	PendingCheckpoints.Reset();
+}
+
+void FFluidSimRenderProxy::RestoreCheckpoint(FRHICommandListImmediate& RHICmdList, const FFluidSimCheckpoint& Checkpoint)
+{
+	if (!ReadyToRender)
+	{
+		UE_LOG(LogFluidSim, Warning, TEXT("Checkpoint restore skipped, the simulation isn't running."));
+		return;
+	}
+	if (Checkpoint.Levels.Num() != Levels.Num())
+	{
+		UE_LOG(LogFluidSim, Warning, TEXT("Checkpoint with %d levels doesn't fit the simulation with %d levels."), Checkpoint.Levels.Num(), Levels.Num());
+		return;
+	}
+
+	FRDGBuilder GraphBuilder(RHICmdList, FRDGEventName(TEXT("UFluidSimulation::RestoreCheckpoint")));
+	UploadCheckpoint(RHICmdList, GraphBuilder, Checkpoint);
+	GraphBuilder.Execute();
+}
+
+void FFluidSimRenderProxy::UploadCheckpoint(FRHICommandListImmediate& RHICmdList, FRDGBuilder& GraphBuilder, const FFluidSimCheckpoint& Checkpoint)
+{
+	// Uploaded into staging volumes RDG doesn't know about yet, then copied into the level textures or resampled the same
+	// way a resize would. The graph transitions the level textures, they're left in whatever state the last step used.
+	// Staging comes from the pool and goes back once the graph is built, the next restore at this size reuses it.
+	const FIntVector Res = GridDescription.GridResolution;
+	const FIntVector From = Checkpoint.Resolution;
+	const FUpdateTextureRegion3D Region(0, 0, 0, 0, 0, 0, From.X, From.Y, From.Z);
+	const uint32 RowPitch = From.X * sizeof(FFloat16Color);
+	const uint32 DepthPitch = RowPitch * From.Y;
+
+	auto UploadField = [&](const FTextureRHIRef& Dest, const TArray<FFloat16Color>& Data, const EFieldUnits Units, const TCHAR* Name)
+	{
+		if (Data.Num() != From.X * From.Y * From.Z)
+		{
+			return;
+		}
+
+		FTextureRHIRef Staging = TexturePool->Acquire(TEXT("FluidSim_CheckpointStaging"), From, EPixelFormat::PF_FloatRGBA);
+		RHICmdList.Transition(FRHITransitionInfo(Staging, ERHIAccess::Unknown, ERHIAccess::CopyDest));
+		RHICmdList.UpdateTexture3D(Staging, 0, Region, RowPitch, DepthPitch, reinterpret_cast<const uint8*>(Data.GetData()));
+		RHICmdList.Transition(FRHITransitionInfo(Staging, ERHIAccess::CopyDest, ERHIAccess::SRVCompute));
+
+		FRDGTextureRef StagingTexture = RegisterExternalTexture(GraphBuilder, Staging, TEXT("FluidSim_CheckpointStaging"));
+		FRDGTextureRef DestTexture = RegisterExternalTexture(GraphBuilder, Dest, Name);
+		if (From == Res)
+		{
+			AddCopyTexturePass(GraphBuilder, StagingTexture, DestTexture, FRHICopyTextureInfo());
+		}
+		else
+		{
+			AddResamplePass(GraphBuilder, StagingTexture, FIntVector::ZeroValue, DestTexture, GetResampleScale(Units, From, Res));
+		}
+
+		// Read by the passes above, only lent out again from the next frame.
+		TexturePool->Release(Staging, true);
+	};
+
+	const int32 LevelCount = FMath::Min(Levels.Num(), Checkpoint.Levels.Num());
+	for (int32 LevelIndex = 0; LevelIndex < LevelCount; LevelIndex++)
+	{
+		FFluidSimCascadeLevel& Level = Levels[LevelIndex];
+		const FFluidSimCheckpointLevel& Source = Checkpoint.Levels[LevelIndex];
+		UploadField(Level.RT_Velocity, Source.Velocity, EFieldUnits::VoxelVector, TEXT("FluidSim_RT_Velocity"));
+		UploadField(Level.RT_Density, Source.Density, EFieldUnits::Unitless, TEXT("FluidSim_RT_Density"));
+		UploadField(Level.RT_Pressure, Source.Pressure, EFieldUnits::VoxelSquared, TEXT("FluidSim_RT_Pressure"));
+
+		// Linear again, the level keeps its place in the world.
+		Level.DomainOffset = FIntVector::ZeroValue;
+		Level.PendingScrollDelta = FIntVector::ZeroValue;
+	}
+}
+
+void FFluidSimRenderProxy::StartBake(const FString& Path)
+{
+	const FFluidSimOutputResources& Outputs = Levels[0].Outputs;
+	if (!ReadyToRender || !Outputs.IsValid())
+	{
+		UE_LOG(LogFluidSim, Warning, TEXT("Bake '%s' skipped, the simulation isn't running."), *Path);
+		return;
+	}
+
+	StopBake();
+	FinishBake();
+
+	// Outputs are already linear and at their authored size, the sequence plays straight back into them.
+	BakePath = Path;
+	BakeResolution = Outputs.Velocity->GetRenderTargetTexture()->GetSizeXYZ();
+	BakeWriter = MakeShared<FFluidSimSequenceWriter>();
+	BakeStartStep = StepCounter;
+	BakeStartTime = FPlatformTime::Seconds();
+	bBakeStopping = false;
+
+	BakeTask = UE::Tasks::Launch(UE_SOURCE_LOCATION, [Writer = BakeWriter, Path, Resolution = BakeResolution]()
+	{
+		if (!Writer->Open(*Path, Resolution))
+		{
+			UE_LOG(LogFluidSim, Warning, TEXT("Failed to open '%s' for baking."), *Path);
+		}
+	}, UE::Tasks::Prerequisites(BakeTask));
+	UE_LOG(LogFluidSim, Log, TEXT("Baking fluid sim outputs at %s to '%s'."), *BakeResolution.ToString(), *Path);
+}
+
+void FFluidSimRenderProxy::StopBake()
+{
+	// Closed once the frames still in flight are written.
+	if (BakeWriter.IsValid())
+	{
+		bBakeStopping = true;
+		PollBake();
+	}
+}
+
+void FFluidSimRenderProxy::AddBakeCapture(FRDGBuilder& GraphBuilder, const uint32 Step)
+{
+	const FFluidSimOutputResources& Outputs = Levels[0].Outputs;
+	if (Outputs.Velocity->GetRenderTargetTexture()->GetSizeXYZ() != BakeResolution)
+	{
+		UE_LOG(LogFluidSim, Warning, TEXT("Bake '%s' stopped, the outputs changed size."), *BakePath);
+		StopBake();
+		return;
+	}
+
+	FBakeCapture& Capture = PendingBakeFrames.AddDefaulted_GetRef();
+	Capture.Step = Step - BakeStartStep;
+
+	// The render thread clock steps at a fixed rate, the game thread clock once per tick at whatever rate the game runs.
+	Capture.Time = Settings.Clock == EFluidSimClock::RenderThread ?
+		static_cast<float>(Capture.Step) / FMath::Max(Settings.SimulationRate, 1.0f) :
+		static_cast<float>(FPlatformTime::Seconds() - BakeStartTime);
+	Capture.Resolution = BakeResolution;
+	Capture.Velocity = MakeUnique<FRHIGPUTextureReadback>(TEXT("FluidSim_BakeVelocityReadback"));
+	Capture.Density = MakeUnique<FRHIGPUTextureReadback>(TEXT("FluidSim_BakeDensityReadback"));
+
+	AddEnqueueCopyPass(GraphBuilder, Capture.Velocity.Get(), RegisterExternalTexture(GraphBuilder, Outputs.Velocity->GetRenderTargetTexture(), TEXT("FluidSim_BakeVelocity")));
+	AddEnqueueCopyPass(GraphBuilder, Capture.Density.Get(), RegisterExternalTexture(GraphBuilder, Outputs.Density->GetRenderTargetTexture(), TEXT("FluidSim_BakeDensity")));
+	ReadbackBytes += static_cast<uint32>(2 * BakeResolution.X * BakeResolution.Y * BakeResolution.Z * sizeof(FFloat16Color));
+}
+
+void FFluidSimRenderProxy::PollBake()
+{
+	// Readbacks land in the order they were queued, frames have to be written in step order anyway.
+	int32 ReadyCount = 0;
+	for (; ReadyCount < PendingBakeFrames.Num(); ReadyCount++)
+	{
+		FBakeCapture& Capture = PendingBakeFrames[ReadyCount];
+		if (!Capture.Velocity->IsReady() || !Capture.Density->IsReady())
+		{
+			break;
+		}
+
+		TSharedRef<FFluidSimCheckpointLevel> Frame = MakeShared<FFluidSimCheckpointLevel>();
+		CopyReadback(*Capture.Velocity, Capture.Resolution, Frame->Velocity);
+		CopyReadback(*Capture.Density, Capture.Resolution, Frame->Density);
+
+		BakeTask = UE::Tasks::Launch(UE_SOURCE_LOCATION, [Writer = BakeWriter, Frame, Step = Capture.Step, Time = Capture.Time]()
+		{
+			if (Writer->IsOpen() && !Writer->AddFrame(static_cast<int32>(Step), Time, *Frame))
+			{
+				UE_LOG(LogFluidSim, Warning, TEXT("Failed to bake fluid sim step %d."), Step);
+			}
+		}, UE::Tasks::Prerequisites(BakeTask));
+	}
+	PendingBakeFrames.RemoveAt(0, ReadyCount);
+
+	if (bBakeStopping && PendingBakeFrames.IsEmpty())
+	{
+		FinishBake();
+	}
+}
+
+void FFluidSimRenderProxy::FinishBake()
+{
+	if (!BakeWriter.IsValid())
+	{
+		return;
+	}
+
+	// Frames still in flight are dropped, the file is closed with whatever was written.
+	if (!PendingBakeFrames.IsEmpty())
+	{
+		UE_LOG(LogFluidSim, Warning, TEXT("Bake '%s' dropped %d frames still being read back."), *BakePath, PendingBakeFrames.Num());
+		PendingBakeFrames.Reset();
+	}
+
+	BakeTask = UE::Tasks::Launch(UE_SOURCE_LOCATION, [Writer = BakeWriter, Path = BakePath]()
+	{
+		Writer->Close();
+		UE_LOG(LogFluidSim, Log, TEXT("Finished baking '%s'."), *Path);
+	}, UE::Tasks::Prerequisites(BakeTask));
+
+	BakeWriter.Reset();
+	bBakeStopping = false;
+}
+
+void FFluidSimRenderProxy::StopRenderThread()
+{
+	ReadyToRender = false; 
+	FinishBake();
+	FlushCheckpoints();
+
+	for (FFluidSimCascadeLevel& Level : Levels)
+	{
+		TexturePool->Release(Level.RT_Pressure);
+		TexturePool->Release(Level.RT_Density);
+		TexturePool->Release(Level.RT_Velocity);
+		TexturePool->Release(Level.RT_Obstacles);
+	}
+	StampAtlas = nullptr;
+	UpdateTextureMemoryStat();
+}
+
+FRDGTextureRef FFluidSimRenderProxy::CreateScratchVolume(FRDGBuilder& GraphBuilder, const TCHAR* TexName, const EPixelFormat TexType) const
+{
+	const FRDGTextureDesc Desc = FRDGTextureDesc::Create3D(
+		GridDescription.GridResolution,
+		TexType,
+		FClearValueBinding::Black,
+		ETextureCreateFlags::UAV | ETextureCreateFlags::ShaderResource);
+
+	return GraphBuilder.CreateTexture(Desc, TexName);
+}
+
+void FFluidSimRenderProxy::AddUnwrapCopyPasses(FRDGBuilder& GraphBuilder, FRDGTextureRef Source, FRDGTextureRef Dest, const FIntVector& DomainOffset) const
+{
+	const FIntVector Resolution = Source->Desc.GetSize();
+	if (DomainOffset == FIntVector::ZeroValue)
+	{
+		AddCopyTexturePass(GraphBuilder, Source, Dest, FRHICopyTextureInfo());
+		return;
+	}
+
+	// Per axis the torus splits into the run from the offset to the end and the run that wrapped around to the start.
+	struct FRun { int32 Src; int32 Dst; int32 Size; };
+	auto GetRuns = [](const int32 Offset, const int32 Size, FRun (&OutRuns)[2]) -> int32
+	{
+		OutRuns[0] = { Offset, 0, Size - Offset };
+		OutRuns[1] = { 0, Size - Offset, Offset };
+		return Offset == 0 ? 1 : 2;
+	};
+
+	FRun RunsX[2], RunsY[2], RunsZ[2];
+	const int32 NumX = GetRuns(DomainOffset.X, Resolution.X, RunsX);
+	const int32 NumY = GetRuns(DomainOffset.Y, Resolution.Y, RunsY);
+	const int32 NumZ = GetRuns(DomainOffset.Z, Resolution.Z, RunsZ);
+
+	for (int32 X = 0; X < NumX; X++)
+	{
+		for (int32 Y = 0; Y < NumY; Y++)
+		{
+			for (int32 Z = 0; Z < NumZ; Z++)
+			{
+				FRHICopyTextureInfo CopyInfo;
+				CopyInfo.SourcePosition = FIntVector(RunsX[X].Src, RunsY[Y].Src, RunsZ[Z].Src);
+				CopyInfo.DestPosition = FIntVector(RunsX[X].Dst, RunsY[Y].Dst, RunsZ[Z].Dst);
+				CopyInfo.Size = FIntVector(RunsX[X].Size, RunsY[Y].Size, RunsZ[Z].Size);
+				AddCopyTexturePass(GraphBuilder, Source, Dest, CopyInfo);
+			}
+		}
+	}
+}
+
+void FFluidSimRenderProxy::AddResamplePass(FRDGBuilder& GraphBuilder, FRDGTextureRef Source, const FIntVector& SourceOffset, FRDGTextureRef Dest, const FVector4f& ValueScale) const
+{
+	const TShaderRef<FObjectGPUResampleShader>& ComputeShader = Shaders->Resample.Get();
+
+	if (!ComputeShader.IsValid())
+	{
+		UE_LOG(LogFluidSim, Warning, TEXT("Resample failed for '%s'"), Source->Name);
+		return;
+	}
+
+	// Shader parameters, the domain is the destination.
+	const FIntVector DestResolution = Dest->Desc.GetSize();
+	FObjectGPUResampleShader::FParameters* PassParameters = GraphBuilder.AllocParameters<FObjectGPUResampleShader::FParameters>();
+	PassParameters->Domain.DomainResolution = DestResolution;
+	PassParameters->Domain.DomainOffset = FIntVector::ZeroValue;
+	PassParameters->RT_Resample_Source = GraphBuilder.CreateSRV(Source);
+	PassParameters->RT_Resample_Dest = GraphBuilder.CreateUAV(Dest);
+	PassParameters->SourceResolution = Source->Desc.GetSize();
+	PassParameters->SourceOffset = SourceOffset;
+	PassParameters->ValueScale = ValueScale;
+
+	// Construct compute pass.
+	GraphBuilder.AddPass(
+		RDG_EVENT_NAME("ExecuteGPUObjectFluidSimResample"),
+		PassParameters,
+		ERDGPassFlags::AsyncCompute,
+		[Params=PassParameters, CS=ComputeShader, Group=FIntVector::DivideAndRoundUp(DestResolution, FluidSimThreads)](FRHIComputeCommandList& CmdList)
+		{
+			FComputeShaderUtils::Dispatch(CmdList, CS, *Params, Group);
+		}
+	);
+}
+
+FVector4f FFluidSimRenderProxy::GetResampleScale(const EFieldUnits Units, const FIntVector& From, const FIntVector& To)
+{
+	const FVector3f Ratio = FVector3f(To) / FVector3f(From);
+	switch (Units)
+	{
+	case EFieldUnits::VoxelVector:
+		return FVector4f(Ratio.X, Ratio.Y, Ratio.Z, 1.0f);
+
+	case EFieldUnits::VoxelSquared:
+	{
+		// Scalar fields are stored in every channel.
+		const float AverageRatio = (Ratio.X + Ratio.Y + Ratio.Z) / 3.0f;
+		const float Scale = AverageRatio * AverageRatio;
+		return FVector4f(Scale, Scale, Scale, 1.0f);
+	}
+
+	default:
+		return FVector4f(1.0f, 1.0f, 1.0f, 1.0f);
+	}
+}
+
+void FFluidSimRenderProxy::AddOutputCopyPasses(FRDGBuilder& GraphBuilder, FRDGTextureRef Source, const FIntVector& SourceOffset, FRDGTextureRef Dest, const EFieldUnits Units) const
+{
+	const FIntVector SourceResolution = Source->Desc.GetSize();
+	const FIntVector DestResolution = Dest->Desc.GetSize();
+	if (SourceResolution == DestResolution)
+	{
+		AddUnwrapCopyPasses(GraphBuilder, Source, Dest, SourceOffset);
+		return;
+	}
+
+	// Outputs keep their authored size while the simulation runs at a lower one. Values measured in voxels are
+	// scaled to output voxels so materials see the same units at any resolution.
+	const FVector4f FieldScale = GetResampleScale(Units, SourceResolution, DestResolution);
+
+	const FRDGTextureDesc Desc = FRDGTextureDesc::Create3D(
+		DestResolution,
+		Source->Desc.Format,
+		FClearValueBinding::Black,
+		ETextureCreateFlags::UAV | ETextureCreateFlags::ShaderResource);
+	FRDGTextureRef Resampled = GraphBuilder.CreateTexture(Desc, TEXT("FluidSim_ResampledOutput"));
+
+	AddResamplePass(GraphBuilder, Source, SourceOffset, Resampled, FieldScale);
+	AddCopyTexturePass(GraphBuilder, Resampled, Dest, FRHICopyTextureInfo());
+}
+
+void FFluidSimRenderProxy::CreateRHITextureResource(FTextureRHIRef& TexReference, const TCHAR* TexName, const EPixelFormat& TexType, const FLinearColor& ClearColour)
+{
+	TexReference = TexturePool->Acquire(TexName, GridDescription.GridResolution, TexType, ClearColour);
+}
@@ -0,0 +1,332 @@
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "RHIResources.h"
+#include "RenderGraphResources.h"
+#include "FluidStructs.h"
+#include "FluidSimMailbox.h"
+#include "FluidSimGPUBudget.h"
+#include "FluidSimStageTimer.h"
+#include "FluidSimObstacles.h"
+#include "Tasks/Task.h"
+
+class FRHICommandListImmediate;
+class FRHIGPUBufferReadback;
+class FRHIGPUTextureReadback;
+struct FFluidSimCheckpoint;
+class FFluidSimSequenceWriter;
+class FFluidSimShaderCache;
+class FFluidSimTexturePool;
+class FTextureRenderTargetResource;
+class FTextureResource;
+
+// Everything the game thread hands over to the proxy between two render thread updates.
+struct FFluidSimProxyPacket
+{
+	FFluidSolverSettings Settings;
+	FGridDescription GridDescription;
+	TArray<FFluidSimSourceShaderData> InjectionEvents;
+	int32 StepCount = 0;
+
+	// World voxel of the finest level at the domain centre, the proxy derives every level's scroll from it.
+	FIntVector DomainCentre = FIntVector::ZeroValue;
+
+	// Obstacle bricks voxelized since the last packet, every level's in one list.
+	TArray<FFluidSimObstacleBrick> ObstacleBricks;
+
+	// Every moving collider, only filled in when they changed since the last packet.
+	TArray<FFluidSimColliderShaderData> Colliders;
+	bool bCollidersChanged = false;
+
+	void Reset()
+	{
+		InjectionEvents.Reset();
+		ObstacleBricks.Reset();
+		Colliders.Reset();
+		bCollidersChanged = false;
+		StepCount = 0;
+	}
+};
+
+// Everything the render thread hands back to the game thread, only the latest one matters.
+struct FFluidSimProxyFeedback
+{
+	FFluidSimDiagnostics Diagnostics;
+
+	// Smoothed GPU time of the simulation per frame and the workload the GPU budget runs it at, measured whether or
+	// not diagnostics are on. 0 until the first frame was timed.
+	float GPUTimeMs = 0.0f;
+	float WorkloadScale = 1.0f;
+
+	void Reset() {}
+};
+
+// Render resources of the content browser textures the simulation is copied into.
+// Resolved on the game thread so the render thread never touches the UObjects.
+struct FFluidSimOutputResources
+{
+	FTextureRenderTargetResource* Velocity = nullptr;
+	FTextureRenderTargetResource* Density = nullptr;
+	FTextureRenderTargetResource* Pressure = nullptr;
+	FTextureRenderTargetResource* Divergence = nullptr;
+
+	// Divergence is an optional debug output.
+	bool IsValid() const { return Velocity && Density && Pressure; }
+};
+
+// Fields the levels start from instead of zero, uploaded once by SetupRenderThread().
+struct FFluidSimInitialState
+{
+	// Any resolution, levels it doesn't have start empty.
+	TSharedPtr<const FFluidSimCheckpoint> Checkpoint;
+
+	// Volume textures resampled into the finest level after the checkpoint, velocity in voxels of the texture.
+	FTextureResource* Velocity = nullptr;
+	FTextureResource* Density = nullptr;
+
+	bool IsSet() const { return Checkpoint.IsValid() || Velocity || Density; }
+};
+
+// GPU state of one cascade level. Level 0 is the finest, every level above doubles the voxel size and steps half as often.
+struct FFluidSimCascadeLevel
+{
+	FFluidSimOutputResources Outputs;
+
+	FTextureRHIRef RT_Density = nullptr;
+	FTextureRHIRef RT_Velocity = nullptr;
+	FTextureRHIRef RT_Pressure = nullptr;
+
+	// World voxel at the centre of the level, in voxels of this level, and the physical voxel holding logical voxel 0.
+	FIntVector Centre = FIntVector::ZeroValue;
+	FIntVector DomainOffset = FIntVector::ZeroValue;
+
+	// Held until the level next steps.
+	FIntVector PendingScrollDelta = FIntVector::ZeroValue;
+	TArray<FFluidSimSourceShaderData> PendingEvents;
+
+	// Solid voxels, toroidally addressed like the fields. Bricks are scattered in before the level's next step.
+	FTextureRHIRef RT_Obstacles = nullptr;
+	TArray<FFluidSimObstacleBrick> PendingObstacleBricks;
+	bool bHasObstacles = false;
+};
+
+// Render thread side of a UFluidSimulation, owns all of the GPU state.
+// Created on the game thread, after that only touched on the render thread apart from the mailbox write slot.
+// Released with a render command so the game thread never has to wait for the GPU on teardown.
+class FFluidSimRenderProxy
+{
+public:
+	// One set of outputs per cascade level. The level textures are borrowed from TexturePool and given back on stop.
+	FFluidSimRenderProxy(const FGridDescription& InGridDescription, const TArray<FFluidSimOutputResources>& InLevelOutputs, const TSharedRef<FFluidSimShaderCache, ESPMode::ThreadSafe>& InShaders, const TSharedRef<FFluidSimTexturePool, ESPMode::ThreadSafe>& InTexturePool, const FFluidSimInitialState& InInitialState = FFluidSimInitialState());
+	~FFluidSimRenderProxy();
+
+	// Game thread
+	TFluidSimMailbox<FFluidSimProxyPacket>& GetMailbox() { return Mailbox; }
+
+	// Game thread consumes, render thread produces.
+	TFluidSimMailbox<FFluidSimProxyFeedback>& GetFeedbackMailbox() { return FeedbackMailbox; }
+
+	// Render thread
+	void SetupRenderThread(FRHICommandListImmediate& RHICmdList);
+
+	// Game thread clock, runs the steps queued by UFluidSimulation::SimulationStep.
+	void UpdateRenderThread(FRHICommandListImmediate& RHICmdList);
+
+	// Render thread clock, called every rendered view family and steps at most once per frame.
+	void TickRenderThread(FRDGBuilder& GraphBuilder);
+
+	// Reads every level back and writes it to Path, encoded off the render thread once the readbacks land.
+	void CaptureCheckpoint(FRHICommandListImmediate& RHICmdList, const FString& Path);
+
+	// Uploads into the level textures, resampled if the resolution differs. The level count has to match.
+	void RestoreCheckpoint(FRHICommandListImmediate& RHICmdList, const FFluidSimCheckpoint& Checkpoint);
+
+	// Appends the finest level's velocity and density outputs to a sequence file every frame that steps, see
+	// FluidSimSequence.h. Frames are read back and encoded in order off the render thread.
+	void StartBake(const FString& Path);
+	void StopBake();
+
+	// Waits for the GPU, then hands over the stage times gathered since the last call. For tests and tools.
+	FFluidSimGPUProfile CaptureGPUProfile(FRHICommandListImmediate& RHICmdList);
+
+private: // Simulation
+	void StopRenderThread();
+	void ConsumeMailbox(FRDGBuilder& GraphBuilder);
+	void UpdateGPUBudget();
+
+	// stat FluidSim and CSV counters. Frame counters are flushed after the steps, GPU feedback once per frame.
+	void FlushStepStats(const int32 StepCount);
+	void ReportFrameStats();
+	void UpdateTextureMemoryStat();
+	void PollCheckpoints();
+	// Writes the checkpoints still being read back, waiting for the GPU.
+	void FlushCheckpoints();
+	void UploadCheckpoint(FRHICommandListImmediate& RHICmdList, FRDGBuilder& GraphBuilder, const FFluidSimCheckpoint& Checkpoint);
+	void ApplyInitialState(FRHICommandListImmediate& RHICmdList);
+	void AddBakeCapture(FRDGBuilder& GraphBuilder, const uint32 Step);
+	void PollBake();
+	void FinishBake();
+	void AddSimulationSteps(FRDGBuilder& GraphBuilder, const int32 StepCount);
+	void DispatchRenderThread(FRDGBuilder& GraphBuilder, const FObjectGPUDispatchParams& Params);
+
+	// Dynamic resolution, carries every level over into new textures.
+	void ResizeLevels(FRDGBuilder& GraphBuilder, const FGridDescription& InGridDescription);
+
+	// Cascades
+	void SetDomainCentre(const FIntVector& FineCentre);
+	bool IsLevelDue(const int32 Level, const uint32 Step) const;
+	void AddCascadeBoundary(FRDGBuilder& GraphBuilder, const int32 FineLevel);
+	void AddCascadeRestriction(FRDGBuilder& GraphBuilder, const int32 FineLevel);
+
+	// Simulation Stages
+	void Dissipate(const TSharedPtr<FComputeStageIntrinsics>& Stage, const FRDGTextureRef& DissipationTexture, const float& Strength);
+	void Diffusion(const TSharedPtr<FComputeStageIntrinsics>& Stage, const FRDGTextureRef& DiffusionTexture);
+	void Divergence(const TSharedPtr<FComputeStageIntrinsics>& Stage);
+	void ProjectPressure(const TSharedPtr<FComputeStageIntrinsics>& Stage, const bool bIndirect = false);
+	void ProjectPressureAdaptive(const TSharedPtr<FComputeStageIntrinsics>& Stage);
+	void CheckPressureConvergence(const TSharedPtr<FComputeStageIntrinsics>& Stage);
+	void ProjectGradient(const TSharedPtr<FComputeStageIntrinsics>& Stage);
+	void Advect(const TSharedPtr<FComputeStageIntrinsics>& Stage);
+	void InjectSources(const TSharedPtr<FComputeStageIntrinsics>& Stage, const FObjectGPUDispatchParams& Params);
+	void UpdateActiveBricks(const TSharedPtr<FComputeStageIntrinsics>& Stage);
+	void ReduceDiagnostics(const TSharedPtr<FComputeStageIntrinsics>& Stage);
+	void ScrollClear(const TSharedPtr<FComputeStageIntrinsics>& Stage, const FIntVector& ScrollDelta);
+	void ScatterObstacles(const TSharedPtr<FComputeStageIntrinsics>& Stage, const TArray<FFluidSimObstacleBrick>& Bricks);
+	void RasterizeColliders(const TSharedPtr<FComputeStageIntrinsics>& Stage);
+	void CopyToOutputs(const TSharedPtr<FComputeStageIntrinsics>& Stage);
+	void CopyDivergenceToOutput(const TSharedPtr<FComputeStageIntrinsics>& Stage);
+
+private: // Helpers GPU
+	// Per step field, allocated by RDG's transient allocator and never kept across steps.
+	FRDGTextureRef CreateScratchVolume(FRDGBuilder& GraphBuilder, const TCHAR* TexName, const EPixelFormat TexType = EPixelFormat::PF_FloatRGBA) const;
+
+	// Copies a toroidally addressed field into a linear one, at most eight region copies.
+	void AddUnwrapCopyPasses(FRDGBuilder& GraphBuilder, FRDGTextureRef Source, FRDGTextureRef Dest, const FIntVector& Offset) const;
+
+	// Trilinear resample of a toroidally addressed field into a linear one of any resolution covering the same extent.
+	void AddResamplePass(FRDGBuilder& GraphBuilder, FRDGTextureRef Source, const FIntVector& SourceOffset, FRDGTextureRef Dest, const FVector4f& ValueScale) const;
+
+	// How a field's values depend on the voxel size, for carrying it over to another resolution.
+	enum class EFieldUnits : uint8
+	{
+		Unitless,		// Density, and divergence, a velocity difference across one voxel.
+		VoxelVector,	// Velocity, scaled per axis.
+		VoxelSquared	// Pressure, its gradient across one voxel is a velocity.
+	};
+	static FVector4f GetResampleScale(const EFieldUnits Units, const FIntVector& From, const FIntVector& To);
+
+	// Unwrapped copy when the output matches the simulation resolution, resampled otherwise.
+	void AddOutputCopyPasses(FRDGBuilder& GraphBuilder, FRDGTextureRef Source, const FIntVector& SourceOffset, FRDGTextureRef Dest, const EFieldUnits Units) const;
+
+	// Maps voxel indices of one level onto another, To = From * 2^(FromLevel - ToLevel) + Offset.
+	FVector3f GetLevelMappingOffset(const int32 FromLevel, const int32 ToLevel) const;
+
+	// Borrowed from the texture pool at the current resolution.
+	void CreateRHITextureResource(FTextureRHIRef& TexReference,
+	                              const TCHAR* TexName,
+	                              const EPixelFormat& TexType,
+	                              const FLinearColor& ClearColour = FLinearColor::Black);
+
+private: // Game <-> render thread handoff
+	TFluidSimMailbox<FFluidSimProxyPacket> Mailbox;
+	TFluidSimMailbox<FFluidSimProxyFeedback> FeedbackMailbox;
+
+private: // Render thread
+	bool ReadyToRender = false;
+
+	// Brought up to date in SetupRenderThread(), the stages never touch the global shader map.
+	TSharedRef<FFluidSimShaderCache, ESPMode::ThreadSafe> Shaders;
+
+	// Both shared with every other proxy, see UFluidSimTexturePoolSubsystem.
+	TSharedRef<FFluidSimTexturePool, ESPMode::ThreadSafe> TexturePool;
+
+	// Released once uploaded.
+	FFluidSimInitialState InitialState;
+
+	FGridDescription GridDescription;
+	FIntVector GroupCount;
+
+	// Latest state received through the mailbox.
+	FFluidSolverSettings Settings;
+
+	// Settings the steps run with, after the GPU budget scaled the workload.
+	FFluidSolverSettings StepSettings;
+	FFluidSimGPUBudget GPUBudget;
+	FFluidSimStageTimer StageTimer;
+	int32 PendingSteps = 0;
+	bool bHasDomainCentre = false;
+
+	// Finest first, persistent state of every level. Everything else is transient per step.
+	TArray<FFluidSimCascadeLevel> Levels;
+
+	// Steps taken by the finest level, coarser levels step every 2^Level of them.
+	uint32 StepCounter = 0;
+
+	// Stats, gathered while the frame's steps are added.
+	uint32 PressureIterationsDispatched = 0;
+	uint32 InjectionEventCount = 0;
+	uint32 ActiveBrickCount = 0;
+	uint32 ReadbackBytes = 0;
+	uint64 TextureMemoryBytes = 0;
+	uint32 LastStatsFrame = MAX_uint32;
+
+	// Sparse steps count their bricks on the GPU, read back a few frames late.
+	FRDGBufferRef FrameBrickCounter = nullptr;
+	TUniquePtr<FRHIGPUBufferReadback> ActiveBrickReadback;
+	bool bBrickReadbackPending = false;
+	uint32 SparseBrickCount = 0;
+
+	// Latest moving colliders, uploaded once per frame that steps and rasterized into every level's step.
+	TArray<FFluidSimColliderShaderData> Colliders;
+	FRDGBufferRef FrameColliders = nullptr;
+
+	// Injection stamps, owned by the texture pool and read by stamped events at every level.
+	FTextureRHIRef StampAtlas = nullptr;
+
+	// Active brick list every dense step binds, uploaded once.
+	TRefCountPtr<FRDGPooledBuffer> DenseActiveBricks;
+
+	// Diagnostics of the frame's last finest step, read back the same way.
+	FRDGBufferRef FrameDiagnostics = nullptr;
+	TUniquePtr<FRHIGPUBufferReadback> DiagnosticsReadback;
+	bool bDiagnosticsReadbackPending = false;
+	uint32 DiagnosticsStep = 0;
+
+	// Every feedback packet carries the latest of everything, a publish the game thread wasn't ready for is retried.
+	FFluidSimDiagnostics LatestDiagnostics;
+	uint32 PublishedGPUMeasurement = 0;
+	bool bFeedbackPending = false;
+
+	// Checkpoint readbacks in flight, level major, velocity, density then pressure.
+	struct FCheckpointCapture
+	{
+		FString Path;
+		FIntVector Resolution;
+		TArray<TUniquePtr<FRHIGPUTextureReadback>> Readbacks;
+	};
+	TArray<FCheckpointCapture> PendingCheckpoints;
+
+	// Bake readbacks in flight, oldest first. Each frame's encode and write waits on the one before.
+	struct FBakeCapture
+	{
+		uint32 Step = 0;
+		float Time = 0.0f;
+		FIntVector Resolution;
+		TUniquePtr<FRHIGPUTextureReadback> Velocity;
+		TUniquePtr<FRHIGPUTextureReadback> Density;
+	};
+	TArray<FBakeCapture> PendingBakeFrames;
+	TSharedPtr<FFluidSimSequenceWriter> BakeWriter;
+	FString BakePath;
+	FIntVector BakeResolution = FIntVector::ZeroValue;
+	uint32 BakeStartStep = 0;
+	double BakeStartTime = 0.0;
+	UE::Tasks::FTask BakeTask;
+	bool bBakeStopping = false;
+
+	// Render thread clock.
+	uint32 LastTickFrame = MAX_uint32;
+	double LastTickTime = 0.0;
+	double ClockAccumulator = 0.0;
+};
@@ -0,0 +1,185 @@
+#include "FluidSimReplay.h"
+
+#include "EngineUtils.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "FluidSimLog.h"
+#include "FluidSimulationManager.h"
+
+
+FFluidSimCoreSettings FluidSimReplay::ToCoreSettings(const FFluidSolverSettings& Settings)
+{
+	FFluidSimCoreSettings CoreSettings;
+	CoreSettings.DiffusionStrength = Settings.DiffusionStrength;
+	CoreSettings.DissipationDensity = Settings.DissipationDensity;
+	CoreSettings.DissipationVelocity = Settings.DissipationVelocity;
+	CoreSettings.PressureIterations = Settings.PressureIterations;
+	CoreSettings.bWarmStartPressure = Settings.bWarmStartPressure;
+	return CoreSettings;
+}
+
+void FluidSimReplay::ApplyCoreSettings(FFluidSolverSettings& Settings, const FFluidSimCoreSettings& CoreSettings)
+{
+	Settings.DiffusionStrength = CoreSettings.DiffusionStrength;
+	Settings.DissipationDensity = CoreSettings.DissipationDensity;
+	Settings.DissipationVelocity = CoreSettings.DissipationVelocity;
+	Settings.PressureIterations = CoreSettings.PressureIterations;
+	Settings.bWarmStartPressure = CoreSettings.bWarmStartPressure;
+}
+
+void FluidSimReplay::ToCoreEvents(const TArray<FFluidSimSourceShaderData>& Events, TArray<FFluidSimCoreEvent>& OutEvents)
+{
+	// Same layout, see the static_assert next to FFluidSimSourceShaderData.
+	OutEvents.SetNumUninitialized(Events.Num());
+	FMemory::Memcpy(OutEvents.GetData(), Events.GetData(), Events.Num() * sizeof(FFluidSimCoreEvent));
+}
+
+void FluidSimReplay::FromCoreEvents(const TArray<FFluidSimCoreEvent>& Events, TArray<FFluidSimSourceShaderData>& OutEvents)
+{
+	OutEvents.SetNumUninitialized(Events.Num());
+	FMemory::Memcpy(OutEvents.GetData(), Events.GetData(), Events.Num() * sizeof(FFluidSimCoreEvent));
+}
+
+bool FFluidSimReplay::Open(const FString& InPath, const float InFixedRate)
+{
+	if (!Reader.Open(*InPath))
+	{
+		UE_LOG(LogFluidSim, Warning, TEXT("Failed to open fluid sim stream '%s'."), *InPath);
+		return false;
+	}
+
+	ReportPath = FPaths::ChangeExtension(InPath, TEXT("csv"));
+	Report = TEXT("Tick,Frame,Steps,WallMs,GPUTimeMs,DiagnosticsStep,TotalDivergence,MaxDivergence,MaxVelocity,TotalDensity,KineticEnergy\n");
+	FixedRate = InFixedRate;
+	Accumulator = 0.0f;
+	FrameIndex = 0;
+	TickIndex = 0;
+	LastTickTime = FPlatformTime::Seconds();
+	return true;
+}
+
+bool FFluidSimReplay::Advance(const float DeltaTime, TArray<FFluidSimStreamFrame>& OutFrames)
+{
+	OutFrames.Reset();
+
+	// Catch up at most a few frames after a hitch, like the proxy's substep cap.
+	int32 FrameCount = 1;
+	if (FixedRate > 0.0f)
+	{
+		const float Interval = 1.0f / FixedRate;
+		Accumulator = FMath::Min(Accumulator + DeltaTime, Interval * 8.0f);
+		FrameCount = FMath::FloorToInt32(Accumulator / Interval);
+		Accumulator -= FrameCount * Interval;
+	}
+
+	for (int32 Frame = 0; Frame < FrameCount; Frame++)
+	{
+		if (!Reader.ReadFrame(OutFrames.AddDefaulted_GetRef()))
+		{
+			OutFrames.Pop();
+			return false;
+		}
+		FrameIndex++;
+	}
+	return true;
+}
+
+void FFluidSimReplay::AddReportRow(const int32 StepCount, const FFluidSimDiagnostics& Diagnostics)
+{
+	const double Now = FPlatformTime::Seconds();
+	const double WallMs = (Now - LastTickTime) * 1000.0;
+	LastTickTime = Now;
+
+	Report += FString::Printf(TEXT("%d,%d,%d,%.3f,%.3f,%d,%f,%f,%f,%f,%f\n"),
+		TickIndex++, FrameIndex, StepCount, WallMs, Diagnostics.GPUTimeMs, Diagnostics.Step,
+		Diagnostics.TotalDivergence, Diagnostics.MaxDivergence, Diagnostics.MaxVelocity, Diagnostics.TotalDensity, Diagnostics.KineticEnergy);
+}
+
+void FFluidSimReplay::Finish()
+{
+	if (ReportPath.IsEmpty())
+	{
+		return;
+	}
+
+	if (!FFileHelper::SaveStringToFile(Report, *ReportPath))
+	{
+		UE_LOG(LogFluidSim, Warning, TEXT("Failed to write fluid sim replay report '%s'."), *ReportPath);
+	}
+	ReportPath.Reset();
+	Report.Reset();
+}
+
+namespace
+{
+	template<typename FunctionType>
+	void ForEachManager(UWorld* World, FunctionType&& Function)
+	{
+		if (World == nullptr)
+		{
+			return;
+		}
+
+		for (TActorIterator<AFluidSimulationManager> It(World); It; ++It)
+		{
+			Function(**It);
+		}
+	}
+
+	// Several managers in a world record side by side, the file gets the actor name appended.
+	FString GetManagerPath(const FString& Path, const AFluidSimulationManager& Manager, const bool bUnique)
+	{
+		return bUnique ? Path : FPaths::GetPath(Path) / FPaths::GetBaseFilename(Path) + TEXT("_") + Manager.GetName() + TEXT(".") + FPaths::GetExtension(Path);
+	}
+
+	int32 CountManagers(UWorld* World)
+	{
+		int32 Count = 0;
+		ForEachManager(World, [&Count](AFluidSimulationManager&) { Count++; });
+		return Count;
+	}
+
+	FString GetStreamPath(const TArray<FString>& Args)
+	{
+		const FString Name = Args.Num() > 0 ? Args[0] : TEXT("FluidSim.fses");
+		return FPaths::IsRelative(Name) ? FPaths::ProjectSavedDir() / TEXT("FluidSim") / Name : Name;
+	}
+
+	FAutoConsoleCommandWithWorldAndArgs CmdFluidSimRecord(
+		TEXT("FluidSim.Record"),
+		TEXT("Records the settings and injection events of every fluid simulation step. FluidSim.Record <File>, relative to Saved/FluidSim."),
+		FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+		{
+			const FString Path = GetStreamPath(Args);
+			const bool bUnique = CountManagers(World) <= 1;
+			ForEachManager(World, [&Path, bUnique](AFluidSimulationManager& Manager)
+			{
+				Manager.StartRecording(GetManagerPath(Path, Manager, bUnique));
+			});
+		}));
+
+	FAutoConsoleCommandWithWorldAndArgs CmdFluidSimStopRecording(
+		TEXT("FluidSim.StopRecording"),
+		TEXT("Closes the streams started by FluidSim.Record."),
+		FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+		{
+			ForEachManager(World, [](AFluidSimulationManager& Manager) { Manager.StopRecording(); });
+		}));
+
+	FAutoConsoleCommandWithWorldAndArgs CmdFluidSimReplay(
+		TEXT("FluidSim.Replay"),
+		TEXT("Replays a recorded stream instead of the live sources and writes a CSV report next to it. ")
+		TEXT("FluidSim.Replay <File> [FramesPerSecond], one recorded frame per tick without a rate."),
+		FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+		{
+			const FString Path = GetStreamPath(Args);
+			const float FixedRate = Args.Num() > 1 ? FCString::Atof(*Args[1]) : 0.0f;
+			const bool bUnique = CountManagers(World) <= 1;
+			ForEachManager(World, [&Path, FixedRate, bUnique](AFluidSimulationManager& Manager)
+			{
+				Manager.StartReplay(GetManagerPath(Path, Manager, bUnique), FixedRate);
+			});
+		}));
+}
@@ -0,0 +1,48 @@
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FluidStructs.h"
+#include "FluidSimEventStream.h"
+
+// Recording and replay of a simulation's input, see FluidSimEventStream.h.
+// FluidSim.Record <File>, FluidSim.StopRecording and FluidSim.Replay <File> [FramesPerSecond] drive every manager in the world.
+namespace FluidSimReplay
+{
+	FFluidSimCoreSettings ToCoreSettings(const FFluidSolverSettings& Settings);
+
+	// Only the members the kernels read, everything else stays as authored.
+	void ApplyCoreSettings(FFluidSolverSettings& Settings, const FFluidSimCoreSettings& CoreSettings);
+
+	void ToCoreEvents(const TArray<FFluidSimSourceShaderData>& Events, TArray<FFluidSimCoreEvent>& OutEvents);
+	void FromCoreEvents(const TArray<FFluidSimCoreEvent>& Events, TArray<FFluidSimSourceShaderData>& OutEvents);
+}
+
+// Plays a recorded stream into a simulation and writes a CSV next to it, one row per tick with the wall and GPU
+// time and the diagnostics of that tick. Diagnostics stand in for a field hash on the GPU, the benchmark program's
+// -Replay checksums every step on the CPU reference.
+class FFluidSimReplay
+{
+public:
+	// A FixedRate of zero plays one recorded frame per tick, as fast as the game ticks.
+	bool Open(const FString& InPath, const float InFixedRate);
+
+	// Frames due this tick, false once the stream ran out.
+	bool Advance(const float DeltaTime, TArray<FFluidSimStreamFrame>& OutFrames);
+
+	void AddReportRow(const int32 StepCount, const FFluidSimDiagnostics& Diagnostics);
+	void Finish();
+
+	const FFluidSimStreamHeader& GetHeader() const { return Reader.GetHeader(); }
+
+private:
+	FFluidSimStreamReader Reader;
+	FString ReportPath;
+	FString Report;
+
+	float FixedRate = 0.0f;
+	float Accumulator = 0.0f;
+	int32 FrameIndex = 0;
+	int32 TickIndex = 0;
+	double LastTickTime = 0.0;
+};
@@ -0,0 +1,223 @@
+#include "FluidSimScalability.h"
+
+#include "HAL/IConsoleManager.h"
+#include "Misc/ConfigCacheIni.h"
+#include "UObject/UObjectIterator.h"
+#include "FluidSimulationManager.h"
+
+
+static TAutoConsoleVariable<int32> CVarFluidSimQuality(
+	TEXT("sg.FluidSimQuality"),
+	-1,
+	TEXT("Scalability group of the fluid simulations, sets the r.FluidSim.* variables below.\n")
+	TEXT(" -1: follow sg.EffectsQuality (default)\n")
+	TEXT("  0: low, 1: medium, 2: high, 3: epic, 4: cinematic\n")
+	TEXT("Tiers can be overridden per project in [FluidSimQuality@N] sections of the scalability ini."),
+	ECVF_ScalabilityGroup);
+
+static TAutoConsoleVariable<float> CVarFluidSimResolutionScale(
+	TEXT("r.FluidSim.ResolutionScale"),
+	1.0f,
+	TEXT("Multiplier on every simulation's resolution scale, the running fields are resampled."),
+	ECVF_Scalability);
+
+static TAutoConsoleVariable<int32> CVarFluidSimPressureIterations(
+	TEXT("r.FluidSim.PressureIterations"),
+	-1,
+	TEXT("Upper limit of pressure iterations per step, for both the fixed and the adaptive solve.\n")
+	TEXT(" -1: as authored (default)"),
+	ECVF_Scalability);
+
+static TAutoConsoleVariable<int32> CVarFluidSimPressureSolve(
+	TEXT("r.FluidSim.PressureSolve"),
+	-1,
+	TEXT(" -1: as authored (default)\n")
+	TEXT("  0: fixed iteration count\n")
+	TEXT("  1: adaptive, stops once converged"),
+	ECVF_Scalability);
+
+static TAutoConsoleVariable<float> CVarFluidSimSimulationRate(
+	TEXT("r.FluidSim.SimulationRate"),
+	-1.0f,
+	TEXT("Upper limit of steps per second on the render thread clock.\n")
+	TEXT(" <= 0: as authored (default)"),
+	ECVF_Scalability);
+
+static TAutoConsoleVariable<int32> CVarFluidSimOutputs(
+	TEXT("r.FluidSim.Outputs"),
+	7,
+	TEXT("Mask the authored output fields are restricted to, a field is only copied if it's authored and in the mask.\n")
+	TEXT(" 1: velocity, 2: density, 4: pressure. 7 keeps all authored fields (default)"),
+	ECVF_Scalability);
+
+static TAutoConsoleVariable<int32> CVarFluidSimSparse(
+	TEXT("r.FluidSim.Sparse"),
+	-1,
+	TEXT("Skip empty bricks of the domain.\n")
+	TEXT(" -1: as authored (default)\n")
+	TEXT("  0: off, simulate every voxel\n")
+	TEXT("  1: on"),
+	ECVF_Scalability);
+
+static TAutoConsoleVariable<float> CVarFluidSimGPUBudgetMs(
+	TEXT("r.FluidSim.GPUBudgetMs"),
+	0.0f,
+	TEXT("GPU milliseconds per frame each simulation may use unless it sets its own budget, usually set per platform.\n")
+	TEXT(" 0: no budget (default)"),
+	ECVF_Scalability);
+
+
+namespace
+{
+	// Built in defaults of sg.FluidSimQuality, anything set in the scalability ini is applied on top.
+	struct FFluidSimQualityTier
+	{
+		float ResolutionScale;
+		int32 PressureIterations;
+		float SimulationRate;
+		int32 Sparse;
+	};
+
+	const FFluidSimQualityTier QualityTiers[] =
+	{
+		{ 0.5f,		8,	30.0f,	1 },	// Low
+		{ 0.75f,	12,	30.0f,	1 },	// Medium
+		{ 1.0f,		16,	60.0f,	1 },	// High
+		{ 1.0f,		-1,	-1.0f,	-1 },	// Epic
+		{ 1.0f,		-1,	-1.0f,	-1 },	// Cinematic
+	};
+
+	void ApplyQualityTier(const int32 Quality)
+	{
+		const int32 Tier = FMath::Clamp(Quality, 0, static_cast<int32>(UE_ARRAY_COUNT(QualityTiers)) - 1);
+		const FFluidSimQualityTier& Values = QualityTiers[Tier];
+
+		// Set by scalability, so anything set from the console or a device profile still wins.
+		CVarFluidSimResolutionScale->Set(Values.ResolutionScale, ECVF_SetByScalability);
+		CVarFluidSimPressureIterations->Set(Values.PressureIterations, ECVF_SetByScalability);
+		CVarFluidSimSimulationRate->Set(Values.SimulationRate, ECVF_SetByScalability);
+		CVarFluidSimSparse->Set(Values.Sparse, ECVF_SetByScalability);
+
+		ApplyCVarSettingsGroupFromIni(TEXT("FluidSimQuality"), Tier, *GScalabilityIni, ECVF_SetByScalability);
+	}
+
+	// Everything a running simulation depends on, to only touch them when something actually changed.
+	struct FFluidSimCVarState
+	{
+		float ResolutionScale = 1.0f;
+		int32 PressureIterations = -1;
+		int32 PressureSolve = -1;
+		float SimulationRate = -1.0f;
+		int32 Outputs = 7;
+		int32 Sparse = -1;
+		float GPUBudgetMs = 0.0f;
+
+		static FFluidSimCVarState Get()
+		{
+			FFluidSimCVarState State;
+			State.ResolutionScale = CVarFluidSimResolutionScale.GetValueOnGameThread();
+			State.PressureIterations = CVarFluidSimPressureIterations.GetValueOnGameThread();
+			State.PressureSolve = CVarFluidSimPressureSolve.GetValueOnGameThread();
+			State.SimulationRate = CVarFluidSimSimulationRate.GetValueOnGameThread();
+			State.Outputs = CVarFluidSimOutputs.GetValueOnGameThread();
+			State.Sparse = CVarFluidSimSparse.GetValueOnGameThread();
+			State.GPUBudgetMs = CVarFluidSimGPUBudgetMs.GetValueOnGameThread();
+			return State;
+		}
+
+		bool operator==(const FFluidSimCVarState& Other) const
+		{
+			return ResolutionScale == Other.ResolutionScale &&
+				PressureIterations == Other.PressureIterations &&
+				PressureSolve == Other.PressureSolve &&
+				SimulationRate == Other.SimulationRate &&
+				Outputs == Other.Outputs &&
+				Sparse == Other.Sparse &&
+				GPUBudgetMs == Other.GPUBudgetMs;
+		}
+	};
+
+	int32 AppliedQuality = INDEX_NONE;
+	FFluidSimCVarState AppliedState;
+
+	// Runs on the game thread once per frame after any console variable changed.
+	void OnConsoleVariablesChanged()
+	{
+		int32 Quality = CVarFluidSimQuality.GetValueOnGameThread();
+		if (Quality < 0)
+		{
+			static const IConsoleVariable* CVarEffectsQuality = IConsoleManager::Get().FindConsoleVariable(TEXT("sg.EffectsQuality"));
+			Quality = CVarEffectsQuality ? CVarEffectsQuality->GetInt() : 3;
+		}
+
+		if (Quality != AppliedQuality)
+		{
+			AppliedQuality = Quality;
+			ApplyQualityTier(Quality);
+		}
+
+		const FFluidSimCVarState State = FFluidSimCVarState::Get();
+		if (State == AppliedState)
+		{
+			return;
+		}
+		AppliedState = State;
+
+		for (TObjectIterator<AFluidSimulationManager> It; It; ++It)
+		{
+			if (IsValid(*It) && !It->IsTemplate() && It->HasActorBegunPlay())
+			{
+				It->ApplyScalability();
+			}
+		}
+	}
+
+	FAutoConsoleVariableSink CVarFluidSimSink(FConsoleCommandDelegate::CreateStatic(&OnConsoleVariablesChanged));
+}
+
+
+FFluidSolverSettings FluidSimScalability::ApplyToSettings(const FFluidSolverSettings& InSettings)
+{
+	FFluidSolverSettings Settings = InSettings;
+
+	const int32 PressureSolve = CVarFluidSimPressureSolve.GetValueOnGameThread();
+	if (PressureSolve >= 0)
+	{
+		Settings.PressureSolve = PressureSolve > 0 ? EFluidPressureSolve::Adaptive : EFluidPressureSolve::Fixed;
+	}
+
+	const int32 PressureIterations = CVarFluidSimPressureIterations.GetValueOnGameThread();
+	if (PressureIterations >= 0)
+	{
+		const int32 Limit = FMath::Max(PressureIterations, 1);
+		Settings.PressureIterations = FMath::Min(Settings.PressureIterations, Limit);
+		Settings.MaxPressureIterations = FMath::Min(Settings.MaxPressureIterations, Limit);
+		Settings.MinPressureIterations = FMath::Min(Settings.MinPressureIterations, Settings.MaxPressureIterations);
+	}
+
+	const float SimulationRate = CVarFluidSimSimulationRate.GetValueOnGameThread();
+	if (SimulationRate > 0.0f)
+	{
+		Settings.SimulationRate = FMath::Min(Settings.SimulationRate, FMath::Max(SimulationRate, 1.0f));
+	}
+
+	Settings.OutputFields &= CVarFluidSimOutputs.GetValueOnGameThread();
+
+	const int32 Sparse = CVarFluidSimSparse.GetValueOnGameThread();
+	if (Sparse >= 0)
+	{
+		Settings.bSparse = Sparse > 0;
+	}
+
+	if (Settings.GPUBudgetMs <= 0.0f)
+	{
+		Settings.GPUBudgetMs = FMath::Max(CVarFluidSimGPUBudgetMs.GetValueOnGameThread(), 0.0f);
+	}
+
+	return Settings;
+}
+
+float FluidSimScalability::GetResolutionScale()
+{
+	return FMath::Max(CVarFluidSimResolutionScale.GetValueOnGameThread(), 0.0f);
+}
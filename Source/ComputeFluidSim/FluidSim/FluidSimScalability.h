@@ -0,0 +1,16 @@
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FluidStructs.h"
+
+// r.FluidSim.* console variables and the sg.FluidSimQuality scalability group that sets them.
+// Changes are picked up by every running simulation without restarting it.
+namespace FluidSimScalability
+{
+	// The authored settings with the console variable overrides applied, game thread only.
+	FFluidSolverSettings ApplyToSettings(const FFluidSolverSettings& InSettings);
+
+	// Multiplier on every AFluidSimulationManager's ResolutionScale.
+	float GetResolutionScale();
+}
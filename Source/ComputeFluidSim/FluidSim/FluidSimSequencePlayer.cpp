@@ -0,0 +1,282 @@
+#include "FluidSimSequencePlayer.h"
+
+#include "RenderGraph.h"
+#include "RenderGraphUtils.h"
+#include "GlobalShader.h"
+#include "RHI.h"
+#include "TextureResource.h"
+#include "Engine/TextureRenderTargetVolume.h"
+#include "Tasks/Task.h"
+#include "FluidSimSequence.h"
+#include "FluidSimLog.h"
+#include "FluidShaderImplementation.h"
+
+// Frames decoded ahead of the playback time, a decode has that long to land before playback holds the last frame.
+static constexpr int32 PrefetchFrames = 4;
+
+
+FFluidSimSequencePlayer::FFluidSimSequencePlayer()
+	: Cache(MakeShared<FFrameCache, ESPMode::ThreadSafe>())
+	, RenderState(MakeShared<FRenderState, ESPMode::ThreadSafe>())
+{}
+
+// Decode tasks and render commands hold on to what they use, nothing here has to wait for them.
+FFluidSimSequencePlayer::~FFluidSimSequencePlayer() = default;
+
+bool FFluidSimSequencePlayer::Open(const FString& Path, UTextureRenderTargetVolume* Velocity, UTextureRenderTargetVolume* Density)
+{
+	if (!IsValid(Velocity) || !IsValid(Density))
+	{
+		UE_LOG(LogFluidSim, Warning, TEXT("Playing '%s' needs velocity and density output volumes."), *Path);
+		return false;
+	}
+
+	TSharedPtr<FFluidSimSequenceReader, ESPMode::ThreadSafe> NewReader = MakeShared<FFluidSimSequenceReader, ESPMode::ThreadSafe>();
+	if (!NewReader->Open(*Path) || NewReader->GetFrameCount() == 0)
+	{
+		UE_LOG(LogFluidSim, Warning, TEXT("Failed to open baked sequence '%s'."), *Path);
+		return false;
+	}
+
+	// Baked from the outputs, so played back without resampling.
+	const FIntVector Resolution = NewReader->GetResolution();
+	if (FIntVector(Velocity->SizeX, Velocity->SizeY, Velocity->SizeZ) != Resolution ||
+		FIntVector(Density->SizeX, Density->SizeY, Density->SizeZ) != Resolution)
+	{
+		UE_LOG(LogFluidSim, Warning, TEXT("'%s' was baked at %s, the output volumes are a different size."), *Path, *Resolution.ToString());
+		return false;
+	}
+
+	Reader = NewReader;
+	{
+		FScopeLock Lock(&Cache->Lock);
+		Cache->Frames.Reset();
+	}
+
+	ENQUEUE_RENDER_COMMAND(FluidSimSequenceOpen)(
+		[State=RenderState, OutVelocity=Velocity->GameThread_GetRenderTargetResource(), OutDensity=Density->GameThread_GetRenderTargetResource(), Resolution](FRHICommandListImmediate& RHICmdList)
+		{
+			if (State->Resolution != Resolution)
+			{
+				State->Velocity[0] = State->Velocity[1] = nullptr;
+				State->Density[0] = State->Density[1] = nullptr;
+			}
+			State->OutVelocity = OutVelocity;
+			State->OutDensity = OutDensity;
+			State->Resolution = Resolution;
+			State->SlotFrame[0] = State->SlotFrame[1] = INDEX_NONE;
+		});
+
+	Time = 0.0f;
+	LastFrameA = LastFrameB = INDEX_NONE;
+	LastAlpha = -1.0f;
+	RequestFrames(0);
+
+	UE_LOG(LogFluidSim, Log, TEXT("Playing baked sequence '%s', %d frames over %.2f s."), *Path, Reader->GetFrameCount(), GetDuration());
+	return true;
+}
+
+float FFluidSimSequencePlayer::GetDuration() const
+{
+	return Reader.IsValid() ? Reader->GetDuration() : 0.0f;
+}
+
+void FFluidSimSequencePlayer::Seek(const float InTime)
+{
+	Time = FMath::Clamp(InTime, 0.0f, GetDuration());
+}
+
+void FFluidSimSequencePlayer::Tick(const float DeltaTime)
+{
+	if (!Reader.IsValid())
+	{
+		return;
+	}
+
+	const float Duration = GetDuration();
+	Time += DeltaTime * PlaybackRate;
+	if (bLoop && Duration > 0.0f)
+	{
+		Time = FMath::Fmod(Time, Duration);
+		Time = Time < 0.0f ? Time + Duration : Time;
+	}
+	else
+	{
+		Time = FMath::Clamp(Time, 0.0f, Duration);
+	}
+
+	const int32 FrameA = FindFrame(Time);
+	const int32 FrameB = FMath::Min(FrameA + 1, Reader->GetFrameCount() - 1);
+	const float TimeA = Reader->GetFrame(FrameA).Time;
+	const float TimeB = Reader->GetFrame(FrameB).Time;
+	const float Alpha = TimeB > TimeA ? FMath::Clamp((Time - TimeA) / (TimeB - TimeA), 0.0f, 1.0f) : 0.0f;
+
+	RequestFrames(FrameA);
+	if (FrameA == LastFrameA && FrameB == LastFrameB && Alpha == LastAlpha)
+	{
+		return;
+	}
+
+	FFramePtr DataA, DataB;
+	{
+		FScopeLock Lock(&Cache->Lock);
+		DataA = Cache->Frames.FindRef(FrameA);
+		DataB = Cache->Frames.FindRef(FrameB);
+	}
+
+	// Holds the last blend until both are decoded rather than stalling the game thread on them.
+	if (!DataA.IsValid() || !DataB.IsValid())
+	{
+		return;
+	}
+
+	LastFrameA = FrameA;
+	LastFrameB = FrameB;
+	LastAlpha = Alpha;
+
+	ENQUEUE_RENDER_COMMAND(FluidSimSequenceBlend)(
+		[State=RenderState, FrameA, DataA, FrameB, DataB, Alpha](FRHICommandListImmediate& RHICmdList)
+		{
+			State->Blend(RHICmdList, FrameA, DataA, FrameB, DataB, Alpha);
+		});
+}
+
+int32 FFluidSimSequencePlayer::FindFrame(const float InTime) const
+{
+	int32 Low = 0;
+	int32 High = Reader->GetFrameCount() - 1;
+	while (Low < High)
+	{
+		const int32 Mid = (Low + High + 1) / 2;
+		if (Reader->GetFrame(Mid).Time <= InTime)
+		{
+			Low = Mid;
+		}
+		else
+		{
+			High = Mid - 1;
+		}
+	}
+	return Low;
+}
+
+void FFluidSimSequencePlayer::RequestFrames(const int32 First)
+{
+	const int32 FrameCount = Reader->GetFrameCount();
+	TArray<int32, TInlineAllocator<PrefetchFrames + 1>> Window;
+	for (int32 Offset = 0; Offset <= PrefetchFrames && Offset < FrameCount; Offset++)
+	{
+		const int32 Index = First + Offset;
+		if (Index < FrameCount || bLoop)
+		{
+			Window.Add(Index % FrameCount);
+		}
+	}
+
+	FScopeLock Lock(&Cache->Lock);
+
+	// Only the window stays decoded, a baked 128^3 frame is 32 MB once decoded.
+	for (auto It = Cache->Frames.CreateIterator(); It; ++It)
+	{
+		if (!Window.Contains(It.Key()))
+		{
+			It.RemoveCurrent();
+		}
+	}
+
+	for (const int32 Index : Window)
+	{
+		if (Cache->Frames.Contains(Index) || Cache->InFlight.Contains(Index))
+		{
+			continue;
+		}
+
+		Cache->InFlight.Add(Index);
+		UE::Tasks::Launch(UE_SOURCE_LOCATION, [SequenceReader=Reader, FrameCache=Cache, Index]()
+		{
+			TSharedPtr<FFluidSimCheckpointLevel, ESPMode::ThreadSafe> Frame = MakeShared<FFluidSimCheckpointLevel, ESPMode::ThreadSafe>();
+			const bool bDecoded = SequenceReader->DecodeFrame(Index, *Frame);
+
+			FScopeLock TaskLock(&FrameCache->Lock);
+			FrameCache->InFlight.Remove(Index);
+			if (bDecoded)
+			{
+				FrameCache->Frames.Add(Index, Frame);
+			}
+			else
+			{
+				UE_LOG(LogFluidSim, Warning, TEXT("Failed to decode baked frame %d."), Index);
+			}
+		});
+	}
+}
+
+int32 FFluidSimSequencePlayer::FRenderState::Upload(FRHICommandListImmediate& RHICmdList, const int32 Frame, const FFramePtr& Data, const int32 KeepSlot)
+{
+	// Stepping forward one frame reuses the newer of the two slots, only the new frame is uploaded.
+	for (int32 Slot = 0; Slot < 2; Slot++)
+	{
+		if (SlotFrame[Slot] == Frame)
+		{
+			return Slot;
+		}
+	}
+
+	const int32 Slot = KeepSlot == 0 ? 1 : 0;
+	if (!Velocity[Slot].IsValid())
+	{
+		for (FTextureRHIRef* Texture : { &Velocity[Slot], &Density[Slot] })
+		{
+			const FRHITextureCreateDesc CDesc = FRHITextureCreateDesc::Create3D(TEXT("FluidSim_SequenceFrame"), Resolution.X, Resolution.Y, Resolution.Z, EPixelFormat::PF_FloatRGBA)
+				.SetFlags(ETextureCreateFlags::ShaderResource)
+				.SetInitialState(ERHIAccess::SRVCompute);
+			*Texture = RHICreateTexture(CDesc);
+		}
+	}
+
+	const FUpdateTextureRegion3D Region(0, 0, 0, 0, 0, 0, Resolution.X, Resolution.Y, Resolution.Z);
+	const uint32 RowPitch = Resolution.X * sizeof(FFloat16Color);
+	const uint32 DepthPitch = RowPitch * Resolution.Y;
+	RHICmdList.UpdateTexture3D(Velocity[Slot], 0, Region, RowPitch, DepthPitch, reinterpret_cast<const uint8*>(Data->Velocity.GetData()));
+	RHICmdList.UpdateTexture3D(Density[Slot], 0, Region, RowPitch, DepthPitch, reinterpret_cast<const uint8*>(Data->Density.GetData()));
+
+	SlotFrame[Slot] = Frame;
+	return Slot;
+}
+
+void FFluidSimSequencePlayer::FRenderState::Blend(FRHICommandListImmediate& RHICmdList, const int32 FrameA, const FFramePtr& DataA, const int32 FrameB, const FFramePtr& DataB, const float Alpha)
+{
+	TShaderMapRef<FObjectGPUSequenceBlendShader> ComputeShader(GetGlobalShaderMap(GMaxRHIFeatureLevel));
+	if (OutVelocity == nullptr || OutDensity == nullptr || !ComputeShader.IsValid())
+	{
+		return;
+	}
+
+	const int32 SlotA = Upload(RHICmdList, FrameA, DataA, INDEX_NONE);
+	const int32 SlotB = FrameB == FrameA ? SlotA : Upload(RHICmdList, FrameB, DataB, SlotA);
+
+	FRDGBuilder GraphBuilder(RHICmdList, FRDGEventName(TEXT("FFluidSimSequencePlayer::Blend")));
+
+	FObjectGPUSequenceBlendShader::FParameters* PassParameters = GraphBuilder.AllocParameters<FObjectGPUSequenceBlendShader::FParameters>();
+	PassParameters->Domain.DomainResolution = Resolution;
+	PassParameters->Domain.DomainOffset = FIntVector::ZeroValue;
+	PassParameters->RT_Sequence_VelocityA = GraphBuilder.CreateSRV(RegisterExternalTexture(GraphBuilder, Velocity[SlotA], TEXT("FluidSim_SequenceVelocityA")));
+	PassParameters->RT_Sequence_VelocityB = GraphBuilder.CreateSRV(RegisterExternalTexture(GraphBuilder, Velocity[SlotB], TEXT("FluidSim_SequenceVelocityB")));
+	PassParameters->RT_Sequence_DensityA = GraphBuilder.CreateSRV(RegisterExternalTexture(GraphBuilder, Density[SlotA], TEXT("FluidSim_SequenceDensityA")));
+	PassParameters->RT_Sequence_DensityB = GraphBuilder.CreateSRV(RegisterExternalTexture(GraphBuilder, Density[SlotB], TEXT("FluidSim_SequenceDensityB")));
+	PassParameters->RT_Sequence_OutVelocity = GraphBuilder.CreateUAV(RegisterExternalTexture(GraphBuilder, OutVelocity->GetRenderTargetTexture(), TEXT("ObjectGPUFluidSimulation_OutRTVel")));
+	PassParameters->RT_Sequence_OutDensity = GraphBuilder.CreateUAV(RegisterExternalTexture(GraphBuilder, OutDensity->GetRenderTargetTexture(), TEXT("ObjectGPUFluidSimulation_OutRTDensity")));
+	PassParameters->FrameAlpha = Alpha;
+
+	GraphBuilder.AddPass(
+		RDG_EVENT_NAME("ExecuteGPUObjectFluidSimSequenceBlend"),
+		PassParameters,
+		ERDGPassFlags::Compute,
+		[Params=PassParameters, CS=ComputeShader, Group=FIntVector::DivideAndRoundUp(Resolution, FluidSimThreads)](FRHIComputeCommandList& CmdList)
+		{
+			FComputeShaderUtils::Dispatch(CmdList, CS, *Params, Group);
+		}
+	);
+
+	GraphBuilder.Execute();
+}
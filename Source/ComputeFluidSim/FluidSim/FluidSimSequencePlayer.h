@@ -0,0 +1,72 @@
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "RHIResources.h"
+
+class FFluidSimSequenceReader;
+class FTextureRenderTargetResource;
+class UTextureRenderTargetVolume;
+struct FFluidSimCheckpointLevel;
+
+// Plays a baked sequence back into a simulation's level 0 velocity and density outputs, none of the solver's stages run.
+// Frames decode a few ahead on background tasks straight out of the memory mapped file, the render thread uploads the
+// two either side of the playback time and blends between them.
+class FFluidSimSequencePlayer
+{
+public:
+	FFluidSimSequencePlayer();
+	~FFluidSimSequencePlayer();
+
+	// The outputs have to be the size the sequence was baked at.
+	bool Open(const FString& Path, UTextureRenderTargetVolume* Velocity, UTextureRenderTargetVolume* Density);
+
+	// Game thread, advances the playback time and hands the frames either side of it to the render thread.
+	void Tick(const float DeltaTime);
+
+	void Seek(const float InTime);
+	float GetTime() const { return Time; }
+	float GetDuration() const;
+
+	bool bLoop = true;
+	float PlaybackRate = 1.0f;
+
+private:
+	typedef TSharedPtr<const FFluidSimCheckpointLevel, ESPMode::ThreadSafe> FFramePtr;
+
+	// Decoded frames, filled by the decode tasks and trimmed to the prefetch window by the game thread.
+	struct FFrameCache
+	{
+		FCriticalSection Lock;
+		TMap<int32, FFramePtr> Frames;
+		TSet<int32> InFlight;
+	};
+
+	// Render thread, the two uploaded frames and which frame each slot holds.
+	struct FRenderState
+	{
+		FTextureRenderTargetResource* OutVelocity = nullptr;
+		FTextureRenderTargetResource* OutDensity = nullptr;
+		FIntVector Resolution = FIntVector::ZeroValue;
+
+		FTextureRHIRef Velocity[2];
+		FTextureRHIRef Density[2];
+		int32 SlotFrame[2] = { INDEX_NONE, INDEX_NONE };
+
+		void Blend(FRHICommandListImmediate& RHICmdList, const int32 FrameA, const FFramePtr& DataA, const int32 FrameB, const FFramePtr& DataB, const float Alpha);
+		int32 Upload(FRHICommandListImmediate& RHICmdList, const int32 Frame, const FFramePtr& Data, const int32 KeepSlot);
+	};
+
+	// Index of the last frame at or before Time.
+	int32 FindFrame(const float InTime) const;
+	void RequestFrames(const int32 First);
+
+	TSharedPtr<FFluidSimSequenceReader, ESPMode::ThreadSafe> Reader;
+	TSharedRef<FFrameCache, ESPMode::ThreadSafe> Cache;
+	TSharedRef<FRenderState, ESPMode::ThreadSafe> RenderState;
+
+	float Time = 0.0f;
+	int32 LastFrameA = INDEX_NONE;
+	int32 LastFrameB = INDEX_NONE;
+	float LastAlpha = -1.0f;
+};
@@ -0,0 +1,56 @@
+#include "FluidSimShaderCache.h"
+
+#include "PipelineStateCache.h"
+#include "RHIStaticStates.h"
+#include "FluidSimLog.h"
+
+template<typename FunctionType>
+void FFluidSimShaderCache::ForEachTable(FunctionType&& Function)
+{
+	Function(Advection);
+	Function(Dissipation);
+	Function(Diffusion);
+	Function(Divergence);
+	Function(ProjectPressure);
+	Function(PressureResidual);
+	Function(PressureConvergence);
+	Function(ScrollClear);
+	Function(ProjectGradient);
+	Function(Injection);
+	Function(Resample);
+	Function(CascadeBoundary);
+	Function(CascadeRestrict);
+	Function(BrickOccupancy);
+	Function(BrickDilate);
+	Function(DiagnosticsReduce);
+	Function(DiagnosticsResolve);
+	Function(ObstacleScatter);
+	Function(ColliderRaster);
+}
+
+void FFluidSimShaderCache::Update(FRHICommandListImmediate& RHICmdList, const ERHIFeatureLevel::Type FeatureLevel)
+{
+	const FGlobalShaderMap* CurrentShaderMap = GetGlobalShaderMap(FeatureLevel);
+	if (CurrentShaderMap == nullptr || CurrentShaderMap == ShaderMap)
+	{
+		return;
+	}
+	ShaderMap = CurrentShaderMap;
+
+	ForEachTable([this](auto& Table) { Table.Resolve(ShaderMap); });
+	SamplerTrilinear = TStaticSamplerState<SF_Trilinear, AM_Clamp, AM_Clamp, AM_Clamp>::GetRHI();
+
+	// Every permutation the tables hold, which of them a step picks depends on settings and scene content that can
+	// change at any time. Created here rather than on first use.
+	int32 PipelineCount = 0;
+	ForEachTable([&RHICmdList, &PipelineCount](auto& Table)
+	{
+		Table.ForEach([&RHICmdList, &PipelineCount](FRHIComputeShader* ComputeShader)
+		{
+			PipelineStateCache::GetAndOrCreateComputePipelineState(RHICmdList, ComputeShader, false);
+			PipelineCount++;
+		});
+	});
+
+	UE_LOG(LogFluidSim, Log, TEXT("Precached %d compute pipelines."), PipelineCount);
+}
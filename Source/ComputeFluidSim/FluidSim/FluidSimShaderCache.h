@@ -0,0 +1,93 @@
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GlobalShader.h"
+#include "FluidShaderImplementation.h"
+
+class FRHICommandListImmediate;
+
+// Every compiled permutation of one shader, looked up by permutation id.
+template<typename ShaderType>
+class TFluidSimShaderTable
+{
+public:
+	using FPermutationDomain = typename ShaderType::FPermutationDomain;
+
+	void Resolve(const FGlobalShaderMap* ShaderMap)
+	{
+		Shaders.Reset();
+		Shaders.SetNum(FPermutationDomain::PermutationCount);
+		for (int32 PermutationId = 0; PermutationId < FPermutationDomain::PermutationCount; PermutationId++)
+		{
+			// Permutations ShouldCompilePermutation() turned down stay invalid.
+			if (ShaderMap->HasShader(&ShaderType::GetStaticType(), PermutationId))
+			{
+				Shaders[PermutationId] = ShaderMap->GetShader<ShaderType>(PermutationId);
+			}
+		}
+	}
+
+	// Invalid before Resolve() or for a permutation that wasn't compiled, the stages warn and skip the pass.
+	const TShaderRef<ShaderType>& Get(const FPermutationDomain& PermutationVector = FPermutationDomain()) const
+	{
+		static const TShaderRef<ShaderType> Invalid;
+		const int32 PermutationId = PermutationVector.ToDimensionValueId();
+		return Shaders.IsValidIndex(PermutationId) ? Shaders[PermutationId] : Invalid;
+	}
+
+	template<typename FunctionType>
+	void ForEach(FunctionType&& Function) const
+	{
+		for (const TShaderRef<ShaderType>& Shader : Shaders)
+		{
+			if (Shader.IsValid())
+			{
+				Function(Shader.GetComputeShader());
+			}
+		}
+	}
+
+private:
+	TArray<TShaderRef<ShaderType>> Shaders;
+};
+
+// Render thread cache of everything the proxies dispatch, so passes don't go through the global shader map or create
+// sampler states. One for the engine, see UFluidSimTexturePoolSubsystem. Resolved and the compute pipelines created by
+// the first simulation set up, and again only when the global shader map changes. The first step then costs the same as
+// any other.
+class FFluidSimShaderCache
+{
+public:
+	// Resolves and precaches when the global shader map isn't the one resolved from, a no-op otherwise.
+	void Update(FRHICommandListImmediate& RHICmdList, const ERHIFeatureLevel::Type FeatureLevel);
+
+	TFluidSimShaderTable<FObjectGPUAdvectionShader> Advection;
+	TFluidSimShaderTable<FObjectGPUDissipationShader> Dissipation;
+	TFluidSimShaderTable<FObjectGPUDiffusionShader> Diffusion;
+	TFluidSimShaderTable<FObjectGPUDivergenceShader> Divergence;
+	TFluidSimShaderTable<FObjectGPUProjectPressureShader> ProjectPressure;
+	TFluidSimShaderTable<FObjectGPUPressureResidualShader> PressureResidual;
+	TFluidSimShaderTable<FObjectGPUPressureConvergenceShader> PressureConvergence;
+	TFluidSimShaderTable<FObjectGPUScrollClearShader> ScrollClear;
+	TFluidSimShaderTable<FObjectGPUProjectGradientShader> ProjectGradient;
+	TFluidSimShaderTable<FObjectGPUInjectionShader> Injection;
+	TFluidSimShaderTable<FObjectGPUResampleShader> Resample;
+	TFluidSimShaderTable<FObjectGPUCascadeBoundaryShader> CascadeBoundary;
+	TFluidSimShaderTable<FObjectGPUCascadeRestrictShader> CascadeRestrict;
+	TFluidSimShaderTable<FObjectGPUBrickOccupancyShader> BrickOccupancy;
+	TFluidSimShaderTable<FObjectGPUBrickDilateShader> BrickDilate;
+	TFluidSimShaderTable<FObjectGPUDiagnosticsReduceShader> DiagnosticsReduce;
+	TFluidSimShaderTable<FObjectGPUDiagnosticsResolveShader> DiagnosticsResolve;
+	TFluidSimShaderTable<FObjectGPUObstacleScatterShader> ObstacleScatter;
+	TFluidSimShaderTable<FObjectGPUColliderRasterShader> ColliderRaster;
+
+	// Trilinear, clamped on every axis. Advection and the injection stamps.
+	FRHISamplerState* SamplerTrilinear = nullptr;
+
+private:
+	template<typename FunctionType>
+	void ForEachTable(FunctionType&& Function);
+
+	const FGlobalShaderMap* ShaderMap = nullptr;
+};
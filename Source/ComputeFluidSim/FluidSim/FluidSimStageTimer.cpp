@@ -0,0 +1,145 @@
+#include "FluidSimStageTimer.h"
+
+#include "HAL/IConsoleManager.h"
+#include "RenderGraphBuilder.h"
+#include "RHI.h"
+#include "RHICommandList.h"
+#include "ShaderParameterMacros.h"
+
+
+static TAutoConsoleVariable<int32> CVarFluidSimStageTimings(
+	TEXT("r.FluidSim.StageTimings"),
+	0,
+	TEXT("Time every stage of every simulation step on the GPU, read by the perf tests.\n")
+	TEXT("Serializes the async compute stages, the frame gets slower while it's on."),
+	ECVF_RenderThreadSafe);
+
+namespace
+{
+	// Stages of steps still in flight, steps beyond it aren't timed.
+	constexpr int32 MaxPendingQueries = 1024;
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FFluidSimStageTimestampParameters, )
+		RDG_TEXTURE_ACCESS(Field0, ERHIAccess::SRVCompute)
+		RDG_TEXTURE_ACCESS(Field1, ERHIAccess::SRVCompute)
+		RDG_TEXTURE_ACCESS(Field2, ERHIAccess::SRVCompute)
+		RDG_TEXTURE_ACCESS(Field3, ERHIAccess::SRVCompute)
+	END_SHADER_PARAMETER_STRUCT()
+}
+
+const TCHAR* LexToString(const EFluidSimGPUStage Stage)
+{
+	switch (Stage)
+	{
+	case EFluidSimGPUStage::Dissipate:	return TEXT("Dissipate");
+	case EFluidSimGPUStage::Inject:		return TEXT("Inject");
+	case EFluidSimGPUStage::Sparse:		return TEXT("Sparse");
+	case EFluidSimGPUStage::Diffuse:	return TEXT("Diffuse");
+	case EFluidSimGPUStage::Divergence:	return TEXT("Divergence");
+	case EFluidSimGPUStage::Pressure:	return TEXT("Pressure");
+	case EFluidSimGPUStage::Project:	return TEXT("Project");
+	case EFluidSimGPUStage::Advect:		return TEXT("Advect");
+	default:							return TEXT("Unknown");
+	}
+}
+
+
+void FFluidSimStageTimer::BeginStep(FRDGBuilder& GraphBuilder, TConstArrayView<FRDGTextureRef> Fields)
+{
+	constexpr int32 QueriesPerStep = static_cast<int32>(EFluidSimGPUStage::Num) + 1;
+	bTimingStep = CVarFluidSimStageTimings.GetValueOnRenderThread() != 0 && GSupportsTimestampRenderQueries &&
+		PendingQueries + QueriesPerStep <= MaxPendingQueries;
+	if (!bTimingStep)
+	{
+		return;
+	}
+
+	if (!QueryPool.IsValid())
+	{
+		QueryPool = RHICreateRenderQueryPool(RQT_AbsoluteTime);
+	}
+
+	PendingSteps.AddDefaulted();
+	AddTimestamp(GraphBuilder, Fields, EFluidSimGPUStage::Num);
+}
+
+void FFluidSimStageTimer::EndStage(FRDGBuilder& GraphBuilder, TConstArrayView<FRDGTextureRef> Fields, const EFluidSimGPUStage Stage)
+{
+	if (bTimingStep)
+	{
+		AddTimestamp(GraphBuilder, Fields, Stage);
+	}
+}
+
+void FFluidSimStageTimer::AddTimestamp(FRDGBuilder& GraphBuilder, TConstArrayView<FRDGTextureRef> Fields, const EFluidSimGPUStage Stage)
+{
+	check(Fields.Num() <= 4);
+
+	FTimestamp& Timestamp = PendingSteps.Last().Timestamps.AddDefaulted_GetRef();
+	Timestamp.Query = QueryPool->AllocateQuery();
+	Timestamp.Stage = Stage;
+	PendingQueries++;
+
+	FFluidSimStageTimestampParameters* PassParameters = GraphBuilder.AllocParameters<FFluidSimStageTimestampParameters>();
+	PassParameters->Field0 = Fields.IsValidIndex(0) ? Fields[0] : nullptr;
+	PassParameters->Field1 = Fields.IsValidIndex(1) ? Fields[1] : nullptr;
+	PassParameters->Field2 = Fields.IsValidIndex(2) ? Fields[2] : nullptr;
+	PassParameters->Field3 = Fields.IsValidIndex(3) ? Fields[3] : nullptr;
+
+	FRHIRenderQuery* Query = Timestamp.Query.GetQuery();
+	GraphBuilder.AddPass(
+		RDG_EVENT_NAME("FluidSimStageTimestamp"),
+		PassParameters,
+		ERDGPassFlags::Compute | ERDGPassFlags::NeverCull,
+		[Query](FRHICommandList& RHICmdList)
+		{
+			RHICmdList.EndRenderQuery(Query);
+		}
+	);
+}
+
+void FFluidSimStageTimer::Resolve(const bool bWait)
+{
+	check(IsInRenderingThread());
+
+	// In order, a later step can't have landed before an earlier one.
+	int32 NumResolved = 0;
+	for (FStep& Step : PendingSteps)
+	{
+		TArray<uint64, TInlineAllocator<static_cast<int32>(EFluidSimGPUStage::Num) + 1>> Microseconds;
+		for (FTimestamp& Timestamp : Step.Timestamps)
+		{
+			uint64 Time = 0;
+			if (!RHIGetRenderQueryResult(Timestamp.Query.GetQuery(), Time, bWait))
+			{
+				break;
+			}
+			Microseconds.Add(Time);
+		}
+		if (Microseconds.Num() < Step.Timestamps.Num())
+		{
+			break;
+		}
+
+		for (int32 Index = 1; Index < Step.Timestamps.Num(); Index++)
+		{
+			const uint64 Begin = FMath::Min(Microseconds[Index - 1], Microseconds[Index]);
+			TotalMs[static_cast<int32>(Step.Timestamps[Index].Stage)] += static_cast<double>(Microseconds[Index] - Begin) / 1000.0;
+		}
+		TimedSteps++;
+		PendingQueries -= Step.Timestamps.Num();
+		NumResolved++;
+	}
+	PendingSteps.RemoveAt(0, NumResolved);
+}
+
+void FFluidSimStageTimer::TakeTotals(FFluidSimGPUProfile& OutProfile)
+{
+	for (int32 Stage = 0; Stage < static_cast<int32>(EFluidSimGPUStage::Num); Stage++)
+	{
+		OutProfile.StageMs[Stage] = TotalMs[Stage];
+		TotalMs[Stage] = 0.0;
+	}
+	OutProfile.TimedSteps = TimedSteps;
+	TimedSteps = 0;
+}
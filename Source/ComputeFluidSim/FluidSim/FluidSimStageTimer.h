@@ -0,0 +1,75 @@
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "RHIResources.h"
+#include "RenderGraphDefinitions.h"
+
+// Stages of a simulation step timed separately, in dispatch order.
+enum class EFluidSimGPUStage : uint8
+{
+	Dissipate = 0,
+	Inject,
+	Sparse,
+	Diffuse,
+	Divergence,
+	Pressure,
+	Project,
+	Advect,
+	Num
+};
+
+const TCHAR* LexToString(const EFluidSimGPUStage Stage);
+
+// What FFluidSimRenderProxy::CaptureGPUProfile() measured since the last capture.
+struct FFluidSimGPUProfile
+{
+	// Summed over every step of every level, only measured with r.FluidSim.StageTimings.
+	double StageMs[static_cast<int32>(EFluidSimGPUStage::Num)] = {};
+	int32 TimedSteps = 0;
+
+	// Level textures the simulation holds, borrowed from the texture pool.
+	uint64 TextureMemoryBytes = 0;
+};
+
+// GPU time of every stage of a step, for the perf tests and r.FluidSim.StageTimings. Render thread only.
+// A timestamp follows each stage and waits for the fields the stage wrote, which serializes the stages' async compute
+// work against the graphics pipe. That changes the overlap being measured, so it's off unless asked for.
+class FFluidSimStageTimer
+{
+public:
+	// Starts timing the step about to be added, a no-op unless r.FluidSim.StageTimings is set.
+	void BeginStep(FRDGBuilder& GraphBuilder, TConstArrayView<FRDGTextureRef> Fields);
+
+	// Ends Stage once everything writing Fields has run, the next stage starts from there.
+	void EndStage(FRDGBuilder& GraphBuilder, TConstArrayView<FRDGTextureRef> Fields, const EFluidSimGPUStage Stage);
+
+	// Adds the steps whose timestamps landed to the totals, waiting for the GPU if bWait.
+	void Resolve(const bool bWait);
+
+	// Totals since the last call.
+	void TakeTotals(FFluidSimGPUProfile& OutProfile);
+
+private:
+	struct FTimestamp
+	{
+		FRHIPooledRenderQuery Query;
+		EFluidSimGPUStage Stage = EFluidSimGPUStage::Num;
+	};
+
+	// The first timestamp is the start of the step, every following one ends its stage.
+	struct FStep
+	{
+		TArray<FTimestamp> Timestamps;
+	};
+
+	void AddTimestamp(FRDGBuilder& GraphBuilder, TConstArrayView<FRDGTextureRef> Fields, const EFluidSimGPUStage Stage);
+
+	FRenderQueryPoolRHIRef QueryPool;
+	TArray<FStep> PendingSteps;
+	int32 PendingQueries = 0;
+	bool bTimingStep = false;
+
+	double TotalMs[static_cast<int32>(EFluidSimGPUStage::Num)] = {};
+	int32 TimedSteps = 0;
+};
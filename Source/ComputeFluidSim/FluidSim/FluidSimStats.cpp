@@ -0,0 +1,22 @@
+#include "FluidSimStats.h"
+
+DEFINE_STAT(STAT_FluidSimAddSteps);
+DEFINE_STAT(STAT_FluidSimPublish);
+
+DEFINE_STAT(STAT_FluidSimGPUTime);
+DEFINE_STAT(STAT_FluidSimSteps);
+DEFINE_STAT(STAT_FluidSimPressureIterations);
+DEFINE_STAT(STAT_FluidSimInjectionEvents);
+DEFINE_STAT(STAT_FluidSimActiveBricks);
+DEFINE_STAT(STAT_FluidSimActiveVoxels);
+DEFINE_STAT(STAT_FluidSimReadbackBytes);
+DEFINE_STAT(STAT_FluidSimTextureMemory);
+DEFINE_STAT(STAT_FluidSimTexturePoolMemory);
+
+DEFINE_STAT(STAT_FluidSimTotalDivergence);
+DEFINE_STAT(STAT_FluidSimMaxDivergence);
+DEFINE_STAT(STAT_FluidSimMaxVelocity);
+DEFINE_STAT(STAT_FluidSimTotalDensity);
+DEFINE_STAT(STAT_FluidSimKineticEnergy);
+
+CSV_DEFINE_CATEGORY(FluidSim, true);
@@ -0,0 +1,31 @@
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Stats/Stats.h"
+#include "ProfilingDebugging/CsvProfiler.h"
+
+// stat FluidSim, counters are summed over every simulation. GPU time per stage is under stat GPU.
+DECLARE_STATS_GROUP(TEXT("FluidSim"), STATGROUP_FluidSim, STATCAT_Advanced);
+
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Add simulation steps"), STAT_FluidSimAddSteps, STATGROUP_FluidSim, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Publish to proxy"), STAT_FluidSimPublish, STATGROUP_FluidSim, );
+
+DECLARE_FLOAT_COUNTER_STAT_EXTERN(TEXT("GPU time (ms)"), STAT_FluidSimGPUTime, STATGROUP_FluidSim, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Steps"), STAT_FluidSimSteps, STATGROUP_FluidSim, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Pressure iterations"), STAT_FluidSimPressureIterations, STATGROUP_FluidSim, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Injection events"), STAT_FluidSimInjectionEvents, STATGROUP_FluidSim, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Active bricks"), STAT_FluidSimActiveBricks, STATGROUP_FluidSim, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Active voxels"), STAT_FluidSimActiveVoxels, STATGROUP_FluidSim, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Bytes read back"), STAT_FluidSimReadbackBytes, STATGROUP_FluidSim, );
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Texture memory"), STAT_FluidSimTextureMemory, STATGROUP_FluidSim, );
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Pooled texture memory"), STAT_FluidSimTexturePoolMemory, STATGROUP_FluidSim, );
+
+// Latest diagnostics of any simulation with them enabled, see FFluidSimDiagnostics.
+DECLARE_FLOAT_ACCUMULATOR_STAT_EXTERN(TEXT("Total divergence"), STAT_FluidSimTotalDivergence, STATGROUP_FluidSim, );
+DECLARE_FLOAT_ACCUMULATOR_STAT_EXTERN(TEXT("Max divergence"), STAT_FluidSimMaxDivergence, STATGROUP_FluidSim, );
+DECLARE_FLOAT_ACCUMULATOR_STAT_EXTERN(TEXT("Max velocity"), STAT_FluidSimMaxVelocity, STATGROUP_FluidSim, );
+DECLARE_FLOAT_ACCUMULATOR_STAT_EXTERN(TEXT("Total density"), STAT_FluidSimTotalDensity, STATGROUP_FluidSim, );
+DECLARE_FLOAT_ACCUMULATOR_STAT_EXTERN(TEXT("Kinetic energy"), STAT_FluidSimKineticEnergy, STATGROUP_FluidSim, );
+
+CSV_DECLARE_CATEGORY_EXTERN(FluidSim);
@@ -2,15 +2,26 @@
 #include "FluidSimSubsystem.h"
 #include "FluidSimulationManager.h"
 #include "FluidSimulationSource.h" 
+#include "FluidSimColliderComponent.h"
 #include "Engine/TextureRenderTargetVolume.h"
+#include "FluidSimViewExtension.h"
+#include "FluidSimLockstepComponent.h"
+#include "GameFramework/GameModeBase.h"
+#include "GameFramework/PlayerController.h"
+#include "SceneViewExtension.h"
 
 void UFluidSimSubsystem::Initialize(FSubsystemCollectionBase& Collection)
 {
 	Super::Initialize(Collection);
+
+	ViewExtension = FSceneViewExtensions::NewExtension<FFluidSimViewExtension>(GetWorld());
+	PostLoginHandle = FGameModeEvents::GameModePostLoginEvent.AddUObject(this, &UFluidSimSubsystem::OnPostLogin);
 }
 
 void UFluidSimSubsystem::Deinitialize()
 {
+	FGameModeEvents::GameModePostLoginEvent.Remove(PostLoginHandle);
+	ViewExtension.Reset();
 	Super::Deinitialize();
 }
 
@@ -30,7 +41,10 @@ void UFluidSimSubsystem::Tick(float DeltaTime)
 	// 			FetchVelocityData(VelField, *Data);
 	// 		});
 
-	FetchVelocityData(VelocityField, VelocityData);
+	if (!LevelVelocityData.IsEmpty())
+	{
+		FetchVelocityData(VelocityField, LevelVelocityData[0]);
+	}
 }
 
 void UFluidSimSubsystem::RegisterSimManager(AFluidSimulationManager* Manager)
@@ -41,10 +55,31 @@ void UFluidSimSubsystem::RegisterSimManager(AFluidSimulationManager* Manager)
 
 		VelocityField = SimManager->RT_Velocity_Vol;
 		checkf(VelocityField, TEXT("SimManager Velocity Field is nullptr!"));
-		VelocityData.Reserve(VelocityField->SizeX * VelocityField->SizeY * VelocityField->SizeZ);
+
+		LevelVelocityData.SetNum(SimManager->CascadeLevels);
+		for (TArray<FFloat16Color>& VelocityData : LevelVelocityData)
+		{
+			VelocityData.Reserve(VelocityField->SizeX * VelocityField->SizeY * VelocityField->SizeZ);
+		}
 	}
 }
 
+void UFluidSimSubsystem::OnPostLogin(AGameModeBase* GameMode, APlayerController* NewPlayer)
+{
+	// Remote players normally join after the manager's BeginPlay, a listen server's own player doesn't need one.
+	if (NewPlayer == nullptr || NewPlayer->GetWorld() != GetWorld() || NewPlayer->IsLocalController())
+	{
+		return;
+	}
+	if (SimManager != nullptr && !SimManager->bLockstep)
+	{
+		return;
+	}
+
+	UFluidSimLockstepComponent* Component = NewObject<UFluidSimLockstepComponent>(NewPlayer);
+	Component->RegisterComponent();
+}
+
 bool UFluidSimSubsystem::RegisterSource(AFluidSimulationSource* SimSource)
 {
 	if (!IsValid(SimSource)) return false;
@@ -54,11 +89,24 @@ bool UFluidSimSubsystem::RegisterSource(AFluidSimulationSource* SimSource)
 	return true;
 }
 
+void UFluidSimSubsystem::RegisterCollider(UFluidSimColliderComponent* Collider)
+{
+	if (IsValid(Collider))
+	{
+		ColliderArray.AddUnique(Collider);
+	}
+}
+
+void UFluidSimSubsystem::UnregisterCollider(UFluidSimColliderComponent* Collider)
+{
+	ColliderArray.RemoveSwap(Collider);
+}
+
 FVector UFluidSimSubsystem::GetFieldUVs(const AActor& InActor) const
 {
 	if (SimManager == nullptr || SimManager == nullptr) return FVector::Zero();
 
-	const FVector SimLocation = SimManager->GetActorLocation();
+	const FVector SimLocation = SimManager->GetSimDomainCentre();
 	const FVector SimResolution = FVector(SimManager->GridResolution.X, SimManager->GridResolution.Y, SimManager->GridResolution.Z);
 	const FVector SimSize = SimResolution * SimManager->VoxelSize * 100.0f; // VoxelSize in M.
 	const FVector ActorPosition = InActor.GetActorLocation();
@@ -70,18 +118,44 @@ FVector UFluidSimSubsystem::GetFieldUVs(const AActor& InActor) const
 	return UVs;
 }
 
+int32 UFluidSimSubsystem::GetCascadeLevel(const FVector& InLocation, FIntVector& OutVoxel) const
+{
+	if (SimManager == nullptr) return INDEX_NONE;
+
+	const FIntVector Res = SimManager->GridResolution;
+	const FVector SimResolution = FVector(Res.X, Res.Y, Res.Z);
+	for (int32 Level = 0; Level < SimManager->CascadeLevels; Level++)
+	{
+		const float VoxelSizeUU = SimManager->VoxelSize * 100.0f * static_cast<float>(1 << Level); // VoxelSize in M.
+
+		FVector UVs = InLocation - SimManager->GetCascadeCentre(Level);
+		UVs /= VoxelSizeUU;
+		UVs += SimResolution / 2.0f;
+		const FIntVector Voxel = FIntVector(FMath::FloorToInt(UVs.X), FMath::FloorToInt(UVs.Y), FMath::FloorToInt(UVs.Z));
+		if (Voxel.X >= 0 && Voxel.Y >= 0 && Voxel.Z >= 0 && Voxel.X < Res.X && Voxel.Y < Res.Y && Voxel.Z < Res.Z)
+		{
+			OutVoxel = Voxel;
+			return Level;
+		}
+	}
+	return INDEX_NONE;
+}
+
 FVector UFluidSimSubsystem::GetVelocity(const FVector& InLocation) const
 {
-	const FVector SimLocation = SimManager->GetActorLocation();
-	const FVector SimResolution = FVector(SimManager->GridResolution.X, SimManager->GridResolution.Y, SimManager->GridResolution.Z);
-	const FVector SimSize = SimResolution * SimManager->VoxelSize * 100.0f; // VoxelSize in M;
+	FIntVector Voxel;
+	const int32 Level = GetCascadeLevel(InLocation, Voxel);
+	if (!LevelVelocityData.IsValidIndex(Level))
+	{
+		return FVector::ZeroVector;
+	}
 
-	FVector UVs = InLocation - SimLocation;
-	UVs += SimSize / 2.0f;
-	UVs /= SimManager->VoxelSize * 100.0f;
-	const FIntVector Voxel = FIntVector(UVs.X, UVs.Y, UVs.Z);
-	const int Idx = Voxel.Z * SimResolution.Z + Voxel.Y * SimResolution.Y + Voxel.X;
+	// The output volumes are linear relative to the domain, any scrolling offset is already resolved.
+	const FIntVector Res = SimManager->GridResolution;
+	const int Idx = (Voxel.Z * Res.Y + Voxel.Y) * Res.X + Voxel.X;
 
+	// Velocities are in voxels per step of the level, which is the same world speed at every level.
+	const TArray<FFloat16Color>& VelocityData = LevelVelocityData[Level];
 	if (Idx >= 0 && Idx < VelocityData.Num())
 	{
 		const FLinearColor Color = VelocityData[Idx].GetFloats() * 100.0f;
@@ -28,13 +28,28 @@ public:
 	
 	bool RegisterSource(class AFluidSimulationSource* SimSource);
 
+	// Moving colliders, sampled by the manager every frame.
+	void RegisterCollider(class UFluidSimColliderComponent* Collider);
+	void UnregisterCollider(class UFluidSimColliderComponent* Collider);
+	const TArray<TObjectPtr<class UFluidSimColliderComponent>>& GetColliders() const { return ColliderArray; }
+
 	FVector GetFieldUVs(const AActor& InActor) const;
 
+	// Sampled from the finest cascade level that covers the location.
 	FVector GetVelocity(const FVector& InLocation) const;
+
+	// Finest cascade level covering the location, INDEX_NONE when outside all of them.
+	int32 GetCascadeLevel(const FVector& InLocation, FIntVector& OutVoxel) const;
+
+	TSharedPtr<class FFluidSimViewExtension, ESPMode::ThreadSafe> GetViewExtension() const { return ViewExtension; }
 	
 private:
 
 	void FetchVelocityData(class UTextureRenderTargetVolume* InVel, TArray<FFloat16Color>& Data);
+
+	// Server, gives remote players the lockstep channel, see UFluidSimLockstepComponent.
+	void OnPostLogin(class AGameModeBase* GameMode, class APlayerController* NewPlayer);
+	FDelegateHandle PostLoginHandle;
 	
 	UPROPERTY()
 	class AFluidSimulationManager* SimManager = nullptr; 
@@ -44,6 +59,13 @@ private:
 	
 	UPROPERTY()
 	TArray<TObjectPtr<class AFluidSimulationSource>> SourceArray;
+
+	UPROPERTY()
+	TArray<TObjectPtr<class UFluidSimColliderComponent>> ColliderArray;
 	
-	TArray<FFloat16Color> VelocityData;
+	// Per cascade level, finest first.
+	TArray<TArray<FFloat16Color>> LevelVelocityData;
+
+	// Render thread hook for simulations running on the render thread clock.
+	TSharedPtr<class FFluidSimViewExtension, ESPMode::ThreadSafe> ViewExtension;
 };
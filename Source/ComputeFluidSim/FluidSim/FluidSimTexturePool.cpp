@@ -0,0 +1,154 @@
+#include "FluidSimTexturePool.h"
+
+#include "Engine/Engine.h"
+#include "HAL/IConsoleManager.h"
+#include "RenderingThread.h"
+#include "RHI.h"
+#include "FluidSimShaderCache.h"
+#include "FluidSimStamps.h"
+#include "FluidSimStats.h"
+
+
+static TAutoConsoleVariable<int32> CVarFluidSimTexturePoolMB(
+	TEXT("r.FluidSim.TexturePoolMB"),
+	512,
+	TEXT("Video memory in MB the fluid simulation volumes nobody is using may keep, to set up the next simulation without allocating.\n")
+	TEXT(" 0: release volumes as soon as they are given back"),
+	ECVF_Default);
+
+static int64 GetMaxFreeBytes()
+{
+	return static_cast<int64>(FMath::Max(CVarFluidSimTexturePoolMB.GetValueOnRenderThread(), 0)) * 1024 * 1024;
+}
+
+
+FFluidSimTexturePool::~FFluidSimTexturePool()
+{
+	Empty();
+}
+
+FTextureRHIRef FFluidSimTexturePool::Acquire(const TCHAR* Name, const FIntVector& Size, const EPixelFormat Format, const FLinearColor& ClearColour)
+{
+	check(IsInRenderingThread());
+
+	const FClearValueBinding ClearValue(ClearColour);
+	for (int32 Index = FreeTextures.Num() - 1; Index >= 0; Index--)
+	{
+		const FFreeTexture& Free = FreeTextures[Index];
+		const FRHITextureDesc& Desc = Free.Texture->GetDesc();
+		if (Free.AvailableFrame <= GFrameCounterRenderThread &&
+			Desc.Extent == FIntPoint(Size.X, Size.Y) && Desc.Depth == Size.Z && Desc.Format == Format && Desc.ClearValue == ClearValue)
+		{
+			// Keeps the name it was created with.
+			FTextureRHIRef Texture = Free.Texture;
+			FreeBytes -= Free.Bytes;
+			DEC_MEMORY_STAT_BY(STAT_FluidSimTexturePoolMemory, Free.Bytes);
+			FreeTextures.RemoveAt(Index);
+			return Texture;
+		}
+	}
+
+	const FRHITextureCreateDesc CDesc = FRHITextureCreateDesc::Create3D(Name, Size.X, Size.Y, Size.Z, Format)
+		.SetFlags(ETextureCreateFlags::External | ETextureCreateFlags::UAV | ETextureCreateFlags::RenderTargetable | ETextureCreateFlags::ShaderResource)
+		.SetInitialState(ERHIAccess::UAVCompute)
+		.SetClearValue(ClearValue);
+	return RHICreateTexture(CDesc);
+}
+
+void FFluidSimTexturePool::Release(FTextureRHIRef& Texture, const bool bStillInUse)
+{
+	check(IsInRenderingThread());
+	if (!Texture)
+	{
+		return;
+	}
+
+	FFreeTexture& Free = FreeTextures.AddDefaulted_GetRef();
+	Free.Texture = MoveTemp(Texture);
+	Free.AvailableFrame = bStillInUse ? GFrameCounterRenderThread + 1 : 0;
+	Free.Bytes = RHIComputeMemorySize(Free.Texture);
+	FreeBytes += Free.Bytes;
+	INC_MEMORY_STAT_BY(STAT_FluidSimTexturePoolMemory, Free.Bytes);
+	Texture = nullptr;
+
+	Trim(GetMaxFreeBytes());
+}
+
+void FFluidSimTexturePool::Empty()
+{
+	Trim(0);
+}
+
+void FFluidSimTexturePool::Trim(const int64 MaxBytes)
+{
+	int32 NumReleased = 0;
+	while (NumReleased < FreeTextures.Num() && FreeBytes > MaxBytes)
+	{
+		FreeBytes -= FreeTextures[NumReleased].Bytes;
+		DEC_MEMORY_STAT_BY(STAT_FluidSimTexturePoolMemory, FreeTextures[NumReleased].Bytes);
+		NumReleased++;
+	}
+	FreeTextures.RemoveAt(0, NumReleased);
+}
+
+FRHITexture* FFluidSimTexturePool::GetStampAtlas(FRHICommandListImmediate& RHICmdList)
+{
+	check(IsInRenderingThread());
+	if (StampAtlas)
+	{
+		return StampAtlas;
+	}
+
+	const FIntVector Size = FluidSimStamps::GetAtlasSize();
+	const FRHITextureCreateDesc CDesc = FRHITextureCreateDesc::Create3D(TEXT("FluidSim_StampAtlas"), Size.X, Size.Y, Size.Z, EPixelFormat::PF_FloatRGBA)
+		.SetFlags(ETextureCreateFlags::ShaderResource)
+		.SetInitialState(ERHIAccess::SRVCompute);
+	StampAtlas = RHICreateTexture(CDesc);
+
+	const uint32 RowPitch = Size.X * sizeof(FFloat16Color);
+	const uint32 DepthPitch = RowPitch * Size.Y;
+	RHICmdList.UpdateTexture3D(StampAtlas, 0, FUpdateTextureRegion3D(0, 0, 0, 0, 0, 0, Size.X, Size.Y, Size.Z), RowPitch, DepthPitch,
+		reinterpret_cast<const uint8*>(FluidSimStamps::GetAtlas().GetData()));
+	return StampAtlas;
+}
+
+
+void UFluidSimTexturePoolSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+	Pool = MakeShared<FFluidSimTexturePool, ESPMode::ThreadSafe>();
+	ShaderCache = MakeShared<FFluidSimShaderCache, ESPMode::ThreadSafe>();
+}
+
+void UFluidSimTexturePoolSubsystem::Deinitialize()
+{
+	// Proxies still alive keep the pool and the cache, whoever drops them last does so on the render thread.
+	ENQUEUE_RENDER_COMMAND(FluidSimTexturePoolEmpty)(
+		[Pool=MoveTemp(Pool), ShaderCache=MoveTemp(ShaderCache)](FRHICommandListImmediate& RHICmdList) mutable
+		{
+			Pool->Empty();
+			Pool.Reset();
+			ShaderCache.Reset();
+		});
+	Super::Deinitialize();
+}
+
+TSharedRef<FFluidSimTexturePool, ESPMode::ThreadSafe> UFluidSimTexturePoolSubsystem::GetPool()
+{
+	const UFluidSimTexturePoolSubsystem* Subsystem = GEngine ? GEngine->GetEngineSubsystem<UFluidSimTexturePoolSubsystem>() : nullptr;
+	if (Subsystem && Subsystem->Pool.IsValid())
+	{
+		return Subsystem->Pool.ToSharedRef();
+	}
+	return MakeShared<FFluidSimTexturePool, ESPMode::ThreadSafe>();
+}
+
+TSharedRef<FFluidSimShaderCache, ESPMode::ThreadSafe> UFluidSimTexturePoolSubsystem::GetShaderCache()
+{
+	const UFluidSimTexturePoolSubsystem* Subsystem = GEngine ? GEngine->GetEngineSubsystem<UFluidSimTexturePoolSubsystem>() : nullptr;
+	if (Subsystem && Subsystem->ShaderCache.IsValid())
+	{
+		return Subsystem->ShaderCache.ToSharedRef();
+	}
+	return MakeShared<FFluidSimShaderCache, ESPMode::ThreadSafe>();
+}
@@ -0,0 +1,74 @@
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "RHIResources.h"
+#include "Subsystems/EngineSubsystem.h"
+
+#include "FluidSimTexturePool.generated.h"
+
+class FRHICommandListImmediate;
+class FFluidSimShaderCache;
+
+// Simulation volumes handed back by stopped or resized proxies, lent out again to the next proxy asking for the same
+// size and format. PIE restarts, streamed levels and respawned managers then set up without allocating, the borrower
+// clears what it gets. Render thread only.
+//
+// Free textures above r.FluidSim.TexturePoolMB are released oldest first.
+class FFluidSimTexturePool
+{
+public:
+	~FFluidSimTexturePool();
+
+	// A free volume matching Size, Format and ClearColour, a new one if there is none.
+	FTextureRHIRef Acquire(const TCHAR* Name, const FIntVector& Size, const EPixelFormat Format, const FLinearColor& ClearColour = FLinearColor::Black);
+
+	// Gives the texture back and nulls the reference, a no-op for a null reference. bStillInUse for a texture read by
+	// passes already in a graph, it's only lent out again from the next frame as other proxies add to the same graph.
+	void Release(FTextureRHIRef& Texture, const bool bStillInUse = false);
+
+	// Releases every free texture, borrowed ones are unaffected.
+	void Empty();
+
+	// Never changes, uploaded on first use and shared by every proxy.
+	FRHITexture* GetStampAtlas(FRHICommandListImmediate& RHICmdList);
+
+private:
+	struct FFreeTexture
+	{
+		FTextureRHIRef Texture;
+		uint64 AvailableFrame = 0;
+		int64 Bytes = 0;
+	};
+
+	void Trim(const int64 MaxBytes);
+
+	// Oldest first.
+	TArray<FFreeTexture> FreeTextures;
+	int64 FreeBytes = 0;
+
+	FTextureRHIRef StampAtlas;
+};
+
+// Owns the pool and the shader cache for the lifetime of the engine so they outlive worlds and managers. Setting up a
+// simulation after the first then neither allocates volumes nor resolves shaders and precaches pipelines again.
+UCLASS()
+class UFluidSimTexturePoolSubsystem : public UEngineSubsystem
+{
+private:
+	GENERATED_BODY()
+
+public:
+	// Begin USubsystem
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+	// End USubsystem
+
+	// The engine's pool and shader cache, private ones when there is no engine to own them.
+	static TSharedRef<FFluidSimTexturePool, ESPMode::ThreadSafe> GetPool();
+	static TSharedRef<FFluidSimShaderCache, ESPMode::ThreadSafe> GetShaderCache();
+
+private:
+	TSharedPtr<FFluidSimTexturePool, ESPMode::ThreadSafe> Pool;
+	TSharedPtr<FFluidSimShaderCache, ESPMode::ThreadSafe> ShaderCache;
+};
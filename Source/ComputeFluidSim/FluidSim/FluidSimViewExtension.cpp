@@ -0,0 +1,29 @@
+#include "FluidSimViewExtension.h"
+
+#include "FluidSimRenderProxy.h"
+
+
+FFluidSimViewExtension::FFluidSimViewExtension(const FAutoRegister& AutoRegister, UWorld* InWorld)
+	: FWorldSceneViewExtension(AutoRegister, InWorld)
+{}
+
+void FFluidSimViewExtension::AddProxy(FFluidSimRenderProxy* Proxy)
+{
+	check(IsInRenderingThread());
+	Proxies.AddUnique(Proxy);
+}
+
+void FFluidSimViewExtension::RemoveProxy(FFluidSimRenderProxy* Proxy)
+{
+	check(IsInRenderingThread());
+	Proxies.Remove(Proxy);
+}
+
+void FFluidSimViewExtension::PreRenderViewFamily_RenderThread(FRDGBuilder& GraphBuilder, FSceneViewFamily& InViewFamily)
+{
+	// Proxies guard against being stepped by more than one view family per frame.
+	for (FFluidSimRenderProxy* Proxy : Proxies)
+	{
+		Proxy->TickRenderThread(GraphBuilder);
+	}
+}
@@ -0,0 +1,27 @@
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "SceneViewExtension.h"
+
+// Gives render thread proxies a hook into every rendered frame of a world.
+// Proxies are added and removed on the render thread only.
+class FFluidSimViewExtension : public FWorldSceneViewExtension
+{
+public:
+	FFluidSimViewExtension(const FAutoRegister& AutoRegister, UWorld* InWorld);
+
+	// Render thread
+	void AddProxy(class FFluidSimRenderProxy* Proxy);
+	void RemoveProxy(class FFluidSimRenderProxy* Proxy);
+
+	// ISceneViewExtension
+	virtual void SetupViewFamily(FSceneViewFamily& InViewFamily) override {}
+	virtual void SetupView(FSceneViewFamily& InViewFamily, FSceneView& InView) override {}
+	virtual void BeginRenderViewFamily(FSceneViewFamily& InViewFamily) override {}
+	virtual void PreRenderViewFamily_RenderThread(FRDGBuilder& GraphBuilder, FSceneViewFamily& InViewFamily) override;
+	// End ISceneViewExtension
+
+private:
+	TArray<class FFluidSimRenderProxy*> Proxies;
+};
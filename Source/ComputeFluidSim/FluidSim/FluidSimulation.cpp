@@ -1,24 +1,21 @@
 #include "FluidSimulation.h"
 
-#include "RenderGraph.h"
-#include "GlobalShader.h"
-#include "RHI.h"
+#include "RenderingThread.h"
+#include "Async/Async.h"
+#include "Misc/FileHelper.h"
 #include "TextureResource.h"
 #include "Engine/TextureRenderTargetVolume.h"
+#include "Engine/VolumeTexture.h"
+#include "Misc/CoreDelegates.h"
+#include "FluidSimCheckpoint.h"
 #include "FluidSimLog.h"
-#include "FluidShaderImplementation.h"
-
-// This will tell the engine to create the shader and where the shader entry point is.
-//                            ShaderType                            ShaderPath                     Shader function name    Type
-IMPLEMENT_GLOBAL_SHADER(FObjectGPUAdvectionShader,			"/DynamicsShaders/FluidSimShader.usf", "AdvectionShader",		SF_Compute);
-IMPLEMENT_GLOBAL_SHADER(FObjectGPUDissipationShader,		"/DynamicsShaders/FluidSimShader.usf", "DissipationShader",		SF_Compute);
-IMPLEMENT_GLOBAL_SHADER(FObjectGPUDiffusionShader,			"/DynamicsShaders/FluidSimShader.usf", "DiffusionShader",		SF_Compute);
-IMPLEMENT_GLOBAL_SHADER(FObjectGPUDivergenceShader,			"/DynamicsShaders/FluidSimShader.usf", "DivergenceShader",		SF_Compute);
-IMPLEMENT_GLOBAL_SHADER(FObjectGPUProjectPressureShader,	"/DynamicsShaders/FluidSimShader.usf", "ProjPressureShader",	SF_Compute);
-IMPLEMENT_GLOBAL_SHADER(FObjectGPUProjectGradientShader,	"/DynamicsShaders/FluidSimShader.usf", "ProjGradientVelShader", SF_Compute);
-
-// Injection
-IMPLEMENT_GLOBAL_SHADER(FObjectGPUInjectionShader, "/DynamicsShaders/FluidSimInjectionShader.usf", "InjectionShader", SF_Compute);
+#include "FluidSimRenderProxy.h"
+#include "FluidSimReplay.h"
+#include "FluidSimScalability.h"
+#include "FluidSimStats.h"
+#include "FluidSimSubsystem.h"
+#include "FluidSimTexturePool.h"
+#include "FluidSimViewExtension.h"
 
 
 bool UFluidSimulation::Setup(const FGridDescription& Desc, const FContentBrowserTextures& CBTexts)
@@ -29,140 +26,346 @@ bool UFluidSimulation::Setup(const FGridDescription& Desc, const FContentBrowser
 	RT_Pressure_Vol = CBTexts.RT_Pressure_Vol;
 	RT_Divergence_Vol = CBTexts.RT_Divergence_Vol;
 	
-	GroupCount = FIntVector(32,32,32); // Can expose if needed.
+	DomainCentre = FIntVector::ZeroValue;
+	Diagnostics = FFluidSimDiagnostics();
+	GPUTimeMs = 0.0f;
+	WorkloadScale = 1.0f;
 
 	// Validate injection events at start.
 	ResetInjectionEvents();
 
+	// Divergence is only a debug view and is optional.
+	const bool bTexturesValid = IsValid(RT_Density_Vol) && IsValid(RT_Velocity_Vol) && IsValid(RT_Pressure_Vol);
+	if (!bTexturesValid)
+	{
+		return false;
+	}
+
+	// Replace any previous proxy, the old one is released on the render thread.
+	Stop();
+
+	CreateCascadeTextures();
+
+	TArray<FFluidSimOutputResources> LevelOutputs;
+	FFluidSimOutputResources& Outputs = LevelOutputs.AddDefaulted_GetRef();
+	Outputs.Velocity = RT_Velocity_Vol->GameThread_GetRenderTargetResource();
+	Outputs.Density = RT_Density_Vol->GameThread_GetRenderTargetResource();
+	Outputs.Pressure = RT_Pressure_Vol->GameThread_GetRenderTargetResource();
+	Outputs.Divergence = IsValid(RT_Divergence_Vol) ? RT_Divergence_Vol->GameThread_GetRenderTargetResource() : nullptr;
+
+	for (const FFluidSimCascadeTextures& Level : CascadeTextures)
+	{
+		FFluidSimOutputResources& CascadeOutputs = LevelOutputs.AddDefaulted_GetRef();
+		CascadeOutputs.Velocity = Level.Velocity->GameThread_GetRenderTargetResource();
+		CascadeOutputs.Density = Level.Density->GameThread_GetRenderTargetResource();
+		CascadeOutputs.Pressure = Level.Pressure->GameThread_GetRenderTargetResource();
+	}
+
+	FFluidSimInitialState InitialState;
+	InitialState.Checkpoint = InitialCheckpoint;
+	InitialState.Velocity = IsValid(InitialVelocity) ? InitialVelocity->GetResource() : nullptr;
+	InitialState.Density = IsValid(InitialDensity) ? InitialDensity->GetResource() : nullptr;
+
+	// Level textures come from the engine wide pool, a restart borrows the volumes the last run gave back.
+	RenderProxy = new FFluidSimRenderProxy(GridDescription, LevelOutputs, UFluidSimTexturePoolSubsystem::GetShaderCache(), UFluidSimTexturePoolSubsystem::GetPool(), InitialState);
+	bCollidersChanged = !Colliders.IsEmpty();
+
+	// The view extension drives the proxy when it runs on the render thread clock.
+	const UWorld* World = GetWorld();
+	const UFluidSimSubsystem* Subsystem = World ? World->GetSubsystem<UFluidSimSubsystem>() : nullptr;
+	ViewExtension = Subsystem ? Subsystem->GetViewExtension() : nullptr;
+
 	// Makes sure the GPU Is ready
-	if (IsInRenderingThread()) {
-		SetupRenderThread(GetImmediateCommandList_ForRenderCommand());
+	ENQUEUE_RENDER_COMMAND(GPUFluidSimCommand)(
+		[Proxy=RenderProxy, Extension=ViewExtension](FRHICommandListImmediate& RHICmdList)
+		{
+			Proxy->SetupRenderThread(RHICmdList);
+			if (Extension.IsValid())
+			{
+				Extension->AddProxy(Proxy);
+			}
+		});
+
+	return true; 
+}
+
+void UFluidSimulation::SetInitialState(const TSharedPtr<const FFluidSimCheckpoint>& Checkpoint, UVolumeTexture* Velocity, UVolumeTexture* Density)
+{
+	InitialCheckpoint = Checkpoint;
+	InitialVelocity = Velocity;
+	InitialDensity = Density;
+}
+
+void UFluidSimulation::SimulationStep(const FFluidSolverSettings& InSettings)
+{
+	if (RenderProxy == nullptr)
+	{
+		return;
+	}
+
+	Settings = InSettings;
+	if (Settings.Clock == EFluidSimClock::RenderThread)
+	{
+		// The proxy steps itself, just make sure it has the latest settings and events.
+		PublishToProxy(0);
+		return;
+	}
+
+	PublishToProxy(1);
+
+	// The proxy is only deleted by a render command queued after this one, so it's safe to capture.
+	ENQUEUE_RENDER_COMMAND(GPUFluidSimCommand)(
+		[Proxy=RenderProxy](FRHICommandListImmediate& RHICmdList)
+		{
+			Proxy->UpdateRenderThread(RHICmdList);
+		});
+}
+
+void UFluidSimulation::ReplayFrame(const FFluidSolverSettings& InSettings, const FFluidSimStreamFrame& Frame)
+{
+	if (RenderProxy == nullptr)
+	{
+		return;
 	}
-	else
+
+	FluidSimReplay::FromCoreEvents(Frame.Events, InjectionEventsPerFrame);
+	Settings = InSettings;
+	FluidSimReplay::ApplyCoreSettings(Settings, Frame.Settings);
+	PublishToProxy(Frame.StepCount);
+
+	if (Frame.StepCount > 0)
 	{
 		ENQUEUE_RENDER_COMMAND(GPUFluidSimCommand)(
-			[this](FRHICommandListImmediate& RHICmdList)
+			[Proxy=RenderProxy](FRHICommandListImmediate& RHICmdList)
 			{
-				UFluidSimulation::SetupRenderThread(RHICmdList);
+				Proxy->UpdateRenderThread(RHICmdList);
 			});
 	}
+}
 
-	return IsValid(RT_Density_Vol) && IsValid(RT_Velocity_Vol) && IsValid(RT_Pressure_Vol) && IsValid(RT_Divergence_Vol) ; 
+void UFluidSimulation::TakeInjectionEvents(TArray<FFluidSimSourceShaderData>& OutEvents)
+{
+	OutEvents = MoveTemp(InjectionEventsPerFrame);
+	ResetInjectionEvents();
 }
 
-void UFluidSimulation::SetupRenderThread(FRHICommandListImmediate& RHICmdList)
+bool UFluidSimulation::StartRecording(const FString& Path)
 {
-	StopRenderThread(RHICmdList);
-	
-	constexpr EPixelFormat TextureFormat = EPixelFormat::PF_FloatRGBA; 
+	if (Settings.Clock != EFluidSimClock::GameThread)
+	{
+		UE_LOG(LogFluidSim, Warning, TEXT("Fluid sim recording needs the game thread clock."));
+		return false;
+	}
 
-	if (RT_Density == nullptr || RT_Velocity == nullptr || RT_Pressure == nullptr || RT_Divergence == nullptr )
+	FFluidSimStreamHeader Header;
+	Header.Resolution = GridDescription.GridResolution;
+	Header.FrameRate = Settings.SimulationRate;
+	if (!Recorder.Open(*Path, Header))
 	{
-		CreateRHITextureResource(RT_Divergence, TEXT("FluidSim_RT_Divergence"), TextureFormat);
-		CreateRHITextureResource(RT_Pressure, TEXT("FluidSim_RT_Pressure"), TextureFormat);
-		CreateRHITextureResource(RT_Density, TEXT("FluidSim_RT_Density"), TextureFormat);
-		CreateRHITextureResource(RT_Velocity, TEXT("FluidSim_RT_Velocity"), TextureFormat);
+		UE_LOG(LogFluidSim, Warning, TEXT("Failed to open '%s' for recording."), *Path);
+		return false;
 	}
 
-	// Clear RTs
-	ClearRenderTarget(RHICmdList, RT_Pressure);
-	ClearRenderTarget(RHICmdList, RT_Divergence);
-	ClearRenderTarget(RHICmdList, RT_Density);
-	ClearRenderTarget(RHICmdList, RT_Velocity);
+	UE_LOG(LogFluidSim, Log, TEXT("Recording fluid sim input to '%s'."), *Path);
+	return true;
+}
 
-	ReadyToRender = 
-		RT_Velocity &&
-		RT_Divergence &&
-		RT_Pressure &&
-		RT_Density &&
-		RT_Density_Vol && // Content Browser textures exist.
-		RT_Velocity_Vol &&
-		RT_Pressure_Vol &&
-		RT_Divergence_Vol &&
-		GridDescription.GridResolution.X > 0 && GridDescription.GridResolution.Y > 0 && GridDescription.GridResolution.Z > 0;
+void UFluidSimulation::StopRecording()
+{
+	if (Recorder.IsOpen())
+	{
+		UE_LOG(LogFluidSim, Log, TEXT("Recorded %d fluid sim frames."), Recorder.GetFrameCount());
+		Recorder.Close();
+	}
+}
+
+bool UFluidSimulation::SaveCheckpoint(const FString& Path)
+{
+	if (RenderProxy == nullptr)
+	{
+		return false;
+	}
 
+	ENQUEUE_RENDER_COMMAND(GPUFluidSimCheckpoint)(
+		[Proxy=RenderProxy, Path](FRHICommandListImmediate& RHICmdList)
+		{
+			Proxy->CaptureCheckpoint(RHICmdList, Path);
+		});
+	return true;
 }
 
-void UFluidSimulation::SimulationStep(const FFluidSolverSettings& InSettings)
+bool UFluidSimulation::LoadCheckpoint(const FString& Path)
+{
+	if (RenderProxy == nullptr)
+	{
+		return false;
+	}
+
+	// The simulation may be gone or set up again by the time the checkpoint is decoded.
+	AsyncTask(ENamedThreads::AnyBackgroundThreadNormalTask, [WeakThis = TWeakObjectPtr<UFluidSimulation>(this), Path]()
+	{
+		TArray<uint8> Data;
+		TSharedRef<FFluidSimCheckpoint> Checkpoint = MakeShared<FFluidSimCheckpoint>();
+		if (!FFileHelper::LoadFileToArray(Data, *Path) || !FluidSimCheckpoint::Decode(Data, *Checkpoint))
+		{
+			UE_LOG(LogFluidSim, Warning, TEXT("Failed to read checkpoint '%s'."), *Path);
+			return;
+		}
+
+		AsyncTask(ENamedThreads::GameThread, [WeakThis, Checkpoint]()
+		{
+			if (UFluidSimulation* Simulation = WeakThis.Get())
+			{
+				Simulation->RestoreCheckpoint(Checkpoint);
+			}
+		});
+	});
+	return true;
+}
+
+void UFluidSimulation::RestoreCheckpoint(const TSharedRef<const FFluidSimCheckpoint>& Checkpoint)
 {
-	if (!ReadyToRender)
+	if (RenderProxy == nullptr)
 	{
 		return;
 	}
 
-	// Make copy so we don't edit the data going to the GPU.
-	const FObjectGPUDispatchParams GPUParams = FObjectGPUDispatchParams(GroupCount, InSettings, InjectionEventsPerFrame);
-	
-	if (IsInRenderingThread()) {
-		DispatchRenderThread(GetImmediateCommandList_ForRenderCommand(), GPUParams);
+	ENQUEUE_RENDER_COMMAND(GPUFluidSimRestore)(
+		[Proxy=RenderProxy, Checkpoint](FRHICommandListImmediate& RHICmdList)
+		{
+			Proxy->RestoreCheckpoint(RHICmdList, *Checkpoint);
+		});
+}
+
+bool UFluidSimulation::StartBake(const FString& Path)
+{
+	const EFluidSimOutputFields Fields = static_cast<EFluidSimOutputFields>(Settings.OutputFields);
+	if (RenderProxy == nullptr || !EnumHasAllFlags(Fields, EFluidSimOutputFields::Velocity | EFluidSimOutputFields::Density))
+	{
+		UE_LOG(LogFluidSim, Warning, TEXT("Baking '%s' needs a running simulation writing its velocity and density outputs."), *Path);
+		return false;
 	}
-	else
+
+	ENQUEUE_RENDER_COMMAND(GPUFluidSimStartBake)(
+		[Proxy=RenderProxy, Path](FRHICommandListImmediate& RHICmdList)
+		{
+			Proxy->StartBake(Path);
+		});
+	return true;
+}
+
+void UFluidSimulation::StopBake()
+{
+	if (RenderProxy == nullptr)
 	{
-		ENQUEUE_RENDER_COMMAND(GPUFluidSimCommand)(
-			[this, Params=GPUParams](FRHICommandListImmediate& RHICmdList)
-			{
-				UFluidSimulation::DispatchRenderThread(RHICmdList, Params);
-			});
+		return;
 	}
 
-	// Clear events after sending to GPU.
-	ResetInjectionEvents();
+	ENQUEUE_RENDER_COMMAND(GPUFluidSimStopBake)(
+		[Proxy=RenderProxy](FRHICommandListImmediate& RHICmdList)
+		{
+			Proxy->StopBake();
+		});
+}
+
+void UFluidSimulation::UpdateSettings(const FFluidSolverSettings& InSettings)
+{
+	Settings = InSettings;
+	PublishToProxy(0);
 }
 
-void UFluidSimulation::DispatchRenderThread(FRHICommandListImmediate& RHICmdList, const FObjectGPUDispatchParams& Params)
+void UFluidSimulation::PublishToProxy(const int32 StepCount)
 {
+	SCOPE_CYCLE_COUNTER(STAT_FluidSimPublish);
+
+	if (RenderProxy == nullptr)
 	{
-		if (!ReadyToRender) return;
+		return;
 	}
-	
-	FRDGBuilder GraphBuilder(RHICmdList, FRDGEventName(TEXT("UFluidSimulation::SimulationStep")));
-	TSharedPtr<FComputeStageIntrinsics> StageIntrinsics = MakeShared<FComputeStageIntrinsics>(RHICmdList, GraphBuilder, Params.GroupCount, Params.Settings);
-	
-	// Register external textures with the graph builder.
-	StageIntrinsics->SH_RT_Density = RegisterExternalTexture(GraphBuilder, RT_Density, TEXT("FluidSim_RT_Density"));
-	StageIntrinsics->SH_RT_Velocity = RegisterExternalTexture(GraphBuilder, RT_Velocity, TEXT("FluidSim_RT_Velocity"));
-	StageIntrinsics->SH_RT_Pressure = RegisterExternalTexture(GraphBuilder, RT_Pressure, TEXT("FluidSim_RT_Pressure"));
-	StageIntrinsics->SH_RT_Divergence = RegisterExternalTexture(GraphBuilder, RT_Divergence, TEXT("FluidSim_RT_Divergence"));
-	
-	// Add simulation steps.
-	Dissipate(StageIntrinsics, StageIntrinsics->SH_RT_Density, StageIntrinsics->Settings.DissipationDensity );
-	Dissipate(StageIntrinsics, StageIntrinsics->SH_RT_Velocity, StageIntrinsics->Settings.DissipationVelocity );
-	
-	InjectSources(StageIntrinsics, Params);
-	
-	Diffusion(StageIntrinsics, StageIntrinsics->SH_RT_Density);
 
-	// Projection
-	ClearRenderTarget(RHICmdList, RT_Pressure);
-	ClearRenderTarget(RHICmdList, RT_Divergence);
-	Divergence(StageIntrinsics);
-	
-	int Itr = 0;
-	while (Itr < Params.Settings.PressureIterations)
+	// Hand the frame over to the proxy, if it hasn't picked up the last one yet this accumulates until it does.
+	TFluidSimMailbox<FFluidSimProxyPacket>& Mailbox = RenderProxy->GetMailbox();
+	FFluidSimProxyPacket& Packet = Mailbox.GetWriteSlot();
+	Packet.Settings = FluidSimScalability::ApplyToSettings(Settings);
+	Packet.GridDescription = GridDescription;
+	Packet.DomainCentre = DomainCentre;
+	Packet.InjectionEvents.Append(InjectionEventsPerFrame);
+	Packet.ObstacleBricks.Append(PendingObstacleBricks);
+	Packet.StepCount += StepCount;
+	PendingObstacleBricks.Reset();
+
+	// Only sent when they changed, the proxy keeps the last ones otherwise.
+	if (bCollidersChanged)
 	{
-		ProjectPressure(StageIntrinsics);
-		Itr++;
+		Packet.Colliders = Colliders;
+		Packet.bCollidersChanged = true;
+		bCollidersChanged = false;
 	}
-	ProjectGradient(StageIntrinsics);
 
-	// Final Advection
-	Advect(StageIntrinsics);
+	// Anything queued for the end of the frame goes out with this publish.
+	CancelQueuedPublish();
 
-	// Copy the field to the RT which is then used with other actors/materials.
-	FRDGTextureRef GameRTVelocity = RegisterExternalTexture(GraphBuilder, RT_Velocity_Vol->GetRenderTargetResource()->GetRenderTargetTexture(), TEXT("ObjectGPUFluidSimulation_OutRTVel"));
-	AddCopyTexturePass(GraphBuilder, StageIntrinsics->SH_RT_Velocity, GameRTVelocity, FRHICopyTextureInfo() ); 
+	if (Recorder.IsOpen() && (StepCount > 0 || !InjectionEventsPerFrame.IsEmpty()))
+	{
+		FFluidSimStreamFrame Frame;
+		Frame.StepCount = StepCount;
+		Frame.Settings = FluidSimReplay::ToCoreSettings(Packet.Settings);
+		FluidSimReplay::ToCoreEvents(InjectionEventsPerFrame, Frame.Events);
+		Recorder.AddFrame(Frame);
+	}
 
-	FRDGTextureRef GameRTDensity = RegisterExternalTexture(GraphBuilder, RT_Density_Vol->GetRenderTargetResource()->GetRenderTargetTexture(), TEXT("ObjectGPUFluidSimulation_OutRTDensity"));
-	AddCopyTexturePass(GraphBuilder, StageIntrinsics->SH_RT_Density, GameRTDensity, FRHICopyTextureInfo() ); 
+	Mailbox.Publish();
 
-	FRDGTextureRef GameRTPressure = RegisterExternalTexture(GraphBuilder, RT_Pressure_Vol->GetRenderTargetResource()->GetRenderTargetTexture(), TEXT("ObjectGPUFluidSimulation_OutRTPressure"));
-	AddCopyTexturePass(GraphBuilder, StageIntrinsics->SH_RT_Pressure, GameRTPressure, FRHICopyTextureInfo() );
+	// Clear events after sending to GPU.
+	ResetInjectionEvents();
+}
 
-	FRDGTextureRef GameRTDivergence = RegisterExternalTexture(GraphBuilder, RT_Divergence_Vol->GetRenderTargetResource()->GetRenderTargetTexture(), TEXT("ObjectGPUFluidSimulation_OutRTDivergence"));
-	AddCopyTexturePass(GraphBuilder, StageIntrinsics->SH_RT_Divergence, GameRTDivergence, FRHICopyTextureInfo() );
-	
-	StageIntrinsics.Reset();
-	GraphBuilder.Execute();
+const FFluidSimDiagnostics& UFluidSimulation::GetDiagnostics()
+{
+	ConsumeFeedback();
+	return Diagnostics;
+}
+
+float UFluidSimulation::GetGPUTimeMs()
+{
+	ConsumeFeedback();
+	return GPUTimeMs;
+}
+
+float UFluidSimulation::GetWorkloadScale()
+{
+	ConsumeFeedback();
+	return WorkloadScale;
+}
+
+FFluidSimGPUProfile UFluidSimulation::CaptureGPUProfile()
+{
+	FFluidSimGPUProfile Profile;
+	if (RenderProxy == nullptr)
+	{
+		return Profile;
+	}
+
+	ENQUEUE_RENDER_COMMAND(GPUFluidSimCaptureProfile)(
+		[Proxy=RenderProxy, &Profile](FRHICommandListImmediate& RHICmdList)
+		{
+			Profile = Proxy->CaptureGPUProfile(RHICmdList);
+		});
+	FlushRenderingCommands();
+	return Profile;
+}
+
+void UFluidSimulation::ConsumeFeedback()
+{
+	if (RenderProxy != nullptr)
+	{
+		if (const FFluidSimProxyFeedback* Feedback = RenderProxy->GetFeedbackMailbox().Consume())
+		{
+			Diagnostics = Feedback->Diagnostics;
+			GPUTimeMs = Feedback->GPUTimeMs;
+			WorkloadScale = Feedback->WorkloadScale;
+		}
+	}
 }
 
 void UFluidSimulation::SourceSim(FFluidSimSourceData SourceData)
@@ -223,306 +426,160 @@ void UFluidSimulation::SourceSim(FFluidSimSourceData SourceData)
 void UFluidSimulation::AddSimInjection(FFluidSimSourceShaderData InjectEvent)
 {
 	InjectionEventsPerFrame.Emplace(InjectEvent);
+
+	// Nothing ticks the solver on the render thread clock, the frame's events go to the proxy together at its end.
+	if (Settings.Clock == EFluidSimClock::RenderThread)
+	{
+		QueuePublish();
+	}
 }
 
-void UFluidSimulation::Stop()
+void UFluidSimulation::QueuePublish()
 {
-	ReadyToRender = false;
-
-	if (IsInRenderingThread()) {
-		StopRenderThread(GetImmediateCommandList_ForRenderCommand() );
-	}
-	else
+	if (!QueuedPublishHandle.IsValid())
 	{
-		ENQUEUE_RENDER_COMMAND(GPUFluidSimCommandStop)(
-			[this](FRHICommandListImmediate& RHICmdList)
-			{
-				UFluidSimulation::StopRenderThread(RHICmdList);
-			});
+		QueuedPublishHandle = FCoreDelegates::OnEndFrame.AddUObject(this, &UFluidSimulation::PublishQueued);
 	}
 }
 
-void UFluidSimulation::Dissipate(const TSharedPtr<FComputeStageIntrinsics>& Stage, const FRDGTextureRef& DissipationTexture, const float& Strength)
+void UFluidSimulation::PublishQueued()
 {
-	if (Stage->Settings.Debug < EFluidStageDebug::Dissipate) { return; }
-	
-	// Instantiate shader.
-	FObjectGPUDissipationShader::FPermutationDomain PermutationVector;
-	TShaderMapRef<FObjectGPUDissipationShader> ComputeShader(GetGlobalShaderMap(GMaxRHIFeatureLevel), PermutationVector);
+	CancelQueuedPublish();
+	PublishToProxy(0);
+}
 
-	if (!ComputeShader.IsValid())
+void UFluidSimulation::CancelQueuedPublish()
+{
+	if (QueuedPublishHandle.IsValid())
 	{
-		UE_LOG(LogFluidSim, Warning, TEXT("Dissipate failed for '%s'"), DissipationTexture->Name);
-		return;
+		FCoreDelegates::OnEndFrame.Remove(QueuedPublishHandle);
+		QueuedPublishHandle.Reset();
 	}
-
-	FObjectGPUDissipationShader::FParameters* PassParameters = Stage->GraphBuilder.AllocParameters<FObjectGPUDissipationShader::FParameters>();
-
-	// Shader parameters.
-	PassParameters->RT_DissipationField = Stage->GraphBuilder.CreateUAV(DissipationTexture);
-	PassParameters->DissipationGain = Strength;
-
-	// Construct compute pass.
-	Stage->GraphBuilder.AddPass(
-		RDG_EVENT_NAME("ExecuteGPUObjectFluidSimDissipation"),
-		PassParameters,
-		ERDGPassFlags::AsyncCompute,
-		[Params=PassParameters, CS=ComputeShader, Group=Stage->GPUGroupCount](FRHIComputeCommandList& CmdList)
-		{
-			FComputeShaderUtils::Dispatch(CmdList, CS, *Params, Group);
-		}
-	);
-	
 }
 
-void UFluidSimulation::Diffusion(const TSharedPtr<FComputeStageIntrinsics>& Stage, const FRDGTextureRef& DiffusionTexture)
+void UFluidSimulation::SetResolution(const FIntVector& NewResolution)
 {
-	if (Stage->Settings.Debug < EFluidStageDebug::Diffuse) { return; }
-	
-	FObjectGPUDiffusionShader::FPermutationDomain PermutationVector;
-	TShaderMapRef<FObjectGPUDiffusionShader> ComputeShader(GetGlobalShaderMap(GMaxRHIFeatureLevel), PermutationVector);
-
-	if (!ComputeShader.IsValid())
+	if (NewResolution == GridDescription.GridResolution || NewResolution.X <= 0 || NewResolution.Y <= 0 || NewResolution.Z <= 0)
 	{
-		UE_LOG(LogFluidSim, Warning, TEXT("Diffusion failed for '%s'"), DiffusionTexture->Name);
 		return;
 	}
 
-	// Shader parameters.
-	FObjectGPUDiffusionShader::FParameters* PassParameters = Stage->GraphBuilder.AllocParameters<FObjectGPUDiffusionShader::FParameters>();
-	PassParameters->RT_DiffusionField = Stage->GraphBuilder.CreateUAV(DiffusionTexture);
-	PassParameters->DiffusionGain = 1.0f - Stage->Settings.DiffusionStrength;
-
-	// Construct compute pass.
-	Stage->GraphBuilder.AddPass(
-		RDG_EVENT_NAME("ExecuteGPUObjectFluidSimDiffusion"),
-		PassParameters,
-		ERDGPassFlags::AsyncCompute,
-		[Params=PassParameters, CS=ComputeShader, Group=Stage->GPUGroupCount](FRHIComputeCommandList& CmdList)
-		{
-			FComputeShaderUtils::Dispatch(CmdList, CS, *Params, Group);
-		}
-	);
-	
+	// The proxy resamples its state when it sees the new resolution, nothing is lost. Obstacle bricks not sent yet
+	// are in voxels of the old resolution, the proxy clears its obstacles and they're voxelized again.
+	GridDescription = GridDescription.WithResolution(NewResolution);
+	PendingObstacleBricks.Reset();
+	if (RenderProxy != nullptr)
+	{
+		RenderProxy->GetMailbox().GetWriteSlot().ObstacleBricks.Reset();
+	}
+	PublishToProxy(0);
 }
 
-void UFluidSimulation::Divergence(const TSharedPtr<FComputeStageIntrinsics>& Stage)
+void UFluidSimulation::SetColliders(TArray<FFluidSimColliderShaderData>&& InColliders)
 {
-	if (Stage->Settings.Debug < EFluidStageDebug::Divergence) { return; }
-	
-	FObjectGPUDivergenceShader::FPermutationDomain PermutationVector;
-	TShaderMapRef<FObjectGPUDivergenceShader> ComputeShader(GetGlobalShaderMap(GMaxRHIFeatureLevel), PermutationVector);
-
-	if (!ComputeShader.IsValid())
+	// Nothing to tell the proxy if there were none before either.
+	if (InColliders.IsEmpty() && Colliders.IsEmpty())
 	{
-		UE_LOG(LogFluidSim, Warning, TEXT("Divergence failed."));
 		return;
 	}
 
-	// Shader parameters.
-	FObjectGPUDivergenceShader::FParameters* PassParameters = Stage->GraphBuilder.AllocParameters<FObjectGPUDivergenceShader::FParameters>();
-	PassParameters->RT_Divergence = Stage->GraphBuilder.CreateUAV(Stage->SH_RT_Divergence);
-	PassParameters->RT_Divergence_Vel = Stage->GraphBuilder.CreateSRV(Stage->SH_RT_Velocity);
-	
-	// Construct compute pass.
-	Stage->GraphBuilder.AddPass(
-		RDG_EVENT_NAME("ExecuteGPUObjectFluidSimDivergence"),
-		PassParameters,
-		ERDGPassFlags::AsyncCompute,
-		[Params=PassParameters, CS=ComputeShader, Group=Stage->GPUGroupCount](FRHIComputeCommandList& CmdList)
-		{
-			FComputeShaderUtils::Dispatch(CmdList, CS, *Params, Group);
-		}
-	);
+	Colliders = MoveTemp(InColliders);
+	bCollidersChanged = true;
+	if (Settings.Clock == EFluidSimClock::RenderThread)
+	{
+		QueuePublish();
+	}
 }
 
-void UFluidSimulation::ProjectPressure(const TSharedPtr<FComputeStageIntrinsics>& Stage)
+void UFluidSimulation::AddObstacleBricks(TArray<FFluidSimObstacleBrick>&& Bricks)
 {
-	if (Stage->Settings.Debug < EFluidStageDebug::Pressure) { return; }
-	
-	FObjectGPUProjectPressureShader::FPermutationDomain PermutationVector;
-	TShaderMapRef<FObjectGPUProjectPressureShader> ComputeShader(GetGlobalShaderMap(GMaxRHIFeatureLevel), PermutationVector);
-
-	if (!ComputeShader.IsValid())
+	if (Bricks.IsEmpty())
 	{
-		UE_LOG(LogFluidSim, Warning, TEXT("Project pressure failed."));
 		return;
 	}
 
-	// Shader parameters.
-	FObjectGPUProjectPressureShader::FParameters* PassParameters = Stage->GraphBuilder.AllocParameters<FObjectGPUProjectPressureShader::FParameters>();
-	PassParameters->RT_ProjPressure_Divergence = Stage->GraphBuilder.CreateSRV(Stage->SH_RT_Divergence);
-	PassParameters->RT_ProjPressure_Pressure = Stage->GraphBuilder.CreateUAV(Stage->SH_RT_Pressure);
-	
-	// Construct compute pass.
-	Stage->GraphBuilder.AddPass(
-		RDG_EVENT_NAME("ExecuteGPUObjectFluidSimProjectPressure"),
-		PassParameters,
-		ERDGPassFlags::AsyncCompute,
-		[Params=PassParameters, CS=ComputeShader, Group=Stage->GPUGroupCount](FRHIComputeCommandList& CmdList)
-		{
-			FComputeShaderUtils::Dispatch(CmdList, CS, *Params, Group);
-		}
-	);
-}
-
-void UFluidSimulation::ProjectGradient(const TSharedPtr<FComputeStageIntrinsics>& Stage)
-{
-	if (Stage->Settings.Debug < EFluidStageDebug::Project) { return; }
-	
-	FObjectGPUProjectGradientShader::FPermutationDomain PermutationVector;
-    TShaderMapRef<FObjectGPUProjectGradientShader> ComputeShader(GetGlobalShaderMap(GMaxRHIFeatureLevel), PermutationVector);
-
-    if (!ComputeShader.IsValid())
-    {
-    	UE_LOG(LogFluidSim, Warning, TEXT("Project gradient failed."));
-    	return;
-    }
-
-    // Shader parameters.
-    FObjectGPUProjectGradientShader::FParameters* PassParameters = Stage->GraphBuilder.AllocParameters<FObjectGPUProjectGradientShader::FParameters>();
-    PassParameters->RT_ProjGradient_Pressure = Stage->GraphBuilder.CreateSRV(Stage->SH_RT_Pressure);
-    PassParameters->RT_ProjGradient_Velocity = Stage->GraphBuilder.CreateUAV(Stage->SH_RT_Velocity);
-    
-    // Construct compute pass.
-    Stage->GraphBuilder.AddPass(
-    	RDG_EVENT_NAME("ExecuteGPUObjectFluidSimProjectGradient"),
-    	PassParameters,
-    	ERDGPassFlags::AsyncCompute,
-    	[Params=PassParameters, CS=ComputeShader, Group=Stage->GPUGroupCount](FRHIComputeCommandList& CmdList)
-    	{
-    		FComputeShaderUtils::Dispatch(CmdList, CS, *Params, Group);
-    	}
-    	);
-}
-
-void UFluidSimulation::Advect(const TSharedPtr<FComputeStageIntrinsics>& Stage)
-{
-	if (Stage->Settings.Debug < EFluidStageDebug::Advect) { return; }
-	
-	// Instantiate shader.
-	FObjectGPUAdvectionShader::FPermutationDomain PermutationVector;
-	TShaderMapRef<FObjectGPUAdvectionShader> ComputeShader(GetGlobalShaderMap(GMaxRHIFeatureLevel), PermutationVector);
+	PendingObstacleBricks.Append(MoveTemp(Bricks));
 
-	if (!ComputeShader.IsValid())
+	// Same as events, nothing else publishes on the render thread clock.
+	if (Settings.Clock == EFluidSimClock::RenderThread)
 	{
-		UE_LOG(LogFluidSim, Warning, TEXT("Advection failed."));
-		return;
+		QueuePublish();
 	}
-	
-	// Shader parameters.
-	FObjectGPUAdvectionShader::FParameters* PassParameters = Stage->GraphBuilder.AllocParameters<FObjectGPUAdvectionShader::FParameters>();
-	PassParameters->RT_Field_Read = Stage->GraphBuilder.CreateSRV(Stage->SH_RT_Density );
-	PassParameters->RT_Field_Write = Stage->GraphBuilder.CreateUAV(Stage->SH_RT_Density);
-	PassParameters->RT_Velocity = Stage->GraphBuilder.CreateSRV(Stage->SH_RT_Velocity );
-	PassParameters->RT_Vel_Write = Stage->GraphBuilder.CreateUAV(Stage->SH_RT_Velocity);
-	PassParameters->FieldSize = Stage->SH_RT_Velocity->Desc.GetSize();
-	
-	// Create the sampler
-	FSamplerStateInitializerRHI SamplerStateInitializer
-	(
-		SF_Trilinear, // Filter mode: Trilinear
-		AM_Clamp, // Addressing mode: Clamp
-		AM_Clamp,
-		AM_Clamp
-	);
-	const FSamplerStateRHIRef TriLinearSampler =  RHICreateSamplerState(SamplerStateInitializer);
-	PassParameters->SamplerTrilinear = TriLinearSampler;
-	
-	// Construct compute pass.
-	Stage->GraphBuilder.AddPass(
-		RDG_EVENT_NAME("ExecuteGPUObjectFluidSimAdvection"),
-		PassParameters,
-		ERDGPassFlags::AsyncCompute,
-		[Params=PassParameters, CS=ComputeShader, Group=Stage->GPUGroupCount](FRHIComputeCommandList& CmdList)
-		{
-			FComputeShaderUtils::Dispatch(CmdList, CS, *Params, Group);
-		}
-	);
 }
 
-void UFluidSimulation::InjectSources(const TSharedPtr<FComputeStageIntrinsics>& Stage, const FObjectGPUDispatchParams& Params)
+void UFluidSimulation::SetDomainCentre(const FIntVector& CentreVoxel)
 {
-	if (Stage->Settings.Debug < EFluidStageDebug::Inject) { return; }
-	
-	// Instantiate shader.
-	FObjectGPUInjectionShader::FPermutationDomain PermutationVector;
-	TShaderMapRef<FObjectGPUInjectionShader> ComputeShader(GetGlobalShaderMap(GMaxRHIFeatureLevel), PermutationVector);
-
-	if (!ComputeShader.IsValid()) return; // Add some warning/error text here later on.
-
-	// Shader parameters.
-	FObjectGPUInjectionShader::FParameters* PassParameters = Stage->GraphBuilder.AllocParameters<FObjectGPUInjectionShader::FParameters>();
-
-	// Assign common textures. 
-	PassParameters->RT_Velocity = Stage->GraphBuilder.CreateUAV(Stage->SH_RT_Velocity);
-	PassParameters->RT_Pressure = Stage->GraphBuilder.CreateUAV(Stage->SH_RT_Pressure);
-	PassParameters->RT_Density = Stage->GraphBuilder.CreateUAV(Stage->SH_RT_Density);
-	PassParameters->FieldResolution = Stage->SH_RT_Velocity->Desc.GetSize();
-
-	// Create Input events buffer.
-	FRDGBufferRef InputBuffer = CreateStructuredBuffer(
-		Stage->GraphBuilder,
-		TEXT("FluidSimSourcingBuffer"),
-		sizeof(FFluidSimSourceData),
-		Params.InjectionEvents.Num(),
-		Params.InjectionEvents.GetData(),
-		Params.InjectionEvents.Num() * sizeof(FFluidSimSourceData));
-
-	PassParameters->InjectionEventBuffer = Stage->GraphBuilder.CreateSRV(InputBuffer);
-	PassParameters->BufferLength = Params.InjectionEvents.Num();
-
-	// Construct render pass.
-	Stage->GraphBuilder.AddPass(
-		RDG_EVENT_NAME("ExecuteGPUObjectFluidSimInjection"),
-		PassParameters,
-		ERDGPassFlags::AsyncCompute,
-		[Params=PassParameters, CS=ComputeShader, Group=Stage->GPUGroupCount](FRHIComputeCommandList& CmdList)
-		{
-			FComputeShaderUtils::Dispatch(CmdList, CS, *Params, Group);
-		}
-	);
+	// The proxy works out how far each cascade level has to scroll.
+	DomainCentre = CentreVoxel;
+	PublishToProxy(0);
 }
 
-void UFluidSimulation::StopRenderThread(FRHICommandListImmediate& RHICmdList)
+FFluidSimCascadeTextures UFluidSimulation::GetCascadeTextures(const int32 Level) const
 {
-	ReleaseRHITextureResource(RT_Divergence);
-	ReleaseRHITextureResource(RT_Pressure);
-	ReleaseRHITextureResource(RT_Density);
-	ReleaseRHITextureResource(RT_Velocity);
+	if (Level == 0)
+	{
+		FFluidSimCascadeTextures Textures;
+		Textures.Velocity = RT_Velocity_Vol;
+		Textures.Density = RT_Density_Vol;
+		Textures.Pressure = RT_Pressure_Vol;
+		return Textures;
+	}
 
-	ReadyToRender = false; 
+	return CascadeTextures.IsValidIndex(Level - 1) ? CascadeTextures[Level - 1] : FFluidSimCascadeTextures();
 }
 
-void UFluidSimulation::CreateRHITextureResource(FTextureRHIRef& TexReference, const TCHAR* TexName, const EPixelFormat& TexType, const FLinearColor& ClearColour)
+void UFluidSimulation::CreateCascadeTextures()
 {
-	const FRHITextureCreateDesc CDesc = FRHITextureCreateDesc::Create3D(
-		TexName, 
-		GridDescription.GridResolution.X,
-		GridDescription.GridResolution.Y,
-		GridDescription.GridResolution.Z,
-		TexType)
-		.SetFlags(ETextureCreateFlags::External | ETextureCreateFlags::UAV | ETextureCreateFlags::RenderTargetable | ETextureCreateFlags::ShaderResource )
-		.SetInitialState(ERHIAccess::UAVCompute)
-		.SetExtent(GridDescription.GridResolution.X, GridDescription.GridResolution.Y)
-		.SetDepth(GridDescription.GridResolution.Z)
-		.SetClearValue(FClearValueBinding(ClearColour ) );
-	
-	TexReference = RHICreateTexture(CDesc);
+	// Sized like the level 0 outputs, a simulation running below that resolution is resampled into them.
+	// Same format as the simulation state.
+	const FIntVector Res = FIntVector(RT_Velocity_Vol->SizeX, RT_Velocity_Vol->SizeY, RT_Velocity_Vol->SizeZ);
+	auto CreateVolume = [this, &Res]()
+	{
+		UTextureRenderTargetVolume* Volume = NewObject<UTextureRenderTargetVolume>(this);
+		Volume->bCanCreateUAV = true;
+		Volume->Init(Res.X, Res.Y, Res.Z, EPixelFormat::PF_FloatRGBA);
+		Volume->UpdateResourceImmediate(true);
+		return Volume;
+	};
+
+	CascadeTextures.Reset();
+	for (int32 Level = 1; Level < GridDescription.CascadeLevels; Level++)
+	{
+		FFluidSimCascadeTextures& Textures = CascadeTextures.AddDefaulted_GetRef();
+		Textures.Velocity = CreateVolume();
+		Textures.Density = CreateVolume();
+		Textures.Pressure = CreateVolume();
+	}
 }
 
-void UFluidSimulation::ReleaseRHITextureResource(FTextureRHIRef Texture)
+void UFluidSimulation::Stop()
 {
-	if (Texture != nullptr) { Texture = nullptr;	}
+	StopRecording();
+	CancelQueuedPublish();
+
+	if (RenderProxy == nullptr)
+	{
+		return;
+	}
+
+	// Released once the render thread gets to it, nothing here waits on the GPU.
+	ENQUEUE_RENDER_COMMAND(GPUFluidSimCommandStop)(
+		[Proxy=RenderProxy, Extension=ViewExtension](FRHICommandListImmediate& RHICmdList)
+		{
+			if (Extension.IsValid())
+			{
+				Extension->RemoveProxy(Proxy);
+			}
+			delete Proxy;
+		});
+
+	RenderProxy = nullptr;
+	ViewExtension.Reset();
 }
 
 void UFluidSimulation::ResetInjectionEvents()
 {
 	InjectionEventsPerFrame.Empty(false);
-
-	FFluidSimSourceShaderData EmptyEvent = FFluidSimSourceShaderData();
-	EmptyEvent.InjectionType = static_cast<int32>(EFluidInjectionType::NONE);
-	InjectionEventsPerFrame.Add(EmptyEvent);
 }
 
 void UFluidSimulation::BeginDestroy()
@@ -4,6 +4,9 @@
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
 #include "FluidStructs.h"
+#include "FluidSimEventStream.h"
+#include "FluidSimObstacles.h"
+#include "FluidSimStageTimer.h"
 
 #include "FluidSimulation.generated.h"
 
@@ -15,49 +18,97 @@ class UFluidSimulation : public UActorComponent
 
 public: // Simulation CPU
 	bool Setup(const FGridDescription& Desc, const FContentBrowserTextures& CBTexts);
+
+	// What the next Setup() starts from instead of an empty domain, see FFluidSimInitialState. All optional.
+	void SetInitialState(const TSharedPtr<const struct FFluidSimCheckpoint>& Checkpoint, class UVolumeTexture* Velocity, class UVolumeTexture* Density);
 	void Stop();
 
 	// Simulation Actions
 	void SimulationStep(const FFluidSolverSettings& InSettings);
+	void UpdateSettings(const FFluidSolverSettings& InSettings);
 	void SourceSim(FFluidSimSourceData SourceData);
+
+	// Carries the fields over to a new resolution covering the same extent, the voxel size follows.
+	void SetResolution(const FIntVector& NewResolution);
+
+	// Centres the domain on a world voxel of the finest level, the fields stay where they are in the world.
+	void SetDomainCentre(const FIntVector& CentreVoxel);
 	FGridDescription GetGridDescription() const { return GridDescription; }
 
+	// Latest diagnostics read back from the GPU, a few frames old. Only measured with FFluidSolverSettings::bDiagnostics.
+	const FFluidSimDiagnostics& GetDiagnostics();
+
+	// GPU time of the simulation's own passes per frame, smoothed, and the workload the GPU budget scaled them to.
+	// Measured without diagnostics too, 0 until the first frame was timed.
+	float GetGPUTimeMs();
+	float GetWorkloadScale();
+
+	// Stage times since the last call, see r.FluidSim.StageTimings, and the level textures' memory. Waits for the
+	// render thread and the GPU, for tests and tools.
+	FFluidSimGPUProfile CaptureGPUProfile();
+
+	// Input recording, every published frame's settings and events. Game thread clock only, the render thread clock
+	// steps on its own and would record publishes rather than steps.
+	bool StartRecording(const FString& Path);
+	void StopRecording();
+	bool IsRecording() const { return Recorder.IsOpen(); }
+
+	// Steps with a recorded frame instead of the live sources, which are dropped.
+	void ReplayFrame(const FFluidSolverSettings& InSettings, const FFluidSimStreamFrame& Frame);
+
+	// Hands over the events gathered since the last step without stepping, for lockstep where the step's events are
+	// decided by the server.
+	void TakeInjectionEvents(TArray<FFluidSimSourceShaderData>& OutEvents);
+
+	// Obstacle bricks voxelized by FFluidSimObstacles, sent with the next publish. Dropped if the resolution changes
+	// before then, they no longer fit.
+	void AddObstacleBricks(TArray<FFluidSimObstacleBrick>&& Bricks);
+
+	// Replaces the moving colliders, sent with the next publish and kept by the proxy until replaced. Positions are in
+	// voxels of the finest level relative to the domain centre set at the same time.
+	void SetColliders(TArray<FFluidSimColliderShaderData>&& InColliders);
+
+	// Writes velocity, density and pressure of every level to Path once the GPU readback lands, encoded off the game
+	// and render threads.
+	bool SaveCheckpoint(const FString& Path);
+
+	// Reads and decodes Path in the background, then uploads it into the running simulation. It has to match the
+	// cascade levels the checkpoint was saved at, a different resolution is resampled.
+	bool LoadCheckpoint(const FString& Path);
+	void RestoreCheckpoint(const TSharedRef<const struct FFluidSimCheckpoint>& Checkpoint);
+
+	// Bakes the level 0 velocity and density outputs of every frame that steps to Path, see FluidSimSequence.h.
+	// Both output fields have to be enabled.
+	bool StartBake(const FString& Path);
+	void StopBake();
+
+	// Level 0 is the content browser textures, coarser levels are created by the simulation.
+	FFluidSimCascadeTextures GetCascadeTextures(const int32 Level) const;
+
 	// UObject Overrides
 	virtual void BeginDestroy() override;
 	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 	// End UObject Overrides
 
 private: // Simulation
-	void SetupRenderThread(FRHICommandListImmediate& RHICmdList);
-	void StopRenderThread(FRHICommandListImmediate& RHICmdList);
-	void DispatchRenderThread(FRHICommandListImmediate& RHICmdList, const FObjectGPUDispatchParams& Params);
-
 	void AddSimInjection(FFluidSimSourceShaderData InjectEvent);
-	
-	// Simulation Stages
-	void Dissipate(const TSharedPtr<FComputeStageIntrinsics>& Stage, const FRDGTextureRef& DissipationTexture, const float& Strength);
-	void Diffusion(const TSharedPtr<FComputeStageIntrinsics>& Stage, const FRDGTextureRef& DiffusionTexture);
-	void Divergence(const TSharedPtr<FComputeStageIntrinsics>& Stage);
-	void ProjectPressure(const TSharedPtr<FComputeStageIntrinsics>& Stage);
-	void ProjectGradient(const TSharedPtr<FComputeStageIntrinsics>& Stage);
-	void Advect(const TSharedPtr<FComputeStageIntrinsics>& Stage);
-	void InjectSources(const TSharedPtr<FComputeStageIntrinsics>& Stage, const FObjectGPUDispatchParams& Params);
-
-private: // Helpers GPU
-	void CreateRHITextureResource(FTextureRHIRef& TexReference,
-	                              const TCHAR* TexName,
-	                              const EPixelFormat& TexType,
-	                              const FLinearColor& ClearColour = FLinearColor::Black);
-
-	void ReleaseRHITextureResource(FTextureRHIRef Texture);
-
 	void ResetInjectionEvents();
+	void PublishToProxy(const int32 StepCount);
 
-private: // GPU Thread Variables/Textures
-	FTextureRHIRef RT_Density = nullptr;
-	FTextureRHIRef RT_Velocity = nullptr;
-	FTextureRHIRef RT_Divergence = nullptr;
-	FTextureRHIRef RT_Pressure = nullptr;
+	// Render thread clock only, publishes once at the end of the frame however many events and colliders came in.
+	void QueuePublish();
+	void PublishQueued();
+	void CancelQueuedPublish();
+	void CreateCascadeTextures();
+	void ConsumeFeedback();
+
+private: // GPU Thread
+	// Owned by the render thread once created, released there through Stop().
+	class FFluidSimRenderProxy* RenderProxy = nullptr;
+
+	TSharedPtr<class FFluidSimViewExtension, ESPMode::ThreadSafe> ViewExtension;
+
+	FFluidSimStreamWriter Recorder;
 
 public: // CPU Thread
 	// Explosions require multipliers for a realistic shape.
@@ -73,14 +124,21 @@ public: // CPU Thread
 	
 private: // CPU Thread
 	UPROPERTY()
-	bool ReadyToRender = false;
+	FGridDescription GridDescription;
 
 	UPROPERTY()
-	FGridDescription GridDescription;
+	FFluidSolverSettings Settings;
 
+	// World voxel of the finest level at the domain centre.
 	UPROPERTY()
-	FIntVector GroupCount;
-	
+	FIntVector DomainCentre = FIntVector::ZeroValue;
+
+	UPROPERTY(Transient)
+	FFluidSimDiagnostics Diagnostics;
+
+	float GPUTimeMs = 0.0f;
+	float WorkloadScale = 1.0f;
+
 	// Textures to copy to content browser.
 	UPROPERTY()
 	class UTextureRenderTargetVolume* RT_Velocity_Vol = nullptr;
@@ -94,7 +152,25 @@ private: // CPU Thread
 	UPROPERTY()
 	class UTextureRenderTargetVolume* RT_Divergence_Vol = nullptr;
 
+	UPROPERTY()
+	class UVolumeTexture* InitialVelocity = nullptr;
+
+	UPROPERTY()
+	class UVolumeTexture* InitialDensity = nullptr;
+
+	TSharedPtr<const struct FFluidSimCheckpoint> InitialCheckpoint;
+
+	// Outputs of cascade levels 1 and up.
+	UPROPERTY(Transient)
+	TArray<FFluidSimCascadeTextures> CascadeTextures;
+
 	UPROPERTY()
 	TArray<FFluidSimSourceShaderData> InjectionEventsPerFrame;
+
+	TArray<FFluidSimObstacleBrick> PendingObstacleBricks;
+	TArray<FFluidSimColliderShaderData> Colliders;
+	bool bCollidersChanged = false;
+
+	FDelegateHandle QueuedPublishHandle;
 };
 
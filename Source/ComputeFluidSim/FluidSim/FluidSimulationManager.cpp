@@ -4,10 +4,24 @@
 #include "Engine/LocalPlayer.h"
 #include "Engine/World.h"
 #include "GameFramework/Actor.h"
+#include "GameFramework/PlayerController.h"
+#include "GameFramework/Pawn.h"
 #include "UObject/ConstructorHelpers.h"
+#include "FluidSimCheckpoint.h"
+#include "FluidSimColliderComponent.h"
+#include "FluidSimGPUBudget.h"
+#include "FluidSimLockstep.h"
+#include "FluidSimLockstepComponent.h"
+#include "FluidSimLog.h"
+#include "FluidSimObstacles.h"
+#include "FluidSimReplay.h"
+#include "FluidSimScalability.h"
+#include "FluidSimSequencePlayer.h"
 #include "FluidSimSubsystem.h"
 #include "FluidSimulation.h"
 #include "Materials/MaterialInstanceDynamic.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
 
 // Sets default values
 AFluidSimulationManager::AFluidSimulationManager()
@@ -38,14 +52,79 @@ void AFluidSimulationManager::BeginPlay()
 		FluidSimSubSystem->RegisterSimManager(this);
 	}
 
+	DomainCentreVoxel = GetWorldVoxel(GetActorLocation());
+
+	// Playback only touches the outputs, the solver is never set up.
+	if (BakeMode == EFluidSimBakeMode::Playback)
+	{
+		TSharedPtr<FFluidSimSequencePlayer> NewPlayer = MakeShared<FFluidSimSequencePlayer>();
+		NewPlayer->bLoop = bLoopPlayback;
+		NewPlayer->PlaybackRate = PlaybackRate;
+		if (NewPlayer->Open(GetBakePath(), RT_Velocity_Vol, RT_Density_Vol))
+		{
+			SequencePlayer = NewPlayer;
+		}
+		SetActorTickEnabled(true);
+		return;
+	}
+
+	// Everything the CPU reference doesn't model is off, its state is what every peer agrees on.
+	if (bLockstep)
+	{
+		CascadeLevels = 1;
+		bScrollingDomain = false;
+		bDynamicResolution = false;
+		SolverSettings.Clock = EFluidSimClock::GameThread;
+		SolverSettings.PressureSolve = EFluidPressureSolve::Fixed;
+		SolverSettings.bSparse = false;
+		bObstacles = false;
+		bMovingColliders = false;
+	}
+
+	if (bDynamicResolution && FluidSimScalability::ApplyToSettings(SolverSettings).GPUBudgetMs <= 0.0f)
+	{
+		UE_LOG(LogFluidSim, Warning, TEXT("'%s' has dynamic resolution on without a GPU budget, it keeps its resolution."), *GetName());
+	}
+
 	// Setup Solver
 	if (IsValid(Solver))
 	{
-		FGridDescription Desc = FGridDescription(VoxelSize, GridResolution);
+		FGridDescription Desc = FGridDescription(VoxelSize, GridResolution, CascadeLevels).WithResolution(GetSimResolution());
 		FContentBrowserTextures Textures = FContentBrowserTextures(RT_Velocity_Vol, RT_Density_Vol, RT_Pressure_Vol, RT_Divergence_Vol);
+		if (!bLockstep)
+		{
+			Solver->SetInitialState(LoadInitialCheckpoint(), InitialVelocity, InitialDensity);
+		}
+		else if (!InitialCheckpoint.FilePath.IsEmpty() || InitialVelocity != nullptr || InitialDensity != nullptr)
+		{
+			UE_LOG(LogFluidSim, Warning, TEXT("'%s' ignores its initial state, lockstep simulations start empty."), *GetName());
+		}
 		SolverCPUReady = Solver->Setup(Desc, Textures);
+		Solver->SetDomainCentre(DomainCentreVoxel);
+		Solver->UpdateSettings(SolverSettings);
+
+		if (SolverCPUReady && BakeMode == EFluidSimBakeMode::Bake)
+		{
+			Solver->StartBake(GetBakePath());
+		}
+
+		if (SolverCPUReady && bLockstep)
+		{
+			Lockstep = MakeShared<FFluidSimLockstep>(GridResolution, FluidSimReplay::ToCoreSettings(SolverSettings), LockstepHashInterval);
+		}
+
+		if (SolverCPUReady && bObstacles)
+		{
+			Obstacles = MakeShared<FFluidSimObstacles>(ObstacleChannel);
+		}
+	}
+
+	// The render thread steps the simulation itself, only tick for debug drawing, scrolling, resolution changes, obstacles
+	// and colliders.
+	if (SolverSettings.Clock == EFluidSimClock::RenderThread)
+	{
+		SetActorTickEnabled(bDrawBounds || bDrawVoxel || bScrollingDomain || bDynamicResolution || bObstacles || bMovingColliders);
 	}
-	
 }
 
 // Called every frame
@@ -53,25 +132,69 @@ void AFluidSimulationManager::Tick(float DeltaTime)
 {
 	Super::Tick(DeltaTime);
 
+	if (SequencePlayer.IsValid())
+	{
+		SequencePlayer->bLoop = bLoopPlayback;
+		SequencePlayer->PlaybackRate = PlaybackRate;
+		SequencePlayer->Tick(DeltaTime);
+		return;
+	}
+
+	if (bScrollingDomain)
+	{
+		UpdateScrollingDomain();
+	}
+
+	if (bDynamicResolution)
+	{
+		UpdateDynamicResolution(DeltaTime);
+	}
+
+	// After the domain and resolution settled, before the step.
+	if (Obstacles.IsValid())
+	{
+		UpdateObstacles();
+	}
+
+	if (bMovingColliders)
+	{
+		UpdateColliders(DeltaTime);
+	}
+
 	const UWorld* World = GetWorld();
 	if ((bDrawBounds || bDrawVoxel) && World != nullptr)
 	{
+		const FVector DomainCentre = GetSimDomainCentre();
 		const FVector GridSize = FVector(GridResolution.X, GridResolution.Y, GridResolution.Z) * 50.0f;
 		if (bDrawBounds)
 		{
-			DrawDebugBox(World, GetActorLocation(), GridSize, FColor::Red);
+			for (int32 Level = 0; Level < CascadeLevels; Level++)
+			{
+				DrawDebugBox(World, GetCascadeCentre(Level), GridSize * VoxelSize * static_cast<float>(1 << Level), Level == 0 ? FColor::Red : FColor::Orange);
+			}
 		}
 		if (bDrawVoxel)
 		{
 			const FVector Voxel = FVector(VoxelSize, VoxelSize, VoxelSize) * 50.0f; 
-			const FVector Corner = GetActorLocation() - GridSize + (Voxel);
+			const FVector Corner = DomainCentre - GridSize + (Voxel);
 			DrawDebugBox(World, Corner, Voxel, FColor::Cyan);
 		}
 	}
 	
-	if (IsValid(Solver) && SolverCPUReady)
+	if (IsValid(Solver) && SolverCPUReady && SolverSettings.Clock == EFluidSimClock::GameThread)
 	{
-		Solver->SimulationStep(SolverSettings);
+		if (Replay.IsValid())
+		{
+			UpdateReplay(DeltaTime);
+		}
+		else if (Lockstep.IsValid())
+		{
+			UpdateLockstep(DeltaTime);
+		}
+		else
+		{
+			Solver->SimulationStep(SolverSettings);
+		}
 	}
 }
 
@@ -91,6 +214,23 @@ void AFluidSimulationManager::PostEditChangeProperty(FPropertyChangedEvent& Prop
 	{
 		UpdateDebug();
 	}
+
+	// Live resolution changes resample the running simulation.
+	if (PropertyName == GET_MEMBER_NAME_CHECKED(AFluidSimulationManager, ResolutionScale) ||
+		MemberPropertyName == GET_MEMBER_NAME_CHECKED(AFluidSimulationManager, GridResolution))
+	{
+		SetResolutionScale(ResolutionScale);
+	}
+
+	// Live edits while playing, the render thread clock has no tick to pick them up.
+	if (MemberPropertyName == GET_MEMBER_NAME_CHECKED(AFluidSimulationManager, SolverSettings) ||
+		PropertyName == GET_MEMBER_NAME_CHECKED(AFluidSimulationManager, SimStageDebug))
+	{
+		if (IsValid(Solver) && SolverCPUReady)
+		{
+			Solver->UpdateSettings(SolverSettings);
+		}
+	}
 }
 
 void AFluidSimulationManager::PostLoad()
@@ -115,6 +255,499 @@ FGridDescription AFluidSimulationManager::GetSimGridDescription() const
 	return Solver->GetGridDescription();
 }
 
+FVector AFluidSimulationManager::GetSimDomainCentre() const
+{
+	if (!bScrollingDomain || !SolverCPUReady)
+	{
+		return GetActorLocation();
+	}
+
+	const float VoxelSizeUU = GetSimVoxelSize() * 100.0f; // VoxelSize in M.
+	return FVector(DomainCentreVoxel) * VoxelSizeUU;
+}
+
+void AFluidSimulationManager::SetResolutionScale(const float Scale)
+{
+	// Eighths keep the resolution a whole number for the usual power of two grids.
+	ResolutionScale = FMath::Clamp(FMath::RoundToFloat(Scale * 8.0f) / 8.0f, 0.25f, 1.0f);
+	if (!IsValid(Solver) || !SolverCPUReady)
+	{
+		return;
+	}
+
+	// The centre voxel changes size, place it again around the same point in the world.
+	const FVector DomainCentre = GetSimDomainCentre();
+	Solver->SetResolution(GetSimResolution());
+	DomainCentreVoxel = GetWorldVoxel(bScrollingDomain ? DomainCentre : GetActorLocation());
+	Solver->SetDomainCentre(DomainCentreVoxel);
+}
+
+void AFluidSimulationManager::ApplyScalability()
+{
+	if (!IsValid(Solver) || !SolverCPUReady)
+	{
+		return;
+	}
+
+	if (Solver->GetGridDescription().GridResolution != GetSimResolution())
+	{
+		SetResolutionScale(ResolutionScale);
+	}
+
+	// The overrides are applied on the way to the proxy, republish so the render thread clock sees them too.
+	Solver->UpdateSettings(SolverSettings);
+}
+
+FFluidSimDiagnostics AFluidSimulationManager::GetDiagnostics() const
+{
+	return IsValid(Solver) ? Solver->GetDiagnostics() : FFluidSimDiagnostics();
+}
+
+bool AFluidSimulationManager::SaveCheckpoint(const FString& Path)
+{
+	return IsValid(Solver) && SolverCPUReady && Solver->SaveCheckpoint(Path);
+}
+
+bool AFluidSimulationManager::LoadCheckpoint(const FString& Path)
+{
+	return IsValid(Solver) && SolverCPUReady && Solver->LoadCheckpoint(Path);
+}
+
+bool AFluidSimulationManager::StartRecording(const FString& Path)
+{
+	return IsValid(Solver) && SolverCPUReady && Solver->StartRecording(Path);
+}
+
+void AFluidSimulationManager::StopRecording()
+{
+	if (IsValid(Solver))
+	{
+		Solver->StopRecording();
+	}
+}
+
+bool AFluidSimulationManager::StartReplay(const FString& Path, const float FixedRate)
+{
+	if (!IsValid(Solver) || !SolverCPUReady || SolverSettings.Clock != EFluidSimClock::GameThread)
+	{
+		UE_LOG(LogFluidSim, Warning, TEXT("'%s' can't replay, it needs a running simulation on the game thread clock."), *GetName());
+		return false;
+	}
+
+	TSharedPtr<FFluidSimReplay> NewReplay = MakeShared<FFluidSimReplay>();
+	if (!NewReplay->Open(Path, FixedRate))
+	{
+		return false;
+	}
+
+	if (NewReplay->GetHeader().Resolution != Solver->GetGridDescription().GridResolution)
+	{
+		UE_LOG(LogFluidSim, Warning, TEXT("'%s' was recorded at %s, replaying at %s."), *Path,
+			*NewReplay->GetHeader().Resolution.ToString(), *Solver->GetGridDescription().GridResolution.ToString());
+	}
+
+	if (Replay.IsValid())
+	{
+		Replay->Finish();
+	}
+	Replay = NewReplay;
+	return true;
+}
+
+void AFluidSimulationManager::UpdateReplay(const float DeltaTime)
+{
+	// Diagnostics are the replay's per tick fingerprint of the fields.
+	FFluidSolverSettings ReplaySettings = SolverSettings;
+	ReplaySettings.bDiagnostics = true;
+
+	TArray<FFluidSimStreamFrame> Frames;
+	const bool bMore = Replay->Advance(DeltaTime, Frames);
+
+	int32 StepCount = 0;
+	for (const FFluidSimStreamFrame& Frame : Frames)
+	{
+		Solver->ReplayFrame(ReplaySettings, Frame);
+		StepCount += Frame.StepCount;
+	}
+	Replay->AddReportRow(StepCount, Solver->GetDiagnostics());
+
+	if (!bMore)
+	{
+		Replay->Finish();
+		Replay.Reset();
+	}
+}
+
+void AFluidSimulationManager::UpdateLockstep(const float DeltaTime)
+{
+	const int32 FirstStep = Lockstep->GetStep();
+	TArray<TArray<FFluidSimCoreEvent>> Steps;
+	TArray<FFluidSimSourceShaderData> Events;
+
+	if (IsLockstepAuthority())
+	{
+		// Fixed rate, anything over MaxSubsteps steps behind is dropped rather than caught up. Events stay with the
+		// simulation until a tick steps.
+		const float StepTime = 1.0f / SolverSettings.SimulationRate;
+		LockstepAccumulator = FMath::Min(LockstepAccumulator + DeltaTime, StepTime * SolverSettings.MaxSubsteps);
+		const int32 StepCount = FMath::FloorToInt(LockstepAccumulator / StepTime);
+		LockstepAccumulator -= StepCount * StepTime;
+		if (StepCount == 0)
+		{
+			return;
+		}
+
+		// All of the tick's events go into its first step, in the order the sources added them.
+		Solver->TakeInjectionEvents(Events);
+		for (int32 Index = 0; Index < StepCount; Index++)
+		{
+			TArray<FFluidSimCoreEvent> StepEvents;
+			if (Index == 0)
+			{
+				FluidSimReplay::ToCoreEvents(Events, StepEvents);
+			}
+			Lockstep->QueueStep(FirstStep + Index, MoveTemp(StepEvents));
+		}
+		Lockstep->Advance(StepCount, &Steps);
+
+		TArray<uint8> Data;
+		FFluidSimLockstep::EncodeSteps(FirstStep, Steps, Data);
+		UFluidSimLockstepComponent::BroadcastSteps(this, Data);
+
+		uint32 Hash = 0;
+		for (int32 Step = FirstStep + 1; Step <= Lockstep->GetStep(); Step++)
+		{
+			if (Lockstep->IsHashStep(Step) && Lockstep->GetHash(Step, Hash))
+			{
+				UFluidSimLockstepComponent::BroadcastHash(this, Step, Hash);
+			}
+		}
+	}
+	else
+	{
+		// Only the server's events count.
+		Solver->TakeInjectionEvents(Events);
+		if (bAwaitingResync)
+		{
+			return;
+		}
+
+		// Up to twice the server's cap so a client that fell behind catches up.
+		Lockstep->Advance(SolverSettings.MaxSubsteps * 2, &Steps);
+
+		for (auto It = LockstepServerHashes.CreateIterator(); It; ++It)
+		{
+			if (It.Key() > Lockstep->GetStep())
+			{
+				continue;
+			}
+
+			uint32 Hash = 0;
+			if (Lockstep->GetHash(It.Key(), Hash) && Hash != It.Value())
+			{
+				UE_LOG(LogFluidSim, Warning, TEXT("'%s' desynced at step %d, resyncing."), *GetName(), It.Key());
+				RequestResync();
+			}
+			It.RemoveCurrent();
+		}
+
+		// Joined late, or the server's steps were dropped.
+		if (Lockstep->IsMissingSteps())
+		{
+			RequestResync();
+		}
+	}
+
+	DrawLockstepSteps(Steps);
+}
+
+void AFluidSimulationManager::DrawLockstepSteps(const TArray<TArray<FFluidSimCoreEvent>>& Steps)
+{
+	// One GPU step per lockstep step on the same events, the GPU result is only ever looked at.
+	for (const TArray<FFluidSimCoreEvent>& Events : Steps)
+	{
+		FFluidSimStreamFrame Frame;
+		Frame.StepCount = 1;
+		Frame.Settings = Lockstep->GetSettings();
+		Frame.Events = Events;
+		Solver->ReplayFrame(SolverSettings, Frame);
+	}
+}
+
+void AFluidSimulationManager::RequestResync()
+{
+	UFluidSimLockstepComponent* Component = UFluidSimLockstepComponent::FindLocal(GetWorld());
+	if (!bAwaitingResync && Component != nullptr)
+	{
+		bAwaitingResync = true;
+		Component->ServerRequestResync(this);
+	}
+}
+
+void AFluidSimulationManager::ReceiveLockstepSteps(const TArray<uint8>& Data)
+{
+	int32 FirstStep = 0;
+	TArray<TArray<FFluidSimCoreEvent>> Steps;
+	if (!Lockstep.IsValid() || !FFluidSimLockstep::DecodeSteps(Data, FirstStep, Steps))
+	{
+		UE_LOG(LogFluidSim, Warning, TEXT("'%s' received lockstep steps it can't use."), *GetName());
+		return;
+	}
+
+	for (int32 Index = 0; Index < Steps.Num(); Index++)
+	{
+		Lockstep->QueueStep(FirstStep + Index, MoveTemp(Steps[Index]));
+	}
+}
+
+void AFluidSimulationManager::ReceiveLockstepHash(const int32 Step, const uint32 Hash)
+{
+	if (Lockstep.IsValid())
+	{
+		LockstepServerHashes.Add(Step, Hash);
+	}
+}
+
+bool AFluidSimulationManager::SaveLockstepSnapshot(TArray<uint8>& OutData) const
+{
+	if (!Lockstep.IsValid())
+	{
+		return false;
+	}
+
+	Lockstep->SaveSnapshot(OutData);
+	return OutData.Num() > 0;
+}
+
+void AFluidSimulationManager::ApplyLockstepSnapshot(const TArray<uint8>& Data)
+{
+	bAwaitingResync = false;
+	if (!Lockstep.IsValid() || !Lockstep->LoadSnapshot(Data))
+	{
+		UE_LOG(LogFluidSim, Warning, TEXT("'%s' failed to load a lockstep snapshot."), *GetName());
+		return;
+	}
+
+	// The GPU restarts from the agreed state too.
+	const FFluidSimReferenceSolver& Reference = Lockstep->GetSolver();
+	auto ToHalf = [](const FFluidSimCoreField& Field, TArray<FFloat16Color>& OutData)
+	{
+		OutData.SetNumUninitialized(Field.Data.Num());
+		for (int32 Index = 0; Index < Field.Data.Num(); Index++)
+		{
+			const FVector4f& Value = Field.Data[Index];
+			OutData[Index] = FFloat16Color(FLinearColor(Value.X, Value.Y, Value.Z, Value.W));
+		}
+	};
+
+	TSharedRef<FFluidSimCheckpoint> Checkpoint = MakeShared<FFluidSimCheckpoint>();
+	Checkpoint->Resolution = Reference.GetVelocity().Resolution;
+	FFluidSimCheckpointLevel& Level = Checkpoint->Levels.AddDefaulted_GetRef();
+	ToHalf(Reference.GetVelocity(), Level.Velocity);
+	ToHalf(Reference.GetDensity(), Level.Density);
+	ToHalf(Reference.GetPressure(), Level.Pressure);
+	Solver->RestoreCheckpoint(Checkpoint);
+}
+
+TSharedPtr<const FFluidSimCheckpoint> AFluidSimulationManager::LoadInitialCheckpoint() const
+{
+	if (InitialCheckpoint.FilePath.IsEmpty())
+	{
+		return nullptr;
+	}
+
+	// Decoded while the level loads, so the first step already runs on it.
+	const FString Path = FPaths::IsRelative(InitialCheckpoint.FilePath) ? FPaths::ProjectDir() / InitialCheckpoint.FilePath : InitialCheckpoint.FilePath;
+	TArray<uint8> Data;
+	TSharedRef<FFluidSimCheckpoint> Checkpoint = MakeShared<FFluidSimCheckpoint>();
+	if (!FFileHelper::LoadFileToArray(Data, *Path) || !FluidSimCheckpoint::Decode(Data, *Checkpoint))
+	{
+		UE_LOG(LogFluidSim, Warning, TEXT("'%s' failed to read its initial checkpoint '%s', starting empty."), *GetName(), *Path);
+		return nullptr;
+	}
+	return Checkpoint;
+}
+
+FString AFluidSimulationManager::GetBakePath() const
+{
+	return FPaths::IsRelative(BakeFile) ? FPaths::ProjectSavedDir() / TEXT("FluidSim") / BakeFile : BakeFile;
+}
+
+FIntVector AFluidSimulationManager::GetSimResolution() const
+{
+	// Every peer has to run the same grid, whatever its scalability.
+	if (bLockstep)
+	{
+		return GridResolution;
+	}
+
+	const float Scale = FMath::Clamp(FMath::RoundToFloat(ResolutionScale * FluidSimScalability::GetResolutionScale() * 8.0f) / 8.0f, 0.125f, 1.0f);
+	auto Scaled = [Scale](const int32 Value) { return FMath::Max(FMath::RoundToInt(Value * Scale), 1); };
+	return FIntVector(Scaled(GridResolution.X), Scaled(GridResolution.Y), Scaled(GridResolution.Z));
+}
+
+float AFluidSimulationManager::GetSimVoxelSize() const
+{
+	return VoxelSize * static_cast<float>(GridResolution.X) / static_cast<float>(GetSimResolution().X);
+}
+
+void AFluidSimulationManager::UpdateDynamicResolution(const float DeltaTime)
+{
+	// The simulation's own passes against its own budget, whatever else the frame renders.
+	const float BudgetMs = FluidSimScalability::ApplyToSettings(SolverSettings).GPUBudgetMs;
+	const float GPUTimeMs = IsValid(Solver) ? Solver->GetGPUTimeMs() : 0.0f;
+	if (BudgetMs <= 0.0f || GPUTimeMs <= 0.0f)
+	{
+		return;
+	}
+
+	ResolutionCooldown -= DeltaTime;
+	if (ResolutionCooldown > 0.0f)
+	{
+		return;
+	}
+
+	// The GPU budget owns the workload and reacts within a few frames, resolution only moves once that can't help.
+	// Down when the workload is at its floor and still over, up when it's back at full workload and the step up is
+	// predicted to fit with a clear margin, the cost goes with the voxel count.
+	const float WorkloadScale = Solver->GetWorkloadScale();
+	float NewScale = ResolutionScale;
+	if (GPUTimeMs > BudgetMs && WorkloadScale <= FFluidSimGPUBudget::MinWorkloadScale)
+	{
+		NewScale -= 0.125f;
+	}
+	else if (WorkloadScale >= 1.0f && ResolutionScale < 1.0f)
+	{
+		const float Growth = FMath::Cube((ResolutionScale + 0.125f) / ResolutionScale);
+		if (GPUTimeMs * Growth < BudgetMs * 0.8f)
+		{
+			NewScale += 0.125f;
+		}
+	}
+	NewScale = FMath::Clamp(NewScale, MinResolutionScale, 1.0f);
+
+	if (!FMath::IsNearlyEqual(NewScale, ResolutionScale))
+	{
+		SetResolutionScale(NewScale);
+		ResolutionCooldown = 1.0f; // Seconds, lets the frame time settle at the new resolution.
+	}
+}
+
+FVector AFluidSimulationManager::GetCascadeCentre(const int32 Level) const
+{
+	// Same snapping as the render proxy, the level's centre voxel is the finest centre voxel divided down.
+	const int32 Divisor = 1 << FMath::Clamp(Level, 0, FluidSimStructs::MaxCascadeLevels - 1);
+	auto FloorDiv = [Divisor](const int32 Value) { return Value >= 0 ? Value / Divisor : -((Divisor - 1 - Value) / Divisor); };
+	const FIntVector LevelCentre = FIntVector(FloorDiv(DomainCentreVoxel.X), FloorDiv(DomainCentreVoxel.Y), FloorDiv(DomainCentreVoxel.Z));
+
+	const float VoxelSizeUU = GetSimVoxelSize() * 100.0f; // VoxelSize in M.
+	return GetSimDomainCentre() + FVector(LevelCentre * Divisor - DomainCentreVoxel) * VoxelSizeUU;
+}
+
+FFluidSimCascadeTextures AFluidSimulationManager::GetCascadeTextures(const int32 Level) const
+{
+	return IsValid(Solver) ? Solver->GetCascadeTextures(Level) : FFluidSimCascadeTextures();
+}
+
+FIntVector AFluidSimulationManager::GetWorldVoxel(const FVector& Location) const
+{
+	const FVector Voxel = Location / (GetSimVoxelSize() * 100.0f); // VoxelSize in M.
+	return FIntVector(FMath::FloorToInt(Voxel.X), FMath::FloorToInt(Voxel.Y), FMath::FloorToInt(Voxel.Z));
+}
+
+void AFluidSimulationManager::UpdateObstacles()
+{
+	const UWorld* World = GetWorld();
+	if (World == nullptr || !IsValid(Solver) || !SolverCPUReady)
+	{
+		return;
+	}
+
+	FFluidSimObstacleGrid Grid;
+	Grid.Resolution = Solver->GetGridDescription().GridResolution;
+	Grid.Levels = CascadeLevels;
+	Grid.VoxelSize = GetSimVoxelSize() * 100.0f; // VoxelSize in M.
+	Grid.Centre = DomainCentreVoxel;
+	Grid.CentreOffset = GetSimDomainCentre() - FVector(DomainCentreVoxel) * Grid.VoxelSize;
+
+	TArray<FFluidSimObstacleBrick> Bricks;
+	Obstacles->BricksPerUpdate = ObstacleBricksPerFrame;
+	Obstacles->Update(*World, Grid, this, Bricks);
+	Solver->AddObstacleBricks(MoveTemp(Bricks));
+}
+
+void AFluidSimulationManager::UpdateColliders(const float DeltaTime)
+{
+	if (FluidSimSubSystem == nullptr || !IsValid(Solver) || !SolverCPUReady)
+	{
+		return;
+	}
+
+	// Per step velocities, the game thread clock steps once a tick and the render thread clock at SimulationRate.
+	const float StepTime = SolverSettings.Clock == EFluidSimClock::GameThread ? DeltaTime : 1.0f / FMath::Max(SolverSettings.SimulationRate, 1.0f);
+	const float VoxelSizeUU = GetSimVoxelSize() * 100.0f; // VoxelSize in M.
+	const FVector Resolution = FVector(Solver->GetGridDescription().GridResolution);
+
+	// Whole numbers are voxel centres, the same voxels the injection events land in.
+	const FVector Origin = GetSimDomainCentre() - (Resolution * 0.5f - 0.5f) * VoxelSizeUU;
+
+	// Anything outside of the coarsest level can't touch the fluid.
+	const int32 Coarsest = FMath::Max(CascadeLevels, 1) - 1;
+	const FBox DomainBox = FBox::BuildAABB(GetCascadeCentre(Coarsest), Resolution * (VoxelSizeUU * 0.5f * static_cast<float>(1 << Coarsest)));
+
+	TArray<FFluidSimColliderShaderData> Colliders;
+	for (UFluidSimColliderComponent* Collider : FluidSimSubSystem->GetColliders())
+	{
+		if (!IsValid(Collider))
+		{
+			continue;
+		}
+
+		// Sampled even when culled so its velocity is right the frame it enters.
+		const FFluidSimColliderState State = Collider->Sample(DeltaTime);
+		const double Reach = State.Extent.Size() + State.Radius;
+		if (!DomainBox.Intersect(FBox::BuildAABB(State.Location, FVector(Reach))))
+		{
+			continue;
+		}
+
+		FFluidSimColliderShaderData& Data = Colliders.AddDefaulted_GetRef();
+		Data.Position = FVector3f((State.Location - Origin) / VoxelSizeUU);
+		Data.Radius = State.Radius / VoxelSizeUU;
+		Data.Extent = FVector3f(State.Extent / VoxelSizeUU);
+		Data.AxisX = FVector3f(State.Rotation.GetAxisX());
+		Data.AxisY = FVector3f(State.Rotation.GetAxisY());
+		Data.AxisZ = FVector3f(State.Rotation.GetAxisZ());
+		Data.Velocity = FVector3f(State.Velocity * (StepTime / VoxelSizeUU));
+		Data.AngularVelocity = FVector3f(State.AngularVelocity * StepTime);
+	}
+
+	Solver->SetColliders(MoveTemp(Colliders));
+}
+
+void AFluidSimulationManager::UpdateScrollingDomain()
+{
+	if (!IsValid(Solver) || !SolverCPUReady) { return; }
+
+	const AActor* Target = ScrollTarget;
+	if (!IsValid(Target))
+	{
+		const UWorld* World = GetWorld();
+		const APlayerController* Controller = World ? World->GetFirstPlayerController() : nullptr;
+		Target = Controller ? Controller->GetPawn() : nullptr;
+	}
+	if (!IsValid(Target)) { return; }
+
+	const FIntVector TargetVoxel = GetWorldVoxel(Target->GetActorLocation());
+	if (TargetVoxel != DomainCentreVoxel)
+	{
+		DomainCentreVoxel = TargetVoxel;
+		Solver->SetDomainCentre(DomainCentreVoxel);
+
+		DebugMeshComponent->SetWorldLocation(GetSimDomainCentre());
+	}
+}
+
 void AFluidSimulationManager::SetupDebug()
 {
 	if (DebugStaticMesh != nullptr && DebugMaterial != nullptr)
@@ -34,9 +34,89 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = 0.001)) // Clamp to not zero.
 	float VoxelSize = 1.0;
 
+	// Co-centred grids at GridResolution, each one doubling the voxel size and stepping half as often as the one before.
+	// Three levels cover 16x the area of one grid for less than twice its cost.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = 1, ClampMax = 4))
+	int32 CascadeLevels = 1;
+
+	// Fraction of GridResolution the simulation runs at, in steps of an eighth. The extent and outputs don't change.
+	// Scaled further by r.FluidSim.ResolutionScale.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, meta = (ClampMin = 0.25, ClampMax = 1.0))
+	float ResolutionScale = 1.0f;
+
+	// Lowers ResolutionScale while the simulation's own GPU time stays over FFluidSolverSettings::GPUBudgetMs with the
+	// workload already scaled down as far as it goes, and raises it again once the next step up fits. Needs a GPU budget.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool bDynamicResolution = false;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = 0.25, ClampMax = 1.0, EditCondition = "bDynamicResolution"))
+	float MinResolutionScale = 0.5f;
+
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	FFluidSolverSettings SolverSettings;
 
+	// Fields the simulation starts from instead of an empty domain, uploaded once during setup. A checkpoint saved with
+	// SaveCheckpoint, relative to the project directory, and volume textures resampled into the finest level on top of it.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, meta = (FilePathFilter = "Fluid Sim Checkpoint (*.fscp)|*.fscp"))
+	FFilePath InitialCheckpoint;
+
+	// Velocity in voxels of the texture per step, resampled to the simulation's voxels.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly)
+	class UVolumeTexture* InitialVelocity = nullptr;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly)
+	class UVolumeTexture* InitialDensity = nullptr;
+
+	// Bake writes the outputs of every simulated frame to BakeFile, Playback streams them back into the outputs instead
+	// of simulating. Set before BeginPlay.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly)
+	EFluidSimBakeMode BakeMode = EFluidSimBakeMode::Live;
+
+	// Relative to Saved/FluidSim.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, meta = (EditCondition = "BakeMode != EFluidSimBakeMode::Live"))
+	FString BakeFile = TEXT("FluidSim.fssq");
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (EditCondition = "BakeMode == EFluidSimBakeMode::Playback"))
+	bool bLoopPlayback = true;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = 0.0, EditCondition = "BakeMode == EFluidSimBakeMode::Playback"))
+	float PlaybackRate = 1.0f;
+
+	// Deterministic multiplayer. The server sends the sources' events of every step and every LockstepHashInterval steps
+	// a hash of the fields, clients run the same steps on the CPU reference and resync from a snapshot when their hash
+	// disagrees. Steps at SolverSettings.SimulationRate with the settings at BeginPlay, the GPU only draws the result.
+	// Forces one cascade level at GridResolution, no scrolling, a fixed pressure solve and the game thread clock.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly)
+	bool bLockstep = false;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, meta = (ClampMin = 1, EditCondition = "bLockstep"))
+	int32 LockstepHashInterval = 60;
+
+	// Keep the domain centred on ScrollTarget, it moves in whole voxels and the fluid stays put in the world.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool bScrollingDomain = false;
+
+	// Actor the scrolling domain follows, the first local player's pawn if not set.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta=(EditCondition="bScrollingDomain"))
+	AActor* ScrollTarget = nullptr;
+
+	// Collision geometry on ObstacleChannel blocks the fluid. Voxelized on the game thread, only the bricks something
+	// moved through are redone and at most ObstacleBricksPerFrame of them a frame. Obstacles are static walls, the fluid
+	// doesn't pick up their velocity.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly)
+	bool bObstacles = false;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, meta = (EditCondition = "bObstacles"))
+	TEnumAsByte<ECollisionChannel> ObstacleChannel = ECC_WorldStatic;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = 1, EditCondition = "bObstacles"))
+	int32 ObstacleBricksPerFrame = 64;
+
+	// UFluidSimColliderComponents push the fluid with their velocity and block it like an obstacle. Ticks the manager
+	// every frame, colliders or not.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly)
+	bool bMovingColliders = false;
+
 	// Draw a debug bounds for the simulation domain.
 	UPROPERTY(EditInstanceOnly, AdvancedDisplay)
 	bool bDrawBounds = false;
@@ -94,6 +174,58 @@ public:
 
 	FGridDescription GetSimGridDescription() const;
 
+	// Resamples the running simulation, the fluid carries over.
+	UFUNCTION(BlueprintCallable)
+	void SetResolutionScale(const float Scale);
+
+	// Picks up changed r.FluidSim.* console variables, called by the scalability sink.
+	void ApplyScalability();
+
+	// Resolution and voxel size the simulation runs at after ResolutionScale and r.FluidSim.ResolutionScale.
+	FIntVector GetSimResolution() const;
+	float GetSimVoxelSize() const;
+
+	// World space centre of the simulation domain, only differs from the actor location when scrolling.
+	UFUNCTION(BlueprintPure)
+	FVector GetSimDomainCentre() const;
+
+	// World space centre of a cascade level, coarse levels snap to their own voxels so can sit slightly off the finest one.
+	UFUNCTION(BlueprintPure)
+	FVector GetCascadeCentre(const int32 Level) const;
+
+	// Solver quality of the finest level, enable SolverSettings.bDiagnostics to measure it. A few frames old.
+	UFUNCTION(BlueprintCallable)
+	FFluidSimDiagnostics GetDiagnostics() const;
+
+	// Records every step's settings and injection events, see FluidSim.Record.
+	UFUNCTION(BlueprintCallable)
+	bool StartRecording(const FString& Path);
+
+	UFUNCTION(BlueprintCallable)
+	void StopRecording();
+
+	// Steps with a recorded stream instead of the live sources until it runs out, then writes a CSV report next to it.
+	// FixedRate is in recorded frames per second, zero plays one per tick.
+	UFUNCTION(BlueprintCallable)
+	bool StartReplay(const FString& Path, const float FixedRate = 0.0f);
+
+	// Persists the running fluid, see UFluidSimulation::SaveCheckpoint. Both return straight away.
+	UFUNCTION(BlueprintCallable)
+	bool SaveCheckpoint(const FString& Path);
+
+	UFUNCTION(BlueprintCallable)
+	bool LoadCheckpoint(const FString& Path);
+
+	// Lockstep traffic, see UFluidSimLockstepComponent.
+	void ReceiveLockstepSteps(const TArray<uint8>& Data);
+	void ReceiveLockstepHash(const int32 Step, const uint32 Hash);
+	bool SaveLockstepSnapshot(TArray<uint8>& OutData) const;
+	void ApplyLockstepSnapshot(const TArray<uint8>& Data);
+
+	// Output volumes of a cascade level, level 0 is the RT_*_Vol textures.
+	UFUNCTION(BlueprintPure)
+	FFluidSimCascadeTextures GetCascadeTextures(const int32 Level) const;
+
 private:
 
 	UPROPERTY(Transient)
@@ -102,6 +234,43 @@ private:
 	UPROPERTY(Transient)
 	class UFluidSimSubsystem* FluidSimSubSystem;
 
+	// Scrolling domain centre in world voxels.
+	UPROPERTY(Transient)
+	FIntVector DomainCentreVoxel = FIntVector::ZeroValue;
+
+	// Dynamic resolution controller, the outer loop around the GPU budget's workload scaling.
+	float ResolutionCooldown = 0.0f;
+	void UpdateDynamicResolution(const float DeltaTime);
+
+	// Baked playback, replaces the solver entirely while set.
+	TSharedPtr<class FFluidSimSequencePlayer> SequencePlayer;
+	FString GetBakePath() const;
+
+	TSharedPtr<const struct FFluidSimCheckpoint> LoadInitialCheckpoint() const;
+
+	// Lockstep state, replaces SimulationStep while set. Server hashes wait here until the local steps catch up.
+	TSharedPtr<class FFluidSimLockstep> Lockstep;
+	TMap<int32, uint32> LockstepServerHashes;
+	float LockstepAccumulator = 0.0f;
+	bool bAwaitingResync = false;
+	bool IsLockstepAuthority() const { return GetNetMode() != NM_Client; }
+	void UpdateLockstep(const float DeltaTime);
+	void DrawLockstepSteps(const TArray<TArray<struct FFluidSimCoreEvent>>& Steps);
+	void RequestResync();
+
+	// Active replay, replaces SimulationStep while set.
+	TSharedPtr<class FFluidSimReplay> Replay;
+	void UpdateReplay(const float DeltaTime);
+
+	// Obstacle voxelizer, incremental across frames.
+	TSharedPtr<class FFluidSimObstacles> Obstacles;
+	void UpdateObstacles();
+
+	void UpdateColliders(const float DeltaTime);
+
+	void UpdateScrollingDomain();
+	FIntVector GetWorldVoxel(const FVector& Location) const;
+
 	void SetupDebug();
 	void UpdateDebug();
 };
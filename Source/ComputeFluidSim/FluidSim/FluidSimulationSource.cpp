@@ -94,13 +94,14 @@ FFluidSimSourceData AFluidSimulationSource::CreateShaderSourceData()
 	SourceData.ShaderData.Strength = Strength;
 	SourceData.ShaderData.Size = Size;
 	SourceData.ShaderData.Hardness = Hardness;
+	SourceData.ShaderData.Stamp = static_cast<uint32>(Stamp);
 	
 	return SourceData;
 }
 
 FIntVector AFluidSimulationSource::GetSimPositionIdx() const 
 {
-	const FVector3f SimLocation = static_cast<FVector3f>(SimManager->GetActorLocation() );
+	const FVector3f SimLocation = static_cast<FVector3f>(SimManager->GetSimDomainCentre() );
 	const FGridDescription Desc = SimManager->GetSimGridDescription();
 	const FVector3f ActorLocation = static_cast<FVector3f>(GetActorLocation() );
 
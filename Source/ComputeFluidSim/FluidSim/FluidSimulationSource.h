@@ -56,6 +56,11 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	float Hardness = 0.5;
 
+	// Precomputed shape instead of the analytic splats, turned along the source's direction. Explosions are emitted
+	// over the same frames either way.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	EFluidSimStamp Stamp = EFluidSimStamp::NONE;
+
 private:
 	bool SourceReady = false; 
 
@@ -6,9 +6,16 @@
 #include "GameFramework/Actor.h"
 #include "RenderGraphDefinitions.h"
 #include "RHICommandList.h"
+#include "FluidSimCoreTypes.h"
+#include "FluidSimStamps.h"
 
 #include "FluidStructs.generated.h"
 
+namespace FluidSimStructs
+{
+	constexpr int32 MaxCascadeLevels = 4;
+}
+
 UENUM()
 enum class EFluidSimDebug : uint8
 {
@@ -31,6 +38,45 @@ enum class EFluidStageDebug : uint8
 	None
 };
 
+UENUM()
+enum class EFluidPressureSolve : uint8
+{
+	// Always runs PressureIterations.
+	Fixed = 0,
+	// Measures the residual every few iterations and stops once it's under TargetResidual.
+	Adaptive
+};
+
+UENUM()
+enum class EFluidSimClock : uint8
+{
+	// Stepped once per AFluidSimulationManager tick.
+	GameThread = 0,
+	// Stepped by the render thread at a fixed rate every rendered frame, independent of game thread hitches.
+	RenderThread
+};
+
+UENUM()
+enum class EFluidSimBakeMode : uint8
+{
+	// Simulates every frame.
+	Live = 0,
+	// Simulates and writes the outputs of every frame to the bake file.
+	Bake,
+	// Plays the bake file back into the outputs, nothing is simulated.
+	Playback
+};
+
+UENUM(meta=(Bitflags, UseEnumValuesAsMaskValuesInEditor="true"))
+enum class EFluidSimOutputFields : uint8
+{
+	None = 0		UMETA(Hidden),
+	Velocity = 1,
+	Density = 2,
+	Pressure = 4,
+};
+ENUM_CLASS_FLAGS(EFluidSimOutputFields);
+
 USTRUCT(BlueprintType)
 struct FFluidSolverSettings
 {
@@ -45,9 +91,71 @@ struct FFluidSolverSettings
 	UPROPERTY(EditAnywhere, meta=(ClampMin="0.0", ClampMax="1.0"))
 	float DissipationVelocity = 0.1f;
 
-	UPROPERTY(EditAnywhere, meta=(ClampMin="1"))
+	UPROPERTY(EditAnywhere, meta=(ClampMin="1", EditCondition="PressureSolve == EFluidPressureSolve::Fixed"))
 	int PressureIterations = 8;
 
+	UPROPERTY(EditAnywhere)
+	EFluidPressureSolve PressureSolve = EFluidPressureSolve::Fixed;
+
+	UPROPERTY(EditAnywhere, meta=(ClampMin="1", EditCondition="PressureSolve == EFluidPressureSolve::Adaptive"))
+	int MinPressureIterations = 4;
+
+	UPROPERTY(EditAnywhere, meta=(ClampMin="1", EditCondition="PressureSolve == EFluidPressureSolve::Adaptive"))
+	int MaxPressureIterations = 32;
+
+	// Iterations between residual checks.
+	UPROPERTY(EditAnywhere, meta=(ClampMin="1", EditCondition="PressureSolve == EFluidPressureSolve::Adaptive"))
+	int ResidualCheckInterval = 4;
+
+	// Largest per voxel residual of the pressure equation that counts as converged.
+	UPROPERTY(EditAnywhere, meta=(ClampMin="0.0", EditCondition="PressureSolve == EFluidPressureSolve::Adaptive"))
+	float TargetResidual = 0.001f;
+
+	// Start the solve from the previous step's pressure instead of zero.
+	UPROPERTY(EditAnywhere)
+	bool bWarmStartPressure = false;
+
+	UPROPERTY(EditAnywhere)
+	EFluidSimClock Clock = EFluidSimClock::GameThread;
+
+	// Steps per second when running on the render thread clock or in lockstep.
+	UPROPERTY(EditAnywhere, meta=(ClampMin="1.0", EditCondition="Clock == EFluidSimClock::RenderThread"))
+	float SimulationRate = 60.0f;
+
+	// Upper limit of catch up steps per rendered frame on the render thread clock.
+	UPROPERTY(EditAnywhere, meta=(ClampMin="1"))
+	int MaxSubsteps = 4;
+
+	// Materials see the previous step while the current one runs on async compute alongside the frame.
+	// Adds one step of latency, hides most of the solver's GPU time behind the base pass.
+	UPROPERTY(EditAnywhere)
+	bool bPipelined = false;
+
+	// Fields copied to the output textures every frame, anything not read by materials or gameplay can be left out.
+	UPROPERTY(EditAnywhere, meta=(Bitmask, BitmaskEnum="/Script/ComputeFluidSim.EFluidSimOutputFields"))
+	int32 OutputFields = static_cast<int32>(EFluidSimOutputFields::Velocity | EFluidSimOutputFields::Density | EFluidSimOutputFields::Pressure);
+
+	// Skip the thread group sized bricks with no velocity or density after injection, in every stage from diffusion on.
+	UPROPERTY(EditAnywhere)
+	bool bSparse = false;
+
+	// Velocity length or density below which a voxel counts as empty.
+	UPROPERTY(EditAnywhere, meta=(ClampMin="0.0", EditCondition="bSparse"))
+	float SparseThreshold = 0.0001f;
+
+	// Bricks around every occupied brick that are simulated too, so fluid can flow into them.
+	UPROPERTY(EditAnywhere, meta=(ClampMin="0", ClampMax="4", EditCondition="bSparse"))
+	int SparseMargin = 1;
+
+	// Reduce divergence, velocity, density and energy once a frame, see FFluidSimDiagnostics.
+	UPROPERTY(EditAnywhere)
+	bool bDiagnostics = false;
+
+	// GPU milliseconds per frame the simulation may use, pressure iterations, substeps and the sparse margin are scaled
+	// down to stay within it. 0 uses r.FluidSim.GPUBudgetMs, which is off unless set for the platform.
+	UPROPERTY(EditAnywhere, meta=(ClampMin="0.0"))
+	float GPUBudgetMs = 0.0f;
+
 	UPROPERTY()
 	EFluidStageDebug Debug = EFluidStageDebug::None;
 };
@@ -66,10 +174,79 @@ struct FGridDescription
 	UPROPERTY()
 	FVector3f GridSizeWS;
 
-	FGridDescription(const float VoxSize = 1.0,const FIntVector GridRes = FIntVector(64, 64, 32)) : VoxelSizeWS(VoxSize), GridResolution(GridRes)
+	// Co-centred grids of the same resolution, each level doubles the voxel size of the one before.
+	UPROPERTY()
+	int32 CascadeLevels = 1;
+
+	FGridDescription(const float VoxSize = 1.0,const FIntVector GridRes = FIntVector(64, 64, 32), const int32 Levels = 1)
+		: VoxelSizeWS(VoxSize), GridResolution(GridRes), CascadeLevels(FMath::Clamp(Levels, 1, FluidSimStructs::MaxCascadeLevels))
 	{
 		GridSizeWS = FVector3f(GridResolution.X * VoxelSizeWS, GridResolution.Y * VoxelSizeWS, GridResolution.Z * VoxelSizeWS);
 	}
+
+	float GetLevelVoxelSizeWS(const int32 Level) const { return VoxelSizeWS * static_cast<float>(1 << Level); }
+
+	// Same extent at a different resolution.
+	FGridDescription WithResolution(const FIntVector& NewResolution) const
+	{
+		FGridDescription Resized = *this;
+		Resized.GridResolution = NewResolution;
+		Resized.VoxelSizeWS = GridSizeWS.X / static_cast<float>(NewResolution.X);
+		return Resized;
+	}
+};
+
+// Output textures of one cascade level, level 0 uses the content browser textures.
+USTRUCT(BlueprintType)
+struct FFluidSimCascadeTextures
+{
+	GENERATED_BODY();
+
+	UPROPERTY(BlueprintReadOnly)
+	class UTextureRenderTargetVolume* Velocity = nullptr;
+
+	UPROPERTY(BlueprintReadOnly)
+	class UTextureRenderTargetVolume* Density = nullptr;
+
+	UPROPERTY(BlueprintReadOnly)
+	class UTextureRenderTargetVolume* Pressure = nullptr;
+};
+
+// Physical quantities of the finest level, reduced on the GPU right after projection and read back a few frames late.
+// Velocities are in voxels per step.
+USTRUCT(BlueprintType)
+struct FFluidSimDiagnostics
+{
+	GENERATED_BODY();
+
+	// Sum and max of |divergence| left over by the pressure solve, zero for a perfectly incompressible field.
+	UPROPERTY(BlueprintReadOnly)
+	float TotalDivergence = 0.0f;
+
+	UPROPERTY(BlueprintReadOnly)
+	float MaxDivergence = 0.0f;
+
+	UPROPERTY(BlueprintReadOnly)
+	float MaxVelocity = 0.0f;
+
+	UPROPERTY(BlueprintReadOnly)
+	float TotalDensity = 0.0f;
+
+	// Sum of half the squared speed, per unit voxel mass.
+	UPROPERTY(BlueprintReadOnly)
+	float KineticEnergy = 0.0f;
+
+	// Finest level step the values were measured at.
+	UPROPERTY(BlueprintReadOnly)
+	int32 Step = 0;
+
+	// GPU time of the simulation in the frame the readback completed.
+	UPROPERTY(BlueprintReadOnly)
+	float GPUTimeMs = 0.0f;
+
+	// False until the first readback arrived.
+	UPROPERTY(BlueprintReadOnly)
+	bool bValid = false;
 };
 
 struct FContentBrowserTextures
@@ -97,6 +274,24 @@ struct FComputeStageIntrinsics
 	FRDGTextureRef SH_RT_Pressure = nullptr;
 	FRDGTextureRef SH_RT_Divergence = nullptr;
 
+	// Cascade level being stepped and the physical voxel holding its logical voxel 0.
+	int32 Level = 0;
+	FIntVector DomainOffset = FIntVector::ZeroValue;
+
+	// Adaptive pressure solve, zeroed by the GPU once the residual is low enough.
+	FRDGBufferRef PressureIndirectArgs = nullptr;
+
+	// Sparse mode, one flag per brick. Dense steps bind a single always active placeholder.
+	FRDGBufferRef ActiveBricks = nullptr;
+
+	// Solid voxels, only read by the stages while bObstacles is set.
+	FRDGTextureRef SH_RT_Obstacles = nullptr;
+	bool bObstacles = false;
+
+	// Moving colliders rasterized for this step, a cleared placeholder while bColliders isn't set.
+	FRDGTextureRef SH_RT_Boundary = nullptr;
+	bool bColliders = false;
+
 	FComputeStageIntrinsics(class FRHICommandListImmediate& InRHICmd, class FRDGBuilder& InGraph, const FIntVector InGPUGroup, const FFluidSolverSettings InSettings)
 		: RHICmdList(InRHICmd), GraphBuilder(InGraph), GPUGroupCount(InGPUGroup), Settings(InSettings)
 	{}
@@ -125,6 +320,19 @@ enum class EFluidInjectionType : uint8 {
 };
 ENUM_CLASS_FLAGS(EFluidInjectionType);
 
+// Precomputed injection shape, see FluidSimStamps.h. None keeps the analytic splats.
+UENUM(BlueprintType)
+enum class EFluidSimStamp : uint8 {
+	NONE =		0		UMETA(DisplayName = "None"),
+	SPHERE =	1		UMETA(DisplayName = "Sphere"),
+	CONE =		2		UMETA(DisplayName = "Cone"),
+	BURST =		3		UMETA(DisplayName = "Burst"),
+};
+
+static_assert(static_cast<uint32>(EFluidSimStamp::SPHERE) == FluidSimStamps::Sphere &&
+	static_cast<uint32>(EFluidSimStamp::CONE) == FluidSimStamps::Cone &&
+	static_cast<uint32>(EFluidSimStamp::BURST) == FluidSimStamps::Burst, "EFluidSimStamp must match FluidSimStamps.");
+
 USTRUCT()
 struct FFluidSimSourceShaderData
 {
@@ -136,6 +344,26 @@ struct FFluidSimSourceShaderData
 	float Strength = 1.0f;
 	float Size = 1.0f;
 	float Hardness = 0.5f;
+	uint32 Stamp = 0;
+};
+
+// The CPU reference solver reads the same events.
+static_assert(sizeof(FFluidSimSourceShaderData) == sizeof(FFluidSimCoreEvent), "FFluidSimSourceShaderData and FFluidSimCoreEvent must share a layout.");
+
+
+// One moving collider for the render thread, in voxels of the finest level relative to the domain where whole numbers
+// are voxel centres. A box of half size Extent along the axes with edges rounded by Radius, capsules and spheres are
+// boxes with no width. Velocities are per step. Layout matches FluidSimColliderShader.usf.
+struct FFluidSimColliderShaderData
+{
+	FVector3f Position = FVector3f::ZeroVector;
+	float Radius = 0.0f;
+	FVector3f Extent = FVector3f::ZeroVector;
+	FVector3f AxisX = FVector3f::XAxisVector;
+	FVector3f AxisY = FVector3f::YAxisVector;
+	FVector3f AxisZ = FVector3f::ZAxisVector;
+	FVector3f Velocity = FVector3f::ZeroVector;
+	FVector3f AngularVelocity = FVector3f::ZeroVector;
 };
 
 
@@ -156,6 +384,12 @@ struct FObjectGPUDispatchParams
 	FIntVector GroupCount = FIntVector(32, 32, 32);
 	FFluidSolverSettings Settings;
 	TArray<FFluidSimSourceShaderData> InjectionEvents;
+	bool bWriteOutputs = true;
+
+	// Scrolling domain of the cascade level, ScrollDelta is the movement since its last step in voxels of that level.
+	int32 Level = 0;
+	FIntVector DomainOffset = FIntVector::ZeroValue;
+	FIntVector ScrollDelta = FIntVector::ZeroValue;
 
 	FObjectGPUDispatchParams(const FIntVector InGroupCount, const FFluidSolverSettings InSettings, const TArray<FFluidSimSourceShaderData>& FrameInjectionEvents )
 		: GroupCount(InGroupCount), Settings(InSettings), InjectionEvents(FrameInjectionEvents)
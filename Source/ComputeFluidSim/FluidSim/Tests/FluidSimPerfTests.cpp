@@ -0,0 +1,427 @@
+#include "CoreMinimal.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "Dom/JsonObject.h"
+#include "Engine/TextureRenderTargetVolume.h"
+#include "HAL/IConsoleManager.h"
+#include "Interfaces/IPluginManager.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "RenderingThread.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/JsonWriter.h"
+#include "FluidSimReferenceSolver.h"
+#include "FluidSimReplay.h"
+#include "FluidSimStageTimer.h"
+#include "FluidSimulation.h"
+
+// Canned scenes at several grid sizes, timed per stage and compared against Tests/FluidSimPerfBaseline.json in the plugin.
+// FluidSim.Perf.Reference runs the CPU reference solver and works with -nullrhi, FluidSim.Perf.GPU runs the same scenes
+// through UFluidSimulation with r.FluidSim.StageTimings and is skipped without an RHI.
+//
+// Run with -FluidSimUpdateBaseline to write the measured values to Saved/FluidSim/FluidSimPerfBaseline.json, copy it over
+// the plugin's file to accept them. Entries missing from the baseline are reported as warnings and not compared.
+//
+// The reference baseline was recorded on a single core, the slowest run of two. ParallelFor only makes the solver faster
+// elsewhere, which is why its tolerance can be tight. GPU times only mean something for the GPU they were recorded on,
+// record them on the machine running the tests.
+
+namespace FluidSimPerfTests
+{
+	constexpr int32 StepCount = 8;
+	const int32 ReferenceResolutions[] = { 32, 64, 128 };
+	const int32 GPUResolutions[] = { 64, 128, 256 };
+
+	FFluidSimCoreEvent MakeEvent(const uint32 Type, const FIntVector& Resolution, const FVector3f& Position, const FVector3f& Direction, const float Strength, const float Size)
+	{
+		const FVector3f Voxel = FVector3f(Resolution) * Position;
+
+		FFluidSimCoreEvent Event;
+		Event.InjectionType = Type;
+		Event.Position = FIntVector(FMath::FloorToInt32(Voxel.X), FMath::FloorToInt32(Voxel.Y), FMath::FloorToInt32(Voxel.Z));
+		Event.Direction = Direction;
+		Event.Strength = Strength;
+		Event.Size = Size * static_cast<float>(Resolution.GetMax());
+		Event.Hardness = 0.5f;
+		return Event;
+	}
+
+	TArray<FFluidSimCoreEvent> SingleFan(const FIntVector& Resolution, const int32 Step)
+	{
+		const FVector3f Fan(0.1f, 0.5f, 0.5f);
+		return {
+			MakeEvent(FluidSimCoreInjection::FanPressure, Resolution, Fan, FVector3f::ForwardVector, 1.0f, 0.1f),
+			MakeEvent(FluidSimCoreInjection::Velocity, Resolution, Fan, FVector3f::ForwardVector, 1.5f, 0.1f)
+		};
+	}
+
+	// Fifty bursts every step, the worst case for the injection loop.
+	TArray<FFluidSimCoreEvent> Explosions(const FIntVector& Resolution, const int32 Step)
+	{
+		TArray<FFluidSimCoreEvent> Events;
+		FRandomStream Random(1234 + Step);
+		for (int32 Index = 0; Index < 50; Index++)
+		{
+			const FVector3f Position(Random.FRandRange(0.1f, 0.9f), Random.FRandRange(0.1f, 0.9f), Random.FRandRange(0.1f, 0.9f));
+			Events.Add(MakeEvent(FluidSimCoreInjection::Pressure, Resolution, Position, FVector3f::ZeroVector, 4.0f, 0.05f));
+			Events.Add(MakeEvent(FluidSimCoreInjection::Density, Resolution, Position, FVector3f::ZeroVector, 1.0f, 0.05f));
+		}
+		return Events;
+	}
+
+	// A source moving across the domain, like a vehicle.
+	TArray<FFluidSimCoreEvent> WakeTrail(const FIntVector& Resolution, const int32 Step)
+	{
+		const FVector3f Position(0.1f + 0.8f * static_cast<float>(Step) / StepCount, 0.5f, 0.3f);
+		return {
+			MakeEvent(FluidSimCoreInjection::Velocity, Resolution, Position, FVector3f::BackwardVector, 1.0f, 0.05f),
+			MakeEvent(FluidSimCoreInjection::Density, Resolution, Position, FVector3f::ZeroVector, 0.5f, 0.05f)
+		};
+	}
+
+	// Nothing going on, the floor every other scene is measured against.
+	TArray<FFluidSimCoreEvent> IdleDomain(const FIntVector& Resolution, const int32 Step)
+	{
+		return {};
+	}
+
+	struct FScene
+	{
+		const TCHAR* Name;
+		TArray<FFluidSimCoreEvent>(*Events)(const FIntVector& Resolution, const int32 Step);
+	};
+
+	const FScene Scenes[] =
+	{
+		{ TEXT("SingleFan"), &SingleFan },
+		{ TEXT("Explosions"), &Explosions },
+		{ TEXT("WakeTrail"), &WakeTrail },
+		{ TEXT("IdleDomain"), &IdleDomain },
+	};
+
+	const FScene* FindScene(const FString& Name)
+	{
+		for (const FScene& Scene : Scenes)
+		{
+			if (Name == Scene.Name)
+			{
+				return &Scene;
+			}
+		}
+		return nullptr;
+	}
+
+	void GetTests(TConstArrayView<int32> Resolutions, TArray<FString>& OutBeautifiedNames, TArray<FString>& OutTestCommands)
+	{
+		for (const FScene& Scene : Scenes)
+		{
+			for (const int32 Resolution : Resolutions)
+			{
+				OutBeautifiedNames.Add(FString::Printf(TEXT("%s.%d"), Scene.Name, Resolution));
+				OutTestCommands.Add(FString::Printf(TEXT("%s %d"), Scene.Name, Resolution));
+			}
+		}
+	}
+
+	bool ParseParameters(const FString& Parameters, const FScene*& OutScene, int32& OutResolution)
+	{
+		FString SceneName, ResolutionString;
+		if (!Parameters.Split(TEXT(" "), &SceneName, &ResolutionString))
+		{
+			return false;
+		}
+		OutScene = FindScene(SceneName);
+		OutResolution = FCString::Atoi(*ResolutionString);
+		return OutScene != nullptr && OutResolution > 0;
+	}
+
+	// Baseline file, one object per test with its limits. Measured values may exceed the baseline by Tolerance times
+	// plus SlackMs before the test fails, memory by MemoryTolerance times. A section may override the tolerance with
+	// <Section>Tolerance.
+	class FBaseline
+	{
+	public:
+		static FBaseline& Get()
+		{
+			static FBaseline Baseline;
+			return Baseline;
+		}
+
+		const TSharedPtr<FJsonObject>* Find(const TCHAR* Section, const FString& Key) const
+		{
+			const TSharedPtr<FJsonObject>* SectionObject = nullptr;
+			if (!Root.IsValid() || !Root->TryGetObjectField(Section, SectionObject))
+			{
+				return nullptr;
+			}
+
+			const TSharedPtr<FJsonObject>* Entry = nullptr;
+			return (*SectionObject)->TryGetObjectField(Key, Entry) ? Entry : nullptr;
+		}
+
+		double GetTolerance(const TCHAR* Section) const
+		{
+			double Tolerance = 3.0;
+			if (Root.IsValid() && !Root->TryGetNumberField(FString(Section) + TEXT("Tolerance"), Tolerance))
+			{
+				Root->TryGetNumberField(TEXT("Tolerance"), Tolerance);
+			}
+			return Tolerance;
+		}
+		double GetSlackMs() const { return Root.IsValid() ? Root->GetNumberField(TEXT("SlackMs")) : 0.5; }
+		double GetMemoryTolerance() const { return Root.IsValid() ? Root->GetNumberField(TEXT("MemoryTolerance")) : 1.1; }
+
+		// Only with -FluidSimUpdateBaseline, merged into a copy of the baseline so untouched entries survive.
+		void Record(const TCHAR* Section, const FString& Key, const TSharedRef<FJsonObject>& Entry)
+		{
+			if (!FParse::Param(FCommandLine::Get(), TEXT("FluidSimUpdateBaseline")))
+			{
+				return;
+			}
+
+			if (!Updated.IsValid())
+			{
+				Updated = MakeShared<FJsonObject>();
+				if (Root.IsValid())
+				{
+					FJsonObject::Duplicate(Root, Updated);
+				}
+			}
+
+			const TSharedPtr<FJsonObject>* SectionObject = nullptr;
+			TSharedPtr<FJsonObject> Target;
+			if (Updated->TryGetObjectField(Section, SectionObject))
+			{
+				Target = *SectionObject;
+			}
+			else
+			{
+				Target = MakeShared<FJsonObject>();
+				Updated->SetObjectField(Section, Target);
+			}
+			Target->SetObjectField(Key, Entry);
+
+			FString Json;
+			const TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&Json);
+			FJsonSerializer::Serialize(Updated.ToSharedRef(), Writer);
+			FFileHelper::SaveStringToFile(Json, *(FPaths::ProjectSavedDir() / TEXT("FluidSim/FluidSimPerfBaseline.json")));
+		}
+
+	private:
+		FBaseline()
+		{
+			const TSharedPtr<IPlugin> Plugin = IPluginManager::Get().FindPlugin(TEXT("ComputeFluidSim"));
+			FString Json;
+			if (Plugin.IsValid() && FFileHelper::LoadFileToString(Json, *(Plugin->GetBaseDir() / TEXT("Tests/FluidSimPerfBaseline.json"))))
+			{
+				FJsonSerializer::Deserialize(TJsonReaderFactory<>::Create(Json), Root);
+			}
+		}
+
+		TSharedPtr<FJsonObject> Root;
+		TSharedPtr<FJsonObject> Updated;
+	};
+
+	// Compares one measurement, true if it's within the baseline or there's nothing to compare against.
+	bool CheckTime(FAutomationTestBase& Test, const TCHAR* Section, const TSharedPtr<FJsonObject>* Entry, const FString& Name, const double MeasuredMs)
+	{
+		double BaselineMs = 0.0;
+		if (Entry == nullptr || !(*Entry)->TryGetNumberField(Name, BaselineMs))
+		{
+			Test.AddWarning(FString::Printf(TEXT("%s: %.3f ms, no baseline."), *Name, MeasuredMs));
+			return true;
+		}
+
+		const FBaseline& Baseline = FBaseline::Get();
+		const double LimitMs = BaselineMs * Baseline.GetTolerance(Section) + Baseline.GetSlackMs();
+		if (MeasuredMs > LimitMs)
+		{
+			Test.AddError(FString::Printf(TEXT("%s: %.3f ms exceeds %.3f ms (baseline %.3f ms)."), *Name, MeasuredMs, LimitMs, BaselineMs));
+			return false;
+		}
+
+		Test.AddInfo(FString::Printf(TEXT("%s: %.3f ms, baseline %.3f ms."), *Name, MeasuredMs, BaselineMs));
+		return true;
+	}
+
+	bool CheckMemory(FAutomationTestBase& Test, const TSharedPtr<FJsonObject>* Entry, const uint64 MeasuredBytes)
+	{
+		double BaselineBytes = 0.0;
+		if (Entry == nullptr || !(*Entry)->TryGetNumberField(TEXT("MemoryBytes"), BaselineBytes))
+		{
+			Test.AddWarning(FString::Printf(TEXT("Memory: %llu bytes, no baseline."), MeasuredBytes));
+			return true;
+		}
+
+		const double LimitBytes = BaselineBytes * FBaseline::Get().GetMemoryTolerance();
+		if (static_cast<double>(MeasuredBytes) > LimitBytes)
+		{
+			Test.AddError(FString::Printf(TEXT("Memory: %llu bytes exceeds %.0f bytes (baseline %.0f)."), MeasuredBytes, LimitBytes, BaselineBytes));
+			return false;
+		}
+		return true;
+	}
+}
+
+IMPLEMENT_COMPLEX_AUTOMATION_TEST(FFluidSimReferencePerfTest, "FluidSim.Perf.Reference",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext | EAutomationTestFlags::PerfFilter)
+
+void FFluidSimReferencePerfTest::GetTests(TArray<FString>& OutBeautifiedNames, TArray<FString>& OutTestCommands) const
+{
+	FluidSimPerfTests::GetTests(FluidSimPerfTests::ReferenceResolutions, OutBeautifiedNames, OutTestCommands);
+}
+
+bool FFluidSimReferencePerfTest::RunTest(const FString& Parameters)
+{
+	using namespace FluidSimPerfTests;
+
+	const FScene* Scene = nullptr;
+	int32 Resolution = 0;
+	if (!ParseParameters(Parameters, Scene, Resolution))
+	{
+		AddError(FString::Printf(TEXT("Bad test parameters '%s'."), *Parameters));
+		return false;
+	}
+
+	const FIntVector Size(Resolution);
+	const FFluidSimCoreSettings Settings;
+	FFluidSimReferenceSolver Solver(Size);
+
+	// One step to fault everything in, timings start from the next.
+	Solver.Step(Settings, Scene->Events(Size, 0));
+	Solver.ResetStageTimes();
+	for (int32 Step = 1; Step <= StepCount; Step++)
+	{
+		Solver.Step(Settings, Scene->Events(Size, Step));
+	}
+
+	const FString Key = FString::Printf(TEXT("%s@%d"), Scene->Name, Resolution);
+	const TSharedPtr<FJsonObject>* Entry = FBaseline::Get().Find(TEXT("Reference"), Key);
+	const TSharedRef<FJsonObject> Measured = MakeShared<FJsonObject>();
+
+	bool bPassed = true;
+	for (int32 Stage = 0; Stage < static_cast<int32>(EFluidSimCoreStage::Num); Stage++)
+	{
+		const FString StageName = LexToString(static_cast<EFluidSimCoreStage>(Stage));
+		const double StageMs = Solver.GetStageSeconds(static_cast<EFluidSimCoreStage>(Stage)) * 1000.0 / StepCount;
+		bPassed &= CheckTime(*this, TEXT("Reference"), Entry, StageName, StageMs);
+		Measured->SetNumberField(StageName, StageMs);
+	}
+
+	const uint64 MemoryBytes = Solver.GetAllocatedSize();
+	bPassed &= CheckMemory(*this, Entry, MemoryBytes);
+	Measured->SetNumberField(TEXT("MemoryBytes"), static_cast<double>(MemoryBytes));
+
+	// Blown up fields are as bad as slow ones.
+	const FFluidSimCoreDiagnostics Diagnostics = FFluidSimReferenceSolver::ComputeDiagnostics(Solver.GetVelocity(), Solver.GetDensity());
+	TestTrue(TEXT("Fields are finite"), FMath::IsFinite(Diagnostics.KineticEnergy) && FMath::IsFinite(Diagnostics.TotalDensity));
+
+	FBaseline::Get().Record(TEXT("Reference"), Key, Measured);
+	return bPassed;
+}
+
+IMPLEMENT_COMPLEX_AUTOMATION_TEST(FFluidSimGPUPerfTest, "FluidSim.Perf.GPU",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext | EAutomationTestFlags::PerfFilter)
+
+void FFluidSimGPUPerfTest::GetTests(TArray<FString>& OutBeautifiedNames, TArray<FString>& OutTestCommands) const
+{
+	FluidSimPerfTests::GetTests(FluidSimPerfTests::GPUResolutions, OutBeautifiedNames, OutTestCommands);
+}
+
+bool FFluidSimGPUPerfTest::RunTest(const FString& Parameters)
+{
+	using namespace FluidSimPerfTests;
+
+	if (!FApp::CanEverRender() || GUsingNullRHI)
+	{
+		AddInfo(TEXT("No RHI, skipped. FluidSim.Perf.Reference covers -nullrhi."));
+		return true;
+	}
+
+	const FScene* Scene = nullptr;
+	int32 Resolution = 0;
+	if (!ParseParameters(Parameters, Scene, Resolution))
+	{
+		AddError(FString::Printf(TEXT("Bad test parameters '%s'."), *Parameters));
+		return false;
+	}
+
+	const FIntVector Size(Resolution);
+	auto CreateVolume = [&Size]()
+	{
+		UTextureRenderTargetVolume* Volume = NewObject<UTextureRenderTargetVolume>(GetTransientPackage());
+		Volume->bCanCreateUAV = true;
+		Volume->Init(Size.X, Size.Y, Size.Z, EPixelFormat::PF_FloatRGBA);
+		Volume->UpdateResourceImmediate(true);
+		return Volume;
+	};
+
+	UFluidSimulation* Simulation = NewObject<UFluidSimulation>(GetTransientPackage());
+	const FContentBrowserTextures Textures(CreateVolume(), CreateVolume(), CreateVolume(), nullptr);
+	if (!Simulation->Setup(FGridDescription(1.0f, Size), Textures))
+	{
+		AddError(TEXT("Failed to set up the simulation."));
+		return false;
+	}
+
+	// Flushed so every step's frame reaches the proxy, the GPU is timed by the stage timestamps and isn't waited on.
+	auto ReplayStep = [Simulation, Scene, &Size](const int32 Step)
+	{
+		FFluidSimStreamFrame Frame;
+		Frame.StepCount = 1;
+		Frame.Events = Scene->Events(Size, Step);
+		Simulation->ReplayFrame(FFluidSolverSettings(), Frame);
+		FlushRenderingCommands();
+	};
+
+	IConsoleVariable* StageTimings = IConsoleManager::Get().FindConsoleVariable(TEXT("r.FluidSim.StageTimings"));
+	const int32 PreviousStageTimings = StageTimings->GetInt();
+	StageTimings->Set(1, ECVF_SetByCode);
+
+	// One step to fault everything in, its timings are thrown away.
+	ReplayStep(0);
+	Simulation->CaptureGPUProfile();
+	for (int32 StepIndex = 1; StepIndex <= StepCount; StepIndex++)
+	{
+		ReplayStep(StepIndex);
+	}
+	const FFluidSimGPUProfile Profile = Simulation->CaptureGPUProfile();
+
+	StageTimings->Set(PreviousStageTimings, ECVF_SetByCode);
+	Simulation->Stop();
+	FlushRenderingCommands();
+
+	if (Profile.TimedSteps != StepCount)
+	{
+		AddError(FString::Printf(TEXT("Timed %d of %d steps, timestamp queries unsupported?"), Profile.TimedSteps, StepCount));
+		return false;
+	}
+
+	const FString Key = FString::Printf(TEXT("%s@%d"), Scene->Name, Resolution);
+	const TSharedPtr<FJsonObject>* Entry = FBaseline::Get().Find(TEXT("GPU"), Key);
+	const TSharedRef<FJsonObject> Measured = MakeShared<FJsonObject>();
+
+	bool bPassed = true;
+	double TotalMs = 0.0;
+	for (int32 Stage = 0; Stage < static_cast<int32>(EFluidSimGPUStage::Num); Stage++)
+	{
+		const FString StageName = LexToString(static_cast<EFluidSimGPUStage>(Stage));
+		const double StageMs = Profile.StageMs[Stage] / StepCount;
+		bPassed &= CheckTime(*this, TEXT("GPU"), Entry, StageName, StageMs);
+		Measured->SetNumberField(StageName, StageMs);
+		TotalMs += StageMs;
+	}
+	bPassed &= CheckTime(*this, TEXT("GPU"), Entry, TEXT("Total"), TotalMs);
+	Measured->SetNumberField(TEXT("Total"), TotalMs);
+
+	bPassed &= CheckMemory(*this, Entry, Profile.TextureMemoryBytes);
+	Measured->SetNumberField(TEXT("MemoryBytes"), static_cast<double>(Profile.TextureMemoryBytes));
+
+	FBaseline::Get().Record(TEXT("GPU"), Key, Measured);
+	return bPassed;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,176 @@
+#include "CoreMinimal.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "Misc/AutomationTest.h"
+#include "FluidSimReferenceSolver.h"
+#include "FluidSimStamps.h"
+
+// The Sphere stamp is the analytic velocity splat baked into the atlas, both go through the CPU reference solver's
+// injection and have to agree at every Strength. The stamp is filtered half floats, so single voxels near the centre
+// differ by a few percent of the peak while the momentum the event adds matches closely. Explosions have no direction,
+// their purely radial velocity is small next to the filtering error at the centre, so they get more room per voxel.
+
+namespace FluidSimStampTests
+{
+	constexpr int32 Resolution = 32;
+	constexpr float Size = 8.0f;
+	constexpr float MaxVoxelError = 0.1f;
+	constexpr float MaxMomentumError = 0.01f;
+	constexpr float MaxExplosionVoxelError = 0.15f;
+	constexpr float MaxScalarError = 0.05f;
+
+	// AFluidSimulationSource's MaxExplosionFrames, stamped or not an explosion is emitted this many frames.
+	constexpr int32 ExplosionFrames = 3;
+
+	FFluidSimCoreField InjectVelocity(const FVector3f& Direction, const float Strength, const uint32 Stamp)
+	{
+		FFluidSimCoreEvent Event;
+		Event.InjectionType = FluidSimCoreInjection::Velocity;
+		Event.Position = FIntVector(Resolution / 2);
+		Event.Direction = Direction;
+		Event.Strength = Strength;
+		Event.Size = Size;
+		Event.Stamp = Stamp;
+
+		const FIntVector FieldSize(Resolution);
+		FFluidSimCoreField Velocity(FieldSize), Pressure(FieldSize), Density(FieldSize);
+		FFluidSimReferenceSolver::Inject(Velocity, Pressure, Density, { Event });
+		return Velocity;
+	}
+
+	struct FExplosionFields
+	{
+		FFluidSimCoreField Velocity;
+		FFluidSimCoreField Pressure;
+		FFluidSimCoreField Density;
+	};
+
+	// The three events UFluidSimulation emits for an explosion, every frame of it.
+	FExplosionFields InjectExplosion(const float Strength, const uint32 Stamp)
+	{
+		const FIntVector FieldSize(Resolution);
+		FExplosionFields Fields = { FFluidSimCoreField(FieldSize), FFluidSimCoreField(FieldSize), FFluidSimCoreField(FieldSize) };
+
+		FFluidSimCoreEvent Event;
+		Event.Position = FIntVector(Resolution / 2);
+		Event.Direction = FVector3f::ZeroVector;
+		Event.Strength = Strength;
+		Event.Size = Size;
+		Event.Hardness = 0.5f;
+		Event.Stamp = Stamp;
+
+		TArray<FFluidSimCoreEvent> Events;
+		for (const uint32 Type : { FluidSimCoreInjection::Velocity, FluidSimCoreInjection::Pressure, FluidSimCoreInjection::Density })
+		{
+			Event.InjectionType = Type;
+			Events.Add(Event);
+		}
+
+		for (int32 Frame = 0; Frame < ExplosionFrames; Frame++)
+		{
+			FFluidSimReferenceSolver::Inject(Fields.Velocity, Fields.Pressure, Fields.Density, Events);
+		}
+		return Fields;
+	}
+
+	float GetLargestScalarError(const FFluidSimCoreField& Expected, const FFluidSimCoreField& Actual, float& OutPeak)
+	{
+		float MaxError = 0.0f;
+		for (int32 Index = 0; Index < Expected.Data.Num(); Index++)
+		{
+			OutPeak = FMath::Max(OutPeak, FMath::Abs(Expected.Data[Index].X));
+			MaxError = FMath::Max(MaxError, FMath::Abs(Actual.Data[Index].X - Expected.Data[Index].X));
+		}
+		return MaxError;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FFluidSimSphereStampTest, "FluidSim.Reference.SphereStampMatchesSplat",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext | EAutomationTestFlags::ProductFilter)
+
+bool FFluidSimSphereStampTest::RunTest(const FString& Parameters)
+{
+	using namespace FluidSimStampTests;
+
+	const FVector3f Directions[] = { FVector3f(1.0f, 0.0f, 0.0f), FVector3f(1.0f, 1.0f, 0.0f).GetUnsafeNormal(), FVector3f(0.3f, -0.5f, 0.81f).GetUnsafeNormal() };
+	const float Strengths[] = { 0.5f, 1.0f, 2.0f };
+
+	for (const FVector3f& Direction : Directions)
+	{
+		for (const float Strength : Strengths)
+		{
+			const FFluidSimCoreField Splat = InjectVelocity(Direction, Strength, FluidSimStamps::None);
+			const FFluidSimCoreField Stamp = InjectVelocity(Direction, Strength, FluidSimStamps::Sphere);
+
+			float Peak = 0.0f, MaxError = 0.0f;
+			double SplatMomentum = 0.0, StampMomentum = 0.0;
+			for (int32 Index = 0; Index < Splat.Data.Num(); Index++)
+			{
+				const FVector3f SplatVelocity(Splat.Data[Index]);
+				const FVector3f StampVelocity(Stamp.Data[Index]);
+				Peak = FMath::Max(Peak, SplatVelocity.Size());
+				MaxError = FMath::Max(MaxError, (StampVelocity - SplatVelocity).GetAbsMax());
+				SplatMomentum += FVector3f::DotProduct(SplatVelocity, Direction);
+				StampMomentum += FVector3f::DotProduct(StampVelocity, Direction);
+			}
+
+			const FString Case = FString::Printf(TEXT("Direction %s, Strength %.1f"), *Direction.ToString(), Strength);
+			TestTrue(FString::Printf(TEXT("%s: largest voxel difference %.4f within %.0f%% of the peak %.4f"), *Case, MaxError, MaxVoxelError * 100.0f, Peak),
+				MaxError <= MaxVoxelError * Peak);
+			TestTrue(FString::Printf(TEXT("%s: stamp momentum %.3f within %.0f%% of the splat's %.3f"), *Case, StampMomentum, MaxMomentumError * 100.0f, SplatMomentum),
+				FMath::Abs(StampMomentum - SplatMomentum) <= MaxMomentumError * FMath::Abs(SplatMomentum));
+		}
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FFluidSimSphereExplosionTest, "FluidSim.Reference.SphereExplosionMatchesSplat",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext | EAutomationTestFlags::ProductFilter)
+
+bool FFluidSimSphereExplosionTest::RunTest(const FString& Parameters)
+{
+	using namespace FluidSimStampTests;
+
+	const FVector3f Centre = FVector3f(FIntVector(Resolution / 2));
+	const float Strengths[] = { 0.5f, 1.0f, 2.0f };
+
+	for (const float Strength : Strengths)
+	{
+		const FExplosionFields Splat = InjectExplosion(Strength, FluidSimStamps::None);
+		const FExplosionFields Stamp = InjectExplosion(Strength, FluidSimStamps::Sphere);
+		const FString Case = FString::Printf(TEXT("Strength %.1f over %d frames"), Strength, ExplosionFrames);
+
+		float Peak = 0.0f, MaxError = 0.0f;
+		double SplatMomentum = 0.0, StampMomentum = 0.0;
+		for (int32 Index = 0; Index < Splat.Velocity.Data.Num(); Index++)
+		{
+			const FVector3f SplatVelocity(Splat.Velocity.Data[Index]);
+			const FVector3f StampVelocity(Stamp.Velocity.Data[Index]);
+			Peak = FMath::Max(Peak, SplatVelocity.Size());
+			MaxError = FMath::Max(MaxError, (StampVelocity - SplatVelocity).GetAbsMax());
+
+			// Outward momentum, the explosion pushes the same amount of fluid away from its centre.
+			const FIntVector Voxel(Index % Resolution, (Index / Resolution) % Resolution, Index / (Resolution * Resolution));
+			const FVector3f Outward = (FVector3f(Voxel) - Centre).GetSafeNormal();
+			SplatMomentum += FVector3f::DotProduct(SplatVelocity, Outward);
+			StampMomentum += FVector3f::DotProduct(StampVelocity, Outward);
+		}
+
+		TestTrue(FString::Printf(TEXT("%s: largest velocity difference %.4f within %.0f%% of the peak %.4f"), *Case, MaxError, MaxExplosionVoxelError * 100.0f, Peak),
+			MaxError <= MaxExplosionVoxelError * Peak);
+		TestTrue(FString::Printf(TEXT("%s: stamp outward momentum %.3f within %.0f%% of the splat's %.3f"), *Case, StampMomentum, MaxMomentumError * 100.0f, SplatMomentum),
+			FMath::Abs(StampMomentum - SplatMomentum) <= MaxMomentumError * FMath::Abs(SplatMomentum));
+
+		float PressurePeak = 0.0f, DensityPeak = 0.0f;
+		const float PressureError = GetLargestScalarError(Splat.Pressure, Stamp.Pressure, PressurePeak);
+		const float DensityError = GetLargestScalarError(Splat.Density, Stamp.Density, DensityPeak);
+		TestTrue(FString::Printf(TEXT("%s: largest pressure difference %.4f within %.0f%% of the peak %.4f"), *Case, PressureError, MaxScalarError * 100.0f, PressurePeak),
+			PressureError <= MaxScalarError * PressurePeak);
+		TestTrue(FString::Printf(TEXT("%s: largest density difference %.4f within %.0f%% of the peak %.4f"), *Case, DensityError, MaxScalarError * 100.0f, DensityPeak),
+			DensityError <= MaxScalarError * DensityPeak);
+	}
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,337 @@
+#include "FluidSimCheckpoint.h"
+
+#include "Misc/Compression.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+namespace
+{
+	constexpr uint32 CheckpointMagic = 0x50435346; // "FSCP"
+	constexpr uint32 CheckpointVersion = 1;
+	constexpr int32 BrickSize = 8;
+	constexpr int32 MaxChannels = 3;
+
+	// Visits the voxels of one brick that are inside the domain, in the same order for encode and decode.
+	template<typename FunctionType>
+	void ForEachBrickVoxel(const FIntVector& Resolution, const FIntVector& Brick, FunctionType&& Function)
+	{
+		const FIntVector Min = Brick * BrickSize;
+		const FIntVector Max = FIntVector(
+			FMath::Min(Min.X + BrickSize, Resolution.X),
+			FMath::Min(Min.Y + BrickSize, Resolution.Y),
+			FMath::Min(Min.Z + BrickSize, Resolution.Z));
+
+		for (int32 Z = Min.Z; Z < Max.Z; Z++)
+		{
+			for (int32 Y = Min.Y; Y < Max.Y; Y++)
+			{
+				int32 Index = (Z * Resolution.Y + Y) * Resolution.X + Min.X;
+				for (int32 X = Min.X; X < Max.X; X++, Index++)
+				{
+					Function(Index);
+				}
+			}
+		}
+	}
+
+	template<typename FunctionType>
+	void ForEachBrick(const FIntVector& Resolution, FunctionType&& Function)
+	{
+		const FIntVector BrickCount = FIntVector::DivideAndRoundUp(Resolution, BrickSize);
+		int32 BrickIndex = 0;
+		for (int32 Z = 0; Z < BrickCount.Z; Z++)
+		{
+			for (int32 Y = 0; Y < BrickCount.Y; Y++)
+			{
+				for (int32 X = 0; X < BrickCount.X; X++)
+				{
+					Function(FIntVector(X, Y, Z), BrickIndex++);
+				}
+			}
+		}
+	}
+
+	float GetChannel(const FFloat16Color& Value, const int32 Channel)
+	{
+		switch (Channel)
+		{
+		case 0:		return Value.R.GetFloat();
+		case 1:		return Value.G.GetFloat();
+		default:	return Value.B.GetFloat();
+		}
+	}
+
+	void EncodeField(FArchive& Ar, const FIntVector& Resolution, const TArray<FFloat16Color>& Field, const int32 ChannelCount)
+	{
+		const FIntVector BrickCount = FIntVector::DivideAndRoundUp(Resolution, BrickSize);
+		const int32 NumBricks = BrickCount.X * BrickCount.Y * BrickCount.Z;
+
+		TBitArray<> Occupied(false, NumBricks);
+		TArray<float> BrickMin, BrickMax;
+		BrickMin.SetNumUninitialized(NumBricks * ChannelCount);
+		BrickMax.SetNumUninitialized(NumBricks * ChannelCount);
+
+		ForEachBrick(Resolution, [&](const FIntVector& Brick, const int32 BrickIndex)
+		{
+			float Min[MaxChannels] = { MAX_flt, MAX_flt, MAX_flt };
+			float Max[MaxChannels] = { -MAX_flt, -MAX_flt, -MAX_flt };
+			ForEachBrickVoxel(Resolution, Brick, [&](const int32 Index)
+			{
+				for (int32 Channel = 0; Channel < ChannelCount; Channel++)
+				{
+					const float Value = GetChannel(Field[Index], Channel);
+					Min[Channel] = FMath::Min(Min[Channel], Value);
+					Max[Channel] = FMath::Max(Max[Channel], Value);
+				}
+			});
+
+			bool bEmpty = true;
+			for (int32 Channel = 0; Channel < ChannelCount; Channel++)
+			{
+				BrickMin[BrickIndex * ChannelCount + Channel] = Min[Channel];
+				BrickMax[BrickIndex * ChannelCount + Channel] = Max[Channel];
+				bEmpty &= FMath::Max(FMath::Abs(Min[Channel]), FMath::Abs(Max[Channel])) <= FluidSimCheckpoint::EmptyThreshold;
+			}
+			Occupied[BrickIndex] = !bEmpty;
+		});
+
+		Ar << Occupied;
+
+		TArray<uint16> Quantized;
+		Quantized.Reserve(BrickSize * BrickSize * BrickSize * ChannelCount);
+		ForEachBrick(Resolution, [&](const FIntVector& Brick, const int32 BrickIndex)
+		{
+			if (!Occupied[BrickIndex])
+			{
+				return;
+			}
+
+			float Min[MaxChannels], Scale[MaxChannels];
+			for (int32 Channel = 0; Channel < ChannelCount; Channel++)
+			{
+				Min[Channel] = BrickMin[BrickIndex * ChannelCount + Channel];
+				const float Range = BrickMax[BrickIndex * ChannelCount + Channel] - Min[Channel];
+				Scale[Channel] = Range > 0.0f ? 65535.0f / Range : 0.0f;
+
+				float Max = BrickMax[BrickIndex * ChannelCount + Channel];
+				Ar << Min[Channel] << Max;
+			}
+
+			// Planar per channel, compresses better than interleaved.
+			Quantized.Reset();
+			for (int32 Channel = 0; Channel < ChannelCount; Channel++)
+			{
+				ForEachBrickVoxel(Resolution, Brick, [&](const int32 Index)
+				{
+					const float Value = (GetChannel(Field[Index], Channel) - Min[Channel]) * Scale[Channel];
+					Quantized.Add(static_cast<uint16>(FMath::Clamp(FMath::RoundToInt32(Value), 0, 65535)));
+				});
+			}
+			Ar.Serialize(Quantized.GetData(), Quantized.Num() * Quantized.GetTypeSize());
+		});
+	}
+
+	bool DecodeField(FArchive& Ar, const FIntVector& Resolution, TArray<FFloat16Color>& Field, const int32 ChannelCount)
+	{
+		const FIntVector BrickCount = FIntVector::DivideAndRoundUp(Resolution, BrickSize);
+		const int32 NumBricks = BrickCount.X * BrickCount.Y * BrickCount.Z;
+
+		TBitArray<> Occupied;
+		Ar << Occupied;
+		if (Ar.IsError() || Occupied.Num() != NumBricks)
+		{
+			return false;
+		}
+
+		// Empty bricks read as the cleared texture.
+		Field.SetNumZeroed(Resolution.X * Resolution.Y * Resolution.Z);
+
+		TArray<uint16> Quantized;
+		bool bValid = true;
+		ForEachBrick(Resolution, [&](const FIntVector& Brick, const int32 BrickIndex)
+		{
+			if (!bValid || !Occupied[BrickIndex])
+			{
+				return;
+			}
+
+			float Min[MaxChannels] = {}, Step[MaxChannels] = {};
+			for (int32 Channel = 0; Channel < ChannelCount; Channel++)
+			{
+				float Max = 0.0f;
+				Ar << Min[Channel] << Max;
+				Step[Channel] = (Max - Min[Channel]) / 65535.0f;
+			}
+
+			const FIntVector Extent = FIntVector(
+				FMath::Min(BrickSize, Resolution.X - Brick.X * BrickSize),
+				FMath::Min(BrickSize, Resolution.Y - Brick.Y * BrickSize),
+				FMath::Min(BrickSize, Resolution.Z - Brick.Z * BrickSize));
+			const int32 VoxelCount = Extent.X * Extent.Y * Extent.Z;
+			Quantized.SetNumUninitialized(VoxelCount * ChannelCount);
+			Ar.Serialize(Quantized.GetData(), Quantized.Num() * Quantized.GetTypeSize());
+			if (Ar.IsError())
+			{
+				bValid = false;
+				return;
+			}
+
+			int32 Voxel = 0;
+			ForEachBrickVoxel(Resolution, Brick, [&](const int32 Index)
+			{
+				float Values[MaxChannels];
+				for (int32 Channel = 0; Channel < ChannelCount; Channel++)
+				{
+					Values[Channel] = Min[Channel] + Quantized[Channel * VoxelCount + Voxel] * Step[Channel];
+				}
+				Voxel++;
+
+				// Scalars are broadcast like the shaders write them.
+				Field[Index] = ChannelCount == 1
+					? FFloat16Color(FLinearColor(Values[0], Values[0], Values[0], 1.0f))
+					: FFloat16Color(FLinearColor(Values[0], Values[1], Values[2], 1.0f));
+			});
+		});
+		return bValid && !Ar.IsError();
+	}
+}
+
+bool FluidSimCheckpoint::EncodeLevel(const FIntVector& Resolution, const FFluidSimCheckpointLevel& Level, const bool bPressure, TArray<uint8>& OutData)
+{
+	const int32 VoxelCount = Resolution.X * Resolution.Y * Resolution.Z;
+	if (Level.Velocity.Num() != VoxelCount || Level.Density.Num() != VoxelCount || (bPressure && Level.Pressure.Num() != VoxelCount))
+	{
+		return false;
+	}
+
+	TArray<uint8> Payload;
+	FMemoryWriter PayloadWriter(Payload);
+	EncodeField(PayloadWriter, Resolution, Level.Velocity, 3);
+	EncodeField(PayloadWriter, Resolution, Level.Density, 1);
+	if (bPressure)
+	{
+		EncodeField(PayloadWriter, Resolution, Level.Pressure, 1);
+	}
+
+	int32 UncompressedSize = Payload.Num();
+	int32 CompressedSize = FCompression::CompressMemoryBound(NAME_LZ4, UncompressedSize);
+	OutData.SetNumUninitialized(2 * sizeof(int32) + CompressedSize);
+	if (!FCompression::CompressMemory(NAME_LZ4, OutData.GetData() + 2 * sizeof(int32), CompressedSize, Payload.GetData(), UncompressedSize))
+	{
+		return false;
+	}
+
+	OutData.SetNum(2 * sizeof(int32) + CompressedSize);
+	FMemory::Memcpy(OutData.GetData(), &UncompressedSize, sizeof(int32));
+	FMemory::Memcpy(OutData.GetData() + sizeof(int32), &CompressedSize, sizeof(int32));
+	return true;
+}
+
+bool FluidSimCheckpoint::DecodeLevel(const FIntVector& Resolution, TConstArrayView<uint8> Data, const bool bPressure, FFluidSimCheckpointLevel& OutLevel)
+{
+	int32 UncompressedSize = 0, CompressedSize = 0;
+	if (Data.Num() < 2 * static_cast<int32>(sizeof(int32)))
+	{
+		return false;
+	}
+	FMemory::Memcpy(&UncompressedSize, Data.GetData(), sizeof(int32));
+	FMemory::Memcpy(&CompressedSize, Data.GetData() + sizeof(int32), sizeof(int32));
+	if (UncompressedSize < 0 || CompressedSize < 0 || CompressedSize > Data.Num() - 2 * static_cast<int32>(sizeof(int32)))
+	{
+		return false;
+	}
+
+	TArray<uint8> Payload;
+	Payload.SetNumUninitialized(UncompressedSize);
+	if (!FCompression::UncompressMemory(NAME_LZ4, Payload.GetData(), UncompressedSize, Data.GetData() + 2 * sizeof(int32), CompressedSize))
+	{
+		return false;
+	}
+
+	FMemoryReader PayloadReader(Payload);
+	return DecodeField(PayloadReader, Resolution, OutLevel.Velocity, 3) &&
+		DecodeField(PayloadReader, Resolution, OutLevel.Density, 1) &&
+		(!bPressure || DecodeField(PayloadReader, Resolution, OutLevel.Pressure, 1));
+}
+
+bool FluidSimCheckpoint::Encode(const FFluidSimCheckpoint& Checkpoint, TArray<uint8>& OutData)
+{
+	const int32 VoxelCount = Checkpoint.GetVoxelCount();
+	for (const FFluidSimCheckpointLevel& Level : Checkpoint.Levels)
+	{
+		if (Level.Velocity.Num() != VoxelCount || Level.Density.Num() != VoxelCount || Level.Pressure.Num() != VoxelCount)
+		{
+			return false;
+		}
+	}
+
+	TArray<uint8> Payload;
+	FMemoryWriter PayloadWriter(Payload);
+	for (const FFluidSimCheckpointLevel& Level : Checkpoint.Levels)
+	{
+		EncodeField(PayloadWriter, Checkpoint.Resolution, Level.Velocity, 3);
+		EncodeField(PayloadWriter, Checkpoint.Resolution, Level.Density, 1);
+		EncodeField(PayloadWriter, Checkpoint.Resolution, Level.Pressure, 1);
+	}
+
+	int32 UncompressedSize = Payload.Num();
+	int32 CompressedSize = FCompression::CompressMemoryBound(NAME_LZ4, UncompressedSize);
+	TArray<uint8> Compressed;
+	Compressed.SetNumUninitialized(CompressedSize);
+	if (!FCompression::CompressMemory(NAME_LZ4, Compressed.GetData(), CompressedSize, Payload.GetData(), UncompressedSize))
+	{
+		return false;
+	}
+	Compressed.SetNum(CompressedSize);
+
+	OutData.Reset();
+	FMemoryWriter Writer(OutData);
+	uint32 Magic = CheckpointMagic;
+	uint32 Version = CheckpointVersion;
+	FIntVector Resolution = Checkpoint.Resolution;
+	int32 LevelCount = Checkpoint.Levels.Num();
+	Writer << Magic << Version << Resolution << LevelCount << UncompressedSize << CompressedSize;
+	Writer.Serialize(Compressed.GetData(), CompressedSize);
+	return true;
+}
+
+bool FluidSimCheckpoint::Decode(const TArray<uint8>& Data, FFluidSimCheckpoint& OutCheckpoint)
+{
+	FMemoryReader Reader(Data);
+	uint32 Magic = 0, Version = 0;
+	int32 LevelCount = 0, UncompressedSize = 0, CompressedSize = 0;
+	Reader << Magic << Version;
+	if (Magic != CheckpointMagic || Version != CheckpointVersion)
+	{
+		return false;
+	}
+
+	Reader << OutCheckpoint.Resolution << LevelCount << UncompressedSize << CompressedSize;
+
+	const FIntVector& Resolution = OutCheckpoint.Resolution;
+	const bool bValidResolution = Resolution.X > 0 && Resolution.Y > 0 && Resolution.Z > 0 && Resolution.GetMax() <= 2048;
+	if (Reader.IsError() || !bValidResolution || LevelCount < 0 || UncompressedSize < 0 || CompressedSize < 0 || CompressedSize > Data.Num() - Reader.Tell())
+	{
+		return false;
+	}
+
+	TArray<uint8> Payload;
+	Payload.SetNumUninitialized(UncompressedSize);
+	if (!FCompression::UncompressMemory(NAME_LZ4, Payload.GetData(), UncompressedSize, Data.GetData() + Reader.Tell(), CompressedSize))
+	{
+		return false;
+	}
+
+	FMemoryReader PayloadReader(Payload);
+	OutCheckpoint.Levels.SetNum(LevelCount);
+	for (FFluidSimCheckpointLevel& Level : OutCheckpoint.Levels)
+	{
+		if (!DecodeField(PayloadReader, OutCheckpoint.Resolution, Level.Velocity, 3) ||
+			!DecodeField(PayloadReader, OutCheckpoint.Resolution, Level.Density, 1) ||
+			!DecodeField(PayloadReader, OutCheckpoint.Resolution, Level.Pressure, 1))
+		{
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,188 @@
+#include "FluidSimEventStream.h"
+
+#include "HAL/FileManager.h"
+#include "Serialization/Archive.h"
+
+namespace
+{
+	constexpr uint32 StreamMagic = 0x53455346; // "FSES"
+	constexpr uint32 StreamVersion = 2;
+
+	enum EFrameFlags : uint8
+	{
+		FrameFlag_None = 0,
+		FrameFlag_Settings = 1 << 0
+	};
+
+	void SerializeSettings(FArchive& Ar, FFluidSimCoreSettings& Settings)
+	{
+		Ar << Settings.DiffusionStrength;
+		Ar << Settings.DissipationDensity;
+		Ar << Settings.DissipationVelocity;
+		Ar << Settings.PressureIterations;
+		Ar << Settings.bWarmStartPressure;
+	}
+
+	bool IsSameSettings(const FFluidSimCoreSettings& A, const FFluidSimCoreSettings& B)
+	{
+		return A.DiffusionStrength == B.DiffusionStrength &&
+			A.DissipationDensity == B.DissipationDensity &&
+			A.DissipationVelocity == B.DissipationVelocity &&
+			A.PressureIterations == B.PressureIterations &&
+			A.bWarmStartPressure == B.bWarmStartPressure;
+	}
+}
+
+FFluidSimStreamWriter::~FFluidSimStreamWriter()
+{
+	Close();
+}
+
+void FluidSimEventStream::SerializeEvent(FArchive& Ar, FFluidSimCoreEvent& Event)
+{
+	// Types are single bits, a byte is plenty.
+	uint8 Type = static_cast<uint8>(Event.InjectionType);
+	Ar << Type;
+	Event.InjectionType = Type;
+
+	Ar << Event.Position;
+	Ar << Event.Direction;
+	Ar << Event.Strength;
+	Ar << Event.Size;
+	Ar << Event.Hardness;
+
+	uint8 Stamp = static_cast<uint8>(Event.Stamp);
+	Ar << Stamp;
+	Event.Stamp = Stamp;
+}
+
+bool FFluidSimStreamWriter::Open(const TCHAR* Path, const FFluidSimStreamHeader& InHeader)
+{
+	Close();
+
+	Archive.Reset(IFileManager::Get().CreateFileWriter(Path));
+	if (!Archive.IsValid())
+	{
+		return false;
+	}
+
+	uint32 Magic = StreamMagic;
+	uint32 Version = StreamVersion;
+	FFluidSimStreamHeader Header = InHeader;
+	*Archive << Magic << Version << Header.Resolution << Header.FrameRate;
+
+	bHasSettings = false;
+	FrameCount = 0;
+	return true;
+}
+
+void FFluidSimStreamWriter::AddFrame(const FFluidSimStreamFrame& Frame)
+{
+	if (!Archive.IsValid())
+	{
+		return;
+	}
+
+	FArchive& Ar = *Archive;
+	const bool bWriteSettings = !bHasSettings || !IsSameSettings(Frame.Settings, LastSettings);
+	uint8 Flags = bWriteSettings ? FrameFlag_Settings : FrameFlag_None;
+	Ar << Flags;
+
+	uint32 StepCount = static_cast<uint32>(FMath::Max(Frame.StepCount, 0));
+	Ar.SerializeIntPacked(StepCount);
+
+	if (bWriteSettings)
+	{
+		LastSettings = Frame.Settings;
+		bHasSettings = true;
+		SerializeSettings(Ar, LastSettings);
+	}
+
+	uint32 EventCount = Frame.Events.Num();
+	Ar.SerializeIntPacked(EventCount);
+	for (FFluidSimCoreEvent Event : Frame.Events)
+	{
+		FluidSimEventStream::SerializeEvent(Ar, Event);
+	}
+
+	FrameCount++;
+}
+
+void FFluidSimStreamWriter::Close()
+{
+	if (Archive.IsValid())
+	{
+		Archive->Close();
+		Archive.Reset();
+	}
+}
+
+FFluidSimStreamReader::~FFluidSimStreamReader()
+{
+	if (Archive.IsValid())
+	{
+		Archive->Close();
+	}
+}
+
+bool FFluidSimStreamReader::Open(const TCHAR* Path)
+{
+	Archive.Reset(IFileManager::Get().CreateFileReader(Path));
+	if (!Archive.IsValid())
+	{
+		return false;
+	}
+
+	uint32 Magic = 0;
+	uint32 Version = 0;
+	*Archive << Magic << Version;
+	if (Magic != StreamMagic || Version != StreamVersion)
+	{
+		Archive.Reset();
+		return false;
+	}
+
+	*Archive << Header.Resolution << Header.FrameRate;
+	Settings = FFluidSimCoreSettings();
+	return !Archive->IsError();
+}
+
+bool FFluidSimStreamReader::ReadFrame(FFluidSimStreamFrame& OutFrame)
+{
+	if (!Archive.IsValid() || Archive->AtEnd())
+	{
+		return false;
+	}
+
+	FArchive& Ar = *Archive;
+	uint8 Flags = 0;
+	Ar << Flags;
+
+	uint32 StepCount = 0;
+	Ar.SerializeIntPacked(StepCount);
+	OutFrame.StepCount = static_cast<int32>(StepCount);
+
+	if (Flags & FrameFlag_Settings)
+	{
+		SerializeSettings(Ar, Settings);
+	}
+	OutFrame.Settings = Settings;
+
+	uint32 EventCount = 0;
+	Ar.SerializeIntPacked(EventCount);
+	OutFrame.Events.Reset();
+
+	// A corrupt count shouldn't allocate the world, each event is at least a few bytes.
+	if (EventCount > static_cast<uint32>(Ar.TotalSize() - Ar.Tell()))
+	{
+		return false;
+	}
+
+	OutFrame.Events.SetNum(EventCount);
+	for (FFluidSimCoreEvent& Event : OutFrame.Events)
+	{
+		FluidSimEventStream::SerializeEvent(Ar, Event);
+	}
+
+	return !Ar.IsError();
+}
@@ -0,0 +1,224 @@
+#include "FluidSimLockstep.h"
+
+#include "FluidSimEventStream.h"
+#include "Misc/Compression.h"
+#include "Misc/Crc.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+namespace
+{
+	constexpr uint32 SnapshotMagic = 0x534C5346; // "FSLS"
+
+	// Hashes older than this many intervals are forgotten.
+	constexpr int32 HashHistoryLength = 8;
+
+	// Every channel a step reads, planar. Density and pressure keep the scalar in xyz, velocity's w is never read.
+	constexpr int32 StateChannels = 5;
+
+	void GatherState(const FFluidSimReferenceSolver& Solver, TArray<float>& OutState)
+	{
+		const int32 VoxelCount = Solver.GetVelocity().Data.Num();
+		OutState.SetNumUninitialized(VoxelCount * StateChannels);
+		for (int32 Index = 0; Index < VoxelCount; Index++)
+		{
+			const FVector4f& Velocity = Solver.GetVelocity().Data[Index];
+			OutState[Index] = Velocity.X;
+			OutState[VoxelCount + Index] = Velocity.Y;
+			OutState[VoxelCount * 2 + Index] = Velocity.Z;
+			OutState[VoxelCount * 3 + Index] = Solver.GetDensity().Data[Index].X;
+			OutState[VoxelCount * 4 + Index] = Solver.GetPressure().Data[Index].X;
+		}
+	}
+}
+
+FFluidSimLockstep::FFluidSimLockstep(const FIntVector& InResolution, const FFluidSimCoreSettings& InSettings, const int32 InHashInterval)
+	: Solver(InResolution)
+	, Settings(InSettings)
+	, HashInterval(InHashInterval)
+{}
+
+void FFluidSimLockstep::QueueStep(const int32 Step, TArray<FFluidSimCoreEvent>&& Events)
+{
+	if (Step >= NextStep)
+	{
+		QueuedSteps.Add(Step, MoveTemp(Events));
+	}
+}
+
+int32 FFluidSimLockstep::Advance(const int32 MaxSteps, TArray<TArray<FFluidSimCoreEvent>>* OutEvents)
+{
+	int32 StepCount = 0;
+	TArray<FFluidSimCoreEvent> Events;
+	while (StepCount < MaxSteps && QueuedSteps.RemoveAndCopyValue(NextStep, Events))
+	{
+		Solver.Step(Settings, Events);
+		NextStep++;
+		StepCount++;
+
+		if (IsHashStep(NextStep))
+		{
+			HashHistory.Add(NextStep, ComputeStateHash());
+			HashHistory.Remove(NextStep - HashInterval * HashHistoryLength);
+		}
+
+		if (OutEvents)
+		{
+			OutEvents->Add(MoveTemp(Events));
+		}
+	}
+	return StepCount;
+}
+
+bool FFluidSimLockstep::GetHash(const int32 Step, uint32& OutHash) const
+{
+	const uint32* Hash = HashHistory.Find(Step);
+	if (Hash)
+	{
+		OutHash = *Hash;
+	}
+	return Hash != nullptr;
+}
+
+uint32 FFluidSimLockstep::ComputeStateHash() const
+{
+	// Raw bits, unlike FFluidSimReferenceSolver::Checksum() a last bit difference is a desync.
+	TArray<float> State;
+	GatherState(Solver, State);
+	return FCrc::MemCrc32(State.GetData(), State.Num() * State.GetTypeSize());
+}
+
+void FFluidSimLockstep::SaveSnapshot(TArray<uint8>& OutData) const
+{
+	TArray<float> State;
+	GatherState(Solver, State);
+
+	// Planar so the empty parts of each channel compress away.
+	const int32 UncompressedSize = State.Num() * State.GetTypeSize();
+	int32 CompressedSize = FCompression::CompressMemoryBound(NAME_LZ4, UncompressedSize);
+	TArray<uint8> Compressed;
+	Compressed.SetNumUninitialized(CompressedSize);
+	if (!FCompression::CompressMemory(NAME_LZ4, Compressed.GetData(), CompressedSize, State.GetData(), UncompressedSize))
+	{
+		OutData.Reset();
+		return;
+	}
+	Compressed.SetNum(CompressedSize);
+
+	OutData.Reset();
+	FMemoryWriter Writer(OutData);
+	uint32 Magic = SnapshotMagic;
+	int32 Step = NextStep;
+	FIntVector Resolution = Solver.GetVelocity().Resolution;
+	int32 Uncompressed = UncompressedSize;
+	Writer << Magic << Step << Resolution << Uncompressed << Compressed;
+}
+
+bool FFluidSimLockstep::LoadSnapshot(const TArray<uint8>& Data)
+{
+	FMemoryReader Reader(Data);
+	uint32 Magic = 0;
+	int32 Step = 0;
+	FIntVector Resolution;
+	int32 UncompressedSize = 0;
+	TArray<uint8> Compressed;
+	Reader << Magic << Step << Resolution << UncompressedSize;
+	if (Reader.IsError() || Magic != SnapshotMagic || Resolution != Solver.GetVelocity().Resolution)
+	{
+		return false;
+	}
+
+	const int32 VoxelCount = Resolution.X * Resolution.Y * Resolution.Z;
+	if (UncompressedSize != VoxelCount * StateChannels * static_cast<int32>(sizeof(float)))
+	{
+		return false;
+	}
+
+	Reader << Compressed;
+	TArray<float> State;
+	State.SetNumUninitialized(VoxelCount * StateChannels);
+	if (Reader.IsError() || !FCompression::UncompressMemory(NAME_LZ4, State.GetData(), UncompressedSize, Compressed.GetData(), Compressed.Num()))
+	{
+		return false;
+	}
+
+	FFluidSimCoreField Velocity(Resolution), Density(Resolution), Pressure(Resolution);
+	for (int32 Index = 0; Index < VoxelCount; Index++)
+	{
+		const float DensityValue = State[VoxelCount * 3 + Index];
+		const float PressureValue = State[VoxelCount * 4 + Index];
+		Velocity.Data[Index] = FVector4f(State[Index], State[VoxelCount + Index], State[VoxelCount * 2 + Index], 1.0f);
+		Density.Data[Index] = FVector4f(DensityValue, DensityValue, DensityValue, 1.0f);
+		Pressure.Data[Index] = FVector4f(PressureValue, PressureValue, PressureValue, 1.0f);
+	}
+	Solver.SetFields(MoveTemp(Velocity), MoveTemp(Density), MoveTemp(Pressure));
+
+	// Anything queued from Step on is still needed, the hashes before it describe a state that's gone.
+	NextStep = Step;
+	for (auto It = QueuedSteps.CreateIterator(); It; ++It)
+	{
+		if (It.Key() < NextStep)
+		{
+			It.RemoveCurrent();
+		}
+	}
+	HashHistory.Reset();
+	if (IsHashStep(NextStep))
+	{
+		HashHistory.Add(NextStep, ComputeStateHash());
+	}
+	return true;
+}
+
+void FFluidSimLockstep::EncodeSteps(const int32 FirstStep, const TArray<TArray<FFluidSimCoreEvent>>& Steps, TArray<uint8>& OutData)
+{
+	OutData.Reset();
+	FMemoryWriter Writer(OutData);
+
+	int32 Step = FirstStep;
+	uint32 StepCount = Steps.Num();
+	Writer << Step;
+	Writer.SerializeIntPacked(StepCount);
+	for (const TArray<FFluidSimCoreEvent>& Events : Steps)
+	{
+		uint32 EventCount = Events.Num();
+		Writer.SerializeIntPacked(EventCount);
+		for (FFluidSimCoreEvent Event : Events)
+		{
+			FluidSimEventStream::SerializeEvent(Writer, Event);
+		}
+	}
+}
+
+bool FFluidSimLockstep::DecodeSteps(const TArray<uint8>& Data, int32& OutFirstStep, TArray<TArray<FFluidSimCoreEvent>>& OutSteps)
+{
+	FMemoryReader Reader(Data);
+
+	uint32 StepCount = 0;
+	Reader << OutFirstStep;
+	Reader.SerializeIntPacked(StepCount);
+
+	// Every step takes at least a byte, anything claiming more is corrupt.
+	if (Reader.IsError() || StepCount > static_cast<uint32>(Data.Num()))
+	{
+		return false;
+	}
+
+	OutSteps.SetNum(StepCount);
+	for (TArray<FFluidSimCoreEvent>& Events : OutSteps)
+	{
+		uint32 EventCount = 0;
+		Reader.SerializeIntPacked(EventCount);
+		if (Reader.IsError() || EventCount > static_cast<uint32>(Data.Num()))
+		{
+			return false;
+		}
+
+		Events.SetNum(EventCount);
+		for (FFluidSimCoreEvent& Event : Events)
+		{
+			FluidSimEventStream::SerializeEvent(Reader, Event);
+		}
+	}
+	return !Reader.IsError();
+}
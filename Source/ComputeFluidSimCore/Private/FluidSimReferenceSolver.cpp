@@ -0,0 +1,401 @@
+#include "FluidSimReferenceSolver.h"
+#include "FluidSimStamps.h"
+
+#include "Async/ParallelFor.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/Crc.h"
+
+namespace
+{
+	// Slices are independent in every stage, one task per Z slice like a row of thread groups.
+	template<typename FunctionType>
+	void ForEachVoxel(const FIntVector& Resolution, FunctionType&& Function)
+	{
+		ParallelFor(Resolution.Z, [&Resolution, &Function](int32 Z)
+		{
+			for (int32 Y = 0; Y < Resolution.Y; Y++)
+			{
+				for (int32 X = 0; X < Resolution.X; X++)
+				{
+					Function(FIntVector(X, Y, Z));
+				}
+			}
+		});
+	}
+
+	FVector3f AlphaBlend(const FVector3f& X, const FVector3f& Y, const float S)
+	{
+		return FMath::Lerp(X, Y, FMath::Clamp(S, 0.0f, 1.0f));
+	}
+
+	float SplatSpherical(const FVector3f& Voxel, const FFluidSimCoreEvent& Event)
+	{
+		const float Distance = (Voxel - FVector3f(Event.Position)).Size();
+		float Splat = 1.0f - Distance;
+		Splat -= 1.0f - Event.Size;
+		Splat /= Event.Size;
+		Splat /= 1.0f - Event.Hardness;
+		return FMath::Clamp(Splat, 0.0f, 1.0f) * Event.Strength;
+	}
+
+	FVector3f SplatVelocity(const FVector3f& Voxel, const FFluidSimCoreEvent& Event)
+	{
+		const FVector3f Location = Voxel - FVector3f(Event.Position);
+		const float SplatMask = 1.0f - FMath::Clamp(Location.Size() / Event.Size, 0.0f, 1.0f);
+
+		// Same small bias as the shader against normalizing a zero vector.
+		const FVector3f Radial = (Location + FVector3f(1.e-3f)).GetUnsafeNormal() * Event.Strength;
+		const FVector3f Directional = Event.Direction * Event.Strength * Event.Strength;
+
+		const FVector3f Biased = (Directional + Radial) / 2.0f;
+		return FMath::Lerp(Biased, Directional, SplatMask) * SplatMask;
+	}
+
+	float SplatFanPressure(const FVector3f& Voxel, const FFluidSimCoreEvent& Event, const FIntVector& Resolution)
+	{
+		const FVector3f Location = Voxel - FVector3f(Event.Position);
+		const float SplatMask = 1.0f - FMath::Clamp(Location.Size() / Event.Size, 0.0f, 1.0f);
+
+		const FVector3f TexSize = FVector3f(Resolution);
+		const FVector3f FieldUV = Voxel / TexSize - FVector3f(Event.Position) / TexSize;
+
+		const FVector3f PressureDir = FieldUV * Event.Direction;
+		const FVector3f InvPressureDir = FieldUV * -Event.Direction;
+
+		float Gradient = (PressureDir.X + PressureDir.Y + PressureDir.Z) / 3.0f;
+		Gradient -= (InvPressureDir.X + InvPressureDir.Y + InvPressureDir.Z) / 3.0f;
+		Gradient *= static_cast<float>(Resolution.GetMax());
+		return Gradient * SplatMask * Event.Strength;
+	}
+
+	// A stamped event placed in the domain, its axes worked out once rather than per voxel.
+	struct FPlacedStamp
+	{
+		FVector3f AxisX = FVector3f::XAxisVector;
+		FVector3f AxisY = FVector3f::YAxisVector;
+		FVector3f AxisZ = FVector3f::ZAxisVector;
+	};
+
+	// Velocity with Strength applied the way the velocity splat does and the scalar with Hardness applied the way the
+	// spherical splat does, zero outside the stamp's box.
+	FVector4f SplatStamp(const FVector3f& Voxel, const FFluidSimCoreEvent& Event, const FPlacedStamp& Placed)
+	{
+		const FVector3f Offset = (Voxel - FVector3f(Event.Position)) / Event.Size;
+		const FVector3f Local = FVector3f(FVector3f::DotProduct(Offset, Placed.AxisX), FVector3f::DotProduct(Offset, Placed.AxisY), FVector3f::DotProduct(Offset, Placed.AxisZ));
+		if (FMath::Abs(Local.X) > 1.0f || FMath::Abs(Local.Y) > 1.0f || FMath::Abs(Local.Z) > 1.0f)
+		{
+			return FVector4f(0.0f, 0.0f, 0.0f, 0.0f);
+		}
+
+		const FVector3f UVW = Local * 0.5f + 0.5f;
+		const FVector4f Texel = FluidSimStamps::Sample(Event.Stamp, UVW);
+		const FVector3f Squared = FluidSimStamps::SampleSquared(Event.Stamp, UVW);
+		const FVector3f Scaled = FVector3f(Texel) * Event.Strength + Squared * (Event.Strength * Event.Strength);
+		const FVector3f Velocity = Placed.AxisX * Scaled.X + Placed.AxisY * Scaled.Y + Placed.AxisZ * Scaled.Z;
+		const float Splat = FMath::Clamp(Texel.W / (1.0f - Event.Hardness), 0.0f, 1.0f) * Event.Strength;
+		return FVector4f(Velocity, Splat);
+	}
+
+	float SumNeighbours(const FFluidSimCoreField& Field, const FIntVector& Voxel)
+	{
+		return Field.Load(Voxel + FIntVector(1, 0, 0)).X + Field.Load(Voxel + FIntVector(-1, 0, 0)).X
+			+ Field.Load(Voxel + FIntVector(0, 1, 0)).X + Field.Load(Voxel + FIntVector(0, -1, 0)).X
+			+ Field.Load(Voxel + FIntVector(0, 0, 1)).X + Field.Load(Voxel + FIntVector(0, 0, -1)).X;
+	}
+
+	// Halved central differences, of the matching channel per axis for vectors or of the first channel for scalars.
+	FVector3f CentralDifference(const FFluidSimCoreField& Field, const FIntVector& Voxel, const bool bVector)
+	{
+		const int32 CX = 0;
+		const int32 CY = bVector ? 1 : 0;
+		const int32 CZ = bVector ? 2 : 0;
+		return FVector3f(
+			Field.Load(Voxel + FIntVector(1, 0, 0))[CX] - Field.Load(Voxel + FIntVector(-1, 0, 0))[CX],
+			Field.Load(Voxel + FIntVector(0, 1, 0))[CY] - Field.Load(Voxel + FIntVector(0, -1, 0))[CY],
+			Field.Load(Voxel + FIntVector(0, 0, 1))[CZ] - Field.Load(Voxel + FIntVector(0, 0, -1))[CZ]) / 2.0f;
+	}
+
+	struct FScopedStageTimer
+	{
+		double& Accumulator;
+		double StartTime;
+
+		explicit FScopedStageTimer(double& InAccumulator)
+			: Accumulator(InAccumulator)
+			, StartTime(FPlatformTime::Seconds())
+		{}
+
+		~FScopedStageTimer()
+		{
+			Accumulator += FPlatformTime::Seconds() - StartTime;
+		}
+	};
+}
+
+const TCHAR* LexToString(const EFluidSimCoreStage Stage)
+{
+	switch (Stage)
+	{
+	case EFluidSimCoreStage::Dissipate:		return TEXT("Dissipate");
+	case EFluidSimCoreStage::Inject:		return TEXT("Inject");
+	case EFluidSimCoreStage::Diffuse:		return TEXT("Diffuse");
+	case EFluidSimCoreStage::Divergence:	return TEXT("Divergence");
+	case EFluidSimCoreStage::Pressure:		return TEXT("Pressure");
+	case EFluidSimCoreStage::Project:		return TEXT("Project");
+	case EFluidSimCoreStage::Advect:		return TEXT("Advect");
+	default:								return TEXT("Unknown");
+	}
+}
+
+FFluidSimReferenceSolver::FFluidSimReferenceSolver(const FIntVector& InResolution)
+	: Velocity(InResolution)
+	, Density(InResolution)
+	, Pressure(InResolution)
+	, DivergenceField(InResolution)
+{}
+
+void FFluidSimReferenceSolver::Step(const FFluidSimCoreSettings& Settings, const TArray<FFluidSimCoreEvent>& Events)
+{
+	auto StageTime = [this](const EFluidSimCoreStage Stage) -> double& { return StageSeconds[static_cast<int32>(Stage)]; };
+
+	// Cleared up front so injected pressure still feeds the solve, as on the GPU.
+	if (!Settings.bWarmStartPressure)
+	{
+		Pressure.Clear();
+	}
+
+	{
+		FScopedStageTimer Timer(StageTime(EFluidSimCoreStage::Dissipate));
+		Dissipate(Density, Settings.DissipationDensity);
+		Dissipate(Velocity, Settings.DissipationVelocity);
+	}
+	{
+		FScopedStageTimer Timer(StageTime(EFluidSimCoreStage::Inject));
+		Inject(Velocity, Pressure, Density, Events);
+	}
+	{
+		FScopedStageTimer Timer(StageTime(EFluidSimCoreStage::Diffuse));
+		Diffuse(Density, Settings.DiffusionStrength);
+	}
+	{
+		FScopedStageTimer Timer(StageTime(EFluidSimCoreStage::Divergence));
+		Divergence(Velocity, DivergenceField);
+	}
+	{
+		FScopedStageTimer Timer(StageTime(EFluidSimCoreStage::Pressure));
+		for (int32 Itr = 0; Itr < Settings.PressureIterations; Itr++)
+		{
+			ProjectPressure(Pressure, DivergenceField);
+		}
+	}
+	{
+		FScopedStageTimer Timer(StageTime(EFluidSimCoreStage::Project));
+		ProjectGradient(Velocity, Pressure);
+	}
+	{
+		FScopedStageTimer Timer(StageTime(EFluidSimCoreStage::Advect));
+		Advect(Velocity, Density);
+	}
+}
+
+void FFluidSimReferenceSolver::Dissipate(FFluidSimCoreField& Field, const float Strength)
+{
+	const float Gain = 1.0f - FMath::Clamp(Strength, 0.0f, 1.0f);
+	ForEachVoxel(Field.Resolution, [&Field, Gain](const FIntVector& Voxel)
+	{
+		Field[Voxel] = Field[Voxel] * Gain;
+	});
+}
+
+void FFluidSimReferenceSolver::Inject(FFluidSimCoreField& Velocity, FFluidSimCoreField& Pressure, FFluidSimCoreField& Density, const TArray<FFluidSimCoreEvent>& Events)
+{
+	if (Events.IsEmpty()) { return; }
+
+	TArray<FPlacedStamp> Stamps;
+	Stamps.SetNum(Events.Num());
+	for (int32 Index = 0; Index < Events.Num(); Index++)
+	{
+		if (Events[Index].Stamp != FluidSimStamps::None)
+		{
+			FluidSimStamps::GetBasis(Events[Index].Direction, Stamps[Index].AxisX, Stamps[Index].AxisY, Stamps[Index].AxisZ);
+		}
+	}
+
+	ForEachVoxel(Velocity.Resolution, [&](const FIntVector& Voxel)
+	{
+		FVector4f& OutVelocity = Velocity[Voxel];
+		FVector4f& OutPressure = Pressure[Voxel];
+		FVector4f& OutDensity = Density[Voxel];
+		const FVector3f VoxelVec(Voxel);
+
+		for (int32 Index = 0; Index < Events.Num(); Index++)
+		{
+			const FFluidSimCoreEvent& Event = Events[Index];
+			if (Event.Stamp != FluidSimStamps::None)
+			{
+				// One sample feeds whichever field the event is for, fan pressure reads like pressure.
+				const FVector4f Stamp = SplatStamp(VoxelVec, Event, Stamps[Index]);
+				const float Splat = Stamp.W;
+				switch (Event.InjectionType)
+				{
+				case FluidSimCoreInjection::Velocity:
+					OutVelocity += FVector4f(Stamp.X, Stamp.Y, Stamp.Z, 1.0f);
+					break;
+				case FluidSimCoreInjection::Pressure:
+				case FluidSimCoreInjection::FanPressure:
+					OutPressure = FVector4f(AlphaBlend(FVector3f(OutPressure), FVector3f(Splat), Splat), 1.0f);
+					break;
+				case FluidSimCoreInjection::Density:
+					OutDensity = FVector4f(AlphaBlend(FVector3f(OutDensity), FVector3f(Splat), Splat), 1.0f);
+					break;
+				default:
+					break;
+				}
+				continue;
+			}
+
+			switch (Event.InjectionType)
+			{
+			case FluidSimCoreInjection::Velocity:
+				OutVelocity += FVector4f(SplatVelocity(VoxelVec, Event), 1.0f);
+				break;
+			case FluidSimCoreInjection::Pressure:
+			{
+				const float Splat = SplatSpherical(VoxelVec, Event);
+				OutPressure = FVector4f(AlphaBlend(FVector3f(OutPressure), FVector3f(Splat), Splat), 1.0f);
+				break;
+			}
+			case FluidSimCoreInjection::FanPressure:
+			{
+				const float Splat = SplatFanPressure(VoxelVec, Event, Velocity.Resolution);
+				OutPressure = FVector4f(AlphaBlend(FVector3f(OutPressure), FVector3f(Splat), FMath::Abs(Splat)), 1.0f);
+				break;
+			}
+			case FluidSimCoreInjection::Density:
+			{
+				const float Splat = SplatSpherical(VoxelVec, Event);
+				OutDensity = FVector4f(AlphaBlend(FVector3f(OutDensity), FVector3f(Splat), Splat), 1.0f);
+				break;
+			}
+			default:
+				break;
+			}
+		}
+	});
+}
+
+void FFluidSimReferenceSolver::Diffuse(FFluidSimCoreField& Field, const float DiffusionStrength)
+{
+	const float Gain = 1.0f - DiffusionStrength;
+	const FFluidSimCoreField Source = Field;
+	ForEachVoxel(Field.Resolution, [&Field, &Source, Gain](const FIntVector& Voxel)
+	{
+		const float Out = (Gain * SumNeighbours(Source, Voxel) + Source[Voxel].X) / (7.0f * Gain);
+		Field[Voxel] = FVector4f(Out, Out, Out, 1.0f);
+	});
+}
+
+void FFluidSimReferenceSolver::Divergence(const FFluidSimCoreField& Velocity, FFluidSimCoreField& OutDivergence)
+{
+	ForEachVoxel(Velocity.Resolution, [&Velocity, &OutDivergence](const FIntVector& Voxel)
+	{
+		const FVector3f Difference = CentralDifference(Velocity, Voxel, true);
+		const float Out = Difference.X + Difference.Y + Difference.Z;
+		OutDivergence[Voxel] = FVector4f(Out, Out, Out, 1.0f);
+	});
+}
+
+void FFluidSimReferenceSolver::ProjectPressure(FFluidSimCoreField& Pressure, const FFluidSimCoreField& Divergence)
+{
+	const FFluidSimCoreField Source = Pressure;
+	ForEachVoxel(Pressure.Resolution, [&Pressure, &Source, &Divergence](const FIntVector& Voxel)
+	{
+		const float Out = (SumNeighbours(Source, Voxel) - Divergence[Voxel].X) * (1.0f / 6.0f);
+		Pressure[Voxel] = FVector4f(Out, Out, Out, 1.0f);
+	});
+}
+
+void FFluidSimReferenceSolver::ProjectGradient(FFluidSimCoreField& Velocity, const FFluidSimCoreField& Pressure)
+{
+	ForEachVoxel(Velocity.Resolution, [&Velocity, &Pressure](const FIntVector& Voxel)
+	{
+		const FVector3f Gradient = CentralDifference(Pressure, Voxel, false);
+		Velocity[Voxel] = FVector4f(FVector3f(Velocity[Voxel]) - Gradient, 1.0f);
+	});
+}
+
+void FFluidSimReferenceSolver::Advect(FFluidSimCoreField& Velocity, FFluidSimCoreField& Density)
+{
+	const FFluidSimCoreField SourceVelocity = Velocity;
+	const FFluidSimCoreField SourceDensity = Density;
+	ForEachVoxel(Velocity.Resolution, [&](const FIntVector& Voxel)
+	{
+		// Whole voxel back trace, truncated toward zero like int3() in HLSL.
+		const FVector4f& Vel = SourceVelocity[Voxel];
+		const FIntVector From = Voxel - FIntVector(static_cast<int32>(Vel.X), static_cast<int32>(Vel.Y), static_cast<int32>(Vel.Z));
+		Density[Voxel] = SourceDensity.Load(From);
+		Velocity[Voxel] = SourceVelocity.Load(From);
+	});
+}
+
+void FFluidSimReferenceSolver::SetFields(FFluidSimCoreField&& InVelocity, FFluidSimCoreField&& InDensity, FFluidSimCoreField&& InPressure)
+{
+	check(InVelocity.Resolution == Velocity.Resolution && InDensity.Resolution == Density.Resolution && InPressure.Resolution == Pressure.Resolution);
+	Velocity = MoveTemp(InVelocity);
+	Density = MoveTemp(InDensity);
+	Pressure = MoveTemp(InPressure);
+}
+
+uint32 FFluidSimReferenceSolver::Checksum(const FFluidSimCoreField& Field)
+{
+	TArray<int32> Quantized;
+	Quantized.SetNumUninitialized(Field.Data.Num() * 4);
+	for (int32 Index = 0; Index < Field.Data.Num(); Index++)
+	{
+		for (int32 Channel = 0; Channel < 4; Channel++)
+		{
+			const float Value = Field.Data[Index][Channel];
+			Quantized[Index * 4 + Channel] = FMath::IsFinite(Value) ? FMath::RoundToInt(FMath::Clamp(Value, -1.e5f, 1.e5f) * 1024.0f) : MAX_int32;
+		}
+	}
+	return FCrc::MemCrc32(Quantized.GetData(), Quantized.Num() * Quantized.GetTypeSize());
+}
+
+FFluidSimCoreDiagnostics FFluidSimReferenceSolver::ComputeDiagnostics(const FFluidSimCoreField& Velocity, const FFluidSimCoreField& Density)
+{
+	// Serial so the float sums are reproducible.
+	FFluidSimCoreDiagnostics Diagnostics;
+	for (int32 Z = 0; Z < Velocity.Resolution.Z; Z++)
+	{
+		for (int32 Y = 0; Y < Velocity.Resolution.Y; Y++)
+		{
+			for (int32 X = 0; X < Velocity.Resolution.X; X++)
+			{
+				const FIntVector Voxel(X, Y, Z);
+				const FVector3f Difference = CentralDifference(Velocity, Voxel, true);
+				const float Divergence = FMath::Abs(Difference.X + Difference.Y + Difference.Z);
+				const FVector3f Vel(Velocity[Voxel]);
+
+				Diagnostics.TotalDivergence += Divergence;
+				Diagnostics.MaxDivergence = FMath::Max(Diagnostics.MaxDivergence, Divergence);
+				Diagnostics.MaxVelocity = FMath::Max(Diagnostics.MaxVelocity, Vel.Size());
+				Diagnostics.TotalDensity += Density[Voxel].X;
+				Diagnostics.KineticEnergy += 0.5f * Vel.SizeSquared();
+			}
+		}
+	}
+	return Diagnostics;
+}
+
+SIZE_T FFluidSimReferenceSolver::GetAllocatedSize() const
+{
+	return Velocity.Data.GetAllocatedSize() + Density.Data.GetAllocatedSize() + Pressure.Data.GetAllocatedSize() + DivergenceField.Data.GetAllocatedSize();
+}
+
+void FFluidSimReferenceSolver::ResetStageTimes()
+{
+	for (double& Seconds : StageSeconds)
+	{
+		Seconds = 0.0;
+	}
+}
@@ -0,0 +1,175 @@
+#include "FluidSimSequence.h"
+
+#include "Async/MappedFileHandle.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFileManager.h"
+#include "Memory/MemoryView.h"
+#include "Serialization/MemoryReader.h"
+
+namespace
+{
+	constexpr uint32 SequenceMagic = 0x51535346; // "FSSQ"
+	// 2: 64 bit frame sizes.
+	constexpr uint32 SequenceVersion = 2;
+	constexpr uint32 SequenceVersionInt32Sizes = 1;
+
+	void SerializeTable(FArchive& Ar, TArray<FFluidSimSequenceFrame>& Frames, const uint32 Version = SequenceVersion)
+	{
+		int32 Count = Frames.Num();
+		Ar << Count;
+		if (Ar.IsLoading())
+		{
+			if (Count < 0 || Count * static_cast<int64>(sizeof(FFluidSimSequenceFrame)) > Ar.TotalSize())
+			{
+				Ar.SetError();
+				return;
+			}
+			Frames.SetNum(Count);
+		}
+
+		for (FFluidSimSequenceFrame& Frame : Frames)
+		{
+			Ar << Frame.Offset;
+			if (Version == SequenceVersionInt32Sizes)
+			{
+				int32 Size = static_cast<int32>(Frame.Size);
+				Ar << Size;
+				Frame.Size = Size;
+			}
+			else
+			{
+				Ar << Frame.Size;
+			}
+			Ar << Frame.Step << Frame.Time;
+		}
+	}
+}
+
+FFluidSimSequenceWriter::~FFluidSimSequenceWriter()
+{
+	Close();
+}
+
+bool FFluidSimSequenceWriter::Open(const TCHAR* Path, const FIntVector& InResolution)
+{
+	Close();
+
+	Archive.Reset(IFileManager::Get().CreateFileWriter(Path));
+	if (!Archive.IsValid())
+	{
+		return false;
+	}
+
+	Resolution = InResolution;
+	Frames.Reset();
+
+	uint32 Magic = SequenceMagic;
+	uint32 Version = SequenceVersion;
+	*Archive << Magic << Version << Resolution;
+
+	// Patched by Close().
+	TableOffsetPosition = Archive->Tell();
+	int64 TableOffset = 0;
+	*Archive << TableOffset;
+	return true;
+}
+
+bool FFluidSimSequenceWriter::AddFrame(const int32 Step, const float Time, const FFluidSimCheckpointLevel& Frame)
+{
+	TArray<uint8> Data;
+	if (!Archive.IsValid() || !FluidSimCheckpoint::EncodeLevel(Resolution, Frame, false, Data))
+	{
+		return false;
+	}
+
+	FFluidSimSequenceFrame& Entry = Frames.AddDefaulted_GetRef();
+	Entry.Offset = Archive->Tell();
+	Entry.Size = Data.Num();
+	Entry.Step = Step;
+	Entry.Time = Time;
+	Archive->Serialize(Data.GetData(), Data.Num());
+	return !Archive->IsError();
+}
+
+void FFluidSimSequenceWriter::Close()
+{
+	if (!Archive.IsValid())
+	{
+		return;
+	}
+
+	int64 TableOffset = Archive->Tell();
+	SerializeTable(*Archive, Frames);
+	Archive->Seek(TableOffsetPosition);
+	*Archive << TableOffset;
+
+	Archive->Close();
+	Archive.Reset();
+}
+
+FFluidSimSequenceReader::FFluidSimSequenceReader() = default;
+FFluidSimSequenceReader::~FFluidSimSequenceReader() = default;
+
+bool FFluidSimSequenceReader::Open(const TCHAR* Path)
+{
+	MappedRegion.Reset();
+	MappedHandle.Reset(FPlatformFileManager::Get().GetPlatformFile().OpenMapped(Path));
+	if (!MappedHandle.IsValid())
+	{
+		return false;
+	}
+
+	MappedRegion.Reset(MappedHandle->MapRegion(0, MappedHandle->GetFileSize()));
+	if (!MappedRegion.IsValid())
+	{
+		return false;
+	}
+
+	// Baked sequences easily run past 2 GB, every offset and size stays 64 bit.
+	const TConstArrayView64<uint8> Mapped(MappedRegion->GetMappedPtr(), MappedRegion->GetMappedSize());
+	FMemoryReaderView Reader(MakeMemoryView(Mapped));
+
+	uint32 Magic = 0, Version = 0;
+	int64 TableOffset = 0;
+	Reader << Magic << Version;
+	if (Magic != SequenceMagic || (Version != SequenceVersion && Version != SequenceVersionInt32Sizes))
+	{
+		return false;
+	}
+
+	Reader << Resolution << TableOffset;
+	if (Reader.IsError() || TableOffset <= 0 || TableOffset >= Mapped.Num())
+	{
+		return false;
+	}
+
+	Reader.Seek(TableOffset);
+	SerializeTable(Reader, Frames, Version);
+	if (Reader.IsError())
+	{
+		Frames.Reset();
+		return false;
+	}
+
+	return Frames.FindByPredicate([&Mapped](const FFluidSimSequenceFrame& Frame)
+	{
+		return Frame.Offset < 0 || Frame.Size < 0 || Frame.Offset > Mapped.Num() - Frame.Size;
+	}) == nullptr;
+}
+
+bool FFluidSimSequenceReader::DecodeFrame(const int32 Index, FFluidSimCheckpointLevel& OutFrame) const
+{
+	if (!MappedRegion.IsValid() || !Frames.IsValidIndex(Index))
+	{
+		return false;
+	}
+
+	// A single level's encoding is limited to 32 bit sizes, only its place in the file isn't.
+	const FFluidSimSequenceFrame& Frame = Frames[Index];
+	if (Frame.Size > MAX_int32)
+	{
+		return false;
+	}
+	const TConstArrayView<uint8> Data(MappedRegion->GetMappedPtr() + Frame.Offset, static_cast<int32>(Frame.Size));
+	return FluidSimCheckpoint::DecodeLevel(Resolution, Data, false, OutFrame);
+}
@@ -0,0 +1,177 @@
+#include "FluidSimStamps.h"
+
+namespace
+{
+	float SmoothFalloff(const float Distance)
+	{
+		const float S = FMath::Clamp(Distance, 0.0f, 1.0f);
+		return 1.0f - S * S * (3.0f - 2.0f * S);
+	}
+
+	// A texel split by how its velocity scales with the event's Strength.
+	struct FTexel
+	{
+		FVector4f Linear = FVector4f(0.0f, 0.0f, 0.0f, 0.0f);
+		FVector3f Squared = FVector3f::ZeroVector;
+	};
+
+	// Same shape as the analytic velocity splat along +X, directional in the centre bending radial towards the edge.
+	// The splat is Lerp((X * S^2 + Radial * S) / 2, X * S^2, Mask) * Mask, its two parts baked apart. The scalar is the
+	// linear falloff the spherical splat applies Hardness to.
+	FTexel EvaluateSphere(const FVector3f& Local)
+	{
+		const float Distance = Local.Size();
+		const float Mask = 1.0f - FMath::Clamp(Distance, 0.0f, 1.0f);
+		const FVector3f Radial = (Local + FVector3f(1.e-3f)).GetUnsafeNormal();
+
+		FTexel Texel;
+		Texel.Linear = FVector4f(Radial * (Mask * (1.0f - Mask) * 0.5f), Mask);
+		Texel.Squared = FVector3f::XAxisVector * (Mask * (1.0f + Mask) * 0.5f);
+		return Texel;
+	}
+
+	// Fan from an apex at the -X face, spreading 30 degrees either side of +X and fading out towards the +X face. A jet
+	// along the stamp's direction, all of it scales like the directional splat.
+	FTexel EvaluateCone(const FVector3f& Local)
+	{
+		FTexel Texel;
+		const FVector3f FromApex = Local + FVector3f(1.0f, 0.0f, 0.0f);
+		const float Length = FromApex.Size();
+		if (Length < 1.e-3f)
+		{
+			return Texel;
+		}
+
+		const FVector3f Spread = FromApex / Length;
+		const float CosHalfAngle = FMath::Cos(FMath::DegreesToRadians(30.0f));
+		const float Angular = FMath::Clamp((Spread.X - CosHalfAngle) / (1.0f - CosHalfAngle), 0.0f, 1.0f);
+		const float Mask = Angular * (1.0f - FMath::Clamp(Length / 2.0f, 0.0f, 1.0f));
+		Texel.Linear = FVector4f(0.0f, 0.0f, 0.0f, Mask);
+		Texel.Squared = Spread * Mask;
+		return Texel;
+	}
+
+	// Blast wave, outward velocity in a shell peaking at 0.6 of the radius around a smooth ball of pressure and density.
+	// Purely radial, it scales like the radial splat.
+	FTexel EvaluateBurst(const FVector3f& Local)
+	{
+		const float Distance = Local.Size();
+		const float Shell = FMath::Clamp(1.0f - FMath::Abs(Distance - 0.6f) / 0.4f, 0.0f, 1.0f);
+		const FVector3f Radial = Distance > 1.e-3f ? Local / Distance : FVector3f::ZeroVector;
+
+		FTexel Texel;
+		Texel.Linear = FVector4f(Radial * Shell, SmoothFalloff(Distance));
+		return Texel;
+	}
+
+	FTexel Evaluate(const uint32 Stamp, const FVector3f& Local)
+	{
+		switch (Stamp)
+		{
+		case FluidSimStamps::Sphere:	return EvaluateSphere(Local);
+		case FluidSimStamps::Cone:		return EvaluateCone(Local);
+		case FluidSimStamps::Burst:		return EvaluateBurst(Local);
+		default:						return FTexel();
+		}
+	}
+
+	TArray<FFloat16Color> BuildAtlas()
+	{
+		constexpr int32 Res = FluidSimStamps::Resolution;
+		constexpr int32 SquaredOffset = Res * Res * Res * FluidSimStamps::Count;
+		TArray<FFloat16Color> Atlas;
+		Atlas.SetNumUninitialized(Res * Res * Res * FluidSimStamps::SlabCount);
+
+		int32 Index = 0;
+		for (uint32 Stamp = 1; Stamp <= FluidSimStamps::Count; Stamp++)
+		{
+			for (int32 Z = 0; Z < Res; Z++)
+			{
+				for (int32 Y = 0; Y < Res; Y++)
+				{
+					for (int32 X = 0; X < Res; X++)
+					{
+						// Texel centres, the outermost ones half a texel in from the stamp's faces.
+						const FVector3f Local = (FVector3f(X, Y, Z) + 0.5f) / static_cast<float>(Res) * 2.0f - 1.0f;
+						const FTexel Texel = Evaluate(Stamp, Local);
+						Atlas[SquaredOffset + Index] = FFloat16Color(FLinearColor(Texel.Squared.X, Texel.Squared.Y, Texel.Squared.Z, 0.0f));
+						Atlas[Index++] = FFloat16Color(FLinearColor(Texel.Linear.X, Texel.Linear.Y, Texel.Linear.Z, Texel.Linear.W));
+					}
+				}
+			}
+		}
+		return Atlas;
+	}
+
+	FVector4f Load(const TArray<FFloat16Color>& Atlas, const int32 X, const int32 Y, const int32 Z)
+	{
+		const FLinearColor Texel = Atlas[(Z * FluidSimStamps::Resolution + Y) * FluidSimStamps::Resolution + X].GetFloats();
+		return FVector4f(Texel.R, Texel.G, Texel.B, Texel.A);
+	}
+
+	FVector4f SampleSlab(const int32 Slab, const FVector3f& UVW)
+	{
+		constexpr int32 Resolution = FluidSimStamps::Resolution;
+		const TArray<FFloat16Color>& Atlas = FluidSimStamps::GetAtlas();
+		const float MaxTexel = static_cast<float>(Resolution - 1);
+		const FVector3f Texel = FVector3f(
+			FMath::Clamp(UVW.X * Resolution - 0.5f, 0.0f, MaxTexel),
+			FMath::Clamp(UVW.Y * Resolution - 0.5f, 0.0f, MaxTexel),
+			FMath::Clamp(UVW.Z * Resolution - 0.5f, 0.0f, MaxTexel));
+
+		const FIntVector Lo = FIntVector(FMath::FloorToInt(Texel.X), FMath::FloorToInt(Texel.Y), FMath::FloorToInt(Texel.Z));
+		const FIntVector Hi = FIntVector(FMath::Min(Lo.X + 1, Resolution - 1), FMath::Min(Lo.Y + 1, Resolution - 1), FMath::Min(Lo.Z + 1, Resolution - 1));
+		const FVector3f T = Texel - FVector3f(Lo);
+		const int32 SlabZ = Slab * Resolution;
+
+		auto LerpX = [&](const int32 Y, const int32 Z)
+		{
+			return FMath::Lerp(Load(Atlas, Lo.X, Y, SlabZ + Z), Load(Atlas, Hi.X, Y, SlabZ + Z), T.X);
+		};
+		const FVector4f Z0 = FMath::Lerp(LerpX(Lo.Y, Lo.Z), LerpX(Hi.Y, Lo.Z), T.Y);
+		const FVector4f Z1 = FMath::Lerp(LerpX(Lo.Y, Hi.Z), LerpX(Hi.Y, Hi.Z), T.Y);
+		return FMath::Lerp(Z0, Z1, T.Z);
+	}
+}
+
+const TArray<FFloat16Color>& FluidSimStamps::GetAtlas()
+{
+	static const TArray<FFloat16Color> Atlas = BuildAtlas();
+	return Atlas;
+}
+
+FVector4f FluidSimStamps::Sample(const uint32 Stamp, const FVector3f& UVW)
+{
+	if (Stamp == None || Stamp > Count)
+	{
+		return FVector4f(0.0f, 0.0f, 0.0f, 0.0f);
+	}
+	return SampleSlab(static_cast<int32>(Stamp - 1), UVW);
+}
+
+FVector3f FluidSimStamps::SampleSquared(const uint32 Stamp, const FVector3f& UVW)
+{
+	if (Stamp == None || Stamp > Count)
+	{
+		return FVector3f::ZeroVector;
+	}
+	return FVector3f(SampleSlab(static_cast<int32>(Count + Stamp - 1), UVW));
+}
+
+void FluidSimStamps::GetBasis(const FVector3f& Direction, FVector3f& OutX, FVector3f& OutY, FVector3f& OutZ)
+{
+	const float Length = Direction.Size();
+	if (Length < 1.e-6f)
+	{
+		OutX = FVector3f::XAxisVector;
+		OutY = FVector3f::YAxisVector;
+		OutZ = FVector3f::ZAxisVector;
+		return;
+	}
+
+	// No roll, Y stays level unless the stamp points straight up or down.
+	OutX = Direction / Length;
+	const FVector3f Up = FMath::Abs(OutX.Z) < 0.999f ? FVector3f::ZAxisVector : FVector3f::YAxisVector;
+	OutY = FVector3f::CrossProduct(Up, OutX).GetUnsafeNormal();
+	OutZ = FVector3f::CrossProduct(OutX, OutY);
+}
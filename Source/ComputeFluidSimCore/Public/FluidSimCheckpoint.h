@@ -0,0 +1,37 @@
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Math/Float16Color.h"
+
+// Full state of a simulation, every cascade level in the half float layout of its textures, unwrapped so voxel 0 is
+// the domain's corner.
+struct FFluidSimCheckpointLevel
+{
+	TArray<FFloat16Color> Velocity;
+	TArray<FFloat16Color> Density;
+	TArray<FFloat16Color> Pressure;
+};
+
+struct FFluidSimCheckpoint
+{
+	FIntVector Resolution = FIntVector::ZeroValue;
+	TArray<FFluidSimCheckpointLevel> Levels;
+
+	int32 GetVoxelCount() const { return Resolution.X * Resolution.Y * Resolution.Z; }
+};
+
+// Checkpoint file codec. Each field is cut into 8^3 bricks, bricks with nothing above EmptyThreshold are a bit in a
+// mask, the rest are quantized to 16 bits per channel between the brick's own min and max. The result is LZ4
+// compressed. Velocity keeps xyz, density and pressure one channel, w is 1 wherever a brick was stored.
+namespace FluidSimCheckpoint
+{
+	constexpr float EmptyThreshold = 1.e-4f;
+
+	COMPUTEFLUIDSIMCORE_API bool Encode(const FFluidSimCheckpoint& Checkpoint, TArray<uint8>& OutData);
+	COMPUTEFLUIDSIMCORE_API bool Decode(const TArray<uint8>& Data, FFluidSimCheckpoint& OutCheckpoint);
+
+	// One level on its own without a file header, for baked sequences. Pressure is left out unless bPressure.
+	COMPUTEFLUIDSIMCORE_API bool EncodeLevel(const FIntVector& Resolution, const FFluidSimCheckpointLevel& Level, const bool bPressure, TArray<uint8>& OutData);
+	COMPUTEFLUIDSIMCORE_API bool DecodeLevel(const FIntVector& Resolution, TConstArrayView<uint8> Data, const bool bPressure, FFluidSimCheckpointLevel& OutLevel);
+}
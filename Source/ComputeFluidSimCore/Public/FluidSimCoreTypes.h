@@ -0,0 +1,74 @@
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Injection types, must match EFluidInjectionType and FluidSimInjectionShader.usf.
+namespace FluidSimCoreInjection
+{
+	constexpr uint32 None = 0;
+	constexpr uint32 Velocity = 1;
+	constexpr uint32 Pressure = 2;
+	constexpr uint32 FanPressure = 4;
+	constexpr uint32 Density = 8;
+}
+
+// One injection event in voxels of the domain, the same layout as FFluidSimSourceShaderData and the GPU buffer.
+struct FFluidSimCoreEvent
+{
+	uint32 InjectionType = FluidSimCoreInjection::None;
+	FIntVector Position = FIntVector::ZeroValue;
+	FVector3f Direction = FVector3f::ZeroVector;
+	float Strength = 1.0f;
+	float Size = 1.0f;
+	float Hardness = 0.5f;
+
+	// FluidSimStamps index, None for the analytic splat.
+	uint32 Stamp = 0;
+};
+
+// The solver knobs the kernels read, a plain copy of the matching FFluidSolverSettings members.
+struct FFluidSimCoreSettings
+{
+	float DiffusionStrength = 0.1f;
+	float DissipationDensity = 0.05f;
+	float DissipationVelocity = 0.1f;
+	int32 PressureIterations = 8;
+	bool bWarmStartPressure = false;
+};
+
+// A dense float4 volume, linear relative to the domain. Reads outside of it are zero like the GPU's LOAD_FIELD.
+struct FFluidSimCoreField
+{
+	FIntVector Resolution = FIntVector::ZeroValue;
+	TArray<FVector4f> Data;
+
+	explicit FFluidSimCoreField(const FIntVector& InResolution = FIntVector::ZeroValue)
+		: Resolution(InResolution)
+	{
+		// Exact size, no growth slack.
+		const int32 Num = Resolution.X * Resolution.Y * Resolution.Z;
+		Data.Reserve(Num);
+		Data.AddZeroed(Num);
+	}
+
+	bool IsInDomain(const FIntVector& Voxel) const
+	{
+		return Voxel.X >= 0 && Voxel.Y >= 0 && Voxel.Z >= 0 && Voxel.X < Resolution.X && Voxel.Y < Resolution.Y && Voxel.Z < Resolution.Z;
+	}
+
+	int32 GetIndex(const FIntVector& Voxel) const
+	{
+		return (Voxel.Z * Resolution.Y + Voxel.Y) * Resolution.X + Voxel.X;
+	}
+
+	FVector4f Load(const FIntVector& Voxel) const
+	{
+		return IsInDomain(Voxel) ? Data[GetIndex(Voxel)] : FVector4f(0.0f, 0.0f, 0.0f, 0.0f);
+	}
+
+	FVector4f& operator[](const FIntVector& Voxel) { return Data[GetIndex(Voxel)]; }
+	const FVector4f& operator[](const FIntVector& Voxel) const { return Data[GetIndex(Voxel)]; }
+
+	void Clear() { FMemory::Memzero(Data.GetData(), Data.Num() * Data.GetTypeSize()); }
+};
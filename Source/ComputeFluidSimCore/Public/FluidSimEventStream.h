@@ -0,0 +1,72 @@
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FluidSimCoreTypes.h"
+
+class FArchive;
+
+// Recorded input of a simulation, the settings and injection events of every step so a run can be replayed
+// into the GPU proxy or the CPU reference solver on identical input.
+//
+// Binary, little endian. A header followed by one record per published frame, settings are only written when
+// they changed since the previous record. Resolution changes during a recording are not captured.
+
+struct FFluidSimStreamHeader
+{
+	FIntVector Resolution = FIntVector::ZeroValue;
+
+	// Frames per second the recording was made at, a fixed rate replay defaults to it.
+	float FrameRate = 60.0f;
+};
+
+namespace FluidSimEventStream
+{
+	// Bit exact, also the wire format of lockstep events.
+	COMPUTEFLUIDSIMCORE_API void SerializeEvent(FArchive& Ar, FFluidSimCoreEvent& Event);
+}
+
+// One published frame, the events go into the first of its steps. Zero steps carries events over to the next frame.
+struct FFluidSimStreamFrame
+{
+	int32 StepCount = 0;
+	FFluidSimCoreSettings Settings;
+	TArray<FFluidSimCoreEvent> Events;
+};
+
+class COMPUTEFLUIDSIMCORE_API FFluidSimStreamWriter
+{
+public:
+	~FFluidSimStreamWriter();
+
+	bool Open(const TCHAR* Path, const FFluidSimStreamHeader& InHeader);
+	void AddFrame(const FFluidSimStreamFrame& Frame);
+	void Close();
+
+	bool IsOpen() const { return Archive.IsValid(); }
+	int32 GetFrameCount() const { return FrameCount; }
+
+private:
+	TUniquePtr<FArchive> Archive;
+	FFluidSimCoreSettings LastSettings;
+	bool bHasSettings = false;
+	int32 FrameCount = 0;
+};
+
+class COMPUTEFLUIDSIMCORE_API FFluidSimStreamReader
+{
+public:
+	~FFluidSimStreamReader();
+
+	bool Open(const TCHAR* Path);
+
+	// False at the end of the stream or on a truncated record.
+	bool ReadFrame(FFluidSimStreamFrame& OutFrame);
+
+	const FFluidSimStreamHeader& GetHeader() const { return Header; }
+
+private:
+	TUniquePtr<FArchive> Archive;
+	FFluidSimStreamHeader Header;
+	FFluidSimCoreSettings Settings;
+};
@@ -0,0 +1,56 @@
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FluidSimReferenceSolver.h"
+
+// Deterministic stepping for multiplayer. Every peer steps the CPU reference on the same ordered events at a fixed
+// rate, so only the events and an occasional hash of the fields have to cross the network. Bitwise reproducible for
+// one build on one architecture: every voxel is computed by one thread from fixed inputs, nothing is reduced across
+// threads and the pressure iteration count never adapts.
+class COMPUTEFLUIDSIMCORE_API FFluidSimLockstep
+{
+public:
+	FFluidSimLockstep(const FIntVector& InResolution, const FFluidSimCoreSettings& InSettings, const int32 InHashInterval);
+
+	// Events of one step in the order the authority applied them. A step without events still has to be queued, the
+	// solver only runs a step once it has its full event list. Steps already run are ignored.
+	void QueueStep(const int32 Step, TArray<FFluidSimCoreEvent>&& Events);
+
+	// Runs queued steps in order until one is missing or MaxSteps ran, the events of every step run are appended to
+	// OutEvents when given. Returns the number of steps run.
+	int32 Advance(const int32 MaxSteps, TArray<TArray<FFluidSimCoreEvent>>* OutEvents = nullptr);
+
+	// Next step to run.
+	int32 GetStep() const { return NextStep; }
+
+	// Later steps are queued but the next one never arrived, only a snapshot can fill the gap.
+	bool IsMissingSteps() const { return QueuedSteps.Num() > 0 && !QueuedSteps.Contains(NextStep); }
+
+	// Hash of the state after every HashInterval-th step, kept for a while so a late or early peer can still compare.
+	bool GetHash(const int32 Step, uint32& OutHash) const;
+	bool IsHashStep(const int32 Step) const { return HashInterval > 0 && Step % HashInterval == 0; }
+
+	// Exact hash of everything that feeds the next step, velocity xyz and the density and pressure scalars.
+	uint32 ComputeStateHash() const;
+
+	// Lossless, the state and the step it's at. Loading drops queued steps it already covers.
+	void SaveSnapshot(TArray<uint8>& OutData) const;
+	bool LoadSnapshot(const TArray<uint8>& Data);
+
+	// Compact wire format of one or more steps' events, floats are sent bit exact.
+	static void EncodeSteps(const int32 FirstStep, const TArray<TArray<FFluidSimCoreEvent>>& Steps, TArray<uint8>& OutData);
+	static bool DecodeSteps(const TArray<uint8>& Data, int32& OutFirstStep, TArray<TArray<FFluidSimCoreEvent>>& OutSteps);
+
+	const FFluidSimReferenceSolver& GetSolver() const { return Solver; }
+	const FFluidSimCoreSettings& GetSettings() const { return Settings; }
+
+private:
+	FFluidSimReferenceSolver Solver;
+	FFluidSimCoreSettings Settings;
+	int32 HashInterval = 0;
+	int32 NextStep = 0;
+
+	TMap<int32, TArray<FFluidSimCoreEvent>> QueuedSteps;
+	TMap<int32, uint32> HashHistory;
+};
@@ -0,0 +1,76 @@
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FluidSimCoreTypes.h"
+
+enum class EFluidSimCoreStage : uint8
+{
+	Dissipate = 0,
+	Inject,
+	Diffuse,
+	Divergence,
+	Pressure,
+	Project,
+	Advect,
+	Num
+};
+
+COMPUTEFLUIDSIMCORE_API const TCHAR* LexToString(const EFluidSimCoreStage Stage);
+
+// Same quantities as FFluidSimDiagnostics, reduced on the CPU.
+struct FFluidSimCoreDiagnostics
+{
+	float TotalDivergence = 0.0f;
+	float MaxDivergence = 0.0f;
+	float MaxVelocity = 0.0f;
+	float TotalDensity = 0.0f;
+	float KineticEnergy = 0.0f;
+};
+
+// CPU reference of every kernel in FluidSimShader.usf and FluidSimInjectionShader.usf, one dense level, no scrolling.
+// Stages run in the order of FFluidSimRenderProxy::DispatchRenderThread(). Where a GPU kernel reads the field it's
+// writing the reference reads a copy of it instead, so it matches a race free (Jacobi) version of that kernel.
+class COMPUTEFLUIDSIMCORE_API FFluidSimReferenceSolver
+{
+public:
+	explicit FFluidSimReferenceSolver(const FIntVector& InResolution);
+
+	void Step(const FFluidSimCoreSettings& Settings, const TArray<FFluidSimCoreEvent>& Events);
+
+	// Stages
+	static void Dissipate(FFluidSimCoreField& Field, const float Strength);
+	static void Inject(FFluidSimCoreField& Velocity, FFluidSimCoreField& Pressure, FFluidSimCoreField& Density, const TArray<FFluidSimCoreEvent>& Events);
+	static void Diffuse(FFluidSimCoreField& Field, const float DiffusionStrength);
+	static void Divergence(const FFluidSimCoreField& Velocity, FFluidSimCoreField& OutDivergence);
+	static void ProjectPressure(FFluidSimCoreField& Pressure, const FFluidSimCoreField& Divergence);
+	static void ProjectGradient(FFluidSimCoreField& Velocity, const FFluidSimCoreField& Pressure);
+	static void Advect(FFluidSimCoreField& Velocity, FFluidSimCoreField& Density);
+
+	// Order independent of threading, quantized so last bit float differences between compilers don't show.
+	static uint32 Checksum(const FFluidSimCoreField& Field);
+	static FFluidSimCoreDiagnostics ComputeDiagnostics(const FFluidSimCoreField& Velocity, const FFluidSimCoreField& Density);
+
+	const FFluidSimCoreField& GetVelocity() const { return Velocity; }
+	const FFluidSimCoreField& GetDensity() const { return Density; }
+	const FFluidSimCoreField& GetPressure() const { return Pressure; }
+	const FFluidSimCoreField& GetDivergence() const { return DivergenceField; }
+
+	// Replaces the persistent fields, they have to be at the solver's resolution.
+	void SetFields(FFluidSimCoreField&& InVelocity, FFluidSimCoreField&& InDensity, FFluidSimCoreField&& InPressure);
+
+	// Persistent fields, the stages add up to two more fields of scratch while they run.
+	SIZE_T GetAllocatedSize() const;
+
+	// Seconds spent in each stage since construction or the last reset.
+	double GetStageSeconds(const EFluidSimCoreStage Stage) const { return StageSeconds[static_cast<int32>(Stage)]; }
+	void ResetStageTimes();
+
+private:
+	FFluidSimCoreField Velocity;
+	FFluidSimCoreField Density;
+	FFluidSimCoreField Pressure;
+	FFluidSimCoreField DivergenceField;
+
+	double StageSeconds[static_cast<int32>(EFluidSimCoreStage::Num)] = {};
+};
@@ -0,0 +1,67 @@
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FluidSimCheckpoint.h"
+
+class IMappedFileHandle;
+class IMappedFileRegion;
+
+// Baked frame sequence, velocity and density of the finest level's outputs once per frame in the checkpoint brick
+// encoding. A header, the frames back to back and a frame table at the end so frames can be written as they arrive.
+struct FFluidSimSequenceFrame
+{
+	int64 Offset = 0;
+	int64 Size = 0;
+
+	// Simulation step the frame was taken at and its time in seconds since the first frame.
+	int32 Step = 0;
+	float Time = 0.0f;
+};
+
+class COMPUTEFLUIDSIMCORE_API FFluidSimSequenceWriter
+{
+public:
+	~FFluidSimSequenceWriter();
+
+	bool Open(const TCHAR* Path, const FIntVector& InResolution);
+
+	// Encodes on the calling thread, frames have to be added in order.
+	bool AddFrame(const int32 Step, const float Time, const FFluidSimCheckpointLevel& Frame);
+
+	// Writes the frame table, the file isn't readable before.
+	void Close();
+
+	bool IsOpen() const { return Archive.IsValid(); }
+
+private:
+	TUniquePtr<FArchive> Archive;
+	FIntVector Resolution = FIntVector::ZeroValue;
+	TArray<FFluidSimSequenceFrame> Frames;
+	int64 TableOffsetPosition = 0;
+};
+
+// Memory maps the file, frames decode straight out of the mapping and can be decoded from any thread.
+class COMPUTEFLUIDSIMCORE_API FFluidSimSequenceReader
+{
+public:
+	FFluidSimSequenceReader();
+	~FFluidSimSequenceReader();
+
+	bool Open(const TCHAR* Path);
+
+	bool DecodeFrame(const int32 Index, FFluidSimCheckpointLevel& OutFrame) const;
+
+	const FIntVector& GetResolution() const { return Resolution; }
+	int32 GetFrameCount() const { return Frames.Num(); }
+	const FFluidSimSequenceFrame& GetFrame(const int32 Index) const { return Frames[Index]; }
+
+	float GetDuration() const { return Frames.Num() > 0 ? Frames.Last().Time : 0.0f; }
+
+private:
+	TUniquePtr<IMappedFileHandle> MappedHandle;
+	TUniquePtr<IMappedFileRegion> MappedRegion;
+
+	FIntVector Resolution = FIntVector::ZeroValue;
+	TArray<FFluidSimSequenceFrame> Frames;
+};
@@ -0,0 +1,39 @@
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Math/Float16Color.h"
+
+// Precomputed injection shapes. An event with a stamp reads its shape from a small volume instead of evaluating the
+// analytic splat, the stamp is centred on the event, spans Size voxels either side and turns with the event's
+// Direction. Velocities are in the stamp's own axes, +X along Direction.
+//
+// Velocity follows the analytic splat's law, the push along Direction scales with Strength^2 and the spread around it
+// with Strength. Every stamp has two Resolution^3 slabs, the first holds the velocity scaled by Strength and the scalar
+// for pressure and density, the second the velocity scaled by Strength^2. The atlas stacks every stamp's first slab
+// along Z in index order followed by every second slab, the half float layout of the GPU texture. The CPU reference
+// solver samples the same half floats so both read identical texels.
+namespace FluidSimStamps
+{
+	constexpr int32 Resolution = 32;
+
+	// Must match EFluidSimStamp and FluidSimInjectionShader.usf. None is the analytic splat and has no slab.
+	constexpr uint32 None = 0;
+	constexpr uint32 Sphere = 1;
+	constexpr uint32 Cone = 2;
+	constexpr uint32 Burst = 3;
+	constexpr uint32 Count = 3;
+	constexpr uint32 SlabCount = Count * 2;
+
+	// Built on first use, Resolution x Resolution x (Resolution * SlabCount).
+	COMPUTEFLUIDSIMCORE_API const TArray<FFloat16Color>& GetAtlas();
+	inline FIntVector GetAtlasSize() { return FIntVector(Resolution, Resolution, Resolution * SlabCount); }
+
+	// Trilinear like the hardware sampler, clamped to the slab. UVW is 0...1 across the stamp. Sample() reads the
+	// velocity scaled by Strength and the scalar, SampleSquared() the velocity scaled by Strength^2.
+	COMPUTEFLUIDSIMCORE_API FVector4f Sample(const uint32 Stamp, const FVector3f& UVW);
+	COMPUTEFLUIDSIMCORE_API FVector3f SampleSquared(const uint32 Stamp, const FVector3f& UVW);
+
+	// Axes of a stamp placed along Direction, the identity for a zero Direction. Same construction as the shader.
+	COMPUTEFLUIDSIMCORE_API void GetBasis(const FVector3f& Direction, FVector3f& OutX, FVector3f& OutY, FVector3f& OutZ);
+}
@@ -0,0 +1,24 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+using UnrealBuildTool;
+
+// Headless CPU benchmark of the solver, no engine, no RHI.
+[SupportedPlatforms(UnrealPlatformClass.Desktop)]
+public class FluidSimBenchmarkTarget : TargetRules
+{
+	public FluidSimBenchmarkTarget(TargetInfo Target) : base(Target)
+	{
+		Type = TargetType.Program;
+		LinkType = TargetLinkType.Monolithic;
+		LaunchModuleName = "FluidSimBenchmark";
+
+		bBuildDeveloperTools = false;
+		bCompileAgainstEngine = false;
+		bCompileAgainstCoreUObject = false;
+		bCompileAgainstApplicationCore = false;
+		bCompileICU = false;
+
+		bIsBuildingConsoleApplication = true;
+		bUseLoggingInShipping = true;
+	}
+}
@@ -0,0 +1,273 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "RequiredProgramMainCPPInclude.h"
+#include "FluidSimEventStream.h"
+#include "FluidSimReferenceSolver.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogFluidSimBenchmark, Log, All);
+
+IMPLEMENT_APPLICATION(FluidSimBenchmark, "FluidSimBenchmark");
+
+// Runs fixed scenarios through the CPU reference solver and writes one CSV row per scenario and resolution,
+// per stage milliseconds per step plus checksums of the final fields so two runs can be diffed.
+//
+// FluidSimBenchmark [-Res=32,64,128,256] [-Steps=16] [-Iterations=8] [-Scenario=Plume] [-Out=Path.csv]
+//
+// With -Replay a stream recorded by FluidSim.Record is stepped instead, one row per step with its time and checksums.
+// Frames run back to back unless -Rate paces them in frames per second.
+//
+// FluidSimBenchmark -Replay=Path.fses [-Rate=60] [-Out=Path.csv]
+
+namespace FluidSimBenchmark
+{
+	// Events of one step, positions as fractions of the domain so every resolution sees the same setup.
+	typedef TArray<FFluidSimCoreEvent>(*FScenarioEvents)(const FIntVector& Resolution, const int32 Step);
+
+	struct FScenario
+	{
+		const TCHAR* Name;
+		FScenarioEvents Events;
+	};
+
+	FFluidSimCoreEvent MakeEvent(const uint32 Type, const FIntVector& Resolution, const FVector3f& Position, const FVector3f& Direction, const float Strength, const float Size)
+	{
+		FFluidSimCoreEvent Event;
+		Event.InjectionType = Type;
+		const FVector3f Voxel = FVector3f(Resolution) * Position;
+		Event.Position = FIntVector(FMath::FloorToInt32(Voxel.X), FMath::FloorToInt32(Voxel.Y), FMath::FloorToInt32(Voxel.Z));
+		Event.Direction = Direction;
+		Event.Strength = Strength;
+		Event.Size = Size * static_cast<float>(Resolution.GetMax());
+		Event.Hardness = 0.5f;
+		return Event;
+	}
+
+	// Continuous source rising from the floor.
+	TArray<FFluidSimCoreEvent> Plume(const FIntVector& Resolution, const int32 Step)
+	{
+		const FVector3f Source(0.5f, 0.5f, 0.1f);
+		return {
+			MakeEvent(FluidSimCoreInjection::Density, Resolution, Source, FVector3f::UpVector, 1.0f, 0.1f),
+			MakeEvent(FluidSimCoreInjection::Velocity, Resolution, Source, FVector3f::UpVector, 1.5f, 0.1f)
+		};
+	}
+
+	// One pressure burst in the centre, then free decay.
+	TArray<FFluidSimCoreEvent> Burst(const FIntVector& Resolution, const int32 Step)
+	{
+		if (Step > 0) { return {}; }
+
+		const FVector3f Centre(0.5f, 0.5f, 0.5f);
+		return {
+			MakeEvent(FluidSimCoreInjection::Density, Resolution, Centre, FVector3f::ZeroVector, 1.0f, 0.2f),
+			MakeEvent(FluidSimCoreInjection::Pressure, Resolution, Centre, FVector3f::ZeroVector, 4.0f, 0.2f)
+		};
+	}
+
+	// Two opposing jets meeting in the middle, stresses the pressure solve.
+	TArray<FFluidSimCoreEvent> Crossflow(const FIntVector& Resolution, const int32 Step)
+	{
+		const FVector3f Left(0.15f, 0.5f, 0.5f);
+		const FVector3f Right(0.85f, 0.5f, 0.5f);
+		return {
+			MakeEvent(FluidSimCoreInjection::Density, Resolution, Left, FVector3f::ZeroVector, 1.0f, 0.08f),
+			MakeEvent(FluidSimCoreInjection::Velocity, Resolution, Left, FVector3f::ForwardVector, 1.5f, 0.08f),
+			MakeEvent(FluidSimCoreInjection::Velocity, Resolution, Right, FVector3f::BackwardVector, 1.5f, 0.08f),
+			MakeEvent(FluidSimCoreInjection::FanPressure, Resolution, Right, FVector3f::BackwardVector, 0.5f, 0.08f)
+		};
+	}
+
+	const FScenario Scenarios[] =
+	{
+		{ TEXT("Plume"), &Plume },
+		{ TEXT("Burst"), &Burst },
+		{ TEXT("Crossflow"), &Crossflow },
+	};
+
+	FString FormatHeader()
+	{
+		FString Header = TEXT("Scenario,Resolution,Steps,PressureIterations");
+		for (int32 Stage = 0; Stage < static_cast<int32>(EFluidSimCoreStage::Num); Stage++)
+		{
+			Header += FString::Printf(TEXT(",%sMs"), LexToString(static_cast<EFluidSimCoreStage>(Stage)));
+		}
+		Header += TEXT(",TotalMs,VelocityChecksum,DensityChecksum,PressureChecksum,TotalDensity,KineticEnergy,MaxDivergence\n");
+		return Header;
+	}
+
+	FString RunScenario(const FScenario& Scenario, const int32 Resolution, const int32 Steps, const FFluidSimCoreSettings& Settings)
+	{
+		const FIntVector Size(Resolution);
+		FFluidSimReferenceSolver Solver(Size);
+
+		for (int32 Step = 0; Step < Steps; Step++)
+		{
+			Solver.Step(Settings, Scenario.Events(Size, Step));
+		}
+
+		FString Row = FString::Printf(TEXT("%s,%d,%d,%d"), Scenario.Name, Resolution, Steps, Settings.PressureIterations);
+		double TotalMs = 0.0;
+		for (int32 Stage = 0; Stage < static_cast<int32>(EFluidSimCoreStage::Num); Stage++)
+		{
+			const double StageMs = Solver.GetStageSeconds(static_cast<EFluidSimCoreStage>(Stage)) * 1000.0 / Steps;
+			Row += FString::Printf(TEXT(",%.3f"), StageMs);
+			TotalMs += StageMs;
+		}
+
+		const FFluidSimCoreDiagnostics Diagnostics = FFluidSimReferenceSolver::ComputeDiagnostics(Solver.GetVelocity(), Solver.GetDensity());
+		Row += FString::Printf(TEXT(",%.3f,%08x,%08x,%08x,%f,%f,%f\n"),
+			TotalMs,
+			FFluidSimReferenceSolver::Checksum(Solver.GetVelocity()),
+			FFluidSimReferenceSolver::Checksum(Solver.GetDensity()),
+			FFluidSimReferenceSolver::Checksum(Solver.GetPressure()),
+			Diagnostics.TotalDensity,
+			Diagnostics.KineticEnergy,
+			Diagnostics.MaxDivergence);
+
+		UE_LOG(LogFluidSimBenchmark, Display, TEXT("%s %d^3: %.3f ms/step"), Scenario.Name, Resolution, TotalMs);
+		return Row;
+	}
+
+	bool Replay(const FString& StreamPath, const float Rate, FString& OutCsv)
+	{
+		FFluidSimStreamReader Reader;
+		if (!Reader.Open(*StreamPath))
+		{
+			UE_LOG(LogFluidSimBenchmark, Error, TEXT("Failed to open stream '%s'."), *StreamPath);
+			return false;
+		}
+
+		const FIntVector Resolution = Reader.GetHeader().Resolution;
+		FFluidSimReferenceSolver Solver(Resolution);
+
+		OutCsv = TEXT("Frame,Step,Events,PressureIterations,StepMs,VelocityChecksum,DensityChecksum,PressureChecksum\n");
+
+		TArray<FFluidSimCoreEvent> PendingEvents;
+		FFluidSimStreamFrame Frame;
+		int32 FrameIndex = 0;
+		int32 StepIndex = 0;
+		double TotalMs = 0.0;
+		double NextFrameTime = FPlatformTime::Seconds();
+		while (Reader.ReadFrame(Frame))
+		{
+			// Same as the proxy, events published without a step wait for the next one.
+			PendingEvents.Append(Frame.Events);
+
+			for (int32 Step = 0; Step < Frame.StepCount; Step++)
+			{
+				const double StartTime = FPlatformTime::Seconds();
+				Solver.Step(Frame.Settings, PendingEvents);
+				const double StepMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+				TotalMs += StepMs;
+
+				OutCsv += FString::Printf(TEXT("%d,%d,%d,%d,%.3f,%08x,%08x,%08x\n"),
+					FrameIndex, StepIndex++, PendingEvents.Num(), Frame.Settings.PressureIterations, StepMs,
+					FFluidSimReferenceSolver::Checksum(Solver.GetVelocity()),
+					FFluidSimReferenceSolver::Checksum(Solver.GetDensity()),
+					FFluidSimReferenceSolver::Checksum(Solver.GetPressure()));
+				PendingEvents.Reset();
+			}
+
+			if (Rate > 0.0f)
+			{
+				NextFrameTime += 1.0 / Rate;
+				const double Wait = NextFrameTime - FPlatformTime::Seconds();
+				if (Wait > 0.0)
+				{
+					FPlatformProcess::Sleep(static_cast<float>(Wait));
+				}
+			}
+			FrameIndex++;
+		}
+
+		UE_LOG(LogFluidSimBenchmark, Display, TEXT("Replayed %d frames, %d steps at %s: %.3f ms/step"),
+			FrameIndex, StepIndex, *Resolution.ToString(), StepIndex > 0 ? TotalMs / StepIndex : 0.0);
+		return true;
+	}
+
+	int32 Run(const TCHAR* CommandLine)
+	{
+		FString ResolutionList = TEXT("32,64,128,256");
+		FParse::Value(CommandLine, TEXT("-Res="), ResolutionList);
+
+		int32 Steps = 16;
+		FParse::Value(CommandLine, TEXT("-Steps="), Steps);
+		Steps = FMath::Max(Steps, 1);
+
+		FFluidSimCoreSettings Settings;
+		FParse::Value(CommandLine, TEXT("-Iterations="), Settings.PressureIterations);
+
+		FString ScenarioFilter;
+		FParse::Value(CommandLine, TEXT("-Scenario="), ScenarioFilter);
+
+		FString OutputPath = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("FluidSimBenchmark.csv"));
+		FParse::Value(CommandLine, TEXT("-Out="), OutputPath);
+
+		FString StreamPath;
+		if (FParse::Value(CommandLine, TEXT("-Replay="), StreamPath))
+		{
+			float Rate = 0.0f;
+			FParse::Value(CommandLine, TEXT("-Rate="), Rate);
+
+			FString Csv;
+			if (!Replay(StreamPath, Rate, Csv))
+			{
+				return 1;
+			}
+			if (!FParse::Value(CommandLine, TEXT("-Out="), OutputPath))
+			{
+				OutputPath = FPaths::ChangeExtension(StreamPath, TEXT("")) + TEXT("_Replay.csv");
+			}
+			return FFileHelper::SaveStringToFile(Csv, *OutputPath) ? 0 : 1;
+		}
+
+		TArray<FString> ResolutionStrings;
+		ResolutionList.ParseIntoArray(ResolutionStrings, TEXT(","));
+
+		FString Csv = FormatHeader();
+		for (const FScenario& Scenario : Scenarios)
+		{
+			if (!ScenarioFilter.IsEmpty() && ScenarioFilter != Scenario.Name) { continue; }
+
+			for (const FString& ResolutionString : ResolutionStrings)
+			{
+				const int32 Resolution = FCString::Atoi(*ResolutionString);
+				if (Resolution < 8)
+				{
+					UE_LOG(LogFluidSimBenchmark, Warning, TEXT("Skipping resolution '%s'."), *ResolutionString);
+					continue;
+				}
+				Csv += RunScenario(Scenario, Resolution, Steps, Settings);
+			}
+		}
+
+		if (!FFileHelper::SaveStringToFile(Csv, *OutputPath))
+		{
+			UE_LOG(LogFluidSimBenchmark, Error, TEXT("Failed to write '%s'."), *OutputPath);
+			return 1;
+		}
+
+		UE_LOG(LogFluidSimBenchmark, Display, TEXT("Wrote '%s'."), *OutputPath);
+		return 0;
+	}
+}
+
+INT32_MAIN_INT32_ARGC_TCHAR_ARGV()
+{
+	FTaskTagScope Scope(ETaskTag::EGameThread);
+	ON_SCOPE_EXIT
+	{
+		LLM(FLowLevelMemTracker::Get().UpdateStatsPerFrame());
+		RequestEngineExit(TEXT("Exiting"));
+		FEngineLoop::AppPreExit();
+		FModuleManager::Get().UnloadModulesAtShutdown();
+		FEngineLoop::AppExit();
+	};
+
+	if (int32 Ret = GEngineLoop.PreInit(ArgC, ArgV))
+	{
+		return Ret;
+	}
+
+	return FluidSimBenchmark::Run(FCommandLine::Get());
+}